@@ -0,0 +1,9 @@
+include(../Examples.pri)
+
+SOURCES += Main.cpp
+
+LIBS += $$LIB_RADIANT $$LIB_NIMBLE $$LIB_PATTERNS
+
+win32 {
+	CONFIG += console
+}
@@ -0,0 +1,120 @@
+#include <Radiant/BinaryData.hpp>
+#include <Radiant/TimeStamp.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Radiant;
+
+/* Writes a message that resembles the typical control traffic: an
+   address string, a few small integers, parameter values and a
+   timestamp. */
+void writeMessage(BinaryData & data, int i, const float * samples)
+{
+  data.writeString("/control/panner/source");
+  data.writeInt32(i & 0xFF);
+  data.writeInt32(3);
+  data.writeFloat32(0.5f * i);
+  data.writeFloat64(1.0 / (i + 1));
+  data.writeVector2Float32(Nimble::Vector2f(i, 2 * i));
+  data.writeVector3Int32(Nimble::Vector3i(i, -i, 7));
+  data.writeTimeStamp(TimeStamp::getTime());
+  data.writeWString(L"\x00e4\x00e4nil\x00e4hde");
+  data.writeFloat32Array(samples, 16);
+  data.writeInt64(int64_t(i) << 40);
+}
+
+bool readMessage(BinaryData & data, int i, const float * samples)
+{
+  bool ok = true;
+  bool good = true;
+  std::string str;
+  std::wstring wstr;
+  std::vector<float> arr;
+
+  good = data.readString(str) && str == "/control/panner/source" && good;
+  good = data.readInt32( & ok) == (i & 0xFF) && ok && good;
+  good = data.readInt32( & ok) == 3 && ok && good;
+  good = data.readFloat32( & ok) == 0.5f * i && ok && good;
+  good = data.readFloat64( & ok) == 1.0 / (i + 1) && ok && good;
+  good = data.readVector2Float32( & ok) == Nimble::Vector2f(i, 2 * i) &&
+         ok && good;
+  good = data.readVector3Int32( & ok) == Nimble::Vector3i(i, -i, 7) &&
+         ok && good;
+  data.readTimeStamp( & ok);
+  good = ok && good;
+  good = data.readWString(wstr) && wstr == L"\x00e4\x00e4nil\x00e4hde" && good;
+  good = data.readFloat32Array(arr) && arr.size() == 16 &&
+         memcmp( & arr[0], samples, 16 * sizeof(float)) == 0 && good;
+  good = data.readInt64( & ok) == (int64_t(i) << 40) && ok && good;
+
+  return good;
+}
+
+void benchmark(BinaryData::Format format, const char * name, int iterations)
+{
+  float samples[16];
+  for(int i = 0; i < 16; i++)
+    samples[i] = i * 0.125f;
+
+  BinaryData data;
+  data.setFormat(format);
+
+  // Round-trip check, also warms up the buffer
+  int errors = 0;
+  for(int i = 0; i < 1000; i++) {
+    data.rewind();
+    writeMessage(data, i, samples);
+    data.rewind();
+    if(!readMessage(data, i, samples))
+      errors++;
+  }
+
+  data.rewind();
+  writeMessage(data, 1, samples);
+  int bytes = data.pos();
+
+  TimeStamp start = TimeStamp::getTime();
+
+  for(int i = 0; i < iterations; i++) {
+    data.rewind();
+    writeMessage(data, i, samples);
+  }
+
+  double writeTime = TimeStamp(TimeStamp::getTime() - start).secondsD();
+
+  start = TimeStamp::getTime();
+
+  for(int i = 0; i < iterations; i++) {
+    data.rewind();
+    if(!readMessage(data, iterations - 1, samples))
+      errors++;
+  }
+
+  double readTime = TimeStamp(TimeStamp::getTime() - start).secondsD();
+
+  printf("%-9s %4d bytes/message, write %6.1f ns/message, read %6.1f ns/message, "
+         "%d round-trip errors\n", name, bytes,
+         writeTime * 1.0e9 / iterations, readTime * 1.0e9 / iterations, errors);
+}
+
+int main(int argc, char ** argv)
+{
+  int iterations = 1000000;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--iterations") == 0 && (i + 1) < argc)
+      iterations = atoi(argv[++i]);
+    else {
+      printf("%s # Unknown argument \"%s\"\n", argv[0], argv[i]);
+      printf("Usage: %s [--iterations N]\n", argv[0]);
+      return -1;
+    }
+  }
+
+  benchmark(BinaryData::FORMAT_STANDARD, "standard", iterations);
+  benchmark(BinaryData::FORMAT_COMPACT, "compact", iterations);
+
+  return 0;
+}
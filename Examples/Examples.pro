@@ -2,9 +2,13 @@ TEMPLATE = subdirs
 
 SUBDIRS += AudioPanning
 SUBDIRS += AmbientSounds
+SUBDIRS += BinaryDataBenchmark
 SUBDIRS += ConfigConversion
+SUBDIRS += ImageConversion
 SUBDIRS += ImageExample
+SUBDIRS += ImageScaling
 SUBDIRS += PlatformExample
+SUBDIRS += SampleMixing
 !win32:SUBDIRS += SamplePlayer
 unix:SUBDIRS += SharedMemory
 SUBDIRS += SocketExample
@@ -0,0 +1,380 @@
+/* Micro-benchmark for the video image conversions that the capture
+   threads use. Each conversion is run on 1080p frames with the code
+   that ImageConversion used before the line kernels (the baseline),
+   with the plain C++ code, with the SIMD code that the CPU supports,
+   and with the SIMD code split over the shared thread pool. The
+   throughput is reported in megabytes (of the source frame) per
+   second. */
+
+#include <Radiant/CPUInfo.hpp>
+#include <Radiant/ImageConversion.hpp>
+#include <Radiant/ThreadPool.hpp>
+#include <Radiant/TimeStamp.hpp>
+#include <Radiant/Trace.hpp>
+#include <Radiant/VideoImage.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Radiant;
+
+/* The original scalar conversions of ImageConversion, kept here as the
+   baseline. There was no bilinear Bayer demosaic. */
+namespace Baseline
+{
+  inline int clamp(int x, int low, int high)
+  {
+    if(x <= low) return low;
+    if(x >= high) return high;
+    return x;
+  }
+
+  inline void YUV2RGB(int y, int u, int v, int & r, int & g, int & b)
+  {
+    r = clamp(y + ((1167 * v) >> 10), 0, 255);
+    g = clamp(y - ((595 * v + 404 * u) >> 10), 0, 255);
+    b = clamp(y + ((2080 * u) >> 10), 0, 255);
+  }
+
+  /* Converts 4:1:1 planar data, with three or four bytes per pixel. */
+  static void YUV411PToRGB(const VideoImage * source, VideoImage * target,
+                           int pixelBytes)
+  {
+    long w = source->m_width;
+    long h = source->m_height;
+
+    uchar * dest = target->m_planes[0].m_data;
+
+    for(long l = 0; l < h; l++) {
+
+      const uchar * iy = source->m_planes[0].line(l);
+      const uchar * iu = source->m_planes[1].line(l);
+      const uchar * iv = source->m_planes[2].line(l);
+
+      const uchar * sentinel = iy + w;
+
+      while(iy < sentinel) {
+
+        int r, g, b;
+
+        int u = *iu++;
+        int v = *iv++;
+
+        // The RGB version was centered on 127, the RGBA version not at all
+        if(pixelBytes == 3) {
+          u -= 127;
+          v -= 127;
+        }
+
+        for(int i = 0; i < 4; i++) {
+          YUV2RGB(*iy++, u, v, r, g, b);
+          dest[0] = r;
+          dest[1] = g;
+          dest[2] = b;
+          if(pixelBytes == 4)
+            dest[3] = 0xFF;
+          dest += pixelBytes;
+        }
+      }
+    }
+  }
+
+  /* Converts 4:2:0 planar data two lines at a time (2x2 macroblocks). */
+  static void YUV420PToRGB(const VideoImage * source, VideoImage * target,
+                           int pixelBytes)
+  {
+    long w = source->m_width;
+    long h = source->m_height;
+
+    target->m_planes[0].m_linesize = w * pixelBytes;
+
+    for(long l = 0; l < h; l += 2) {
+
+      uchar * dest1 = target->m_planes[0].line(l);
+      uchar * dest2 = target->m_planes[0].line(l + 1);
+
+      long l2 = l / 2;
+
+      const uchar * iy1 = source->m_planes[0].line(l);
+      const uchar * iy2 = source->m_planes[0].line(l + 1);
+      const uchar * iu  = source->m_planes[1].line(l2);
+      const uchar * iv  = source->m_planes[2].line(l2);
+
+      const uchar * sentinel = iy1 + w;
+
+      while(iy1 < sentinel) {
+
+        int r, g, b;
+
+        int u = *iu++ - 128;
+        int v = *iv++ - 128;
+
+        for(int i = 0; i < 2; i++) {
+          YUV2RGB(*iy1++, u, v, r, g, b);
+          dest1[0] = r;
+          dest1[1] = g;
+          dest1[2] = b;
+          if(pixelBytes == 4)
+            dest1[3] = 0xFF;
+          dest1 += pixelBytes;
+        }
+
+        for(int i = 0; i < 2; i++) {
+          YUV2RGB(*iy2++, u, v, r, g, b);
+          dest2[0] = r;
+          dest2[1] = g;
+          dest2[2] = b;
+          if(pixelBytes == 4)
+            dest2[3] = 0xFF;
+          dest2 += pixelBytes;
+        }
+      }
+    }
+  }
+
+  static void YUV422PToRGBA(const VideoImage * source, VideoImage * target)
+  {
+    long w = source->m_width;
+    long h = source->m_height;
+
+    target->m_planes[0].m_linesize = w * 4;
+
+    for(long l = 0; l < h; l++) {
+
+      uchar * dest = target->m_planes[0].line(l);
+
+      const uchar * iy  = source->m_planes[0].line(l);
+      const uchar * iu  = source->m_planes[1].line(l);
+      const uchar * iv  = source->m_planes[2].line(l);
+
+      const uchar * sentinel = iy + w;
+
+      while(iy < sentinel) {
+
+        int r, g, b;
+
+        int u = *iu++ - 128;
+        int v = *iv++ - 128;
+
+        for(int i = 0; i < 2; i++) {
+          YUV2RGB(*iy++, u, v, r, g, b);
+          dest[0] = r;
+          dest[1] = g;
+          dest[2] = b;
+          dest[3] = 0xFF;
+          dest += 4;
+        }
+      }
+    }
+  }
+
+  /* Half-size GBRG Bayer to RGB. */
+  static void bayerToRGB(const VideoImage * source, VideoImage * target)
+  {
+    long lw = source->m_planes[0].m_linesize;
+    long w = source->m_width / 2;
+    long h = source->m_height / 2;
+
+    target->m_planes[0].m_linesize = 3 * w;
+
+    const uchar * src = source->m_planes[0].m_data;
+    uchar * dest = target->m_planes[0].m_data;
+
+    for(long y = 0; y < h; y++) {
+
+      const uchar * src1 = & src[y * 2 * lw];
+      const uchar * src2 = src1 + lw;
+
+      for(long x = 0; x < w; x++) {
+        uint green = (uint) src1[0] + (uint) src2[1];
+        dest[0] = src2[0];
+        dest[2] = src1[1];
+        dest[1] = green >> 1;
+
+        src1 += 2;
+        src2 += 2;
+        dest += 3;
+      }
+    }
+  }
+
+  /* Runs the original conversion, returns false if there was none. */
+  static bool convert(const VideoImage * source, VideoImage * target,
+                      ImageConversion::BayerDemosaic bayer)
+  {
+    ImageFormat from = source->m_format;
+    ImageFormat to = target->m_format;
+
+    if(from == IMAGE_YUV_411P && (to == IMAGE_RGB || to == IMAGE_RGBA))
+      YUV411PToRGB(source, target, to == IMAGE_RGB ? 3 : 4);
+    else if(from == IMAGE_YUV_420P && (to == IMAGE_RGB || to == IMAGE_RGBA))
+      YUV420PToRGB(source, target, to == IMAGE_RGB ? 3 : 4);
+    else if(from == IMAGE_YUV_422P && to == IMAGE_RGBA)
+      YUV422PToRGBA(source, target);
+    else if(from == IMAGE_RAWBAYER && to == IMAGE_RGB &&
+            bayer == ImageConversion::BAYER_HALF_SIZE)
+      bayerToRGB(source, target);
+    else
+      return false;
+
+    return true;
+  }
+}
+
+static unsigned char * randomPlane(int bytes)
+{
+  unsigned char * data = (unsigned char *) malloc(bytes);
+
+  for(int i = 0; i < bytes; i++)
+    data[i] = (unsigned char) (rand() >> 4);
+
+  return data;
+}
+
+/* Creates a source frame. The chroma planes are divided by cw
+   horizontally and ch vertically. */
+static void createSource(VideoImage & image, ImageFormat fmt,
+                         int w, int h, int cw, int ch)
+{
+  image.m_format = fmt;
+  image.m_width = w;
+  image.m_height = h;
+
+  if(fmt == IMAGE_RAWBAYER) {
+    image.m_planes[0].set(randomPlane(w * h), w, PLANE_RAWBAYER);
+    return;
+  }
+
+  int chroma = (w / cw) * (h / ch);
+
+  image.m_planes[0].set(randomPlane(w * h), w, PLANE_Y);
+  image.m_planes[1].set(randomPlane(chroma), w / cw, PLANE_U);
+  image.m_planes[2].set(randomPlane(chroma), w / cw, PLANE_V);
+}
+
+/* Returns the size of the source frame in bytes. */
+static double sourceBytes(const VideoImage & image, int cw, int ch)
+{
+  double pixels = image.width() * (double) image.height();
+
+  if(image.m_format == IMAGE_RAWBAYER)
+    return pixels;
+
+  return pixels + 2.0 * pixels / (cw * ch);
+}
+
+/* Runs the conversion a few times, returns megabytes per second, or
+   zero if the baseline does not support the conversion. */
+static double measure(const VideoImage & source, VideoImage & target,
+                      ImageConversion::BayerDemosaic bayer,
+                      double bytes, int rounds, ThreadPool * pool = 0,
+                      bool baseline = false)
+{
+  if(baseline && !Baseline::convert( & source, & target, bayer))
+    return 0.0;
+
+  TimeStamp start = TimeStamp::getTime();
+
+  for(int i = 0; i < rounds; i++) {
+    if(baseline)
+      Baseline::convert( & source, & target, bayer);
+    else if(pool)
+      ImageConversion::convert( & source, & target, * pool, bayer);
+    else
+      ImageConversion::convert( & source, & target, bayer);
+  }
+
+  double secs = start.sinceSecondsD();
+
+  return bytes * rounds * 1.0e-6 / secs;
+}
+
+int main(int argc, char ** argv)
+{
+  int w = 1920;
+  int h = 1080;
+  int rounds = 50;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--size") == 0 && (i + 2) < argc) {
+      w = atoi(argv[++i]);
+      h = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "--rounds") == 0 && (i + 1) < argc)
+      rounds = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [--size <width> <height>] [--rounds <n>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  struct Conversion
+  {
+    const char * name;
+    ImageFormat from;
+    ImageFormat to;
+    int cw, ch;
+    ImageConversion::BayerDemosaic bayer;
+  };
+
+  const Conversion conversions[] = {
+    { "YUV420P -> RGBA", IMAGE_YUV_420P, IMAGE_RGBA, 2, 2, ImageConversion::BAYER_HALF_SIZE },
+    { "YUV420P -> RGB", IMAGE_YUV_420P, IMAGE_RGB, 2, 2, ImageConversion::BAYER_HALF_SIZE },
+    { "YUV422P -> RGBA", IMAGE_YUV_422P, IMAGE_RGBA, 2, 1, ImageConversion::BAYER_HALF_SIZE },
+    { "YUV411P -> RGB", IMAGE_YUV_411P, IMAGE_RGB, 4, 1, ImageConversion::BAYER_HALF_SIZE },
+    { "YUV411P -> RGBA", IMAGE_YUV_411P, IMAGE_RGBA, 4, 1, ImageConversion::BAYER_HALF_SIZE },
+    { "Bayer -> RGB/half", IMAGE_RAWBAYER, IMAGE_RGB, 1, 1, ImageConversion::BAYER_HALF_SIZE },
+    { "Bayer -> RGB/bilinear", IMAGE_RAWBAYER, IMAGE_RGB, 1, 1, ImageConversion::BAYER_BILINEAR }
+  };
+
+  unsigned features = CPUInfo::detectedFeatures();
+
+  ThreadPool & pool = ThreadPool::instance();
+
+  info("Frame size %d x %d, %d rounds, %d threads. CPU: %s%s%s", w, h, rounds,
+       pool.threadCount() + 1,
+       (features & CPUInfo::FEATURE_SSE2) ? "SSE2 " : "",
+       (features & CPUInfo::FEATURE_SSSE3) ? "SSSE3 " : "",
+       (features & CPUInfo::FEATURE_AVX2) ? "AVX2" : "");
+
+  for(unsigned c = 0; c < sizeof(conversions) / sizeof(conversions[0]); c++) {
+
+    const Conversion & conv = conversions[c];
+
+    VideoImage source;
+    createSource(source, conv.from, w, h, conv.cw, conv.ch);
+
+    VideoImage target;
+    target.allocateMemory(conv.to, w, h);
+
+    double bytes = sourceBytes(source, conv.cw, conv.ch);
+
+    // The original code
+    double baseline = measure(source, target, conv.bayer, bytes, rounds, 0, true);
+
+    // Plain C++ code
+    CPUInfo::setDisabledFeatures(~0u);
+    double plain = measure(source, target, conv.bayer, bytes, rounds);
+
+    // SIMD code
+    CPUInfo::setDisabledFeatures(0);
+    double simd = measure(source, target, conv.bayer, bytes, rounds);
+
+    // SIMD code in bands on the thread pool
+    double threaded = measure(source, target, conv.bayer, bytes, rounds, & pool);
+
+    if(baseline > 0.0)
+      info("%-22s baseline %8.1f MB/s   plain %8.1f MB/s   SIMD %8.1f MB/s   "
+           "threads %8.1f MB/s (%.2fx baseline)", conv.name, baseline, plain,
+           simd, threaded, threaded / baseline);
+    else
+      info("%-22s baseline      n/a        plain %8.1f MB/s   SIMD %8.1f MB/s   "
+           "threads %8.1f MB/s (%.2fx plain)", conv.name, plain, simd,
+           threaded, threaded / plain);
+
+    source.freeMemory();
+    target.freeMemory();
+  }
+
+  return 0;
+}
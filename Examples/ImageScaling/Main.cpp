@@ -0,0 +1,342 @@
+/* Micro-benchmark for the image scaling kernels that are used to
+   create mipmaps. Each operation is run with the code that Image used
+   before the ImageScaling kernels (the baseline), with the plain C++
+   code and with the SIMD code that the CPU supports. The throughput
+   is reported in megapixels (of the source image) per second. */
+
+#include <Luminous/Image.hpp>
+
+#include <Radiant/CPUInfo.hpp>
+#include <Radiant/TimeStamp.hpp>
+#include <Radiant/Trace.hpp>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Radiant;
+
+/* The original Image::quarterSize and Image::copyResample, kept here
+   as the baseline. copyResample was bilinear, for RGB and RGBA only. */
+namespace Baseline
+{
+  static int toByte(float val)
+  {
+    int i = (int) (val + 0.5f);
+    return i < 255 ? i : 255;
+  }
+
+  static bool copyResample(Luminous::Image & dest,
+                           const Luminous::Image & source, int w, int h)
+  {
+    const Luminous::PixelFormat & pf = source.pixelFormat();
+    int channels;
+
+    if(pf == Luminous::PixelFormat::rgbUByte())
+      channels = 3;
+    else if(pf == Luminous::PixelFormat::rgbaUByte())
+      channels = 4;
+    else
+      return false;
+
+    dest.allocate(w, h, pf);
+
+    int sw = source.width();
+    int sh = source.height();
+
+    float xscale = sw / (float) w;
+    float yscale = sh / (float) h;
+
+    const uint8_t * src = source.bytes();
+
+    for(int y = 0; y < h; y++) {
+
+      float sy = y * yscale;
+      int yi = (int) sy;
+      int yi1 = yi + 1;
+
+      if(yi1 >= sh) yi1 = yi;
+      float wy1 = sy - yi;
+      float wy0 = 1.0f - wy1;
+
+      uint8_t * d = dest.bytes() + y * w * channels;
+
+      for(int x = 0; x < w; x++) {
+
+        float sx = x * xscale;
+        int xi = (int) sx;
+        int xi1 = xi + 1;
+        if(xi1 >= sw) xi1 = xi;
+
+        float wx1 = sx - xi;
+        float wx0 = 1.0f - wx1;
+
+        const uint8_t * v00 = & src[(yi * sw  + xi) * channels];
+        const uint8_t * v10 = & src[(yi * sw  + xi1) * channels];
+        const uint8_t * v01 = & src[(yi1 * sw + xi) * channels];
+        const uint8_t * v11 = & src[(yi1 * sw + xi1) * channels];
+
+        float fw00 = wy0 * wx0;
+        float fw10 = wy0 * wx1;
+        float fw01 = wy1 * wx0;
+        float fw11 = wy1 * wx1;
+
+        if(channels == 3) {
+          for(int c = 0; c < 3; c++)
+            *d++ = uint8_t(toByte(v00[c] * fw00 + v10[c] * fw10 +
+                                  v01[c] * fw01 + v11[c] * fw11));
+        }
+        else {
+          float a00 = v00[3];
+          float a10 = v10[3];
+          float a01 = v01[3];
+          float a11 = v11[3];
+
+          float asum = a00 * fw00 + a10 * fw10 + a01 * fw01 + a11 * fw11;
+          float ascale = asum > 0.00001 ? 1.0f / asum : 0.0f;
+
+          for(int c = 0; c < 3; c++)
+            *d++ = uint8_t(toByte((v00[c] * fw00 * a00 + v10[c] * fw10 * a10 +
+                                   v01[c] * fw01 * a01 + v11[c] * fw11 * a11)
+                                  * ascale));
+
+          int a = (int) asum;
+          *d++ = uint8_t(a < 255 ? a : 255);
+        }
+      }
+    }
+
+    return true;
+  }
+
+  static bool quarterSize(Luminous::Image & dest,
+                          const Luminous::Image & source)
+  {
+    const int sw = source.width();
+    int w = sw / 2;
+
+    const int sh = source.height();
+    int h = sh / 2;
+
+    while(w & 0x3)
+      w--;
+    while(h & 0x3)
+      h--;
+
+    const Luminous::PixelFormat & pf = source.pixelFormat();
+    const uint8_t * const src = source.bytes();
+
+    if(pf == Luminous::PixelFormat::alphaUByte() ||
+       pf == Luminous::PixelFormat::luminanceUByte()) {
+
+      dest.allocate(w, h, pf);
+
+      for(int y = 0; y < h; y++) {
+
+        const uint8_t * l0 = src + y * 2 * sw;
+        const uint8_t * l1 = l0 + sw;
+
+        uint8_t * d = dest.bytes() + y * w;
+
+        for(int x = 0; x < w; x++) {
+          unsigned tmp = l0[0];
+          tmp += l0[1];
+          tmp += l1[0];
+          tmp += l1[1];
+
+          *d++ = uint8_t(tmp >> 2);
+
+          l0 += 2;
+          l1 += 2;
+        }
+      }
+    }
+    else if(pf == Luminous::PixelFormat::rgbUByte()) {
+
+      dest.allocate(w, h, pf);
+
+      for(int y = 0; y < h; y++) {
+
+        const uint8_t * l0 = src + y * 2 * 3 * sw;
+        const uint8_t * l1 = l0 + sw * 3;
+
+        uint8_t * d = dest.bytes() + y * w * 3;
+
+        for(int x = 0; x < w; x++) {
+
+          for(int i = 0; i < 3; i++) {
+            unsigned tmp = l0[0];
+            tmp += l0[3];
+            tmp += l1[0];
+            tmp += l1[3];
+
+            *d++ = uint8_t(tmp >> 2);
+
+            l0++;
+            l1++;
+          }
+
+          l0 += 3;
+          l1 += 3;
+        }
+      }
+    }
+    else if(pf == Luminous::PixelFormat::rgbaUByte()) {
+
+      dest.allocate(w, h, pf);
+
+      for(int y = 0; y < h; y++) {
+
+        const uint8_t * l0 = src + y * 2 * 4 * sw;
+        const uint8_t * l1 = l0 + sw * 4;
+
+        uint8_t * d = dest.bytes() + y * w * 4;
+
+        for(int x = 0; x < w; x++) {
+
+          unsigned a00 = l0[3];
+          unsigned a10 = l0[7];
+          unsigned a01 = l1[3];
+          unsigned a11 = l1[7];
+
+          unsigned asum = a00 + a10 + a01 + a11;
+
+          if(!asum)
+            asum = 1;
+
+          for(int i = 0; i < 3; i++) {
+            unsigned tmp = (unsigned) l0[0] * a00;
+            tmp += (unsigned) l0[4] * a10;
+            tmp += (unsigned) l1[0] * a01;
+            tmp += (unsigned) l1[4] * a11;
+
+            *d++ = uint8_t(tmp / asum);
+
+            l0++;
+            l1++;
+          }
+
+          *d++ = uint8_t(asum >> 2);
+
+          l0 += 5;
+          l1 += 5;
+        }
+      }
+    }
+    else
+      return false;
+
+    return true;
+  }
+}
+
+static void fill(Luminous::Image & image)
+{
+  int n = image.width() * image.height() * image.pixelFormat().numChannels();
+  unsigned char * data = image.data();
+
+  for(int i = 0; i < n; i++)
+    data[i] = (unsigned char) (rand() >> 4);
+}
+
+/* Runs the operation a few times, returns megapixels per second, or
+   zero if the baseline does not support the operation. */
+static double measure(Luminous::Image & source, int op, int rounds,
+                      bool baseline)
+{
+  Luminous::Image dest;
+  int w = 1024;
+  int h = 1024 * source.height() / source.width();
+
+  TimeStamp start = TimeStamp::getTime();
+
+  for(int i = 0; i < rounds; i++) {
+    if(baseline) {
+      bool ok = (op == 0) ? Baseline::quarterSize(dest, source) :
+                (op == 1) ? Baseline::copyResample(dest, source, w, h) : false;
+      if(!ok)
+        return 0.0;
+    }
+    else if(op == 0)
+      dest.quarterSize(source);
+    else if(op == 1)
+      dest.copyResample(source, w, h, Luminous::ImageScaling::FILTER_BILINEAR);
+    else
+      dest.copyResample(source, w, h, Luminous::ImageScaling::FILTER_LANCZOS3);
+  }
+
+  double secs = start.sinceSecondsD();
+  double mpix = source.width() * (double) source.height() * rounds * 1.0e-6;
+
+  return mpix / secs;
+}
+
+int main(int argc, char ** argv)
+{
+  // Default size is that of a 20-megapixel photo
+  int w = 5472;
+  int h = 3648;
+  int rounds = 5;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--size") == 0 && (i + 2) < argc) {
+      w = atoi(argv[++i]);
+      h = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "--rounds") == 0 && (i + 1) < argc)
+      rounds = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [--size <width> <height>] [--rounds <n>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  const char * ops[] = { "quarterSize", "resample/bilinear", "resample/lanczos3" };
+
+  Luminous::PixelFormat formats[] = {
+    Luminous::PixelFormat::luminanceUByte(),
+    Luminous::PixelFormat::alphaUByte(),
+    Luminous::PixelFormat::rgbUByte(),
+    Luminous::PixelFormat::rgbaUByte()
+  };
+  const char * formatNames[] = { "luminance", "alpha", "rgb", "rgba" };
+
+  unsigned features = CPUInfo::detectedFeatures();
+
+  info("Image size %d x %d, %d rounds. CPU: %s%s%s", w, h, rounds,
+       (features & CPUInfo::FEATURE_SSE2) ? "SSE2 " : "",
+       (features & CPUInfo::FEATURE_SSSE3) ? "SSSE3 " : "",
+       (features & CPUInfo::FEATURE_AVX2) ? "AVX2" : "");
+
+  for(int f = 0; f < 4; f++) {
+
+    Luminous::Image source;
+    source.allocate(w, h, formats[f]);
+    fill(source);
+
+    for(int op = 0; op < 3; op++) {
+
+      // The code before the ImageScaling kernels
+      double baseline = measure(source, op, rounds, true);
+
+      // Plain C++ code
+      CPUInfo::setDisabledFeatures(~0u);
+      double plain = measure(source, op, rounds, false);
+
+      // SIMD code
+      CPUInfo::setDisabledFeatures(0);
+      double simd = measure(source, op, rounds, false);
+
+      if(baseline > 0.0)
+        info("%-10s %-18s baseline %8.1f Mpix/s   plain %8.1f Mpix/s   "
+             "SIMD %8.1f Mpix/s   (%.2fx baseline)", formatNames[f], ops[op],
+             baseline, plain, simd, simd / baseline);
+      else
+        info("%-10s %-18s baseline      n/a          plain %8.1f Mpix/s   "
+             "SIMD %8.1f Mpix/s   (%.2fx plain)", formatNames[f], ops[op],
+             plain, simd, simd / plain);
+    }
+  }
+
+  return 0;
+}
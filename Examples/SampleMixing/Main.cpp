@@ -0,0 +1,123 @@
+/* Micro-benchmark for the sample mixing kernels that are used by
+   ModuleSamplePlayer. A number of voices is mixed into 64-sample
+   buffers, first with the plain C++ code and then with the SIMD code
+   that the CPU supports. The result is reported as the number of
+   voices that could be mixed in real time at 44.1 kHz, on one core. */
+
+#include <Resonant/SampleMixing.hpp>
+
+#include <Radiant/CPUInfo.hpp>
+#include <Radiant/TimeStamp.hpp>
+#include <Radiant/Trace.hpp>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+using namespace Radiant;
+using namespace Resonant;
+
+static const int BLOCK = 64;
+static const double SAMPLE_RATE = 44100.0;
+
+/* Mixes the voices for the given number of blocks, returns the number
+   of voices that would fit in real time. */
+static double measure(const std::vector<float> & sample, int channels,
+                      float pitch, int voices, int blocks)
+{
+  unsigned frames = sample.size() / channels;
+  std::vector<uint64_t> phases(voices);
+  float out[BLOCK];
+
+  // Spread the voices around the sample
+  for(int v = 0; v < voices; v++)
+    phases[v] = ((uint64_t) (v * 7919 % frames)) << 32;
+
+  uint64_t step = SampleMixing::rateToStep(pitch);
+  uint64_t end = (uint64_t) frames << 32;
+
+  TimeStamp start = TimeStamp::getTime();
+
+  for(int b = 0; b < blocks; b++) {
+    memset(out, 0, sizeof(out));
+
+    for(int v = 0; v < voices; v++) {
+      const float * src = & sample[v % channels];
+      int done = 0;
+
+      while(done < BLOCK) {
+        if(step == SampleMixing::FRAME) {
+          unsigned pos = (unsigned) (phases[v] >> 32);
+          int avail = frames - pos;
+          if(avail > BLOCK - done)
+            avail = BLOCK - done;
+          SampleMixing::mix(out + done, src + pos * channels, channels,
+                            0.1f, avail);
+          done += avail;
+          phases[v] += (uint64_t) avail << 32;
+        }
+        else
+          done += SampleMixing::mixResampled(out + done, src, channels, frames,
+                                             phases[v], step, 0.1f,
+                                             BLOCK - done, true);
+        if(phases[v] >= end)
+          phases[v] %= end;
+      }
+    }
+  }
+
+  double secs = start.sinceSecondsD();
+  double audio = blocks * BLOCK / SAMPLE_RATE;
+
+  return voices * audio / secs;
+}
+
+int main(int argc, char ** argv)
+{
+  int voices = 64;
+  int blocks = 20000;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--voices") == 0 && (i + 1) < argc)
+      voices = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--blocks") == 0 && (i + 1) < argc)
+      blocks = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [--voices <n>] [--blocks <n>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  unsigned features = CPUInfo::detectedFeatures();
+
+  info("%d voices, %d blocks of %d samples. CPU: %s%s", voices, blocks, BLOCK,
+       (features & CPUInfo::FEATURE_SSE2) ? "SSE2 " : "",
+       (features & CPUInfo::FEATURE_AVX2) ? "AVX2" : "");
+
+  float pitches[] = { 1.0f, 0.943874f, 1.498307f };
+
+  for(int channels = 1; channels <= 2; channels++) {
+
+    // Five seconds of noise
+    std::vector<float> sample((int) SAMPLE_RATE * 5 * channels);
+    for(unsigned i = 0; i < sample.size(); i++)
+      sample[i] = rand() / (float) RAND_MAX - 0.5f;
+
+    for(int p = 0; p < 3; p++) {
+
+      CPUInfo::setDisabledFeatures(~0u);
+      double plain = measure(sample, channels, pitches[p], voices, blocks);
+
+      CPUInfo::setDisabledFeatures(0);
+      double simd = measure(sample, channels, pitches[p], voices, blocks);
+
+      info("%-6s pitch %.3f   plain %8.0f voices   SIMD %8.0f voices   (%.2fx)",
+           channels == 1 ? "mono" : "stereo", pitches[p], plain, simd,
+           simd / plain);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,7 @@
+include(../Examples.pri)
+
+win32: CONFIG += console
+
+SOURCES += Main.cpp
+
+LIBS += $$LIB_RESONANT $$LIB_RADIANT $$LIB_PATTERNS $$LIB_NIMBLE $$LIB_VALUABLE
@@ -13,8 +13,16 @@
  * 
  */
 
+/* Sends messages between two processes through Radiant::SHMPipe, and
+   measures the latency and throughput. Start the sender first, as it
+   creates the pipe, and then the listener with --listener. With --poll the listener polls the pipe
+   and sleeps between polls; by default it blocks in SHMPipe::waitRead.
+   Use --interval to leave the listener idle between messages, which is
+   where the wake-up latency matters. */
+
 #include <Radiant/SHMPipe.hpp>
 #include <Radiant/Sleep.hpp>
+#include <Radiant/TimeStamp.hpp>
 #include <Radiant/Trace.hpp>
 
 #include <stdio.h>
@@ -30,6 +38,8 @@ static const char * appname = 0;
 static int bytes = 10000;
 static int times = 10000;
 static key_t key = 100;
+static int interval = 0;
+static bool poll = false;
 
 
 void sendTest()
@@ -63,7 +73,11 @@ void sendTest()
       index = 1;
     }
 
+    if(interval)
+      Radiant::Sleep::sleepUs(interval);
+
     bd.rewind();
+    bd.writeTimeStamp(Radiant::TimeStamp::getTime());
     bd.writeString(tmp);
 
     
@@ -90,19 +104,36 @@ void sendTest()
 
 void listenTest()
 {    
-  Radiant::info("Setting up shared memory buffer for listening");
+  Radiant::info("Setting up shared memory buffer for listening (%s)",
+                poll ? "polling" : "blocking");
 
   Radiant::SHMPipe * shm = new Radiant::SHMPipe(key, 0);
 
   Radiant::BinaryData bd;
 
-  int i, fails = 0;
+  int i = 0, fails = 0;
+  long total = 0;
+
+  double latencySum = 0.0;
+  double latencyMax = 0.0;
 
   std::string str;
 
-  for(i = 0; true; i++) {
-    
-    if(shm->read(bd) <= 0) {
+  Radiant::TimeStamp first, last;
+
+  while(true) {
+
+    if(!poll && !shm->waitRead(4, 1000)) {
+      Radiant::info("No data for a second, maybe the sender is done");
+      break;
+    }
+
+    int n = shm->read(bd);
+
+    if(n <= 0) {
+      if(!poll)
+        continue;
+
       fails++;
 
       if(fails > 10) {
@@ -111,17 +142,43 @@ void listenTest()
       }
 
       Radiant::Sleep::sleepMs(50);
+      continue;
     }
-    else
-      fails = 0;
 
-    if(i % 100 == 0) {
-      bd.rewind();
+    fails = 0;
+
+    Radiant::TimeStamp now = Radiant::TimeStamp::getTime();
+    Radiant::TimeStamp sent = bd.readTimeStamp();
+
+    double latency = Radiant::TimeStamp(now - sent).secondsD();
+    latencySum += latency;
+    if(latency > latencyMax)
+      latencyMax = latency;
+
+    if(!i)
+      first = now;
+    last = now;
+    total += n;
 
+    if(i % 100 == 0) {
       bd.readString(str);
       printf("str = %s\n", str.c_str());
       fflush(0);
     }
+
+    i++;
+  }
+
+  if(i) {
+    double secs = Radiant::TimeStamp(last - first).secondsD();
+    if(secs <= 0.0)
+      secs = 1.0e-6;
+
+    Radiant::info("Received %d messages (%ld bytes) in %.3f s: "
+                  "%.0f messages/s, %.2f MB/s", i, total, secs,
+                  i / secs, total / secs * 1.0e-6);
+    Radiant::info("Latency: average %.1f us, maximum %.1f us",
+                  latencySum / i * 1.0e6, latencyMax * 1.0e6);
   }
 
   Radiant::info("Deleting shared memory buffer after %d reads", i);
@@ -143,6 +200,12 @@ int main(int argc, char ** argv)
       key = atoi(argv[++i]);
     else if(strcmp(argv[i], "--listener") == 0)
       sender = false;
+    else if(strcmp(argv[i], "--poll") == 0)
+      poll = true;
+    else if(strcmp(argv[i], "--interval") == 0 && (i + 1) < argc)
+      interval = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--times") == 0 && (i + 1) < argc)
+      times = atoi(argv[++i]);
     else if(strcmp(argv[i], "--verbose") == 0)
       Radiant::enableVerboseOutput(true);
     else
@@ -127,6 +127,95 @@ void listenTest(const char * host, int port)
   socket.close();
 }
 
+/* Sends small packets over the loopback interface, and reads them
+   back. Compares one system call per packet (read/write) with the
+   batched calls (readMany/writeMany). */
+void benchmarkTest(const char * host, int port, int packets, bool batched)
+{
+  enum { BATCH = 32, PACKET = 64, BUFFER = 2048 };
+
+  UDPSocket server;
+  UDPSocket client;
+
+  int err = server.openServer(host, port);
+
+  if(!err)
+    err = client.openClient(host, port);
+
+  if(err) {
+    printf("%s cannot open UDP sockets to %s:%d -> %s\n",
+           appname, host, port, strerror(err));
+    return;
+  }
+
+  static char outgoing[BATCH][PACKET];
+  static char incoming[BATCH][BUFFER];
+
+  UDPSocket::Datagram out[BATCH];
+  UDPSocket::Datagram in[BATCH];
+
+  for(int i = 0; i < BATCH; i++) {
+    memset(outgoing[i], i, PACKET);
+    out[i] = UDPSocket::Datagram(outgoing[i], PACKET);
+    in[i] = UDPSocket::Datagram(incoming[i], BUFFER);
+  }
+
+  double sendTime = 0.0;
+  double receiveTime = 0.0;
+  int sent = 0;
+  int received = 0;
+
+  while(sent < packets) {
+
+    Radiant::TimeStamp t1 = Radiant::TimeStamp::getTime();
+
+    if(batched) {
+      int n = client.writeMany(out, BATCH);
+      if(n < 0)
+        break;
+      sent += n;
+    }
+    else {
+      for(int i = 0; i < BATCH; i++) {
+        if(client.write(outgoing[i], PACKET) != PACKET)
+          break;
+        sent++;
+      }
+    }
+
+    Radiant::TimeStamp t2 = Radiant::TimeStamp::getTime();
+
+    // Read until the socket is empty
+    for(;;) {
+      int n = 0;
+
+      if(batched)
+        n = server.readMany(in, BATCH, false);
+      else {
+        while(n < BATCH && server.read(incoming[n], BUFFER, false) > 0)
+          n++;
+      }
+
+      if(n <= 0)
+        break;
+
+      received += n;
+    }
+
+    Radiant::TimeStamp t3 = Radiant::TimeStamp::getTime();
+
+    sendTime += Radiant::TimeStamp(t2 - t1).secondsD();
+    receiveTime += Radiant::TimeStamp(t3 - t2).secondsD();
+  }
+
+  printf("%-8s sent %d packets (%.0f packets/s), received %d (%.0f packets/s)\n",
+         batched ? "batched" : "single", sent, sent / sendTime,
+         received, received / receiveTime);
+
+  client.close();
+  server.close();
+}
+
 int main(int argc, char ** argv)
 {
   Radiant::TimeStamp startTime(Radiant::TimeStamp::getTime());
@@ -137,6 +226,7 @@ int main(int argc, char ** argv)
   bool islistener = false;
   bool isclient = true;
   bool withBlocking = true;
+  int benchmark = 0;
 
   appname = argv[0];
 
@@ -166,6 +256,8 @@ int main(int argc, char ** argv)
       withBlocking = true;
     else if(strcmp(argv[i], "--withreplies") == 0)
       withreplies = true;
+    else if(strcmp(argv[i], "--benchmark") == 0 && (i + 1) < argc)
+      benchmark = atoi(argv[++i]);
     else
       printf("%s # Unknown argument \"%s\"\n", appname, argv[i]);
   }
@@ -174,7 +266,11 @@ int main(int argc, char ** argv)
   // WinPort::initSockets();
 #endif
   
-  if(islistener)
+  if(benchmark) {
+    benchmarkTest(host, port, benchmark, false);
+    benchmarkTest(host, port, benchmark, true);
+  }
+  else if(islistener)
     listenTest(host, port);
   else
     sendTest(host, port, message);
@@ -17,7 +17,8 @@
 
 #include <Nimble/Math.hpp>
 
-#include <Radiant/Sleep.hpp>
+#include <Radiant/Atomic.hpp>
+#include <Radiant/PlatformUtils.hpp>
 #include <Radiant/Trace.hpp>
 
 #include <typeinfo>
@@ -27,13 +28,197 @@
 namespace Luminous
 {
 
+  /* Binary heap of tasks. Each task stores its slot in the heap, so
+     that a task can be moved in the heap in O(log n) time after its
+     key has changed. */
+  class TaskHeap
+  {
+  public:
+    enum Order
+    {
+      BY_PRIORITY, // Highest priority first, FIFO among equal priorities
+      BY_TIME      // Earliest scheduled time first
+    };
+
+    TaskHeap(Order order) : m_order(order) {}
+
+    bool empty() const { return m_items.empty(); }
+    size_t size() const { return m_items.size(); }
+
+    Task * top() const { return m_items[0]; }
+
+    void push(Task * task)
+    {
+      m_items.push_back(task);
+      place((int) m_items.size() - 1, task);
+      up(task->m_heapSlot);
+    }
+
+    Task * pop()
+    {
+      Task * task = m_items[0];
+      remove(task);
+      return task;
+    }
+
+    void remove(Task * task)
+    {
+      int slot = task->m_heapSlot;
+      assert(slot >= 0 && slot < (int) m_items.size() &&
+             m_items[slot] == task);
+
+      Task * last = m_items.back();
+      m_items.pop_back();
+      task->m_heapSlot = -1;
+
+      if(last != task) {
+        place(slot, last);
+        update(last);
+      }
+    }
+
+    /// Restores the heap order after the key of the task has changed
+    void update(Task * task)
+    {
+      up(task->m_heapSlot);
+      down(task->m_heapSlot);
+    }
+
+    /// Returns true if task a should be before task b
+    bool before(const Task * a, const Task * b) const
+    {
+      if(m_order == BY_TIME)
+        return a->m_queuedTime < b->m_queuedTime;
+
+      if(a->m_queuedPriority != b->m_queuedPriority)
+        return a->m_queuedPriority > b->m_queuedPriority;
+
+      // Wraparound-safe comparison of the sequence numbers
+      return (int) (a->m_sequence - b->m_sequence) < 0;
+    }
+
+  private:
+
+    void place(int slot, Task * task)
+    {
+      m_items[slot] = task;
+      task->m_heapSlot = slot;
+    }
+
+    void up(int slot)
+    {
+      Task * task = m_items[slot];
+
+      while(slot > 0) {
+        int parent = (slot - 1) / 2;
+        if(!before(task, m_items[parent]))
+          break;
+        place(slot, m_items[parent]);
+        slot = parent;
+      }
+
+      place(slot, task);
+    }
+
+    void down(int slot)
+    {
+      Task * task = m_items[slot];
+      int n = (int) m_items.size();
+
+      for(;;) {
+        int child = 2 * slot + 1;
+        if(child >= n)
+          break;
+        if(child + 1 < n && before(m_items[child + 1], m_items[child]))
+          child++;
+        if(!before(m_items[child], task))
+          break;
+        place(slot, m_items[child]);
+        slot = child;
+      }
+
+      place(slot, task);
+    }
+
+    Order m_order;
+    std::vector<Task *> m_items;
+  };
+
+  /* A request that is posted to the inbox of a worker. */
+  class BGThread::Message
+  {
+  public:
+    enum Type
+    {
+      ADD_TASK,
+      UPDATE_PRIORITY
+    };
+
+    Message(Type type, Task * task) : m_type(type), m_task(task), m_next(0) {}
+
+    Type m_type;
+    Task * m_task;
+    Message * m_next;
+  };
+
+  /* One worker of the thread pool. The heaps are protected by m_mutex,
+     the inbox is a lock-free stack that anybody may push to. */
+  class BGThread::Worker : public Radiant::Thread
+  {
+  public:
+    Worker(BGThread * host, int index)
+      : m_host(host),
+      m_index(index),
+      m_ready(TaskHeap::BY_PRIORITY),
+      m_timed(TaskHeap::BY_TIME),
+      m_sequence(0),
+      m_inbox(0),
+      m_queued(0)
+    {}
+
+    virtual ~Worker()
+    {
+      Message * msg = m_inbox;
+      while(msg) {
+        Message * next = msg->m_next;
+        delete msg;
+        msg = next;
+      }
+    }
+
+    BGThread * m_host;
+    int m_index;
+
+    Radiant::MutexAuto m_mutex;
+    TaskHeap m_ready;
+    TaskHeap m_timed;
+    unsigned m_sequence;
+
+    Message * volatile m_inbox;
+    // Number of tasks owned by this worker, used for load balancing
+    volatile int m_queued;
+
+  protected:
+    virtual void childLoop() { m_host->workerLoop(this); }
+  };
+
   BGThread * BGThread::m_instance = 0;
+  int BGThread::m_defaultThreadCount = 0;
 
-  BGThread::BGThread():
+  BGThread::BGThread(int threads)
+    : m_generation(0),
+    m_sleeping(0),
+    m_taskCount(0),
     m_continue(true)
   {
     if(m_instance == 0)
       m_instance = this;
+
+    if(threads <= 0)
+      threads = defaultThreadCount();
+
+    for(int i = 0; i < threads; i++)
+      m_workers.push_back(new Worker(this, i));
   }
 /*  
   static void g_deletePred1(Task * x)
@@ -52,21 +237,50 @@ namespace Luminous
       m_instance = 0;
     stop();
 
+    for(size_t i = 0; i < m_workers.size(); i++)
+      delete m_workers[i];
+
     /// @todo Free resources, should we do this?
     // for_each(m_taskQueue.begin(), m_taskQueue.end(), g_deletePred2);
   }
 
+  bool BGThread::run()
+  {
+    m_continue = true;
+
+    bool ok = true;
+
+    for(size_t i = 0; i < m_workers.size(); i++) {
+      if(!m_workers[i]->isRunning())
+        ok = m_workers[i]->run() && ok;
+    }
+
+    return ok;
+  }
+
   void BGThread::addTask(Task * task)
   {
 //    Radiant::trace("BGThread::addTask #");
     assert(task);
     task->m_host = this;
 
-    m_mutex.lock();
-    m_taskQueue.insert(contained(task->priority(), task));
-    m_mutex.unlock();
+    // Give the task to the worker with the fewest tasks
+    Worker * target = m_workers[0];
 
-    m_wait.wakeAll();
+    for(size_t i = 1; i < m_workers.size(); i++) {
+      if(m_workers[i]->m_queued < target->m_queued)
+        target = m_workers[i];
+    }
+
+    task->m_worker = target->m_index;
+    task->m_queueState = Task::QUEUE_INBOX;
+
+    Radiant::Atomic::add(&target->m_queued, 1);
+    Radiant::Atomic::add(&m_taskCount, 1);
+
+    post(target, new Message(Message::ADD_TASK, task));
+
+    wakeWorker();
   }
 /*
   void BGThread::markForDeletion(Task * task)
@@ -82,40 +296,36 @@ namespace Luminous
 */
   void BGThread::stop()
   {
+    m_mutexWait.lock();
     m_continue = false;
+    Radiant::Atomic::add(&m_generation, 1);
+    m_wait.wakeAll();
+    m_mutexWait.unlock();
 
-    if(isRunning()) 
-    {
-      m_wait.wakeAll();
-      waitEnd();
+    for(size_t i = 0; i < m_workers.size(); i++) {
+      if(m_workers[i]->isRunning())
+        m_workers[i]->waitEnd();
     }
   }
 
   void BGThread::setPriority(Task * task, Priority p)
   {
-    m_mutex.lock();
+    // Count the message before publishing the priority, see releaseMessages()
+    Radiant::Atomic::add(&task->m_pendingMessages, 1);
 
-    // Find tasks with the given priority
-    container::iterator beg = m_taskQueue.find(task->priority());
-    container::iterator end = m_taskQueue.upper_bound(task->priority());
+    task->m_priority = p;
+    Radiant::Atomic::memoryBarrier();
 
-    // Find the actual requested task
-    container::iterator it;
-    for(it = beg; it != end; it++) {
-      if(it->second == task) break;
-    }
-    
-    if(it != end) {
-      // Move the task in the queue and update its priority
-      m_taskQueue.erase(it);
-
-      task->m_priority = p;
-      m_taskQueue.insert(contained(p, task));
-    } else {
-      Radiant::error("BGThread::setPriority # requested task was not found");
+    int index = task->m_worker;
+
+    if(index < 0 || task->m_queueState == Task::QUEUE_NONE) {
+      /* The task is not in any queue (it might be running), it will be
+         queued with the new priority. */
+      Radiant::Atomic::add(&task->m_pendingMessages, -1);
+      return;
     }
 
-    m_mutex.unlock();
+    post(m_workers[index], new Message(Message::UPDATE_PRIORITY, task));
   }
 
    BGThread * BGThread::instance()
@@ -142,8 +352,30 @@ namespace Luminous
 
   unsigned BGThread::taskCount() 
   {
-    Radiant::Guard guard(&m_mutex);
-    return m_taskQueue.size();
+    return (unsigned) m_taskCount;
+  }
+
+  bool BGThread::isRunning()
+  {
+    for(size_t i = 0; i < m_workers.size(); i++) {
+      if(m_workers[i]->isRunning())
+        return true;
+    }
+
+    return false;
+  }
+
+  int BGThread::defaultThreadCount()
+  {
+    if(m_defaultThreadCount > 0)
+      return m_defaultThreadCount;
+
+    return Radiant::PlatformUtils::getNumberOfCPUs();
+  }
+
+  void BGThread::setDefaultThreadCount(int threads)
+  {
+    m_defaultThreadCount = threads;
   }
 
   Radiant::Mutex * BGThread::generalMutex()
@@ -151,28 +383,25 @@ namespace Luminous
     return & m_generalMutex;
   }
 
-/*
- * For TimeStamps: use Condition::wait(mutex, timeout)
- *
- * compute the next possible runtime from tasks, set as timeout
- * can't use m_taskQueue.empty() anymore
-*/
-
-  void BGThread::childLoop()
+  void BGThread::workerLoop(Worker * worker)
   {
     while(m_continue) {
-//      Radiant::trace("BGThread::childLoop # running");
+//      Radiant::trace("BGThread::workerLoop # running");
+
+      /* Remember the generation before looking at the queues, so that
+         tasks added while we are looking are not missed. */
+      int generation = m_generation;
+      Radiant::Atomic::memoryBarrier();
 
       // Pick a task to run
-      Radiant::TimeStamp toWait;
-      Task * task = pickNextTask(toWait);
+      Radiant::TimeStamp toWait = Radiant::TimeStamp::createSecondsI(1);
+      Task * task = pickNextTask(worker, toWait);
 
       // Run the task
       if(task) {
 
 	/* Radiant::trace("Picked a task %s with priority %f",
            typeid(*task).name(), task->priority());*/
-//        Radiant::trace("FOO");
         bool first = (task->state() == Task::WAITING);
 
         if(first) {
@@ -184,76 +413,221 @@ namespace Luminous
 
         // Did the task complete?
         if(task->state() == Task::DONE) {
-//          Radiant::trace("BGThread::childLoop # TASK DONE %s", typeid(*task).name());
+//          Radiant::trace("BGThread::workerLoop # TASK DONE %s", typeid(*task).name());
+          releaseMessages(task);
           task->finished();
         } else {
           // If we are still running, push the task to the back of the given
           // priority range so that other tasks with the same priority will be 
           // executed in round-robin
-          m_mutex.lock();
-          m_taskQueue.insert(contained(task->priority(), task));
-          m_mutex.unlock();
+          Radiant::Guard guard(worker->m_mutex);
+          enqueue(worker, task);
+          Radiant::Atomic::add(&worker->m_queued, 1);
+          Radiant::Atomic::add(&m_taskCount, 1);
         }
-      } else if(!m_taskQueue.empty()) {
-        // There was nothing to run, wait until the next task can be run (or we
-        // get interrupted)
-//        Radiant::trace("BGTHREAD: NOTHING TO RUN; WAITING %d MSECS", (int)(toWait.secondsD() * 1000.0));
-//        Radiant::trace("\t%d TASKS IN QUEUE", (int)m_taskQueue.size());
-        m_mutexWait.lock();
-        m_wait.wait(m_mutexWait, (int)(toWait.secondsD() * 1000.0));
-        m_mutexWait.unlock();         
-      }
-
-      // Remove all tasks marked for deletion
-      //m_mutex.lock();
-      //m_taskQueue.remove_if(g_deleteMarkedPred);
-      //m_mutex.unlock();
 
+        continue;
+      }
 
-      // Wait for new tasks to appear
-      while(m_taskQueue.empty() && m_continue) {
-//        Radiant::trace("BGTHREAD: QUEUE EMPTY; WAITING FOR MORE");
-        m_mutexWait.lock();
-        m_wait.wait(m_mutexWait);
-        m_mutexWait.unlock();
+      // There was nothing to run, wait until the next task can be run (or we
+      // get interrupted)
+      m_mutexWait.lock();
+      Radiant::Atomic::add(&m_sleeping, 1);
+      if(generation == m_generation && m_continue) {
+        if(m_taskCount == 0)
+          m_wait.wait(m_mutexWait);
+        else
+          m_wait.wait(m_mutexWait, Nimble::Math::Max
+                      ((int) (toWait.secondsD() * 1000.0), 1));
       }
+      Radiant::Atomic::add(&m_sleeping, -1);
+      m_mutexWait.unlock();
     }
-
-    // Down use all the cpu
-    Radiant::Sleep::sleepS(1);
   }
 
-  Task * BGThread::pickNextTask(Radiant::TimeStamp & wait)
+  Task * BGThread::pickNextTask(Worker * worker, Radiant::TimeStamp & wait)
   { 
 //    Radiant::trace("BGThread::pickNextTask #");
-    Radiant::Guard guard(&m_mutex);
+    const Radiant::TimeStamp now = Radiant::TimeStamp::getTime();
+
+    bool own = false;
+    Priority best = 0;
+
+    {
+      Radiant::Guard guard(worker->m_mutex);
+      if(peekRunnable(worker, now, wait)) {
+        own = true;
+        best = worker->m_ready.top()->m_queuedPriority;
+      }
+    }
+
+    /* Steal from the other workers, if they have more urgent tasks
+       than we have, or if we have nothing to do. */
+    int n = (int) m_workers.size();
+
+    for(int i = 1; i < n; i++) {
+      Worker * victim = m_workers[(worker->m_index + i) % n];
 
-    if(m_taskQueue.empty()) { 
+      // Skip workers that have nothing, without touching their mutex
+      if(victim->m_queued <= 0 && !victim->m_inbox)
+        continue;
+
+      Radiant::Guard guard(victim->m_mutex);
+
+      if(peekRunnable(victim, now, wait) &&
+         (!own || victim->m_ready.top()->m_queuedPriority > best))
+        return dequeue(victim);
+    }
+
+    if(!own)
+      return 0;
+
+    Radiant::Guard guard(worker->m_mutex);
+
+    // Someone may have stolen the task in the meantime
+    if(!peekRunnable(worker, now, wait))
       return 0;
+
+    return dequeue(worker);
+  }
+
+  void BGThread::processInbox(Worker * worker)
+  {
+    Message * msg = Radiant::Atomic::exchangePtr(&worker->m_inbox,
+                                                 (Message *) 0);
+
+    // The inbox is a stack, reverse it to process messages in FIFO order
+    Message * fifo = 0;
+    while(msg) {
+      Message * next = msg->m_next;
+      msg->m_next = fifo;
+      fifo = msg;
+      msg = next;
     }
 
-    const Radiant::TimeStamp now = Radiant::TimeStamp::getTime();
+    while(fifo) {
+      msg = fifo;
+      fifo = fifo->m_next;
+
+      Task * task = msg->m_task;
+
+      if(msg->m_type == Message::ADD_TASK) {
+        assert(task->m_queueState == Task::QUEUE_INBOX);
+        enqueue(worker, task);
+        delete msg;
+        continue;
+      }
+
+      int index = task->m_worker;
+
+      if(index == worker->m_index) {
+        // The task is ours, so its state cannot change under our feet
+        if(task->m_queueState == Task::QUEUE_READY &&
+           task->m_queuedPriority != task->m_priority) {
+          task->m_queuedPriority = task->m_priority;
+          worker->m_ready.update(task);
+        }
+      }
+      else if(index >= 0 && task->m_queueState != Task::QUEUE_NONE) {
+        // The task has moved to another worker meanwhile
+        post(m_workers[index], msg);
+        continue;
+      }
 
-    assert(!m_taskQueue.empty());
-    wait = m_taskQueue.begin()->second->scheduled() - now;
+      /* In other states the task is not in a heap, and the new priority
+         is picked up when it is queued. */
+      Radiant::Atomic::add(&task->m_pendingMessages, -1);
+      delete msg;
+    }
+  }
 
-    for(container::iterator it = m_taskQueue.begin(); it != m_taskQueue.end(); it++) {
-      Task * task = it->second;      
+  bool BGThread::peekRunnable(Worker * worker, Radiant::TimeStamp now,
+                              Radiant::TimeStamp & wait)
+  {
+    processInbox(worker);
 
-//      Radiant::trace("\tTASK SCHEDULED %s; NOW %s", task->scheduled().asString().c_str(), now.asString().c_str());
+    // Move the tasks whose time has come to the ready-heap
+    while(!worker->m_timed.empty()) {
+      Task * task = worker->m_timed.top();
 
-      // Should the task be run now?
-      if(task->scheduled() <= now) {
-        wait = 0;
-        m_taskQueue.erase(it);
-        return task;
-      } else {
-        Radiant::TimeStamp next = task->scheduled() - now;
+      if(task->m_queuedTime > now) {
+        Radiant::TimeStamp next = task->m_queuedTime - now;
         wait = Nimble::Math::Min(wait, next);
+        break;
       }
+
+      worker->m_timed.pop();
+      task->m_queuedPriority = task->m_priority;
+      task->m_queueState = Task::QUEUE_READY;
+      worker->m_ready.push(task);
     }
 
-    return 0;
+    return !worker->m_ready.empty();
+  }
+
+  void BGThread::enqueue(Worker * worker, Task * task)
+  {
+    task->m_worker = worker->m_index;
+    task->m_queuedPriority = task->m_priority;
+    task->m_queuedTime = task->scheduled();
+    task->m_sequence = worker->m_sequence++;
+
+    if(task->m_queuedTime > Radiant::TimeStamp::getTime()) {
+      task->m_queueState = Task::QUEUE_TIMED;
+      worker->m_timed.push(task);
+    }
+    else {
+      task->m_queueState = Task::QUEUE_READY;
+      worker->m_ready.push(task);
+    }
+  }
+
+  Task * BGThread::dequeue(Worker * worker)
+  {
+    Task * task = worker->m_ready.pop();
+
+    task->m_queueState = Task::QUEUE_NONE;
+    task->m_worker = -1;
+
+    Radiant::Atomic::add(&worker->m_queued, -1);
+    Radiant::Atomic::add(&m_taskCount, -1);
+
+    return task;
+  }
+
+  void BGThread::post(Worker * worker, Message * msg)
+  {
+    Message * head;
+
+    do {
+      head = worker->m_inbox;
+      msg->m_next = head;
+    } while(!Radiant::Atomic::compareAndSwapPtr(&worker->m_inbox, head, msg));
+  }
+
+  void BGThread::releaseMessages(Task * task)
+  {
+    /* Priority updates may still refer to the task. The owner of the
+       task may delete it once it is finished, so make sure that none
+       of the inboxes contains messages about the task any more. */
+    while(task->m_pendingMessages > 0) {
+      for(size_t i = 0; i < m_workers.size(); i++) {
+        Radiant::Guard guard(m_workers[i]->m_mutex);
+        processInbox(m_workers[i]);
+      }
+    }
+  }
+
+  void BGThread::wakeWorker()
+  {
+    Radiant::Atomic::add(&m_generation, 1);
+
+    // Only take the lock if some worker is actually waiting
+    if(m_sleeping > 0) {
+      m_mutexWait.lock();
+      m_wait.wakeOne();
+      m_mutexWait.unlock();
+    }
   }
 
 }
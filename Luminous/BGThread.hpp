@@ -19,25 +19,51 @@
 #include <Luminous/Export.hpp>
 #include <Luminous/Task.hpp>
 
+#include <Patterns/NotCopyable.hpp>
+
 #include <Radiant/Condition.hpp>
 #include <Radiant/Mutex.hpp>
 #include <Radiant/Thread.hpp>
 
-#include <list>
-#include <map>
+#include <vector>
 
 namespace Luminous
 {
 
-  /// A class used to execute tasks in a separate thread.
-
-  class LUMINOUS_API BGThread : public Radiant::Thread
+  /// A class used to execute tasks in a pool of background threads.
+  /** BGThread runs a number of worker threads. Each worker has its own
+      queue of tasks, ordered by task priority. A worker first looks
+      for runnable tasks from its own queue, and steals tasks from the
+      other workers when they have more urgent work pending (or when it
+      has nothing else to do). Tasks whose scheduled time is in the
+      future are skipped until their time comes.
+
+      The queue of each worker is an indexed binary heap: every task
+      knows its slot in the heap, so that changing the priority of a
+      task costs O(log n). New tasks and priority changes are posted
+      to a lock-free inbox of the worker, and applied by whichever
+      thread next locks the queue. Thus addTask(), setPriority() and
+      taskCount() never wait for a worker that is holding its queue.
+
+      Since tasks may be executed by any of the workers, tasks that
+      share data with each other should use generalMutex() (or some
+      other locking) to protect the shared state. */
+
+  class LUMINOUS_API BGThread : public Patterns::NotCopyable
   {
 
   public:
-    BGThread();
+    /** Creates the thread pool. The threads are not started before
+        run() is called.
+
+        @param threads The number of worker threads. If the value is
+        zero (or less) defaultThreadCount() threads are used. */
+    BGThread(int threads = 0);
     virtual ~BGThread();
 
+    /// Starts the worker threads
+    virtual bool run();
+
     /// Add a task to be executed
     virtual void addTask(Task * task);
 
@@ -45,20 +71,37 @@ namespace Luminous
     // immediate
     //virtual void markForDeletion(Task * task);
 
-    /// Stop the thread and wait for it to terminate
+    /// Stop the threads and wait for them to terminate
     virtual void stop();
 
     /// Change the priority of a task
-    ///@todo Check that it works in all cases
+    /** The change is applied asynchronously, the next time a worker
+        looks at the queue. If the task is being executed at the
+        moment, the new priority takes effect when the task is put
+        back to the queue. */
     virtual void setPriority(Task * task, Priority p);
 
     static BGThread * instance();
 
-    typedef std::multimap<Priority, Task *, std::greater<Priority> > container;
-    typedef std::pair<Priority, Task * > contained;
-
+    /// Returns the number of tasks waiting in the queues
     unsigned taskCount();
 
+    /// Returns the number of worker threads
+    int threadCount() const { return (int) m_workers.size(); }
+
+    /// Returns true if the worker threads are running
+    bool isRunning();
+
+    /// The number of worker threads that is used by default
+    /** Unless changed with setDefaultThreadCount, this is the number
+        of CPUs in the system. */
+    static int defaultThreadCount();
+    /// Sets the number of worker threads that is used by default
+    /** This affects the BGThread objects that are created after the
+        call, including the object returned by instance(), if it has
+        not been created yet. */
+    static void setDefaultThreadCount(int threads);
+
     /** This method returns a mutex that Task objects and their
     clients can use to perform temporary mutex locking.
 
@@ -66,29 +109,48 @@ namespace Luminous
     accessing the tasks, without the need to create a separate
     mutex for each class. It is assumed that in general the mutex
     is going to be used by few threads only - the background
-    thread and one or few client threads.
+    threads and one or few client threads.
 
     BGThread does not use this mutex for anything.
     */
     Radiant::Mutex * generalMutex();
 
   protected:
-    virtual void childLoop();
 
-    Task * pickNextTask(Radiant::TimeStamp & wait);
+    class Worker;
+    class Message;
+
+    void workerLoop(Worker * worker);
+
+    Task * pickNextTask(Worker * worker, Radiant::TimeStamp & wait);
+
+    // The following functions must be called with the worker mutex locked
+    void processInbox(Worker * worker);
+    bool peekRunnable(Worker * worker, Radiant::TimeStamp now,
+                      Radiant::TimeStamp & wait);
+    void enqueue(Worker * worker, Task * task);
+    Task * dequeue(Worker * worker);
+
+    void post(Worker * worker, Message * msg);
+    void releaseMessages(Task * task);
+    void wakeWorker();
 
     Radiant::MutexAuto m_generalMutex;
-    Radiant::MutexAuto m_mutex;
     Radiant::MutexAuto m_mutexWait;
     Radiant::Condition m_wait;
+    // Incremented whenever new work appears
+    volatile int m_generation;
+    // Number of workers waiting for m_wait
+    volatile int m_sleeping;
+    volatile int m_taskCount;
 
-    container m_taskQueue;
+    std::vector<Worker *> m_workers;
 
-    bool m_continue;
+    volatile bool m_continue;
     static BGThread * m_instance;
+    static int m_defaultThreadCount;
   };
 
 }
 
 #endif
-
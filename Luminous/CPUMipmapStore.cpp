@@ -15,14 +15,28 @@
 
 #include "CPUMipmapStore.hpp"
 
+#include <Radiant/Atomic.hpp>
+#include <Radiant/TimeStamp.hpp>
 #include <Radiant/Trace.hpp>
 
+#include <algorithm>
+#include <map>
+#include <vector>
+
 namespace Luminous {
 
   using namespace Radiant;
 
   static Radiant::MutexStatic __mutex;
 
+  static volatile int64_t __budget = 0;
+  static volatile int64_t __usage = 0;
+  static volatile int64_t __hits = 0;
+  static volatile int64_t __misses = 0;
+  static volatile int64_t __evictions = 0;
+  // Time when enforceBudget may scan the mipmaps next
+  static volatile int64_t __nextScan = 0;
+
   /* Note that the mipmaps are not deleted opun application exit. This
      is done on purpose: As we are daeling with static data one easily
      gets conflicts with the order of deleting resources. As a result
@@ -110,4 +124,157 @@ namespace Luminous {
     }
   }
 
+  void CPUMipmapStore::setMemoryBudget(uint64_t bytes)
+  {
+    __budget = bytes;
+  }
+
+  uint64_t CPUMipmapStore::memoryBudget()
+  {
+    return __budget;
+  }
+
+  uint64_t CPUMipmapStore::memoryUsage()
+  {
+    return Atomic::add( & __usage, 0);
+  }
+
+  /* One level that could be dropped to get under the memory budget. */
+  class EvictionCandidate
+  {
+  public:
+    EvictionCandidate(CPUMipmaps * mipmaps, int level, int bytes,
+                      bool thumbnail, float score)
+      : m_mipmaps(mipmaps), m_level(level), m_bytes(bytes),
+        m_thumbnail(thumbnail), m_score(score)
+    {}
+
+    /* Larger levels go first, thumbnails last. Within the groups the
+       levels that have been unused longest go first. */
+    bool operator < (const EvictionCandidate & that) const
+    {
+      if(m_thumbnail != that.m_thumbnail)
+        return !m_thumbnail;
+      return m_score > that.m_score;
+    }
+
+    CPUMipmaps * m_mipmaps;
+    int   m_level;
+    int   m_bytes;
+    bool  m_thumbnail;
+    float m_score;
+  };
+
+  void CPUMipmapStore::enforceBudget()
+  {
+    int64_t budget = __budget;
+
+    int64_t usage = Atomic::add( & __usage, 0);
+
+    if(budget <= 0 || usage <= budget)
+      return;
+
+    /* The scan goes through all mipmaps, so only one thread does it,
+       and at most ten times per second. Levels that are marked are
+       dropped by the next updates. */
+    int64_t now = TimeStamp::getTime();
+    int64_t next = __nextScan;
+
+    if(now < next ||
+       !Atomic::compareAndSwap( & __nextScan, next,
+                               now + TimeStamp::ticksPerSecond() / 10))
+      return;
+
+    Radiant::GuardStatic g( & __mutex);
+
+    static std::vector<EvictionCandidate> candidates;
+    candidates.clear();
+
+    for(MipMapItemContainer::iterator it = __mipmaps.begin();
+        it != __mipmaps.end(); it++) {
+
+      CPUMipmaps * mm = (*it).second.m_mipmaps;
+
+      if(!mm)
+        continue;
+
+      for(int i = CPUMipmaps::lowestLevel(); i < CPUMipmaps::MAX_MAPS; i++) {
+        float idle = mm->m_levelIdle[i];
+
+        if(idle <= 0.0f)
+          continue;
+
+        bool thumbnail = i <= CPUMipmaps::DEFAULT_MAP1;
+        float score = idle;
+
+        // Bigger levels cost more to keep
+        if(!thumbnail)
+          score *= float(i - CPUMipmaps::DEFAULT_MAP1 + 1);
+
+        candidates.push_back(EvictionCandidate(mm, i, mm->m_levelBytes[i],
+                                               thumbnail, score));
+      }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    /* Go a bit below the budget, so that we do not need to evict
+       something again on the next frame. */
+    int64_t excess = usage - (budget - budget / 10);
+
+    for(size_t i = 0; i < candidates.size() && excess > 0; i++) {
+      EvictionCandidate & c = candidates[i];
+      volatile int * mask = & c.m_mipmaps->m_evictMask;
+      int old = *mask;
+
+      while(!Atomic::compareAndSwap(mask, old, old | (1 << c.m_level)))
+        old = *mask;
+
+      excess -= c.m_bytes;
+    }
+  }
+
+  uint64_t CPUMipmapStore::hits()
+  {
+    return Atomic::add( & __hits, 0);
+  }
+
+  uint64_t CPUMipmapStore::misses()
+  {
+    return Atomic::add( & __misses, 0);
+  }
+
+  uint64_t CPUMipmapStore::evictions()
+  {
+    return Atomic::add( & __evictions, 0);
+  }
+
+  void CPUMipmapStore::resetCounters()
+  {
+    Atomic::add( & __hits, -Atomic::add( & __hits, 0));
+    Atomic::add( & __misses, -Atomic::add( & __misses, 0));
+    Atomic::add( & __evictions, -Atomic::add( & __evictions, 0));
+  }
+
+  void CPUMipmapStore::changeByteConsumption(int64_t deltaBytes)
+  {
+    if(deltaBytes)
+      Atomic::add( & __usage, deltaBytes);
+  }
+
+  void CPUMipmapStore::countHit()
+  {
+    Atomic::add( & __hits, 1);
+  }
+
+  void CPUMipmapStore::countMiss()
+  {
+    Atomic::add( & __misses, 1);
+  }
+
+  void CPUMipmapStore::countEviction()
+  {
+    Atomic::add( & __evictions, 1);
+  }
+
 }
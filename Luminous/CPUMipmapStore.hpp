@@ -22,7 +22,13 @@ namespace Luminous {
 
 
   /** Shared CPUMipmap storage. This class is used as an access point
-      to load CPUMipmap objects from the hard-disk. */
+      to load CPUMipmap objects from the hard-disk.
+
+      The store keeps count of the memory used by the mipmap levels of
+      all CPUMipmaps objects. If a memory budget is set, the least
+      recently used levels are dropped when the budget is exceeded.
+      The lowest levels (up to the first thumbnail level) are kept
+      longest, since they are small and needed for quick previews. */
   class LUMINOUS_API CPUMipmapStore
   {
   public:
@@ -38,6 +44,39 @@ namespace Luminous {
     /** Release a #Luminous::CPUMipmaps object. If there are no references to
     the object, then its memory is freed. */
     static void release(Luminous::CPUMipmaps *);
+
+    /** Sets the memory budget for the CPU-side mipmaps, in bytes. Zero
+        means no limit, which is the default. */
+    static void setMemoryBudget(uint64_t bytes);
+    /// Returns the memory budget in bytes
+    static uint64_t memoryBudget();
+    /// Returns the number of bytes used by the mipmap images
+    static uint64_t memoryUsage();
+
+    /** Chooses least recently used levels to drop, until the memory
+        usage would be below the budget. This is called automatically
+        from CPUMipmaps::update, and does its work at most ten times
+        per second. The chosen levels are only marked: each CPUMipmaps
+        object drops them in its own update, unless they have been used
+        since. */
+    static void enforceBudget();
+
+    /// Number of times that the optimal level was available
+    static uint64_t hits();
+    /// Number of times that the optimal level was not available
+    static uint64_t misses();
+    /// Number of levels dropped because of the memory budget
+    static uint64_t evictions();
+    /// Resets the hit, miss and eviction counters
+    static void resetCounters();
+
+  private:
+    friend class CPUMipmaps;
+
+    static void changeByteConsumption(int64_t deltaBytes);
+    static void countHit();
+    static void countMiss();
+    static void countEviction();
   };
 }
 
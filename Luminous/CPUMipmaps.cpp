@@ -15,10 +15,13 @@
 
 #include "CPUMipmaps.hpp"
 
+#include "CPUMipmapStore.hpp"
 #include "GPUMipmaps.hpp"
+#include "MipmapCacheFile.hpp"
 
 #include <Luminous/GLResources.hpp>
 
+#include <Radiant/Atomic.hpp>
 #include <Radiant/Directory.hpp>
 #include <Radiant/FileUtils.hpp>
 #include <Radiant/Trace.hpp>
@@ -32,11 +35,13 @@ namespace Luminous {
 
   CPUMipmaps::Loader::Loader(Luminous::Priority prio,
 			     CPUMipmaps * master, 
-			     CPUItem * dest, const std::string file)
+			     CPUItem * dest, const std::string file,
+                             int level)
     : Task(prio),
       m_master(master),
       m_dest(dest),
-      m_file(file)
+      m_file(file),
+      m_level(level)
   {
     assert(dest);
     // info("CPUMipmaps::Loader::Loader # %s", file.c_str());
@@ -56,7 +61,15 @@ namespace Luminous {
 
     Image * image = new Image();
 
-    bool ok = image->read(m_file.c_str());
+    bool ok;
+
+    if(m_level >= 0) {
+      MipmapCacheFile cache(m_file, m_master->m_sourceBytes,
+                            m_master->m_sourceModified);
+      ok = cache.readLevel(m_level, *image);
+    }
+    else
+      ok = image->read(m_file.c_str());
     
     /* trace("CPUMipmaps::Loader::doTask # Loaded %s : %d",
           m_file.c_str(), (int) ok);
@@ -89,7 +102,7 @@ namespace Luminous {
 	m_master->m_ok = false;
       }
       else {
-        m_dest->m_image = image;
+        m_dest->setImage(image);
         m_dest->m_state = FINISHED;
       }
       
@@ -197,27 +210,18 @@ namespace Luminous {
     
     // trace("CPUMipmaps::Scaler::doTask # created level %d", m_level);
 
-    if(m_file.size()) {
+    bool saved = false;
 
-      if(!Directory::mkdir(FileUtils::path(m_file))) {
-        /* This is just debug. The mkdir may fail if the directory
-           already exist, which is not really a problem. */
-	debug("Could not create directory %s", FileUtils::path(m_file).c_str());
-      }
+    if(m_file.size()) {
 
-      bool ok;
+      MipmapCacheFile cache(m_file, m_master->m_sourceBytes,
+                            m_master->m_sourceModified);
 
-      if(dimage->pixelFormat() == PixelFormat::rgbaUByte()) {
-        // if(FileUtils::suffix(m_file) == "PNG")
-        //  m_file = FileUtils::baseFileName(m_file) + ".png";
-        ok = dimage->write(m_file.c_str());
-      } else
-        ok = dimage->write(m_file.c_str());
+      saved = cache.writeLevel(m_level, *dimage);
 
-      if(ok)
-        debug("CPUMipmaps::Scaler::doTask # Saved mipmap %s", m_file.c_str());
-      else
-        error("CPUMipmaps::Scaler::doTask # Failed saving %s", m_file.c_str());
+      if(saved)
+        debug("CPUMipmaps::Scaler::doTask # Saved mipmap %d to %s",
+              m_level, m_file.c_str());
     }
 
     Guard g(generalMutex());
@@ -226,11 +230,16 @@ namespace Luminous {
       assert(m_dest->m_scaler == this);
 
       m_dest->m_scaler = 0;
-      m_dest->m_image = dref;
+      m_dest->setImage(dref);
       m_dest->m_state = FINISHED;
     }
 
-    if(m_file.size())
+    /* The source may now be dropped from memory without touching this
+       task any more. */
+    if(m_source && m_source->m_scalerOut == this)
+      m_source->m_scalerOut = 0;
+
+    if(saved)
       m_master->m_fileMask = m_master->m_fileMask | (1 << m_level);
 
     // Break the links explicitly, while protected by the guard.
@@ -251,7 +260,8 @@ namespace Luminous {
       m_scaler(0),
       m_loader(0),
       m_image(0),
-      m_unUsed(0)
+      m_unUsed(0),
+      m_bytes(0)
   {
     //trace("CPUMipmaps::CPUItem::CPUqItem # %d", ++__cpcount);
   }
@@ -275,6 +285,20 @@ namespace Luminous {
     }
 
     m_image.breakLink();
+
+    CPUMipmapStore::changeByteConsumption(-m_bytes);
+  }
+
+  void CPUMipmaps::CPUItem::setImage(const Radiant::RefPtr<Image> & image)
+  {
+    m_image = image;
+
+    const Image * im = m_image.ptr();
+    int64_t bytes = im ?
+      int64_t(im->width()) * im->height() * im->pixelFormat().numChannels() : 0;
+
+    CPUMipmapStore::changeByteConsumption(bytes - m_bytes);
+    m_bytes = bytes;
   }
 
   /////////////////////////////////////////////////////////////////////////////
@@ -284,9 +308,17 @@ namespace Luminous {
     : m_nativeSize(100, 100),
       m_maxLevel(0),
       m_fileMask(0),
+      m_sourceBytes(0),
+      m_sourceModified(0),
       m_hasAlpha(false),
+      m_evictMask(0),
       m_ok(true)
-  {}
+  {
+    for(int i = 0; i < MAX_MAPS; i++) {
+      m_levelIdle[i] = -1.0f;
+      m_levelBytes[i] = 0;
+    }
+  }
 
   CPUMipmaps::~CPUMipmaps()
   {
@@ -295,11 +327,25 @@ namespace Luminous {
   
   void CPUMipmaps::update(float dt, float purgeTime)
   {
+    // Take the levels that CPUMipmapStore wants to drop
+    int evict = m_evictMask;
+    while(evict && !Atomic::compareAndSwap( & m_evictMask, evict, 0))
+      evict = m_evictMask;
+
     for(int i = DEFAULT_MAP1; i <= m_maxLevel; i++) {
       CPUItem * item = m_stack[i].ptr();
 
+      m_levelIdle[i] = -1.0f;
+
       if(!item)
         continue;
+
+      /* Levels used since the last update, levels still being worked
+         on, and levels that feed a pending scaler are never dropped
+         for the budget. */
+      bool droppable = item->m_unUsed > 0.0f && !item->working() &&
+        !item->m_scalerOut && item->m_bytes;
+
       item->m_unUsed += dt;
 
       if(item->m_unUsed > purgeTime && purgeTime >= 0) {
@@ -307,7 +353,17 @@ namespace Luminous {
 	// trace("CPUMipmaps:: # Dropping level %d from CPU", i);
         m_stack[i].clear();
       }
+      else if(droppable && (evict & (1 << i))) {
+        m_stack[i].clear();
+        CPUMipmapStore::countEviction();
+      }
+      else if(droppable) {
+        m_levelIdle[i] = item->m_unUsed;
+        m_levelBytes[i] = (int) item->m_bytes;
+      }
     }
+
+    CPUMipmapStore::enforceBudget();
   }
 
   int CPUMipmaps::getOptimal(Nimble::Vector2f size)
@@ -339,8 +395,12 @@ namespace Luminous {
     if(item && item->m_state == FINISHED) {
       /* This is the happy case when the desired level is readily
 	 available. */
+      CPUMipmapStore::countHit();
       return bestlevel;
     }
+
+    CPUMipmapStore::countMiss();
+
     if(!item || item->needsLoader()) {
       createLevelScalers(bestlevel);      
     }
@@ -396,6 +456,20 @@ namespace Luminous {
     return item->m_image.ptr();
   }
 
+  Radiant::RefPtr<Image> CPUMipmaps::getImageRef(int i)
+  {
+    Guard g(bgt()->generalMutex());
+
+    CPUItem * item = m_stack[i].ptr();
+
+    if(!item)
+      return Radiant::RefPtr<Image>();
+
+    item->m_unUsed = 0.0f;
+
+    return item->m_image;
+  }
+
   void CPUMipmaps::markImage(int i)
   {
     CPUItem * item = m_stack[i].ptr();
@@ -466,16 +540,18 @@ namespace Luminous {
     
     m_maxLevel = i < MAX_MAPS ? i : MAX_MAPS - 1;
 
-    for(i = lowestLevel(); i <= (unsigned) m_maxLevel; i++) {
-      if(savebleMipmap(i)) {
-	
-	std::string cachefile;
-	cacheFileName(cachefile, i);
-	
-	if(FileUtils::fileReadable(cachefile.c_str())) {
-	  m_fileMask = m_fileMask | (1 << i);
-	}
-      }
+    /* One look at the cache header tells which levels are available,
+       and whether they were made from this version of the file. */
+    m_fileMask = 0;
+    m_sourceBytes = 0;
+    m_sourceModified = 0;
+
+    if(FileUtils::getFileInfo(m_filename, m_sourceBytes, m_sourceModified)) {
+      std::string cachefile;
+      cacheFileName(cachefile);
+
+      MipmapCacheFile cache(cachefile, m_sourceBytes, m_sourceModified);
+      m_fileMask = cache.levelMask();
     }
 
     if(immediate) {
@@ -622,7 +698,7 @@ namespace Luminous {
         // Now load the lowest mip-map from file, with higher priority.
         
         std::string cachefile;
-        cacheFileName(cachefile, DEFAULT_MAP1);
+        cacheFileName(cachefile);
 
         Guard g(bgt()->generalMutex());
 
@@ -632,7 +708,7 @@ namespace Luminous {
         CPUItem * ci = m_stack[DEFAULT_MAP1].ptr();
 
         Loader * load = new Loader(levelPriority(DEFAULT_MAP1),
-                                   this, ci, cachefile);
+                                   this, ci, cachefile, DEFAULT_MAP1);
         ci->m_loader = load;
         bgt()->addTask(load);
 
@@ -644,21 +720,17 @@ namespace Luminous {
       for(int i = level; i <= m_maxLevel; i++) {
 	if((savebleMipmap(i) || (i == m_maxLevel)) && needsLoader(i)) {
 
-	  std::string cachefile;
-	  cacheFileName(cachefile, i);
-
-          // if(FileUtils::fileReadable(cachefile.c_str())) {
           if(m_fileMask & (1 << i)) {
           
             // trace("CPUMipmaps::createLevelScalers # Loading cache %d", i);
             
             std::string cachefile;
-            cacheFileName(cachefile, i);
+            cacheFileName(cachefile);
 
 	    Guard g(bgt()->generalMutex());
             
             Loader * load = new Loader(levelPriority(i),
-				       this, m_stack[i].ptr(), cachefile);
+				       this, m_stack[i].ptr(), cachefile, i);
             m_stack[i].ptr()->m_loader = load;
             higher = i;
             bgt()->addTask(load);
@@ -724,7 +796,7 @@ namespace Luminous {
 	uint32_t mask = 1 << i;
 
         if(savebleMipmap(i) && ((m_fileMask & mask) == 0)) {
-	  cacheFileName(s->m_file, i);
+	  cacheFileName(s->m_file);
         }
 
         if(higher == m_maxLevel)
@@ -735,34 +807,17 @@ namespace Luminous {
     }
   }
 
-  void CPUMipmaps::cacheFileName(std::string & name, int level)
+  void CPUMipmaps::cacheFileName(std::string & name)
   {
-    char buf[32];
-
     name = Radiant::FileUtils::path(m_filename);
 
     if(name.empty())
-      sprintf(buf, ".imagecache/%.2d_", level);
+      name = ".imagecache/";
     else
-      sprintf(buf, "/.imagecache/%.2d_", level);
+      name += "/.imagecache/";
 
-    name += buf;
     name += Radiant::FileUtils::filename(m_filename);
-    
-    // Put in the right suffix
-
-    unsigned i = name.size() - 1;
-
-    while(i && name[i] != '.' && name[i] != '/')
-      i--;
-
-    name.erase(i + 1);
-
-    if(m_info.pf.layout() == PixelFormat::LAYOUT_RGB ||
-       m_info.pf.layout() == PixelFormat::LAYOUT_LUMINANCE)
-      name += "jpg";
-    else // if(m_info.pf.layout() == PixelFormat::LAYOUT_RGBA)
-      name += "png";
+    name += ".mipmaps";
   }
 
 }
@@ -27,6 +27,7 @@
 
 namespace Luminous {
 
+  class CPUMipmapStore;
   class GLResources;
   class GPUMipmaps;
 
@@ -49,6 +50,7 @@ namespace Luminous {
   public:
 
     friend class GPUMipmaps;
+    friend class CPUMipmapStore;
 
     LUMINOUS_API CPUMipmaps();
     LUMINOUS_API virtual ~CPUMipmaps();
@@ -71,6 +73,10 @@ namespace Luminous {
     /** Gets the mipmap image on level i. If the level does not
     contain a valid mipmap, then 0 is returned. */
     LUMINOUS_API Image * getImage(int i);
+    /** Returns a reference to the mipmap image on level i. Unlike
+    getImage, the returned image stays valid even if the level is
+    dropped from memory. */
+    LUMINOUS_API Radiant::RefPtr<Image> getImageRef(int i);
     /** Mark an image used. This method resets the idle-counter of the
     level, preventing it from being dropped from the memory in the
     near future. */
@@ -117,8 +123,12 @@ namespace Luminous {
     {
     public:
       friend class CPUItem;
+      /** If level is negative, the file is an image file that is
+          decoded. Otherwise the level is read from the mipmap cache
+          file. */
       Loader(Luminous::Priority prio,
-         CPUMipmaps * master, CPUItem * dest, const std::string file);
+         CPUMipmaps * master, CPUItem * dest, const std::string file,
+         int level = -1);
       virtual ~Loader();
 
       virtual void doTask();
@@ -127,6 +137,7 @@ namespace Luminous {
       CPUMipmaps * m_master;
       CPUItem    * m_dest;
       std::string  m_file;
+      int          m_level;
     };
 
     class Scaler : public Task
@@ -183,6 +194,9 @@ namespace Luminous {
     return (m_scaler != 0) || (m_loader != 0) || (m_state != FINISHED);
       }
 
+      /// Sets the image, and updates the memory usage in CPUMipmapStore
+      void setImage(const Radiant::RefPtr<Image> & image);
+
     private:
       ItemState m_state;
       Scaler  * m_scalerOut;
@@ -190,6 +204,8 @@ namespace Luminous {
       Loader  * m_loader;
       Radiant::RefPtr<Image> m_image;
       float     m_unUsed;
+      // Bytes reported to CPUMipmapStore for m_image
+      int64_t   m_bytes;
     };
 
 
@@ -207,7 +223,7 @@ namespace Luminous {
 
     void createLevelScalers(int level);
 
-    void cacheFileName(std::string &, int level);
+    void cacheFileName(std::string &);
 
     BGThread * bgt() { return BGThread::instance(); }
 
@@ -224,11 +240,23 @@ namespace Luminous {
     Radiant::RefPtr<CPUItem> m_stack[MAX_MAPS];
     Nimble::Vector2i m_nativeSize;
     int              m_maxLevel;
-    // What level files are available as mip-maps.
+    // What levels are available in the mipmap cache file.
     uint32_t         m_fileMask;
+    // Size and modification time of the source file, for the cache.
+    uint64_t         m_sourceBytes;
+    uint64_t         m_sourceModified;
     bool             m_hasAlpha;
     Radiant::TimeStamp m_startedLoading;
 
+    /* Published by update for CPUMipmapStore::enforceBudget, which
+       does not touch the items. The idle time is negative if the
+       level cannot be dropped. */
+    float            m_levelIdle[MAX_MAPS];
+    int              m_levelBytes[MAX_MAPS];
+    /* Levels that CPUMipmapStore has chosen to drop. They are dropped
+       by the next update, unless they have been used since. */
+    volatile int     m_evictMask;
+
     Luminous::ImageInfo m_info;
     bool                m_ok;
   };
@@ -22,7 +22,11 @@ namespace Luminous
 
   GLResource::GLResource(GLResources * resources)
     : m_resources(resources),
-      m_deleteOnFrame(0)
+      m_deleteOnFrame(0),
+      m_lastUsed(0),
+      m_priority(PRIORITY_NORMAL),
+      m_category(CATEGORY_OTHER),
+      m_reportedBytes(0)
   {}
   
   GLResource::~GLResource()
@@ -45,10 +49,33 @@ namespace Luminous
     return 0;
   }
 
-  void GLResource::changeByteConsumption(long deallocated, long allocated)
+  void GLResource::setCategory(Category category)
   {
+    if(category == m_category)
+      return;
+
     if(m_resources)
-      m_resources->changeByteConsumption(deallocated, allocated);
+      m_resources->moveCategory(m_reportedBytes, m_category, category);
+
+    m_category = category;
+  }
+
+  const char * GLResource::categoryName(Category category)
+  {
+    switch(category) {
+    case CATEGORY_TEXTURE: return "texture";
+    case CATEGORY_MIPMAP: return "mipmap";
+    case CATEGORY_FONT: return "font";
+    default: return "other";
+    }
+  }
+
+  void GLResource::changeByteConsumption(long deallocated, long allocated)
+  {
+    if(m_resources) {
+      m_reportedBytes += allocated - deallocated;
+      m_resources->changeByteConsumption(deallocated, allocated, m_category);
+    }
   }
 
 }
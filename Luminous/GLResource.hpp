@@ -114,6 +114,29 @@ namespace Luminous
   public:
     friend class GLResources;
 
+    /// Eviction priority hint
+    /** When GPU memory runs over budget, resources with lower priority
+        are evicted first, and resources of equal priority in least
+        recently used order. Only resources that have been given a
+        grace period with GLResources::deleteAfter are ever evicted,
+        for others the priority is only a hint. */
+    enum Priority {
+      /// Cheap to recreate, evicted first
+      PRIORITY_LOW,
+      PRIORITY_NORMAL,
+      /// Expensive to recreate, or needed as a fallback
+      PRIORITY_HIGH
+    };
+
+    /// Resource categories, for reporting GPU memory consumption
+    enum Category {
+      CATEGORY_OTHER,
+      CATEGORY_TEXTURE,
+      CATEGORY_MIPMAP,
+      CATEGORY_FONT,
+      CATEGORY_COUNT
+    };
+
     GLResource(GLResources * resources = 0);
     virtual ~GLResource();
 
@@ -126,6 +149,23 @@ namespace Luminous
     /// Returns the number of bytes this object consumes at the moment
     virtual long consumesBytes();
 
+    /// Sets the eviction priority of this resource
+    void setPriority(Priority priority) { m_priority = priority; }
+    /// Returns the eviction priority of this resource
+    Priority priority() const { return m_priority; }
+
+    /** Sets the category under which the memory consumption of this
+        resource is reported. */
+    void setCategory(Category category);
+    /// Returns the category of this resource
+    Category category() const { return m_category; }
+
+    /// The frame when this resource was last used
+    long lastUsedFrame() const { return m_lastUsed; }
+
+    /// Returns a human-readable name of the category
+    static const char * categoryName(Category category);
+
   protected:
 
     /// To be called when changing memory consumption
@@ -135,6 +175,12 @@ namespace Luminous
     GLResources * m_resources;
 
     long m_deleteOnFrame;
+    long m_lastUsed;
+
+    Priority m_priority;
+    Category m_category;
+    /// Bytes reported to m_resources through changeByteConsumption
+    long m_reportedBytes;
   };
 }
 
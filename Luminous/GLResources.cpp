@@ -23,8 +23,10 @@
 #include <Radiant/Thread.hpp>
 #include <Radiant/Trace.hpp>
 
+#include <algorithm>
 #include <cassert>
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <typeinfo>
@@ -34,11 +36,19 @@ namespace Luminous
   
   using namespace Radiant;
 
+  /// Initial size of the hash table, must be a power of two
+  static const size_t INITIAL_SLOTS = 64;
+
   GLResources::GLResources(Radiant::ResourceLocator & rl)
-    : m_deallocationSum(0),
+    : m_count(0),
+      m_shift(0),
+      m_deallocationSum(0),
       m_allocationSum(0),
       m_consumingBytes(0),
       m_comfortableGPURAM((1 << 20) * 70), // 70 MB
+      m_evictions(0),
+      m_frameAllocationSum(0),
+      m_uploadLimit((1 << 20) * 16), // 16 MB
       m_frame(0),
       m_resourceLocator(rl)
   {
@@ -49,6 +59,16 @@ namespace Luminous
       m_comfortableGPURAM = Nimble::Math::Max(atol(envgp) * (1 << 20),
 					      m_comfortableGPURAM);
     }
+
+    const char * envup = getenv("MULTI_GPU_UPLOAD");
+
+    if(envup)
+      m_uploadLimit = atol(envup) * (1 << 20);
+
+    for(int i = 0; i < GLResource::CATEGORY_COUNT; i++)
+      m_categoryBytes[i] = 0;
+
+    rehash(INITIAL_SLOTS);
   }
 
   GLResources::~GLResources()
@@ -65,39 +85,49 @@ namespace Luminous
 
   GLResource * GLResources::getResource(const Collectable * key)
   {
-    iterator it = m_resources.find(key);
+    GLResource * resource = m_slots[findSlot(key)].m_resource;
 
-    if(it == m_resources.end())
-      return 0;
+    if(resource)
+      resource->m_lastUsed = m_frame;
 
-    return (*it).second;
+    return resource;
   }
 
   void GLResources::addResource(const Collectable * key, GLResource * resource)
   {
-    iterator it = m_resources.find(key);
-
-    if(it != m_resources.end()) {
+    if(m_slots[findSlot(key)].m_key) {
       Radiant::error("GLResources::addResource # There already is a resource for %p", key);
       eraseResource(key);
     }
 
-    m_resources[key] = resource;
+    // Keep the load factor below 1/2
+    if((m_count + 1) * 2 > m_slots.size())
+      rehash(m_slots.size() * 2);
+
+    Slot & slot = m_slots[findSlot(key)];
+    slot.m_key = key;
+    slot.m_resource = resource;
+    m_count++;
+
+    resource->m_lastUsed = m_frame;
+
     long bytes = resource->consumesBytes();
     m_consumingBytes += bytes;
+    m_categoryBytes[resource->category()] += bytes;
     m_allocationSum += bytes;
+    m_frameAllocationSum += bytes;
   }
 
   bool GLResources::eraseResource(const Collectable * key)
   {
-    iterator it = m_resources.find(key);
+    size_t index = findSlot(key);
 
-    if(it == m_resources.end()) {
+    if(!m_slots[index].m_key) {
       //Radiant::error("GLResources::eraseResource # No resource for %p", key);
       return false;
     }
 
-    GLResource * resource = (*it).second;
+    GLResource * resource = m_slots[index].m_resource;
 
     /* long bytes = resource->consumesBytes();
 
@@ -107,61 +137,52 @@ namespace Luminous
     
     // Radiant::info("GLResources::eraseResource # Resource %s for %p erased", typeid(*resource).name(), key);
 
+    // Remove the slot first, the destructor may add or erase resources
+    eraseSlot(index);
     delete resource;
-    m_resources.erase(it);
 
     return true;
   }
 
   void GLResources::eraseResources()
   {
-    /* Radiant::info("GLResources::eraseResources # checking %d deleted keys",
-                  Luminous::GarbageCollector::size());
-    */
     eraseOnce();
 
     m_frame++;
-    
+    m_frameAllocationSum = 0;
 
-    for(iterator it = m_resources.begin();
-	(m_consumingBytes >= m_comfortableGPURAM) && 
-	  (it != m_resources.end()); ) {
-      
-      GLResource * r = (*it).second;
-
-      if(r->m_deleteOnFrame && r->m_deleteOnFrame < m_frame) {
-	
-        //Radiant::info("GLResources::eraseResource # Resource %s for %p erased", typeid(*(*it).second).name(), (*it).first);
-        // Radiant::trace("GLResources::eraseResources # Removing old");
-
-        delete (*it).second;
-        iterator tmp = it;
-        tmp++;
-        m_resources.erase(it);
-        it = tmp;
-      }
-      else
-        it++;
-    }
+    if(m_consumingBytes >= m_comfortableGPURAM)
+      evict();
   }
 
   void GLResources::clear()
   {
-    while(m_resources.size()) {
-      GLResource * res = (*m_resources.begin()).second;
-      delete res;
-      m_resources.erase(m_resources.begin());
-    }
+    std::vector<Slot> slots;
+    slots.swap(m_slots);
+
+    m_count = 0;
+    rehash(INITIAL_SLOTS);
+
+    for(size_t i = 0; i < slots.size(); i++)
+      delete slots[i].m_resource;
 
     m_deallocationSum = 0;
     m_allocationSum = 0;
+    m_frameAllocationSum = 0;
     m_consumingBytes = 0;
+
+    for(int i = 0; i < GLResource::CATEGORY_COUNT; i++)
+      m_categoryBytes[i] = 0;
   }
 
-  void GLResources::changeByteConsumption(long deallocated, long allocated)
+  void GLResources::changeByteConsumption(long deallocated, long allocated,
+                                          GLResource::Category category)
   {
+    m_categoryBytes[category] += (allocated - deallocated);
+
     m_deallocationSum += deallocated;
     m_allocationSum   += allocated;
+    m_frameAllocationSum += allocated;
     m_consumingBytes  += (allocated - deallocated);
 
     assert(m_consumingBytes >= 0);
@@ -169,6 +190,8 @@ namespace Luminous
 
   void GLResources::deleteAfter(GLResource * resource, int frames)
   {
+    resource->m_lastUsed = m_frame;
+
     if(frames >= 0)
       resource->m_deleteOnFrame = m_frame + frames;
     else
@@ -255,17 +278,107 @@ namespace Luminous
   
   void GLResources::eraseOnce()
   {
-    GarbageCollector::mutex().lock();
-    for(GarbageCollector::iterator it = GarbageCollector::begin();
-    it != GarbageCollector::end(); it++) {
+    m_deleted.clear();
+    m_garbage.take(m_deleted);
 
-      GarbageCollector::mutex().unlock();
-      const Collectable * key = GarbageCollector::getObject(it);
-      eraseResource(key);
+    for(size_t i = 0; i < m_deleted.size(); i++)
+      eraseResource(m_deleted[i]);
+  }
+
+  void GLResources::evict()
+  {
+    // Go below the threshold, so that the next frame does not evict again
+    long target = m_comfortableGPURAM - m_comfortableGPURAM / 10;
+
+    // Collect the old resources first, erasing moves the slots
+    m_candidates.clear();
+
+    for(size_t i = 0; i < m_slots.size(); i++) {
+      GLResource * r = m_slots[i].m_resource;
+
+      if(r && r->m_deleteOnFrame && r->m_deleteOnFrame < m_frame)
+        m_candidates.push_back(Candidate(m_slots[i].m_key, r));
+    }
+
+    std::sort(m_candidates.begin(), m_candidates.end());
+
+    for(size_t i = 0; i < m_candidates.size() &&
+          m_consumingBytes > target; i++) {
+      if(eraseResource(m_candidates[i].m_key))
+        m_evictions++;
+    }
+  }
+
+  void GLResources::moveCategory(long bytes, GLResource::Category from,
+                                 GLResource::Category to)
+  {
+    m_categoryBytes[from] -= bytes;
+    m_categoryBytes[to] += bytes;
+  }
+
+  size_t GLResources::slotOf(const Collectable * key) const
+  {
+    // Fibonacci hashing, the high bits of the product are well mixed
+    uint64_t h = (uint64_t) (uintptr_t) key * 0x9E3779B97F4A7C15ULL;
+    return size_t(h >> m_shift);
+  }
+
+  size_t GLResources::findSlot(const Collectable * key) const
+  {
+    size_t mask = m_slots.size() - 1;
+    size_t i = slotOf(key);
+
+    // Linear probing, the table always has empty slots
+    while(m_slots[i].m_key && m_slots[i].m_key != key)
+      i = (i + 1) & mask;
+
+    return i;
+  }
+
+  void GLResources::eraseSlot(size_t index)
+  {
+    size_t mask = m_slots.size() - 1;
+    size_t i = index;
+    size_t j = index;
+
+    /* Move the following entries of the cluster backwards, so that no
+       tombstones are needed. An entry can fill the hole at i unless its
+       home slot lies cyclically between i and j. */
+    for(;;) {
+      j = (j + 1) & mask;
+
+      if(!m_slots[j].m_key)
+        break;
+
+      size_t home = slotOf(m_slots[j].m_key);
+
+      if((j > i && (home <= i || home > j)) ||
+         (j < i && (home <= i && home > j))) {
+        m_slots[i] = m_slots[j];
+        i = j;
+      }
+    }
+
+    m_slots[i] = Slot();
+    m_count--;
+  }
+
+  void GLResources::rehash(size_t capacity)
+  {
+    std::vector<Slot> old;
+    old.swap(m_slots);
+
+    m_slots.resize(capacity);
+
+    int bits = 0;
+    while((size_t(1) << bits) < capacity)
+      bits++;
+    m_shift = 64 - bits;
 
-      GarbageCollector::mutex().lock();
+    for(size_t i = 0; i < old.size(); i++) {
+      if(old[i].m_key)
+        m_slots[findSlot(old[i].m_key)] = old[i];
     }
-    GarbageCollector::mutex().unlock();
   }
 
 
@@ -17,17 +17,18 @@
 #define LUMINOUS_GLRESOURCES_HPP
 
 #include <Luminous/Export.hpp>
+#include <Luminous/GarbageCollector.hpp>
+#include <Luminous/GLResource.hpp>
 #include <Luminous/MultiHead.hpp>
 
 #include <Radiant/ResourceLocator.hpp>
 
-#include <map>
+#include <vector>
 
 namespace Luminous
 {
   class Collectable;
   class GarbageCollector;
-  class GLResource;
 
   /// Collection of OpenGL-context -specific resources (textures, FBOs etc).
   /** This class is also used to store information about how much
@@ -39,8 +40,10 @@ namespace Luminous
       to the GPU during one frame etc.
       
       The GLResource objects are deleted if they are too old -
-      i.e. not used for some time. The old objects are only deleted
-      when the GPU RAM usage exceeds given threshold. By default the
+      i.e. not used for some time. Only resources that have been given
+      a grace period with deleteAfter can be deleted this way, and
+      only after the grace period has passed. The old objects are only
+      deleted when the GPU RAM usage exceeds given threshold. By default the
       threshold is 70MB, but it can be changed by setting environment
       variable MULTI_GPU_RAM to a numeric value that represents the
       number of GPU megabytes that one allowed to use. The value can
@@ -49,14 +52,34 @@ namespace Luminous
 
       For example setting MULTI_GPU_RAM to 200, GLResources starts to
       drop old resources from GPU as the GPU RAM usage exceeds 200MB.
+
+      The resources are evicted in the order of their priority (see
+      GLResource::setPriority), and resources of the same priority in
+      least recently used order. A resource is used when it is fetched
+      with getResource, or passed to deleteAfter. Eviction continues
+      until the usage is 10% below the threshold, so that a full GPU
+      memory does not evict a resource on every frame.
+
+      The memory consumption is also tracked per resource category
+      (see GLResource::setCategory), which tells where the GPU memory
+      goes.
+
+      Streaming uploads (see TextureUploader) are limited to a number
+      of bytes per frame, where a frame is counted by each call to
+      eraseResources. By default the limit is 16MB, and it can be
+      changed with environment variable MULTI_GPU_UPLOAD (in
+      megabytes), or with setUploadLimit.
+
+      The resources are kept in an open-addressing hash table, so
+      getResource does not depend on the number of resources. The
+      resources of deleted Collectable objects are found through a
+      GarbageCollector::Queue, so erasing them costs time in proportion
+      to the number of deleted objects.
   */
   class LUMINOUS_API GLResources
   {
   public:
 
-    typedef std::map<const Collectable *, GLResource *> container;
-    typedef container::iterator iterator;
-
     GLResources(Radiant::ResourceLocator & rl);
     virtual ~GLResources();
 
@@ -70,14 +93,23 @@ namespace Luminous
     void eraseResources();
     /// Erases all resources.
     void clear();
+    /// Number of resources
+    int resourceCount() const { return (int) m_count; }
     /// Tell the resource manager that byte consumption was changed
     /** Individual resource objects should call this function when
       their byte consumption changes. A typical example might be a
       texture object that is resized, or gets new mipmaps. */
-    void changeByteConsumption(long deallocated, long allocated);
+    void changeByteConsumption(long deallocated, long allocated,
+                               GLResource::Category category =
+                               GLResource::CATEGORY_OTHER);
     
     /// Total number of bytes used on the GPU
     long consumesBytes() const { return m_consumingBytes; }
+    /// Number of bytes used on the GPU by the given category of resources
+    long consumesBytes(GLResource::Category category) const
+    { return m_categoryBytes[category]; }
+    /// Number of resources evicted because of the GPU RAM threshold
+    long evictionCount() const { return m_evictions; }
 
     /// Number of bytes deallocated since last counter reset
     long deallocationSum() { return m_deallocationSum; }
@@ -89,11 +121,32 @@ namespace Luminous
       rendering the OpenGL scene. */
     void resetSumCounters() { m_deallocationSum = m_allocationSum = 0; }
 
+    /** Allows the resource to be evicted once the given number of
+        frames has passed, and marks it as used. With negative value
+        the resource can be evicted at any time. */
     void deleteAfter(GLResource * resource, int frames);
     /** Sets the threshold for deleting old objects from GPU memory. */
     void setComfortableGPURAM(long bytes)
     { m_comfortableGPURAM = bytes; }
 
+    /** Sets the number of bytes that may be uploaded to the GPU
+        during one frame. Zero or negative disables the limit. */
+    void setUploadLimit(long bytes) { m_uploadLimit = bytes; }
+    /// Returns the per-frame upload limit, in bytes
+    long uploadLimit() const { return m_uploadLimit; }
+    /// Number of bytes allocated during the current frame
+    long frameAllocationSum() const { return m_frameAllocationSum; }
+    /** Returns true if the given number of bytes can be uploaded
+        during this frame without exceeding the upload limit. The
+        first upload of each frame is always allowed, so that large
+        images get uploaded eventually. If eraseResources is never
+        called, there are no frames and no limit. */
+    bool canUpload(long bytes) const
+    {
+      return m_uploadLimit <= 0 || !m_frame || !m_frameAllocationSum ||
+        (m_frameAllocationSum + bytes <= m_uploadLimit);
+    }
+
     Radiant::ResourceLocator & resourceLocator() { return m_resourceLocator; }
 
     // static void setThreadResources(GLResources *);
@@ -104,11 +157,58 @@ namespace Luminous
     static void getThreadMultiHead(const MultiHead::Window ** w,
 				   const MultiHead::Area **);
  
- private:
-    
+  private:
+
+    friend class GLResource;
+
+    /// Slot of the resource hash table
+    class Slot
+    {
+    public:
+      Slot() : m_key(0), m_resource(0) {}
+
+      const Collectable * m_key;
+      GLResource * m_resource;
+    };
+
+    /// Resource that can be evicted
+    class Candidate
+    {
+    public:
+      Candidate(const Collectable * key, const GLResource * resource)
+        : m_key(key),
+          m_priority(resource->priority()),
+          m_lastUsed(resource->lastUsedFrame())
+      {}
+
+      bool operator < (const Candidate & that) const
+      {
+        return m_priority < that.m_priority ||
+          (m_priority == that.m_priority && m_lastUsed < that.m_lastUsed);
+      }
+
+      const Collectable * m_key;
+      int m_priority;
+      long m_lastUsed;
+    };
+
     void eraseOnce();
+    void evict();
+    void moveCategory(long bytes, GLResource::Category from,
+                      GLResource::Category to);
+
+    size_t slotOf(const Collectable * key) const;
+    size_t findSlot(const Collectable * key) const;
+    void eraseSlot(size_t index);
+    void rehash(size_t capacity);
 
-    container m_resources;
+    std::vector<Slot> m_slots;
+    size_t m_count;
+    int m_shift;
+
+    GarbageCollector::Queue m_garbage;
+    std::vector<const Collectable *> m_deleted;
+    std::vector<Candidate> m_candidates;
 
     long m_deallocationSum;
     long m_allocationSum;
@@ -119,6 +219,14 @@ namespace Luminous
     /** The maximum amount of GPU RAM to use before starting to erase
 	objects. */
     long m_comfortableGPURAM;
+    /// Bytes per resource category
+    long m_categoryBytes[GLResource::CATEGORY_COUNT];
+    long m_evictions;
+
+    /// Bytes allocated during the current frame
+    long m_frameAllocationSum;
+    /// Maximum number of bytes to upload per frame
+    long m_uploadLimit;
 
     long m_frame;
 
@@ -18,6 +18,7 @@
 #include "GPUMipmaps.hpp"
 
 #include <Luminous/GLResources.hpp>
+#include <Luminous/TextureUploader.hpp>
 
 #include <Radiant/Trace.hpp>
 
@@ -44,8 +45,14 @@ namespace Luminous {
       error("GPUMipmaps::~GPUMipmaps # %p resources object is needed for clean delete", this);
     }
     else {
-      for(int i = 0; i < CPUMipmaps::MAX_MAPS; i++)
+      TextureUploader * uploader =
+        TextureUploader::instance(resources(), false);
+
+      for(int i = 0; i < CPUMipmaps::MAX_MAPS; i++) {
+        if(uploader)
+          uploader->cancel(m_keys + i);
         resources()->eraseResource(m_keys + i);
+      }
     }
   }
 
@@ -112,16 +119,47 @@ namespace Luminous {
         assert(tex);
         tex->bind();
       }
+      else if(closest == CPUMipmaps::lowestLevel()) {
+        // The smallest level is tiny, and it is uploaded right away
+        tex = uploadLevel(closest);
+
+        if(tex)
+          tex->bind();
+      }
       else if(closest >= 0) {
-        tex = new Texture2D(resources());
-        resources()->addResource(m_keys + closest, tex);
-        tex->loadImage(*m_cpumaps->getImage(closest),
-		       closest == CPUMipmaps::lowestLevel());
-        tex->bind();
-      }      
+        /* Stream the level to the GPU in the background. Until it is
+           ready, use the best texture that is on the GPU already. */
+        TextureUploader * uploader = TextureUploader::instance(resources());
+        Collectable * key = m_keys + closest;
+
+        if(uploader->isPending(key))
+          tex = uploader->upload(key, Radiant::RefPtr<Image>());
+        else
+          tex = uploader->upload(key, m_cpumaps->getImageRef(closest));
+
+        if(!tex && mybest >= 0)
+          tex = dynamic_cast<Texture2D *> (res);
+
+        /* Nothing is on the GPU yet. Upload the lowest level right
+           away, so that the image is drawn while the better level
+           streams. If even that is not in CPU RAM, upload the closest
+           level synchronously, as before streaming. */
+        if(!tex) {
+          tex = uploadLevel(CPUMipmaps::lowestLevel());
+
+          if(!tex) {
+            uploader->cancel(key);
+            tex = uploadLevel(closest);
+          }
+        }
+
+        if(tex)
+          tex->bind();
+      }
     }
     
     if(tex) {
+      tex->setCategory(GLResource::CATEGORY_MIPMAP);
       resources()->deleteAfter(tex, 10);
     }
     else
@@ -130,6 +168,26 @@ namespace Luminous {
     return true;
   }
 
+  Texture2D * GPUMipmaps::uploadLevel(int level)
+  {
+    Image * image = m_cpumaps->getImage(level);
+
+    if(!image)
+      return 0;
+
+    bool lowest = level == CPUMipmaps::lowestLevel();
+
+    Texture2D * tex = new Texture2D(resources());
+    // The lowest level is the fallback for every other level, evict it last
+    if(lowest)
+      tex->setPriority(GLResource::PRIORITY_HIGH);
+    resources()->addResource(m_keys + level, tex);
+    // The lowest level gets CPU-built mipmaps
+    tex->loadImage(*image, lowest);
+
+    return tex;
+  }
+
   bool GPUMipmaps::bind(const Nimble::Matrix3 & transform, 
 			Nimble::Vector2 pixelsize)
   {
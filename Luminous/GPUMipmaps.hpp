@@ -58,6 +58,9 @@ namespace Luminous {
 
   private:
 
+    /// Uploads a level synchronously, returns 0 if it is not in CPU RAM
+    Texture2D * uploadLevel(int level);
+
     CPUMipmaps * m_cpumaps;
 
     Collectable m_keys[CPUMipmaps::MAX_MAPS];
@@ -15,13 +15,76 @@
 
 #include "GarbageCollector.hpp"
 
+#include <Radiant/Atomic.hpp>
+
+#include <algorithm>
+
 namespace Luminous
 {
 
-  GarbageCollector::container GarbageCollector::m_items;
+  class GarbageCollector::Queue::Node
+  {
+  public:
+    Node(const Collectable * obj, Node * next) : m_obj(obj), m_next(next) {}
+
+    const Collectable * m_obj;
+    Node * m_next;
+  };
+
+  std::vector<GarbageCollector::Queue *> GarbageCollector::m_queues;
 
   static Radiant::MutexStatic __garbmutex;
 
+  GarbageCollector::Queue::Queue()
+    : m_head(0)
+  {
+    Radiant::GuardStatic g(__garbmutex);
+    m_queues.push_back(this);
+  }
+
+  GarbageCollector::Queue::~Queue()
+  {
+    {
+      Radiant::GuardStatic g(__garbmutex);
+      m_queues.erase(std::find(m_queues.begin(), m_queues.end(), this));
+    }
+
+    Node * node = m_head;
+    while(node) {
+      Node * next = node->m_next;
+      delete node;
+      node = next;
+    }
+  }
+
+  int GarbageCollector::Queue::take(std::vector<const Collectable *> & objects)
+  {
+    Node * node = Radiant::Atomic::exchangePtr(&m_head, (Node *) 0);
+
+    int n = 0;
+
+    while(node) {
+      Node * next = node->m_next;
+      objects.push_back(node->m_obj);
+      delete node;
+      node = next;
+      n++;
+    }
+
+    return n;
+  }
+
+  void GarbageCollector::Queue::push(const Collectable * obj)
+  {
+    Node * node = new Node(obj, 0);
+    Node * head;
+
+    do {
+      head = m_head;
+      node->m_next = head;
+    } while(!Radiant::Atomic::compareAndSwapPtr(&m_head, head, node));
+  }
+
   GarbageCollector::GarbageCollector()
   {}
 
@@ -29,15 +92,14 @@ namespace Luminous
   {}
 
   void GarbageCollector::clear()
-  {
-    Radiant::GuardStatic g(__garbmutex);
-    m_items.clear();
-  }
+  {}
 
   void GarbageCollector::objectDeleted(Collectable * obj)
   {
     Radiant::GuardStatic g(__garbmutex);
-    m_items.insert(obj);
+
+    for(size_t i = 0; i < m_queues.size(); i++)
+      m_queues[i]->push(obj);
   }
 
   Radiant::MutexStatic & GarbageCollector::mutex()
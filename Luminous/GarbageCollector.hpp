@@ -18,9 +18,11 @@
 
 #include <Luminous/Export.hpp>
 
+#include <Patterns/NotCopyable.hpp>
+
 #include <Radiant/Mutex.hpp>
 
-#include <set>
+#include <vector>
 
 namespace Luminous
 {
@@ -29,74 +31,86 @@ namespace Luminous
 
   /// This class is used to keep track of objects that have been deleted.
 
-  /** The general usage pattern is as follows:
+  /** Every consumer of the deletion events (typically one GLResources
+      object per OpenGL context) owns a GarbageCollector::Queue. When a
+      Collectable object is deleted, its pointer is pushed to all the
+      queues, and the consumer takes the pointers from its queue when
+      it is ready to release the related resources:
 
       <pre>
 
       // Application main loop:
       while(true) {
 
-        // Clean up the collector:
-        GarbageCollector::clear();
-
-        // When Collectable objects are deleted, they store their pointers here
+        // When Collectable objects are deleted, they store their pointers
+        // to the queues
         updateLogic();
 
-    // Go set the OpenGL context
-    setOpenGLContext1();
+        // Go set the OpenGL context
+        setOpenGLContext1();
 
-    // Remove the deleted resources:
-    GLResources * rsc1 = getResources1();
-    rsc1->eraseResources();
-    renderOpenGL();
+        // Remove the deleted resources:
+        GLResources * rsc1 = getResources1();
+        rsc1->eraseResources();
+        renderOpenGL();
 
-    // Then another OpenGL context:
-    setOpenGLContext2();
+        // Then another OpenGL context:
+        setOpenGLContext2();
 
-    // Remove the deleted resources:
-    GLResources * rsc2 = getResources2();
-    rsc2->eraseResources();
-    renderOpenGL();
+        // Remove the deleted resources:
+        GLResources * rsc2 = getResources2();
+        rsc2->eraseResources();
+        renderOpenGL();
       }
       </pre>
 
-      This code snippet is for the single-threaded case, with two
-      OpenGL contexts.
+      The queues are lock-free, so the rendering threads never wait
+      for the threads that delete objects. The cost of processing a
+      queue is proportional to the number of deleted objects.
    */
   /// @todo Rename??
   class LUMINOUS_API GarbageCollector
   {
   public:
 
-    typedef std::set<Collectable *> container;
-    typedef container::iterator iterator;
+    /// Deleted objects for one consumer
+    class LUMINOUS_API Queue : public Patterns::NotCopyable
+    {
+    public:
+      /// Creates a queue and starts collecting the deleted objects
+      Queue();
+      ~Queue();
 
-    /// Empties the garbage list.
-    static void clear();
+      /// Moves the deleted objects to the end of the vector
+      /** Only one thread may take objects from a queue.
+          @return The number of objects taken */
+      int take(std::vector<const Collectable *> & objects);
 
-    /// Adds the obj to the list of deleted objects
-    static void objectDeleted(Collectable * obj);
+    private:
+      friend class GarbageCollector;
 
-    /// Iterator to the beginning of the list
-    static iterator begin() { return m_items.begin(); }
-    /// Iterator to the end of the list
-    static iterator end() { return m_items.end(); }
+      class Node;
 
-    /// Gets an object from an interator
-    /** By using this method to access the object, you can guarantee
-      that your code will work even if the container type is
-      changed. */
-    static Collectable * getObject(iterator & it) { return (*it); }
+      void push(const Collectable * obj);
 
-    static int size() { return (int) m_items.size(); }
+      Node * volatile m_head;
+    };
+
+    /// Does nothing, the queues are emptied by their consumers
+    /** This function is kept for compatibility. */
+    static void clear();
+
+    /// Adds the obj to the queues of deleted objects
+    static void objectDeleted(Collectable * obj);
 
+    /// Mutex that protects the list of queues
     static Radiant::MutexStatic & mutex();
   private:
 
     GarbageCollector();
     ~GarbageCollector();
 
-    static container m_items;
+    static std::vector<Queue *> m_queues;
 
   };
 }
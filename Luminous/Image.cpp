@@ -97,154 +97,24 @@ namespace Luminous
     }
   }
 
-  bool Image::copyResample(const Image & source, int w, int h)
+  bool Image::copyResample(const Image & source, int w, int h,
+                           ImageScaling::Filter filter)
   {
-    if(source.pixelFormat() == PixelFormat::rgbUByte()) {
+    const PixelFormat & pf = source.pixelFormat();
 
-      allocate(w, h, source.pixelFormat());
-
-      int sw = source.width();
-      int sh = source.height();
-
-      float xscale = source.width()  / (float) w;
-      float yscale = source.height() / (float) h;
-
-      const uint8_t * src = source.bytes();
-
-      for(int y = 0; y < h; y++) {
-
-        float sy = y * yscale;
-        int yi = (int) sy;
-        int yi1 = yi + 1;
-
-        if(yi1 >= sh) yi1 = yi;
-        float wy1 = sy - yi;
-        float wy0 = 1.0f - wy1;
-
-        uint8_t * dest = bytes() + y * w * 3;
-
-        for(int x = 0; x < w; x++) {
-
-          float sx = x * xscale;
-          int xi = (int) sx;
-          int xi1 = xi + 1;
-          if(xi1 >= sw) xi1 = xi;
-
-          float wx1 = sx - xi;
-          float wx0 = 1.0f - wx1;
-
-          const uint8_t * v00 = & src[(yi * sw  + xi) * 3];
-          const uint8_t * v10 = & src[(yi * sw  + xi1) * 3];
-          const uint8_t * v01 = & src[(yi1 * sw + xi) * 3];
-          const uint8_t * v11 = & src[(yi1 * sw + xi1) * 3];
-
-          float fw00 = wy0 * wx0;
-          float fw10 = wy0 * wx1;
-          float fw01 = wy1 * wx0;
-          float fw11 = wy1 * wx1;
-
-          for(int c = 0; c < 3; c++) {
-            float val =
-                (*v00) * fw00 +  (*v10) * fw10 +  (*v01) * fw01 + (*v11) * fw11;
-
-            *dest = uint8_t(Nimble::Math::Min((int) (val + 0.5f), 255));
-
-            dest++;
-
-            v00++;
-            v10++;
-            v01++;
-            v11++;
-          }
-        }
-      }
-    }
-    else if(source.pixelFormat() == PixelFormat::rgbaUByte()) {
-
-      allocate(w, h, source.pixelFormat());
-
-      int sw = source.width();
-      int sh = source.height();
-
-      float xscale = source.width()  / (float) w;
-      float yscale = source.height() / (float) h;
-
-      const uint8_t * src = source.bytes();
-      for(int y = 0; y < h; y++) {
-
-        float sy = y * yscale;
-        int yi = (int) sy;
-        int yi1 = yi + 1;
-
-        if(yi1 >= sh) yi1 = yi;
-        float wy1 = sy - yi;
-        float wy0 = 1.0f - wy1;
-
-        uint8_t * dest = bytes() + y * w * 4;
-
-        for(int x = 0; x < w; x++) {
-
-          float sx = x * xscale;
-          int xi = (int) sx;
-          int xi1 = xi + 1;
-          if(xi1 >= sw) xi1 = xi;
-
-          float wx1 = sx - xi;
-          float wx0 = 1.0f - wx1;
-
-          const uint8_t * v00 = & src[(yi * sw  + xi) * 4];
-          const uint8_t * v10 = & src[(yi * sw  + xi1) * 4];
-          const uint8_t * v01 = & src[(yi1 * sw + xi) * 4];
-          const uint8_t * v11 = & src[(yi1 * sw + xi1) * 4];
-
-          float fw00 = wy0 * wx0;
-          float fw10 = wy0 * wx1;
-          float fw01 = wy1 * wx0;
-          float fw11 = wy1 * wx1;
-
-          float a00 = v00[3];
-          float a10 = v10[3];
-          float a01 = v01[3];
-          float a11 = v11[3];
-
-          /*a00 = 200;
-            a10 = 200;
-            a01 = 200;
-            a11 = 20;
-            */
-          float asum = a00 * fw00 + a10 * fw10 + a01 * fw01 + a11 * fw11;
-          float ascale = asum > 0.00001 ? 1.0f / asum : 0.0f;
-
-          for(int c = 0; c < 3; c++) {
-            float val =
-                ((*v00) * fw00 * a00 +  (*v10) * fw10 * a10 +
-                 (*v01) * fw01 * a01 +  (*v11) * fw11 * a11) * ascale;
-
-            *dest = uint8_t(Nimble::Math::Min((int) (val + 0.5f), 255));
-
-            dest++;
-
-            v00++;
-            v10++;
-            v01++;
-            v11++;
-          }
-
-          *dest = uint8_t(Nimble::Math::Min((int) asum, 255));
+    if(pf.type() != PixelFormat::TYPE_UBYTE || source.empty())
+      return false;
 
-          /* if(*dest > 128)
-             printf("."); */
-          // *dest = 255;
-          dest++;
-        }
-      }
+    int channels = pf.numChannels();
 
-      //write("some-with-a.png");
+    if(channels != 1 && channels != 3 && channels != 4)
+      return false;
 
-      return true;
-    }
+    allocate(w, h, pf);
 
-    return false;
+    return ImageScaling::resample(source.bytes(), source.width(),
+                                  source.height(), bytes(), w, h,
+                                  channels, filter);
   }
 
 
@@ -268,127 +138,20 @@ namespace Luminous
     while(h & 0x3)
       h--;
 
-    if(source.pixelFormat() == PixelFormat::alphaUByte() ||
-       source.pixelFormat() == PixelFormat::luminanceUByte()) {
+    const PixelFormat & pf = source.pixelFormat();
 
-      allocate(w, h, source.pixelFormat());
+    if(pf == PixelFormat::alphaUByte() ||
+       pf == PixelFormat::luminanceUByte() ||
+       pf == PixelFormat::rgbUByte() ||
+       pf == PixelFormat::rgbaUByte()) {
 
-      const uint8_t * src = source.bytes();
+      int channels = pf.numChannels();
 
-      for(int y = 0; y < h; y++) {
+      allocate(w, h, pf);
 
-        const uint8_t * l0 = src + y * 2 * sw;
-        const uint8_t * l1 = l0 + sw;
-
-        uint8_t * dest = bytes() + y * w;
-
-        for(int x = 0; x < w; x++) {
-
-          unsigned tmp = l0[0];
-          tmp += l0[1];
-          tmp += l1[0];
-          tmp += l1[1];
-
-          *dest = uint8_t(tmp >> 2);
-
-          l0 += 2;
-          l1 += 2;
-
-          dest++;
-        }
-
-      }
-
-      return true;
-    }
-    else if(source.pixelFormat() == PixelFormat::rgbUByte()) {
-
-      allocate(w, h, source.pixelFormat());
-
-      const uint8_t * const src = source.bytes();
-
-      for(int y = 0; y < h; y++) {
-
-        const uint8_t * l0 = src + y * 2 * 3 * sw;
-        const uint8_t * l1 = l0 + sw * 3;
-
-        uint8_t * dest = bytes() + y * w * 3;
-
-        for(int x = 0; x < w; x++) {
-
-          for(int i = 0; i < 3; i++) {
-            unsigned tmp = l0[0];
-            tmp += l0[3];
-            tmp += l1[0];
-            tmp += l1[3];
-
-            *dest = uint8_t(tmp >> 2);
-
-            l0++;
-            l1++;
-            dest++;
-          }
-
-          l0 += 3;
-          l1 += 3;
-        }
-      }
-
-      return true;
-    }
-    else if(source.pixelFormat() == PixelFormat::rgbaUByte()) {
-
-      allocate(w, h, source.pixelFormat());
-
-      const uint8_t * const src = source.bytes();
-
-      for(int y = 0; y < h; y++) {
-
-        const uint8_t * l0 = src + y * 2 * 4 * sw;
-        const uint8_t * l1 = l0 + sw * 4;
-
-        uint8_t * dest = bytes() + y * w * 4;
-
-        for(int x = 0; x < w; x++) {
-
-          unsigned a00 = l0[3];
-          unsigned a10 = l0[7];
-          unsigned a01 = l1[3];
-          unsigned a11 = l1[7];
-
-          /* a00 = 255;
-             a10 = 255;
-             a01 = 255;
-             a11 = 255;
-             */
-          unsigned asum = a00 + a10 + a01 + a11;
-
-          if(!asum)
-            asum = 1;
-
-          for(int i = 0; i < 3; i++) {
-            unsigned tmp = (unsigned) l0[0] * a00;
-            tmp += (unsigned) l0[4] * a10;
-            tmp += (unsigned) l1[0] * a01;
-            tmp += (unsigned) l1[4] * a11;
-
-            *dest = uint8_t(tmp / asum);
-
-            l0++;
-            l1++;
-            dest++;
-          }
-
-          *dest = uint8_t(asum >> 2);
-          // *dest = 255;
-          dest++;
-
-          l0 += 5;
-          l1 += 5;
-        }
-      }
-
-      return true;
+      return ImageScaling::quarterSize(source.bytes(), sw * channels,
+                                       bytes(), w * channels,
+                                       w, h, channels);
     }
 
     return false;
@@ -18,6 +18,7 @@
 
 #include <Luminous/ContextVariable.hpp>
 #include <Luminous/Export.hpp>
+#include <Luminous/ImageScaling.hpp>
 #include <Luminous/PixelFormat.hpp>
 #include <Luminous/Texture.hpp>
 
@@ -104,11 +105,15 @@ namespace Luminous
     /// Flip the image upside down
     void flipVertical();
 
-    /** Resample a source image using straightforward bilinear
-    interpolation. */
-    bool copyResample(const Image & source, int w, int h);
+    /** Resample a source image to the given size. The image is
+        filtered separably in both directions, with the filter widened
+        when the image is made smaller. Works for 8-bit images with 1,
+        3 or 4 channels. */
+    bool copyResample(const Image & source, int w, int h,
+                      ImageScaling::Filter filter = ImageScaling::FILTER_BILINEAR);
 
-    /** Down-sample the image to quarter size. */
+    /** Down-sample the image to quarter size, by averaging 2x2 pixel
+        blocks. */
     bool quarterSize(const Image & source);
     /** Remove pixels from the right edge of the image. */
     bool forgetLastPixels(int n);
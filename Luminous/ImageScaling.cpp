@@ -0,0 +1,764 @@
+/* COPYRIGHT
+ *
+ * This file is part of Luminous.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Luminous.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+
+#include "ImageScaling.hpp"
+
+#include <Nimble/Math.hpp>
+
+#include <Radiant/CPUInfo.hpp>
+
+#include <cmath>
+#include <vector>
+
+#ifdef RADIANT_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace Luminous
+{
+
+  namespace ImageScaling
+  {
+
+    /////////////////////////////////////////////////////////////////////////
+    // Quarter-size, plain C++
+
+    static void quarter1(const uint8_t * l0, const uint8_t * l1,
+                         uint8_t * dest, int x, int w)
+    {
+      l0 += 2 * x;
+      l1 += 2 * x;
+
+      for(; x < w; x++) {
+        unsigned tmp = l0[0];
+        tmp += l0[1];
+        tmp += l1[0];
+        tmp += l1[1];
+
+        dest[x] = uint8_t(tmp >> 2);
+
+        l0 += 2;
+        l1 += 2;
+      }
+    }
+
+    static void quarter3(const uint8_t * l0, const uint8_t * l1,
+                         uint8_t * dest, int x, int w)
+    {
+      l0 += 6 * x;
+      l1 += 6 * x;
+      dest += 3 * x;
+
+      for(; x < w; x++) {
+
+        for(int i = 0; i < 3; i++) {
+          unsigned tmp = l0[0];
+          tmp += l0[3];
+          tmp += l1[0];
+          tmp += l1[3];
+
+          *dest = uint8_t(tmp >> 2);
+
+          l0++;
+          l1++;
+          dest++;
+        }
+
+        l0 += 3;
+        l1 += 3;
+      }
+    }
+
+    static void quarter4(const uint8_t * l0, const uint8_t * l1,
+                         uint8_t * dest, int x, int w)
+    {
+      l0 += 8 * x;
+      l1 += 8 * x;
+      dest += 4 * x;
+
+      for(; x < w; x++) {
+
+        unsigned a00 = l0[3];
+        unsigned a10 = l0[7];
+        unsigned a01 = l1[3];
+        unsigned a11 = l1[7];
+
+        unsigned asum = a00 + a10 + a01 + a11;
+
+        if(!asum)
+          asum = 1;
+
+        for(int i = 0; i < 3; i++) {
+          unsigned tmp = (unsigned) l0[0] * a00;
+          tmp += (unsigned) l0[4] * a10;
+          tmp += (unsigned) l1[0] * a01;
+          tmp += (unsigned) l1[4] * a11;
+
+          *dest = uint8_t(tmp / asum);
+
+          l0++;
+          l1++;
+          dest++;
+        }
+
+        *dest = uint8_t(asum >> 2);
+        dest++;
+
+        l0 += 5;
+        l1 += 5;
+      }
+    }
+
+#ifdef RADIANT_X86
+
+    /////////////////////////////////////////////////////////////////////////
+    // Quarter-size, SSE2/SSSE3
+
+    RADIANT_TARGET_SSE2
+    static int quarter1SSE2(const uint8_t * l0, const uint8_t * l1,
+                            uint8_t * dest, int w)
+    {
+      const __m128i mask = _mm_set1_epi16(0x00FF);
+      int x = 0;
+
+      // 32 source bytes per line -> 16 destination bytes
+      for(; x + 16 <= w; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *) (l0 + 2 * x));
+        __m128i b0 = _mm_loadu_si128((const __m128i *) (l0 + 2 * x + 16));
+        __m128i a1 = _mm_loadu_si128((const __m128i *) (l1 + 2 * x));
+        __m128i b1 = _mm_loadu_si128((const __m128i *) (l1 + 2 * x + 16));
+
+        // Sums of horizontal pairs, as 16-bit integers
+        __m128i sa = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, mask),
+                                                 _mm_srli_epi16(a0, 8)),
+                                   _mm_add_epi16(_mm_and_si128(a1, mask),
+                                                 _mm_srli_epi16(a1, 8)));
+        __m128i sb = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(b0, mask),
+                                                 _mm_srli_epi16(b0, 8)),
+                                   _mm_add_epi16(_mm_and_si128(b1, mask),
+                                                 _mm_srli_epi16(b1, 8)));
+
+        __m128i res = _mm_packus_epi16(_mm_srli_epi16(sa, 2),
+                                       _mm_srli_epi16(sb, 2));
+        _mm_storeu_si128((__m128i *) (dest + x), res);
+      }
+
+      return x;
+    }
+
+    RADIANT_TARGET_SSSE3
+    static int quarter3SSSE3(const uint8_t * l0, const uint8_t * l1,
+                             uint8_t * dest, int w, int srcBytes)
+    {
+      const __m128i zero = _mm_setzero_si128();
+      // Picks bytes 0,1,2, 6,7,8, 12,13,14 and 18,19,20 of the pair sums
+      const __m128i pick0 = _mm_setr_epi8(0, 1, 2, 6, 7, 8, 12, 13, 14,
+                                          -1, -1, -1, -1, -1, -1, -1);
+      const __m128i pick1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          2, 3, 4, -1, -1, -1, -1);
+      int x = 0;
+
+      /* 24 source bytes per line -> 12 destination bytes. The loads read
+         32 bytes and the store writes 16, so stay clear of the ends. */
+      for(; x + 6 <= w && 6 * x + 32 <= srcBytes; x += 4) {
+        const uint8_t * p0 = l0 + 6 * x;
+        const uint8_t * p1 = l1 + 6 * x;
+
+        __m128i a0 = _mm_loadu_si128((const __m128i *) p0);
+        __m128i b0 = _mm_loadu_si128((const __m128i *) (p0 + 16));
+        __m128i a1 = _mm_loadu_si128((const __m128i *) p1);
+        __m128i b1 = _mm_loadu_si128((const __m128i *) (p1 + 16));
+
+        // Vertical sums of bytes 0-31
+        __m128i v0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero),
+                                   _mm_unpacklo_epi8(a1, zero));
+        __m128i v1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero),
+                                   _mm_unpackhi_epi8(a1, zero));
+        __m128i v2 = _mm_add_epi16(_mm_unpacklo_epi8(b0, zero),
+                                   _mm_unpacklo_epi8(b1, zero));
+        __m128i v3 = _mm_add_epi16(_mm_unpackhi_epi8(b0, zero),
+                                   _mm_unpackhi_epi8(b1, zero));
+
+        // Add the neighbouring pixel (three values to the right)
+        __m128i s0 = _mm_add_epi16(v0, _mm_alignr_epi8(v1, v0, 6));
+        __m128i s1 = _mm_add_epi16(v1, _mm_alignr_epi8(v2, v1, 6));
+        __m128i s2 = _mm_add_epi16(v2, _mm_alignr_epi8(v3, v2, 6));
+
+        __m128i p = _mm_packus_epi16(_mm_srli_epi16(s0, 2),
+                                     _mm_srli_epi16(s1, 2));
+        __m128i q = _mm_packus_epi16(_mm_srli_epi16(s2, 2), zero);
+
+        __m128i res = _mm_or_si128(_mm_shuffle_epi8(p, pick0),
+                                   _mm_shuffle_epi8(q, pick1));
+        _mm_storeu_si128((__m128i *) (dest + 3 * x), res);
+      }
+
+      return x;
+    }
+
+    /* Computes one alpha-weighted RGBA pixel from 2x2 source pixels.
+       r0 and r1 hold two pixels of both lines, as 16-bit channels. */
+    RADIANT_TARGET_SSE2
+    static inline __m128i quarter4Pixel(__m128i r0, __m128i r1)
+    {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i one = _mm_set1_epi32(1);
+      const __m128i maskAlpha = _mm_setr_epi32(0, 0, 0, -1);
+
+      __m128i a0 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(r0, 0xFF), 0xFF);
+      __m128i a1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(r1, 0xFF), 0xFF);
+
+      // Colors weighted by alpha, fits in 16 bits (255 * 255)
+      __m128i c0 = _mm_mullo_epi16(r0, a0);
+      __m128i c1 = _mm_mullo_epi16(r1, a1);
+
+      __m128i csum = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(c0, zero),
+                                                 _mm_unpackhi_epi16(c0, zero)),
+                                   _mm_add_epi32(_mm_unpacklo_epi16(c1, zero),
+                                                 _mm_unpackhi_epi16(c1, zero)));
+      __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(r0, zero),
+                                                _mm_unpackhi_epi16(r0, zero)),
+                                  _mm_add_epi32(_mm_unpacklo_epi16(r1, zero),
+                                                _mm_unpackhi_epi16(r1, zero)));
+
+      __m128i asum = _mm_shuffle_epi32(sum, 0xFF);
+      // Avoid division by zero, like the plain version
+      asum = _mm_or_si128(asum, _mm_and_si128(_mm_cmpeq_epi32(asum, zero), one));
+
+      /* Exact integer division: the quotient of two integers below 2^18
+         is never so close to an integer that float rounding matters. */
+      __m128i q = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(csum),
+                                              _mm_cvtepi32_ps(asum)));
+
+      return _mm_or_si128(_mm_andnot_si128(maskAlpha, q),
+                          _mm_and_si128(maskAlpha, _mm_srli_epi32(asum, 2)));
+    }
+
+    RADIANT_TARGET_SSE2
+    static int quarter4SSE2(const uint8_t * l0, const uint8_t * l1,
+                            uint8_t * dest, int w)
+    {
+      const __m128i zero = _mm_setzero_si128();
+      int x = 0;
+
+      // 16 source bytes per line -> 8 destination bytes
+      for(; x + 2 <= w; x += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (l0 + 8 * x));
+        __m128i b = _mm_loadu_si128((const __m128i *) (l1 + 8 * x));
+
+        __m128i p0 = quarter4Pixel(_mm_unpacklo_epi8(a, zero),
+                                   _mm_unpacklo_epi8(b, zero));
+        __m128i p1 = quarter4Pixel(_mm_unpackhi_epi8(a, zero),
+                                   _mm_unpackhi_epi8(b, zero));
+
+        __m128i p = _mm_packs_epi32(p0, p1);
+        _mm_storel_epi64((__m128i *) (dest + 4 * x), _mm_packus_epi16(p, p));
+      }
+
+      return x;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // Quarter-size, AVX2
+
+    RADIANT_TARGET_AVX2
+    static int quarter1AVX2(const uint8_t * l0, const uint8_t * l1,
+                            uint8_t * dest, int w)
+    {
+      const __m256i mask = _mm256_set1_epi16(0x00FF);
+      int x = 0;
+
+      // 64 source bytes per line -> 32 destination bytes
+      for(; x + 32 <= w; x += 32) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *) (l0 + 2 * x));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *) (l0 + 2 * x + 32));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *) (l1 + 2 * x));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *) (l1 + 2 * x + 32));
+
+        __m256i sa = _mm256_add_epi16
+          (_mm256_add_epi16(_mm256_and_si256(a0, mask), _mm256_srli_epi16(a0, 8)),
+           _mm256_add_epi16(_mm256_and_si256(a1, mask), _mm256_srli_epi16(a1, 8)));
+        __m256i sb = _mm256_add_epi16
+          (_mm256_add_epi16(_mm256_and_si256(b0, mask), _mm256_srli_epi16(b0, 8)),
+           _mm256_add_epi16(_mm256_and_si256(b1, mask), _mm256_srli_epi16(b1, 8)));
+
+        // Packing works within 128-bit lanes, restore the order afterwards
+        __m256i res = _mm256_packus_epi16(_mm256_srli_epi16(sa, 2),
+                                          _mm256_srli_epi16(sb, 2));
+        res = _mm256_permute4x64_epi64(res, 0xD8);
+        _mm256_storeu_si256((__m256i *) (dest + x), res);
+      }
+
+      return x;
+    }
+
+    RADIANT_TARGET_AVX2
+    static inline __m256i quarter4PixelAVX2(__m256i r0, __m256i r1)
+    {
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i one = _mm256_set1_epi32(1);
+      const __m256i maskAlpha = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+
+      __m256i a0 = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(r0, 0xFF), 0xFF);
+      __m256i a1 = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(r1, 0xFF), 0xFF);
+
+      __m256i c0 = _mm256_mullo_epi16(r0, a0);
+      __m256i c1 = _mm256_mullo_epi16(r1, a1);
+
+      __m256i csum = _mm256_add_epi32
+        (_mm256_add_epi32(_mm256_unpacklo_epi16(c0, zero),
+                          _mm256_unpackhi_epi16(c0, zero)),
+         _mm256_add_epi32(_mm256_unpacklo_epi16(c1, zero),
+                          _mm256_unpackhi_epi16(c1, zero)));
+      __m256i sum = _mm256_add_epi32
+        (_mm256_add_epi32(_mm256_unpacklo_epi16(r0, zero),
+                          _mm256_unpackhi_epi16(r0, zero)),
+         _mm256_add_epi32(_mm256_unpacklo_epi16(r1, zero),
+                          _mm256_unpackhi_epi16(r1, zero)));
+
+      __m256i asum = _mm256_shuffle_epi32(sum, 0xFF);
+      asum = _mm256_or_si256(asum, _mm256_and_si256
+                             (_mm256_cmpeq_epi32(asum, zero), one));
+
+      __m256i q = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(csum),
+                                                    _mm256_cvtepi32_ps(asum)));
+
+      return _mm256_or_si256(_mm256_andnot_si256(maskAlpha, q),
+                             _mm256_and_si256(maskAlpha,
+                                              _mm256_srli_epi32(asum, 2)));
+    }
+
+    RADIANT_TARGET_AVX2
+    static int quarter4AVX2(const uint8_t * l0, const uint8_t * l1,
+                            uint8_t * dest, int w)
+    {
+      const __m256i zero = _mm256_setzero_si256();
+      int x = 0;
+
+      /* 32 source bytes per line -> 16 destination bytes. Each 128-bit
+         lane works like the SSE2 version. */
+      for(; x + 4 <= w; x += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (l0 + 8 * x));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (l1 + 8 * x));
+
+        __m256i p0 = quarter4PixelAVX2(_mm256_unpacklo_epi8(a, zero),
+                                       _mm256_unpacklo_epi8(b, zero));
+        __m256i p1 = quarter4PixelAVX2(_mm256_unpackhi_epi8(a, zero),
+                                       _mm256_unpackhi_epi8(b, zero));
+
+        __m256i p = _mm256_packs_epi32(p0, p1);
+        p = _mm256_packus_epi16(p, p);
+        p = _mm256_permute4x64_epi64(p, 0x08);
+        _mm_storeu_si128((__m128i *) (dest + 4 * x), _mm256_castsi256_si128(p));
+      }
+
+      return x;
+    }
+
+#endif
+
+    bool quarterSize(const uint8_t * src, int srcStride,
+                     uint8_t * dest, int destStride,
+                     int w, int h, int channels)
+    {
+      if(channels != 1 && channels != 3 && channels != 4)
+        return false;
+
+#ifdef RADIANT_X86
+      using Radiant::CPUInfo::hasFeature;
+
+      const bool avx2 = hasFeature(Radiant::CPUInfo::FEATURE_AVX2);
+      const bool ssse3 = hasFeature(Radiant::CPUInfo::FEATURE_SSSE3);
+      const bool sse2 = hasFeature(Radiant::CPUInfo::FEATURE_SSE2);
+#endif
+
+      for(int y = 0; y < h; y++) {
+
+        const uint8_t * l0 = src + 2 * y * srcStride;
+        const uint8_t * l1 = l0 + srcStride;
+        uint8_t * d = dest + y * destStride;
+
+        // The SIMD versions handle what they can, the rest is done here
+        int x = 0;
+
+        if(channels == 1) {
+#ifdef RADIANT_X86
+          if(avx2)
+            x = quarter1AVX2(l0, l1, d, w);
+          else if(sse2)
+            x = quarter1SSE2(l0, l1, d, w);
+#endif
+          quarter1(l0, l1, d, x, w);
+        }
+        else if(channels == 3) {
+#ifdef RADIANT_X86
+          if(ssse3)
+            x = quarter3SSSE3(l0, l1, d, w, srcStride);
+#endif
+          quarter3(l0, l1, d, x, w);
+        }
+        else {
+#ifdef RADIANT_X86
+          if(avx2)
+            x = quarter4AVX2(l0, l1, d, w);
+          else if(sse2)
+            x = quarter4SSE2(l0, l1, d, w);
+#endif
+          quarter4(l0, l1, d, x, w);
+        }
+      }
+
+      return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // Separable resampling
+
+    /* Filter taps for one output coordinate are stored with a fixed
+       stride, shorter filters are padded with zero weights. */
+    class Contributions
+    {
+    public:
+      Contributions(int srcSize, int dstSize, Filter filter)
+      {
+        float scale = srcSize / (float) dstSize;
+        float filterScale = Nimble::Math::Max(scale, 1.0f);
+        float radius = (filter == FILTER_LANCZOS3) ? 3.0f : 1.0f;
+        float support = radius * filterScale;
+
+        m_taps = Nimble::Math::Min((int) ceilf(support) * 2 + 1, srcSize);
+        m_first.resize(dstSize);
+        m_weights.resize(dstSize * m_taps, 0.0f);
+
+        for(int i = 0; i < dstSize; i++) {
+          // Map pixel centers
+          float center = (i + 0.5f) * scale - 0.5f;
+
+          int first = (int) floorf(center - support + 1.0f);
+          first = Nimble::Math::Clamp(first, 0, srcSize - m_taps);
+          m_first[i] = first;
+
+          float * weights = & m_weights[i * m_taps];
+          float sum = 0.0f;
+
+          for(int j = 0; j < m_taps; j++) {
+            float w = kernel((first + j - center) / filterScale, filter);
+            weights[j] = w;
+            sum += w;
+          }
+
+          if(sum != 0.0f) {
+            for(int j = 0; j < m_taps; j++)
+              weights[j] /= sum;
+          }
+          else {
+            // Should not happen, but make sure something comes out
+            int nearest = Nimble::Math::Clamp((int) (center + 0.5f) - first,
+                                              0, m_taps - 1);
+            weights[nearest] = 1.0f;
+          }
+        }
+      }
+
+      static float kernel(float x, Filter filter)
+      {
+        x = fabsf(x);
+
+        if(filter == FILTER_LANCZOS3) {
+          if(x < 1.0e-5f)
+            return 1.0f;
+          if(x >= 3.0f)
+            return 0.0f;
+          float px = float(Nimble::Math::PI) * x;
+          return 3.0f * sinf(px) * sinf(px / 3.0f) / (px * px);
+        }
+
+        return x < 1.0f ? 1.0f - x : 0.0f;
+      }
+
+      int m_taps;
+      std::vector<int> m_first;
+      std::vector<float> m_weights;
+    };
+
+    /* Vertical pass: accumulates weighted source lines to a line of
+       floats. With four channels the colors are multiplied by alpha. */
+
+    static void accumulateLine(const uint8_t * src, float * acc, int n,
+                               float weight, bool first, int x)
+    {
+      for(; x < n; x++) {
+        float v = weight * src[x];
+        acc[x] = first ? v : acc[x] + v;
+      }
+    }
+
+    static void accumulateLineRGBA(const uint8_t * src, float * acc,
+                                   int pixels, float weight, bool first, int x)
+    {
+      for(; x < pixels; x++) {
+        const uint8_t * s = src + 4 * x;
+        float * a = acc + 4 * x;
+        float wa = weight * s[3];
+
+        if(first) {
+          a[0] = wa * s[0];
+          a[1] = wa * s[1];
+          a[2] = wa * s[2];
+          a[3] = wa;
+        }
+        else {
+          a[0] += wa * s[0];
+          a[1] += wa * s[1];
+          a[2] += wa * s[2];
+          a[3] += wa;
+        }
+      }
+    }
+
+#ifdef RADIANT_X86
+
+    RADIANT_TARGET_SSE2
+    static int accumulateLineSSE2(const uint8_t * src, float * acc, int n,
+                                  float weight, bool first)
+    {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 w = _mm_set1_ps(weight);
+      int x = 0;
+
+      for(; x + 16 <= n; x += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + x));
+        __m128i lo = _mm_unpacklo_epi8(b, zero);
+        __m128i hi = _mm_unpackhi_epi8(b, zero);
+
+        __m128 v[4];
+        v[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+        v[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+        v[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+        v[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+
+        for(int i = 0; i < 4; i++) {
+          __m128 r = _mm_mul_ps(v[i], w);
+          if(!first)
+            r = _mm_add_ps(r, _mm_loadu_ps(acc + x + 4 * i));
+          _mm_storeu_ps(acc + x + 4 * i, r);
+        }
+      }
+
+      return x;
+    }
+
+    RADIANT_TARGET_SSE2
+    static int accumulateLineRGBASSE2(const uint8_t * src, float * acc,
+                                      int pixels, float weight, bool first)
+    {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 w = _mm_set1_ps(weight);
+      const __m128 maskColor = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+      const __m128 oneAlpha = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+      int x = 0;
+
+      for(; x + 4 <= pixels; x += 4) {
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + 4 * x));
+        __m128i lo = _mm_unpacklo_epi8(b, zero);
+        __m128i hi = _mm_unpackhi_epi8(b, zero);
+
+        __m128 v[4];
+        v[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+        v[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+        v[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+        v[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+
+        for(int i = 0; i < 4; i++) {
+          // (r, g, b, a) * (a, a, a, 1) * weight
+          __m128 a = _mm_shuffle_ps(v[i], v[i], 0xFF);
+          a = _mm_or_ps(_mm_and_ps(a, maskColor), oneAlpha);
+          __m128 r = _mm_mul_ps(_mm_mul_ps(v[i], a), w);
+          if(!first)
+            r = _mm_add_ps(r, _mm_loadu_ps(acc + 4 * (x + i)));
+          _mm_storeu_ps(acc + 4 * (x + i), r);
+        }
+      }
+
+      return x;
+    }
+
+    RADIANT_TARGET_AVX2
+    static int accumulateLineAVX2(const uint8_t * src, float * acc, int n,
+                                  float weight, bool first)
+    {
+      const __m256 w = _mm256_set1_ps(weight);
+      int x = 0;
+
+      for(; x + 8 <= n; x += 8) {
+        __m128i b = _mm_loadl_epi64((const __m128i *) (src + x));
+        __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b));
+        __m256 r = _mm256_mul_ps(v, w);
+        if(!first)
+          r = _mm256_add_ps(r, _mm256_loadu_ps(acc + x));
+        _mm256_storeu_ps(acc + x, r);
+      }
+
+      return x;
+    }
+
+    RADIANT_TARGET_AVX2
+    static int accumulateLineRGBAAVX2(const uint8_t * src, float * acc,
+                                      int pixels, float weight, bool first)
+    {
+      const __m256 w = _mm256_set1_ps(weight);
+      const __m256 ones = _mm256_set1_ps(1.0f);
+      int x = 0;
+
+      for(; x + 2 <= pixels; x += 2) {
+        __m128i b = _mm_loadl_epi64((const __m128i *) (src + 4 * x));
+        __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b));
+        // (a, a, a, 1) for both pixels
+        __m256 a = _mm256_blend_ps(_mm256_permute_ps(v, 0xFF), ones, 0x88);
+        __m256 r = _mm256_mul_ps(_mm256_mul_ps(v, a), w);
+        if(!first)
+          r = _mm256_add_ps(r, _mm256_loadu_ps(acc + 4 * x));
+        _mm256_storeu_ps(acc + 4 * x, r);
+      }
+
+      return x;
+    }
+
+#endif
+
+    static inline uint8_t toByte(float v)
+    {
+      int i = (int) (v + 0.5f);
+      return uint8_t(i < 0 ? 0 : (i > 255 ? 255 : i));
+    }
+
+    /* Horizontal pass: filters the accumulated line to the
+       destination. */
+    static void filterLine(const float * acc, uint8_t * dest, int w,
+                           int channels, const Contributions & cx)
+    {
+      const int taps = cx.m_taps;
+
+      for(int x = 0; x < w; x++) {
+        const float * weights = & cx.m_weights[x * taps];
+        const float * a = acc + cx.m_first[x] * channels;
+
+        if(channels == 1) {
+          float sum = 0.0f;
+          for(int j = 0; j < taps; j++)
+            sum += weights[j] * a[j];
+          dest[x] = toByte(sum);
+        }
+        else if(channels == 3) {
+          float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f;
+          for(int j = 0; j < taps; j++, a += 3) {
+            s0 += weights[j] * a[0];
+            s1 += weights[j] * a[1];
+            s2 += weights[j] * a[2];
+          }
+          uint8_t * d = dest + 3 * x;
+          d[0] = toByte(s0);
+          d[1] = toByte(s1);
+          d[2] = toByte(s2);
+        }
+        else {
+          float s[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+          for(int j = 0; j < taps; j++, a += 4) {
+            for(int c = 0; c < 4; c++)
+              s[c] += weights[j] * a[c];
+          }
+          // Undo the alpha weighting
+          float scale = s[3] > 0.001f ? 1.0f / s[3] : 0.0f;
+          uint8_t * d = dest + 4 * x;
+          d[0] = toByte(s[0] * scale);
+          d[1] = toByte(s[1] * scale);
+          d[2] = toByte(s[2] * scale);
+          d[3] = toByte(s[3]);
+        }
+      }
+    }
+
+    bool resample(const uint8_t * src, int sw, int sh,
+                  uint8_t * dest, int w, int h, int channels,
+                  Filter filter)
+    {
+      if(channels != 1 && channels != 3 && channels != 4)
+        return false;
+
+      if(sw <= 0 || sh <= 0 || w <= 0 || h <= 0)
+        return false;
+
+      Contributions cx(sw, w, filter);
+      Contributions cy(sh, h, filter);
+
+      std::vector<float> line(sw * channels);
+      float * acc = & line[0];
+
+      const int n = sw * channels;
+
+#ifdef RADIANT_X86
+      using Radiant::CPUInfo::hasFeature;
+
+      const bool avx2 = hasFeature(Radiant::CPUInfo::FEATURE_AVX2);
+      const bool sse2 = hasFeature(Radiant::CPUInfo::FEATURE_SSE2);
+#endif
+
+      for(int y = 0; y < h; y++) {
+
+        const float * weights = & cy.m_weights[y * cy.m_taps];
+        bool first = true;
+
+        for(int j = 0; j < cy.m_taps; j++) {
+
+          // There is always at least one non-zero weight
+          if(weights[j] == 0.0f)
+            continue;
+
+          const uint8_t * s = src + (cy.m_first[y] + j) * n;
+          int x = 0;
+
+          if(channels == 4) {
+#ifdef RADIANT_X86
+            if(avx2)
+              x = accumulateLineRGBAAVX2(s, acc, sw, weights[j], first);
+            else if(sse2)
+              x = accumulateLineRGBASSE2(s, acc, sw, weights[j], first);
+#endif
+            accumulateLineRGBA(s, acc, sw, weights[j], first, x);
+          }
+          else {
+#ifdef RADIANT_X86
+            if(avx2)
+              x = accumulateLineAVX2(s, acc, n, weights[j], first);
+            else if(sse2)
+              x = accumulateLineSSE2(s, acc, n, weights[j], first);
+#endif
+            accumulateLine(s, acc, n, weights[j], first, x);
+          }
+
+          first = false;
+        }
+
+        filterLine(acc, dest + y * w * channels, w, channels, cx);
+      }
+
+      return true;
+    }
+
+  }
+
+}
@@ -0,0 +1,73 @@
+/* COPYRIGHT
+ *
+ * This file is part of Luminous.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Luminous.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#ifndef LUMINOUS_IMAGE_SCALING_HPP
+#define LUMINOUS_IMAGE_SCALING_HPP
+
+#include <Luminous/Export.hpp>
+
+#include <stdint.h>
+
+namespace Luminous
+{
+
+  /// Low-level image scaling kernels
+  /** These functions implement the pixel crunching behind
+      Image::quarterSize and Image::copyResample. They operate on 8-bit
+      pixels with 1 (luminance or alpha), 3 (RGB) or 4 (RGBA)
+      channels. With 4 channels the color channels are weighted by
+      alpha, so that fully transparent pixels do not bleed their color
+      into the result.
+
+      The best available implementation (AVX2, SSSE3, SSE2 or plain
+      C++) is selected at run-time with Radiant::CPUInfo. The
+      different implementations produce identical results for
+      quarterSize; for resample they may differ by rounding. */
+  namespace ImageScaling
+  {
+    /// Filters for resample
+    enum Filter
+    {
+      /// Triangle filter; bilinear interpolation when magnifying
+      FILTER_BILINEAR,
+      /// Three-lobed Lanczos filter, sharper but slower
+      FILTER_LANCZOS3
+    };
+
+    /// Averages 2x2 pixel blocks of the source into the destination
+    /** @param src The source pixels, at least 2*w x 2*h pixels
+        @param srcStride Number of bytes per source line
+        @param dest The destination pixels, w x h pixels
+        @param destStride Number of bytes per destination line
+        @param w Width of the destination
+        @param h Height of the destination
+        @param channels Number of channels per pixel (1, 3 or 4)
+        @return false if the number of channels is not supported */
+    LUMINOUS_API bool quarterSize(const uint8_t * src, int srcStride,
+                                  uint8_t * dest, int destStride,
+                                  int w, int h, int channels);
+
+    /// Resamples an image to a new size with a separable filter
+    /** When minifying, the filter is widened so that all source pixels
+        contribute to the result.
+
+        @return false if the number of channels is not supported */
+    LUMINOUS_API bool resample(const uint8_t * src, int sw, int sh,
+                               uint8_t * dest, int w, int h, int channels,
+                               Filter filter);
+  }
+
+}
+
+#endif
@@ -24,9 +24,11 @@ HEADERS += GPUMipmaps.hpp
 HEADERS += ImageCodec.hpp
 HEADERS += ImageCodecTGA.hpp
 HEADERS += Image.hpp
+HEADERS += ImageScaling.hpp
 HEADERS += ImagePyramid.hpp
 HEADERS += Luminous.hpp
 HEADERS += MatrixStep.hpp
+HEADERS += MipmapCacheFile.hpp
 HEADERS += MultiHead.hpp
 HEADERS += Path.hpp
 HEADERS += PixelFormat.hpp
@@ -34,6 +36,7 @@ HEADERS += RenderContext.hpp
 HEADERS += Task.hpp
 HEADERS += TCBSpline.hpp
 HEADERS += Texture.hpp
+HEADERS += TextureUploader.hpp
 HEADERS += Transformer.hpp
 HEADERS += Utils.hpp
 HEADERS += VertexBuffer.hpp
@@ -58,7 +61,9 @@ SOURCES += GLSLShaderObject.cpp
 SOURCES += GPUMipmaps.cpp
 SOURCES += ImageCodecTGA.cpp
 SOURCES += Image.cpp
+SOURCES += ImageScaling.cpp
 SOURCES += Luminous.cpp
+SOURCES += MipmapCacheFile.cpp
 SOURCES += MultiHead.cpp
 SOURCES += Path.cpp
 SOURCES += PixelFormat.cpp
@@ -66,6 +71,7 @@ SOURCES += RenderContext.cpp
 SOURCES += Task.cpp
 SOURCES += TCBSpline.cpp
 SOURCES += Texture.cpp
+SOURCES += TextureUploader.cpp
 SOURCES += Transformer.cpp
 SOURCES += Utils.cpp
 SOURCES += VertexBuffer.cpp
@@ -0,0 +1,316 @@
+/* COPYRIGHT
+ *
+ * This file is part of Luminous.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Luminous.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#include "MipmapCacheFile.hpp"
+
+#include "Image.hpp"
+
+#include <Radiant/Directory.hpp>
+#include <Radiant/FileUtils.hpp>
+#include <Radiant/MemoryMappedFile.hpp>
+#include <Radiant/Mutex.hpp>
+#include <Radiant/Trace.hpp>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace Luminous {
+
+  using namespace Radiant;
+
+  namespace {
+
+    const char     s_magic[8] = { 'M', 'T', 'M', 'I', 'P', 'M', 'A', 'P' };
+    const uint32_t s_version = 2;
+    const uint32_t s_byteOrder = 0x01020304;
+    const uint64_t s_alignment = 16;
+
+    enum Compression {
+      COMPRESSION_NONE
+    };
+
+    struct LevelEntry
+    {
+      uint32_t m_width;
+      uint32_t m_height;
+      uint32_t m_layout;
+      uint32_t m_type;
+      uint32_t m_compression;
+      uint32_t m_reserved;
+      uint64_t m_offset;
+      uint64_t m_bytes;
+    };
+
+    struct Header
+    {
+      char       m_magic[8];
+      uint32_t   m_version;
+      uint32_t   m_byteOrder;
+      uint64_t   m_sourceBytes;
+      uint64_t   m_sourceModified;
+      uint32_t   m_levelMask;
+      /// Checksum of the header, computed with this field set to zero
+      uint32_t   m_checksum;
+      LevelEntry m_levels[MipmapCacheFile::MAX_LEVELS];
+    };
+
+    /* Writers of the same file are serialized with one of these
+       mutexes, chosen by the file name. Readers do not lock. */
+    enum { MUTEX_COUNT = 32 };
+    static Radiant::MutexStatic s_mutexes[MUTEX_COUNT];
+
+    Radiant::MutexStatic & mutexFor(const std::string & filename)
+    {
+      uint32_t h = 2166136261u;
+      for(size_t i = 0; i < filename.size(); i++)
+        h = (h ^ (uint8_t) filename[i]) * 16777619u;
+      return s_mutexes[h % MUTEX_COUNT];
+    }
+
+    /* The header is rewritten in place when a level is added, so a
+       reader may see a partially written header. The checksum makes
+       it look stale instead. */
+    uint32_t checksum(const Header & h)
+    {
+      Header tmp = h;
+      tmp.m_checksum = 0;
+
+      const uint8_t * bytes = (const uint8_t *) & tmp;
+      uint32_t sum = 2166136261u;
+
+      for(size_t i = 0; i < sizeof(tmp); i++)
+        sum = (sum ^ bytes[i]) * 16777619u;
+
+      return sum;
+    }
+
+    void initHeader(Header & h, uint64_t bytes, uint64_t modified)
+    {
+      memset( & h, 0, sizeof(h));
+      memcpy(h.m_magic, s_magic, sizeof(s_magic));
+      h.m_version = s_version;
+      h.m_byteOrder = s_byteOrder;
+      h.m_sourceBytes = bytes;
+      h.m_sourceModified = modified;
+    }
+
+    bool headerValid(const Header & h, uint64_t bytes, uint64_t modified,
+                     uint64_t fileSize)
+    {
+      if(memcmp(h.m_magic, s_magic, sizeof(s_magic)) != 0 ||
+         h.m_version != s_version ||
+         h.m_byteOrder != s_byteOrder ||
+         h.m_sourceBytes != bytes ||
+         h.m_sourceModified != modified ||
+         h.m_checksum != checksum(h))
+        return false;
+
+      // Make sure that a truncated file is not trusted
+      for(int i = 0; i < MipmapCacheFile::MAX_LEVELS; i++) {
+        if(!(h.m_levelMask & (1 << i)))
+          continue;
+
+        const LevelEntry & e = h.m_levels[i];
+
+        if(e.m_offset + e.m_bytes > fileSize)
+          return false;
+      }
+
+      return true;
+    }
+
+    bool levelValid(const LevelEntry & e)
+    {
+      if(e.m_compression != COMPRESSION_NONE)
+        return false;
+
+      PixelFormat pf((PixelFormat::ChannelLayout) e.m_layout,
+                     (PixelFormat::ChannelType) e.m_type);
+
+      return e.m_width && e.m_height &&
+        e.m_bytes == uint64_t(e.m_width) * e.m_height * pf.numChannels();
+    }
+  }
+
+  MipmapCacheFile::MipmapCacheFile(const std::string & filename,
+                                   uint64_t sourceBytes,
+                                   uint64_t sourceModified)
+    : m_filename(filename),
+      m_sourceBytes(sourceBytes),
+      m_sourceModified(sourceModified)
+  {}
+
+  MipmapCacheFile::~MipmapCacheFile()
+  {}
+
+  uint32_t MipmapCacheFile::levelMask() const
+  {
+    FILE * f = fopen(m_filename.c_str(), "rb");
+
+    if(!f)
+      return 0;
+
+    Header h;
+    bool ok = fread( & h, sizeof(h), 1, f) == 1;
+
+    fseek(f, 0, SEEK_END);
+    uint64_t fileSize = ftell(f);
+    fclose(f);
+
+    if(!ok || !headerValid(h, m_sourceBytes, m_sourceModified, fileSize))
+      return 0;
+
+    return h.m_levelMask;
+  }
+
+  bool MipmapCacheFile::readLevel(int level, Image & image) const
+  {
+    if(level < 0 || level >= MAX_LEVELS)
+      return false;
+
+    MemoryMappedFile map;
+
+    if(!map.open(m_filename.c_str()) || map.size() < sizeof(Header))
+      return false;
+
+    Header h;
+    memcpy( & h, map.data(), sizeof(h));
+
+    if(!headerValid(h, m_sourceBytes, m_sourceModified, map.size()) ||
+       !(h.m_levelMask & (1 << level)))
+      return false;
+
+    const LevelEntry & e = h.m_levels[level];
+
+    if(!levelValid(e))
+      return false;
+
+    image.fromData(map.data() + e.m_offset, e.m_width, e.m_height,
+                   PixelFormat((PixelFormat::ChannelLayout) e.m_layout,
+                               (PixelFormat::ChannelType) e.m_type));
+
+    return true;
+  }
+
+  bool MipmapCacheFile::writeLevel(int level, const Image & image)
+  {
+    if(level < 0 || level >= MAX_LEVELS || image.empty())
+      return false;
+
+    GuardStatic g(mutexFor(m_filename));
+
+    Header h;
+    FILE * f = fopen(m_filename.c_str(), "r+b");
+    bool fresh = true;
+    /* A new file is written under a temporary name and renamed into
+       place, so that readers of the old file are not disturbed. */
+    std::string target = m_filename;
+
+    if(f) {
+      bool ok = fread( & h, sizeof(h), 1, f) == 1;
+      fseek(f, 0, SEEK_END);
+      uint64_t fileSize = ftell(f);
+
+      if(ok && headerValid(h, m_sourceBytes, m_sourceModified, fileSize)) {
+        fresh = false;
+
+        if(h.m_levelMask & (1 << level)) {
+          fclose(f);
+          return true;
+        }
+      }
+      else {
+        fclose(f);
+        f = 0;
+      }
+    }
+
+    if(fresh) {
+      if(!Directory::mkdir(FileUtils::path(m_filename))) {
+        /* The mkdir fails if the directory exists already, which is
+           not a problem. */
+        debug("MipmapCacheFile::writeLevel # Could not create directory %s",
+              FileUtils::path(m_filename).c_str());
+      }
+
+      target = m_filename + ".tmp";
+      f = fopen(target.c_str(), "w+b");
+
+      if(!f) {
+        error("MipmapCacheFile::writeLevel # Could not open %s",
+              target.c_str());
+        return false;
+      }
+
+      initHeader(h, m_sourceBytes, m_sourceModified);
+      h.m_checksum = checksum(h);
+
+      if(fwrite( & h, sizeof(h), 1, f) != 1) {
+        fclose(f);
+        return false;
+      }
+    }
+
+    // Append the pixels to the end of the file
+    fseek(f, 0, SEEK_END);
+    uint64_t offset = ftell(f);
+
+    static const char zeros[s_alignment] = { 0 };
+    uint64_t pad = (s_alignment - (offset % s_alignment)) % s_alignment;
+
+    const PixelFormat & pf = image.pixelFormat();
+
+    LevelEntry & e = h.m_levels[level];
+    e.m_width = image.width();
+    e.m_height = image.height();
+    e.m_layout = pf.layout();
+    e.m_type = pf.type();
+    e.m_compression = COMPRESSION_NONE;
+    e.m_reserved = 0;
+    e.m_offset = offset + pad;
+    e.m_bytes = uint64_t(e.m_width) * e.m_height * pf.numChannels();
+
+    bool ok = fwrite(zeros, 1, pad, f) == pad &&
+      fwrite(image.data(), 1, e.m_bytes, f) == e.m_bytes;
+
+    /* The header is written last, so that readers never see a level
+       whose pixels are not in the file yet. */
+    if(ok) {
+      h.m_levelMask |= (1 << level);
+      h.m_checksum = checksum(h);
+      ok = fseek(f, 0, SEEK_SET) == 0 && fwrite( & h, sizeof(h), 1, f) == 1;
+    }
+
+    if(fclose(f) != 0)
+      ok = false;
+
+    if(fresh) {
+      // Windows does not rename over an existing file
+      if(ok && !FileUtils::renameFile(target.c_str(), m_filename.c_str())) {
+        remove(m_filename.c_str());
+        ok = FileUtils::renameFile(target.c_str(), m_filename.c_str());
+      }
+
+      if(!ok)
+        remove(target.c_str());
+    }
+
+    if(!ok)
+      error("MipmapCacheFile::writeLevel # Failed to write level %d to %s",
+            level, m_filename.c_str());
+
+    return ok;
+  }
+
+}
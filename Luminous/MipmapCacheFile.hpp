@@ -0,0 +1,90 @@
+/* COPYRIGHT
+ *
+ * This file is part of Luminous.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Luminous.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#ifndef LUMINOUS_MIPMAP_CACHE_FILE_HPP
+#define LUMINOUS_MIPMAP_CACHE_FILE_HPP
+
+#include <Luminous/Export.hpp>
+
+#include <stdint.h>
+
+#include <string>
+
+namespace Luminous {
+
+  class Image;
+
+  /** Single-file cache for the mipmap levels of one source image.
+
+      All levels of one image are stored in one binary container
+      file. The file starts with a fixed-size header that identifies
+      the source image (its size and modification time) and contains
+      a table with the dimensions, pixel format and file offset of each
+      stored level. The pixel data follows the header, each level
+      aligned to 16 bytes. The pixels are stored raw, so a level can
+      be taken directly from a memory mapping of the file, without
+      decoding it.
+
+      If the source image has changed since the cache was written, the
+      header does not match, and the cache is treated as empty. The
+      next call to writeLevel re-creates the file.
+
+      The object itself is a light-weight description of the cache
+      file; the file is opened for each operation. Writers of the same
+      file are serialized, so scalers running in different threads can
+      add levels to it. Readers do not lock: a level is added by
+      appending its pixels and then rewriting the header, and the
+      header has a checksum, so a reader sees either the old or the new
+      level table, or a miss. A new file is written under a temporary
+      name and renamed into place.
+  */
+  class LUMINOUS_API MipmapCacheFile
+  {
+  public:
+    enum {
+      /// Largest number of levels that a cache file can hold
+      MAX_LEVELS = 16
+    };
+
+    /** @param filename Name of the cache file
+        @param sourceBytes Size of the source image file in bytes
+        @param sourceModified Modification time of the source image */
+    MipmapCacheFile(const std::string & filename,
+                    uint64_t sourceBytes, uint64_t sourceModified);
+    ~MipmapCacheFile();
+
+    /** Returns a bit mask of the levels that are available in the
+        cache. If the cache file does not exist, or is stale, zero is
+        returned. */
+    uint32_t levelMask() const;
+
+    /** Reads one level from the cache.
+        @return false if the level is not in the cache */
+    bool readLevel(int level, Image & image) const;
+    /** Stores one level in the cache. If the cache file is missing or
+        stale it is created from scratch. */
+    bool writeLevel(int level, const Image & image);
+
+    /// Name of the cache file
+    const std::string & filename() const { return m_filename; }
+
+  private:
+    std::string m_filename;
+    uint64_t    m_sourceBytes;
+    uint64_t    m_sourceModified;
+  };
+
+}
+
+#endif
@@ -30,7 +30,14 @@ namespace Luminous
     m_priority(p),
 //    m_canDelete(false),
       m_scheduled(0),
-      m_host(0)
+      m_host(0),
+      m_worker(-1),
+      m_queueState(QUEUE_NONE),
+      m_heapSlot(-1),
+      m_queuedPriority(p),
+      m_queuedTime(0),
+      m_sequence(0),
+      m_pendingMessages(0)
   {}
 
   Task::~Task()
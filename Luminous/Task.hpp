@@ -97,8 +97,31 @@ namespace Luminous
       Radiant::TimeStamp m_scheduled;
 
       BGThread * m_host;
-    
+
+      /* Bookkeeping of BGThread. Apart from m_pendingMessages these are
+         modified only while holding the queue mutex of the worker. */
+      enum QueueState
+      {
+        QUEUE_NONE,   // Not queued (or being executed)
+        QUEUE_INBOX,  // Posted to the inbox of a worker
+        QUEUE_READY,  // In the ready-heap of a worker
+        QUEUE_TIMED   // In the heap of tasks that are scheduled for later
+      };
+
+      // Index of the BGThread worker that holds the task, or -1
+      volatile int m_worker;
+      volatile int m_queueState;
+      // Slot of the task in the heap
+      int m_heapSlot;
+      // The keys the task was sorted with when it was put to the heap
+      Priority m_queuedPriority;
+      Radiant::TimeStamp m_queuedTime;
+      unsigned m_sequence;
+      // Number of BGThread inbox messages that refer to this task
+      volatile int m_pendingMessages;
+
       friend class BGThread;
+      friend class TaskHeap;
   };
 
 }
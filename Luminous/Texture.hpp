@@ -45,7 +45,9 @@ namespace Luminous
       m_height(0),
       m_pf(PixelFormat::LAYOUT_UNKNOWN, PixelFormat::TYPE_UNKNOWN),
       m_haveMipmaps(false)
-    {}
+    {
+      setCategory(CATEGORY_TEXTURE);
+    }
     virtual ~TextureT();
 
     void allocate()
@@ -0,0 +1,299 @@
+/* COPYRIGHT
+ *
+ * This file is part of Luminous.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Luminous.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#include "TextureUploader.hpp"
+
+#include <Luminous/BGThread.hpp>
+#include <Luminous/Collectable.hpp>
+#include <Luminous/GLResources.hpp>
+#include <Luminous/Image.hpp>
+#include <Luminous/Task.hpp>
+#include <Luminous/Texture.hpp>
+
+#include <Radiant/Atomic.hpp>
+#include <Radiant/Sleep.hpp>
+#include <Radiant/Trace.hpp>
+
+#include <string.h>
+
+namespace Luminous {
+
+  using namespace Radiant;
+
+  class TextureUploader::Slot
+  {
+  public:
+    Slot()
+      : m_pbo(0),
+        m_mapped(0),
+        m_key(0),
+        m_width(0),
+        m_height(0),
+        m_bytes(0),
+        m_copied(0),
+        m_busy(false)
+    {}
+
+    GLuint m_pbo;
+    void * m_mapped;
+    const Collectable * m_key;
+    // Only touched with the BGThread general mutex locked
+    Radiant::RefPtr<Image> m_image;
+    int    m_width;
+    int    m_height;
+    PixelFormat m_pf;
+    long   m_bytes;
+    // Set by the copy task when the pixels are in the buffer
+    volatile int m_copied;
+    bool   m_busy;
+  };
+
+  /* Copies one image to a mapped pixel buffer. */
+  class TextureUploader::CopyTask : public Task
+  {
+  public:
+    CopyTask(Slot * slot)
+      : Task(PRIORITY_HIGH),
+        m_slot(slot)
+    {}
+
+    virtual void doTask()
+    {
+      memcpy(m_slot->m_mapped, m_slot->m_image.ptr()->data(), m_slot->m_bytes);
+
+      {
+        Guard g(BGThread::instance()->generalMutex());
+        m_slot->m_image.breakLink();
+      }
+
+      /* After this the slot belongs to the rendering thread, and may be
+         deleted at any time. */
+      Radiant::Atomic::memoryBarrier();
+      m_slot->m_copied = 1;
+
+      m_state = DONE;
+    }
+
+    virtual void finished()
+    {
+      delete this;
+    }
+
+  private:
+    Slot * m_slot;
+  };
+
+  TextureUploader::TextureUploader(GLResources * resources)
+    : GLResource(resources),
+      m_usePBO(GLEW_ARB_pixel_buffer_object)
+  {
+    for(int i = 0; i < SLOTS; i++)
+      m_slots[i] = new Slot();
+  }
+
+  TextureUploader::~TextureUploader()
+  {
+    for(int i = 0; i < SLOTS; i++) {
+      Slot * s = m_slots[i];
+
+      // Let running copies finish, before the memory is unmapped
+      while(s->m_busy && !s->m_copied)
+        Radiant::Sleep::sleepMs(1);
+
+      if(s->m_busy)
+        releaseSlot(s);
+
+      if(s->m_pbo)
+        glDeleteBuffers(1, & s->m_pbo);
+
+      delete s;
+    }
+  }
+
+  Texture2D * TextureUploader::upload(const Collectable * key,
+                                      const Radiant::RefPtr<Image> & image)
+  {
+    Slot * slot = findSlot(key);
+
+    if(slot) {
+      if(!slot->m_copied || !resources()->canUpload(slot->m_bytes))
+        return 0;
+
+      return finish(slot);
+    }
+
+    const Image * im = image.ptr();
+
+    if(!im || im->empty())
+      return 0;
+
+    long bytes = long(im->width()) * im->height() *
+      im->pixelFormat().numChannels();
+
+    if(!m_usePBO) {
+      if(!resources()->canUpload(bytes))
+        return 0;
+
+      Texture2D * tex = new Texture2D(resources());
+      resources()->addResource(key, tex);
+      tex->loadImage(*im, false);
+      resources()->deleteAfter(tex, 10);
+      return tex;
+    }
+
+    // Free the slots of the uploads that are done already
+    process();
+
+    for(int i = 0; i < SLOTS && !slot; i++)
+      if(!m_slots[i]->m_busy)
+        slot = m_slots[i];
+
+    if(!slot)
+      return 0;
+
+    if(!slot->m_pbo)
+      glGenBuffers(1, & slot->m_pbo);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->m_pbo);
+    // Orphan the old storage, so that mapping does not wait for the GPU
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, 0, GL_STREAM_DRAW);
+    slot->m_mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if(!slot->m_mapped) {
+      error("TextureUploader::upload # Could not map a pixel buffer, "
+            "using direct uploads");
+      m_usePBO = false;
+      return 0;
+    }
+
+    slot->m_key = key;
+    slot->m_width = im->width();
+    slot->m_height = im->height();
+    slot->m_pf = im->pixelFormat();
+    slot->m_bytes = bytes;
+    slot->m_copied = 0;
+    slot->m_busy = true;
+
+    {
+      Guard g(BGThread::instance()->generalMutex());
+      slot->m_image = image;
+    }
+
+    BGThread::instance()->addTask(new CopyTask(slot));
+
+    return 0;
+  }
+
+  bool TextureUploader::isPending(const Collectable * key) const
+  {
+    return findSlot(key) != 0;
+  }
+
+  void TextureUploader::cancel(const Collectable * key)
+  {
+    Slot * slot = findSlot(key);
+
+    if(!slot)
+      return;
+
+    // The copy may be running, so the slot is released later
+    slot->m_key = 0;
+
+    if(slot->m_copied)
+      releaseSlot(slot);
+  }
+
+  void TextureUploader::process()
+  {
+    for(int i = 0; i < SLOTS; i++) {
+      Slot * s = m_slots[i];
+
+      if(!s->m_busy || !s->m_copied)
+        continue;
+
+      if(!s->m_key)
+        releaseSlot(s);
+      else if(resources()->canUpload(s->m_bytes))
+        finish(s);
+    }
+  }
+
+  TextureUploader * TextureUploader::instance(GLResources * resources,
+                                              bool create)
+  {
+    static Collectable * key = new Collectable();
+
+    if(!create)
+      return dynamic_cast<TextureUploader *> (resources->getResource(key));
+
+    GLRESOURCE_ENSURE(TextureUploader, uploader, key, resources);
+
+    return uploader;
+  }
+
+  TextureUploader::Slot * TextureUploader::findSlot(const Collectable * key) const
+  {
+    if(!key)
+      return 0;
+
+    for(int i = 0; i < SLOTS; i++)
+      if(m_slots[i]->m_busy && m_slots[i]->m_key == key)
+        return m_slots[i];
+
+    return 0;
+  }
+
+  Texture2D * TextureUploader::finish(Slot * slot)
+  {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->m_pbo);
+    bool ok = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    slot->m_mapped = 0;
+
+    Texture2D * tex = 0;
+
+    if(ok) {
+      tex = new Texture2D(resources());
+      resources()->addResource(slot->m_key, tex);
+      // With the buffer bound, the data pointer is an offset to the buffer
+      tex->loadBytes(slot->m_pf.layout(), slot->m_width, slot->m_height,
+                     0, slot->m_pf, false);
+      resources()->deleteAfter(tex, 10);
+    }
+    else
+      error("TextureUploader::finish # Pixel buffer contents were lost");
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    releaseSlot(slot);
+
+    return tex;
+  }
+
+  void TextureUploader::releaseSlot(Slot * slot)
+  {
+    if(slot->m_mapped) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->m_pbo);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      slot->m_mapped = 0;
+    }
+
+    slot->m_key = 0;
+    slot->m_bytes = 0;
+    slot->m_copied = 0;
+    slot->m_busy = false;
+  }
+
+}
@@ -0,0 +1,115 @@
+/* COPYRIGHT
+ *
+ * This file is part of Luminous.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Luminous.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#ifndef LUMINOUS_TEXTURE_UPLOADER_HPP
+#define LUMINOUS_TEXTURE_UPLOADER_HPP
+
+#include <Luminous/Export.hpp>
+#include <Luminous/GLResource.hpp>
+#include <Luminous/Luminous.hpp>
+
+#include <Radiant/RefPtr.hpp>
+
+namespace Luminous {
+
+  class Collectable;
+  class Image;
+  class Texture2D;
+
+  /** Streams images to textures through a ring of pixel buffer
+      objects.
+
+      A plain glTexImage2D call blocks the rendering thread while the
+      driver copies the pixels. With TextureUploader the upload is
+      split in three steps:
+
+      <OL>
+      <LI>The rendering thread maps a pixel buffer object, and hands
+      the pointer to a background task.</LI>
+
+      <LI>The task copies the image into the mapped buffer in a
+      BGThread worker.</LI>
+
+      <LI>On a later frame the rendering thread unmaps the buffer, and
+      creates the texture from it. The driver can do this with DMA,
+      without touching the pixels with the CPU.</LI>
+      </OL>
+
+      The final step is limited by the per-frame upload limit of the
+      GLResources object (see GLResources::canUpload), so that a burst
+      of new images does not cause long frames.
+
+      There is one uploader per OpenGL context, which can be accessed
+      with the instance function. If pixel buffer objects are not
+      supported, upload falls back to loading the texture directly.
+  */
+  class LUMINOUS_API TextureUploader : public GLResource
+  {
+  public:
+    enum {
+      /// Number of pixel buffer objects in the ring
+      SLOTS = 4
+    };
+
+    TextureUploader(GLResources * resources);
+    virtual ~TextureUploader();
+
+    /** Uploads an image to a texture.
+
+        If the image for the key has been uploaded, a new texture is
+        created and added to the resources with the given key, and it
+        is returned. Otherwise the upload is started, if there is a free
+        slot, and zero is returned. The caller should call this
+        function again on the following frames, until the texture is
+        returned.
+
+        @param key The key for the new texture in GLResources
+        @param image The image to upload. The image is held by the
+        uploader until the pixels have been copied.
+    */
+    Texture2D * upload(const Collectable * key,
+                       const Radiant::RefPtr<Image> & image);
+
+    /// Returns true if an upload is in progress for the given key
+    bool isPending(const Collectable * key) const;
+
+    /** Cancels the upload for the given key. This must be called when
+        the key object is deleted. */
+    void cancel(const Collectable * key);
+
+    /** Finishes the uploads whose pixels have been copied, within the
+        upload limit of this frame. */
+    void process();
+
+    /** Returns the uploader of the given OpenGL context. If create is
+        false, and there is no uploader yet, zero is returned. */
+    static TextureUploader * instance(GLResources * resources,
+                                      bool create = true);
+
+  private:
+
+    class Slot;
+    class CopyTask;
+
+    Slot * findSlot(const Collectable * key) const;
+    Texture2D * finish(Slot * slot);
+    void releaseSlot(Slot * slot);
+
+    Slot * m_slots[SLOTS];
+    bool   m_usePBO;
+  };
+
+}
+
+#endif
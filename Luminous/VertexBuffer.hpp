@@ -19,6 +19,8 @@
 #include <Luminous/Export.hpp>
 #include <Luminous/Luminous.hpp>
 
+#include <cstddef>
+
 #define BUFFER_OFFSET(bytes) ((GLubyte *)0 + (bytes))
 
 namespace Luminous
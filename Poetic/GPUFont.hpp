@@ -29,6 +29,12 @@ namespace Poetic
   class POETIC_API GPUFont : public Luminous::GLResource
   {
     public:
+      /// Fonts are expensive to recreate, so they hint a high priority
+      GPUFont()
+      {
+        setCategory(CATEGORY_FONT);
+        setPriority(PRIORITY_HIGH);
+      }
       virtual ~GPUFont() {}
 
       virtual CPUFont * cpuFont() = 0;
@@ -29,6 +29,9 @@ namespace Poetic
     m_cmf(cmf),
     m_resources(glrc)
   {
+    setCategory(CATEGORY_FONT);
+    setPriority(PRIORITY_HIGH);
+
     m_fonts.resize(m_cmf->fontCount());
   }
 
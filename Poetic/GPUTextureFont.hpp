@@ -18,14 +18,14 @@
 #include <Poetic/Export.hpp>
 #include <Poetic/GPUFontBase.hpp>
 
-#include <Luminous/Luminous.hpp>
-
-#include <vector>
-
 namespace Poetic 
 {
+  class GlyphAtlas;
 
   /// A GPU font that uses textures to render the glyphs
+  /** The glyphs are stored in the shared GlyphAtlas of the OpenGL
+      context, and each rendered string is drawn with one draw call
+      per atlas page. Use TextBatch to draw many strings together. */
   class POETIC_API GPUTextureFont : public GPUFontBase
   {
   public:
@@ -38,33 +38,11 @@ namespace Poetic
     
     inline virtual Glyph * makeGlyph(const Glyph * cpuGlyph);
 
-    virtual void faceSizeChanged();
-
   private:
-    inline void calculateTextureSize();
-    inline GLuint createTexture();
-
-    void resetGLResources();
-   
-    GLsizei m_maxTextureSize;
-
-    GLsizei m_texWidth;
-    GLsizei m_texHeight;
-
-    std::vector<GLuint> m_textures;
-
-    int m_glyphMaxWidth;
-    int m_glyphMaxHeight;
-
-    int m_padding;
-
-    unsigned int m_numGlyphs;
-    unsigned int m_remGlyphs;
-
-    int m_xOffset;
-    int m_yOffset;
+    inline GlyphAtlas * atlas();
+    inline void beginString();
 
-    bool m_reset;
+    GlyphAtlas * m_atlas;
   };
 
 }
@@ -26,34 +26,26 @@ namespace Poetic
 {
   using namespace Nimble;
 
-  GLuint GPUTextureGlyph::s_activeTexture = 0;
-
-  GPUTextureGlyph::GPUTextureGlyph(const CPUBitmapGlyph * glyph, int texId, int xOff, int yOff, GLsizei width, GLsizei height)
+  GPUTextureGlyph::GPUTextureGlyph(const CPUBitmapGlyph * glyph,
+                                   GlyphAtlas * atlas)
     : Glyph(*glyph),
-    m_width(0),
-    m_height(0),
-    m_textureId(texId)
+    m_width(glyph->m_size.x),
+    m_height(glyph->m_size.y),
+    m_atlas(atlas),
+    m_page(-1)
   {
-    m_width = glyph->m_size.x;
-    m_height = glyph->m_size.y;
-
-    if(m_width && m_height) {
-      glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT); 
-      glPixelStorei(GL_UNPACK_LSB_FIRST, GL_FALSE);
-      glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    GlyphAtlas::Region region;
 
-      glBindTexture(GL_TEXTURE_2D, m_textureId);
-      glTexSubImage2D(GL_TEXTURE_2D, 0, xOff, yOff, m_width, m_height, GL_ALPHA, GL_UNSIGNED_BYTE, glyph->m_bitmap);
+    if(atlas->add(m_width, m_height, glyph->m_bitmap, region))
+      m_page = region.m_page;
 
-      glPopClientAttrib();
-    }
+    float size = static_cast<float> (atlas->pageSize());
 
-    m_uv[0].x = static_cast<float> (xOff) / static_cast<float> (width);
-    m_uv[0].y = static_cast<float> (yOff) / static_cast<float> (height);
+    m_uv[0].x = region.m_x / size;
+    m_uv[0].y = region.m_y / size;
 
-    m_uv[1].x = static_cast<float> (xOff + m_width) / static_cast<float> (width);
-    m_uv[1].y = static_cast<float> (yOff + m_height) / static_cast<float> (height);
+    m_uv[1].x = (region.m_x + m_width) / size;
+    m_uv[1].y = (region.m_y + m_height) / size;
 
     m_pos = glyph->m_pos;
   }
@@ -63,10 +55,9 @@ namespace Poetic
 
   Nimble::Vector2 GPUTextureGlyph::render(Nimble::Vector2 pen, const Nimble::Matrix3 & m)
   {
-    if(s_activeTexture != m_textureId) {
-      glBindTexture(GL_TEXTURE_2D, m_textureId);
-      s_activeTexture = m_textureId;
-    }
+    // Blank glyphs (spaces) only advance the pen
+    if(!m_width || !m_height || m_page < 0)
+      return m_advance + pen;
 
 #ifdef POETIC_FLIP_Y
     Vector2f v0 = pen + Vector2f(m_pos.x,              -m_pos.y);
@@ -80,24 +71,14 @@ namespace Poetic
     Vector2f v3 = pen + Vector2f(m_width + m_pos.x,     m_pos.y);
 #endif
 
-    Vector4f p0 = Luminous::Utils::project(m, v0);
-    Vector4f p1 = Luminous::Utils::project(m, v1);
-    Vector4f p2 = Luminous::Utils::project(m, v2);
-    Vector4f p3 = Luminous::Utils::project(m, v3);
-
-    glBegin(GL_QUADS);
-    glTexCoord2f(m_uv[0].x, m_uv[0].y);
-    glVertex4fv(p0.data());
-
-    glTexCoord2f(m_uv[0].x, m_uv[1].y);
-    glVertex4fv(p1.data());
-
-    glTexCoord2f(m_uv[1].x, m_uv[1].y);
-    glVertex4fv(p2.data());
+    Vector4f corners[4] = {
+      Luminous::Utils::project(m, v0),
+      Luminous::Utils::project(m, v1),
+      Luminous::Utils::project(m, v2),
+      Luminous::Utils::project(m, v3)
+    };
 
-    glTexCoord2f(m_uv[1].x, m_uv[0].y);
-    glVertex4fv(p3.data());
-    glEnd();
+    m_atlas->addQuad(m_page, corners, m_uv[0], m_uv[1]);
 
     return m_advance + pen;
   }
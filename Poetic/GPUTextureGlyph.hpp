@@ -17,23 +17,24 @@
 #define POETIC_GPU_TEXTURE_GLYPH_HPP
 
 #include <Poetic/Glyph.hpp>
-
-#include <Luminous/Luminous.hpp>
+#include <Poetic/GlyphAtlas.hpp>
 
 namespace Poetic
 {
   class CPUBitmapGlyph;
 
-  /// A glyph stored in a texture on the GPU
+  /// A glyph stored in a glyph atlas on the GPU
+  /** Rendering the glyph adds its quad to the atlas batch, see
+      GlyphAtlas. */
   class GPUTextureGlyph : public Glyph
   {
     public:
-      GPUTextureGlyph(const CPUBitmapGlyph * glyph, int texId, int xOff, int yOff, GLsizei width, GLsizei height);
+      /// Copies the bitmap of the glyph to the atlas
+      GPUTextureGlyph(const CPUBitmapGlyph * glyph, GlyphAtlas * atlas);
       virtual ~GPUTextureGlyph();
 
       virtual Nimble::Vector2 render(Nimble::Vector2 pen, const Nimble::Matrix3 & m);
 
-      static void resetActiveTexture() { s_activeTexture = 0; }
     private:
       int m_width;
       int m_height;
@@ -41,11 +42,8 @@ namespace Poetic
       Nimble::Vector2 m_pos;
       Nimble::Vector2 m_uv[2];
 
-      GLuint m_textureId;
-
-      // Attempt to minimize texture changes
-      /// @todo this is not thread-safe
-      static GLuint s_activeTexture;
+      GlyphAtlas * m_atlas;
+      int m_page;
   };
 
 }
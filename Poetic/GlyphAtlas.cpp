@@ -0,0 +1,285 @@
+/* COPYRIGHT
+ *
+ * This file is part of Poetic.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Poetic.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#include "GlyphAtlas.hpp"
+
+#include <Luminous/GLResources.hpp>
+#include <Luminous/Collectable.hpp>
+
+#include <Nimble/Math.hpp>
+
+#include <Radiant/Trace.hpp>
+
+#include <cassert>
+#include <cstring>
+
+/* Empty pixels around each glyph, so that bilinear filtering does not
+   pick up the neighbouring glyphs. */
+#define GLYPH_PADDING 2
+
+namespace Poetic
+{
+  using namespace Nimble;
+
+  enum {
+    // Floats per vertex
+    VERTEX_SIZE = 10
+  };
+
+  GlyphAtlas::GlyphAtlas(Luminous::GLResources * resources)
+    : GLResource(resources),
+      m_pageSize(0),
+      m_color(1, 1, 1, 1),
+      m_batchDepth(0),
+      m_drawCalls(0),
+      m_vbo(0)
+  {
+    // Rebuilding the pages means rendering every glyph again
+    setCategory(CATEGORY_FONT);
+    setPriority(PRIORITY_HIGH);
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, & maxSize);
+
+    /* Same limit as with the earlier per-font textures: larger textures
+       have crashed OSX drivers. */
+    m_pageSize = Nimble::Math::Min(maxSize ? (int) maxSize : 1024, 1024);
+
+    if(GLEW_ARB_vertex_buffer_object)
+      m_vbo = new Luminous::VertexBuffer();
+  }
+
+  GlyphAtlas::~GlyphAtlas()
+  {
+    changeByteConsumption((long) m_pages.size() * m_pageSize * m_pageSize, 0);
+
+    for(unsigned i = 0; i < m_pages.size(); i++)
+      glDeleteTextures(1, & m_pages[i].m_texture);
+
+    delete m_vbo;
+  }
+
+  bool GlyphAtlas::add(int width, int height, const unsigned char * bitmap,
+                       Region & region)
+  {
+    int w = width + GLYPH_PADDING;
+    int h = height + GLYPH_PADDING;
+
+    if(w + GLYPH_PADDING > m_pageSize || h + GLYPH_PADDING > m_pageSize) {
+      Radiant::error("GlyphAtlas::add # Glyph too large (%d x %d)",
+                     width, height);
+      return false;
+    }
+
+    int page = (int) m_pages.size() - 1;
+    int x = 0, y = 0;
+
+    // Only the last page is filled, the older pages are mostly full
+    if(page < 0 || !allocate(m_pages[page], w, h, x, y)) {
+      createPage();
+      page++;
+      bool ok = allocate(m_pages[page], w, h, x, y);
+      assert(ok);
+      (void) ok;
+    }
+
+    region.m_page = page;
+    region.m_x = x;
+    region.m_y = y;
+
+    if(width && height) {
+      glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+      glPixelStorei(GL_UNPACK_LSB_FIRST, GL_FALSE);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+      glBindTexture(GL_TEXTURE_2D, m_pages[page].m_texture);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height,
+                      GL_ALPHA, GL_UNSIGNED_BYTE, bitmap);
+
+      glPopClientAttrib();
+    }
+
+    return true;
+  }
+
+  void GlyphAtlas::addQuad(int page, const Nimble::Vector4 * corners,
+                           Nimble::Vector2 uvLow, Nimble::Vector2 uvHigh)
+  {
+    std::vector<GLfloat> & v = m_pages[page].m_vertices;
+
+    const Vector2 uv[4] = {
+      uvLow,
+      Vector2(uvLow.x, uvHigh.y),
+      uvHigh,
+      Vector2(uvHigh.x, uvLow.y)
+    };
+
+    size_t base = v.size();
+    v.resize(base + 4 * VERTEX_SIZE);
+    GLfloat * dest = & v[base];
+
+    for(int i = 0; i < 4; i++) {
+      memcpy(dest, corners[i].data(), 4 * sizeof(GLfloat));
+      dest[4] = uv[i].x;
+      dest[5] = uv[i].y;
+      memcpy(dest + 6, m_color.data(), 4 * sizeof(GLfloat));
+      dest += VERTEX_SIZE;
+    }
+  }
+
+  void GlyphAtlas::endBatch()
+  {
+    assert(m_batchDepth > 0);
+
+    if(--m_batchDepth == 0)
+      draw();
+  }
+
+  void GlyphAtlas::flush()
+  {
+    if(m_batchDepth == 0)
+      draw();
+  }
+
+  unsigned GlyphAtlas::takeDrawCalls()
+  {
+    unsigned n = m_drawCalls;
+    m_drawCalls = 0;
+    return n;
+  }
+
+  GlyphAtlas * GlyphAtlas::instance(Luminous::GLResources * resources)
+  {
+    static Luminous::Collectable * key = new Luminous::Collectable();
+
+    if(!resources) {
+      // Applications that render without GLResources have one context
+      static GlyphAtlas * single = 0;
+      if(!single)
+        single = new GlyphAtlas();
+      return single;
+    }
+
+    GLRESOURCE_ENSURE(GlyphAtlas, atlas, key, resources);
+
+    return atlas;
+  }
+
+  bool GlyphAtlas::allocate(Page & page, int width, int height, int & x, int & y)
+  {
+    // Best fitting shelf, that does not waste too much height
+    Shelf * best = 0;
+
+    for(unsigned i = 0; i < page.m_shelves.size(); i++) {
+      Shelf & s = page.m_shelves[i];
+
+      if(s.m_height < height || s.m_height > height + height / 4 + 2 ||
+         s.m_x + width > m_pageSize)
+        continue;
+
+      if(!best || s.m_height < best->m_height)
+        best = & s;
+    }
+
+    if(!best) {
+      if(page.m_top + height > m_pageSize)
+        return false;
+
+      page.m_shelves.push_back(Shelf(page.m_top, height));
+      page.m_top += height;
+      best = & page.m_shelves.back();
+    }
+
+    x = best->m_x + GLYPH_PADDING;
+    y = best->m_y + GLYPH_PADDING;
+    best->m_x += width;
+
+    return true;
+  }
+
+  void GlyphAtlas::createPage()
+  {
+    std::vector<unsigned char> zeros(m_pageSize * m_pageSize, 0);
+
+    Page page;
+
+    glGenTextures(1, & page.m_texture);
+    glBindTexture(GL_TEXTURE_2D, page.m_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, m_pageSize, m_pageSize,
+                 0, GL_ALPHA, GL_UNSIGNED_BYTE, & zeros[0]);
+
+    m_pages.push_back(page);
+
+    long bytes = (long) m_pageSize * m_pageSize;
+    changeByteConsumption(0, bytes);
+  }
+
+  void GlyphAtlas::draw()
+  {
+    bool any = false;
+
+    for(unsigned i = 0; i < m_pages.size() && !any; i++)
+      any = !m_pages[i].m_vertices.empty();
+
+    if(!any)
+      return;
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    // The color array overrides the current color
+    glPushAttrib(GL_CURRENT_BIT);
+
+    const GLsizei stride = VERTEX_SIZE * sizeof(GLfloat);
+
+    for(unsigned i = 0; i < m_pages.size(); i++) {
+      std::vector<GLfloat> & v = m_pages[i].m_vertices;
+
+      if(v.empty())
+        continue;
+
+      const GLfloat * base = & v[0];
+
+      if(m_vbo) {
+        m_vbo->fill((void *) base, v.size() * sizeof(GLfloat),
+                    Luminous::VertexBuffer::STREAM_DRAW);
+        base = 0;
+      }
+
+      glVertexPointer(4, GL_FLOAT, stride, base);
+      glTexCoordPointer(2, GL_FLOAT, stride, base + 4);
+      glColorPointer(4, GL_FLOAT, stride, base + 6);
+
+      glBindTexture(GL_TEXTURE_2D, m_pages[i].m_texture);
+      glDrawArrays(GL_QUADS, 0, (GLsizei) (v.size() / VERTEX_SIZE));
+
+      m_drawCalls++;
+      v.clear();
+    }
+
+    if(m_vbo)
+      m_vbo->unbind();
+
+    glPopAttrib();
+    glPopClientAttrib();
+  }
+
+}
@@ -0,0 +1,141 @@
+/* COPYRIGHT
+ *
+ * This file is part of Poetic.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Poetic.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#ifndef POETIC_GLYPH_ATLAS_HPP
+#define POETIC_GLYPH_ATLAS_HPP
+
+#include <Poetic/Export.hpp>
+
+#include <Luminous/GLResource.hpp>
+#include <Luminous/Luminous.hpp>
+#include <Luminous/VertexBuffer.hpp>
+
+#include <Nimble/Vector2.hpp>
+#include <Nimble/Vector4.hpp>
+
+#include <vector>
+
+namespace Poetic
+{
+
+  /// Shared glyph textures, and batched rendering of glyph quads
+  /** All texture fonts of one OpenGL context pack their glyphs into
+      the same atlas, regardless of the font face or point size. The
+      atlas consists of one or more alpha textures (pages), which are
+      filled row by row with a shelf packer.
+
+      Glyphs do not draw themselves, they add quads to the atlas with
+      addQuad. The quads are collected into one vertex array per page,
+      and drawn with one call per page in flush(). Normally every
+      string is flushed after it has been rendered, but inside a
+      TextBatch all strings are collected and flushed together.
+
+      The vertices include the current OpenGL color, which is sampled
+      when the string is rendered. Other OpenGL state (blending,
+      texturing, matrices) must stay the same for all strings of a
+      batch. */
+  class POETIC_API GlyphAtlas : public Luminous::GLResource
+  {
+  public:
+    /// A rectangle in the atlas
+    class Region
+    {
+    public:
+      Region() : m_page(-1), m_x(0), m_y(0) {}
+
+      int m_page;
+      int m_x;
+      int m_y;
+    };
+
+    GlyphAtlas(Luminous::GLResources * resources = 0);
+    virtual ~GlyphAtlas();
+
+    /** Reserves space for a glyph bitmap, and uploads the
+        bitmap. Returns false if the glyph does not fit in a page. */
+    bool add(int width, int height, const unsigned char * bitmap,
+             Region & region);
+
+    /// Returns the texture of the given page
+    GLuint texture(int page) const { return m_pages[page].m_texture; }
+    /// Returns the width and height of the pages
+    int pageSize() const { return m_pageSize; }
+    /// Returns the number of pages
+    int pageCount() const { return (int) m_pages.size(); }
+
+    /// Sets the color of the quads that are added after this call
+    void setColor(const Nimble::Vector4 & color) { m_color = color; }
+
+    /** Adds a glyph quad to the batch. The corners are in
+        counter-clockwise order, starting from the top-left
+        corner. */
+    void addQuad(int page, const Nimble::Vector4 * corners,
+                 Nimble::Vector2 uvLow, Nimble::Vector2 uvHigh);
+
+    /// Starts a batch, nested calls are allowed
+    void beginBatch() { m_batchDepth++; }
+    /// Ends a batch, and draws it if this was the outermost batch
+    void endBatch();
+    /// Draws the collected quads, unless a batch is active
+    void flush();
+
+    /// Returns the number of draw calls made since the last call
+    unsigned takeDrawCalls();
+
+    /** Returns the atlas of the given OpenGL context. If resources
+        is zero, one shared atlas is used. */
+    static GlyphAtlas * instance(Luminous::GLResources * resources);
+
+  private:
+
+    class Shelf
+    {
+    public:
+      Shelf(int y = 0, int height = 0) : m_y(y), m_height(height), m_x(0) {}
+
+      int m_y;
+      int m_height;
+      int m_x;
+    };
+
+    class Page
+    {
+    public:
+      Page() : m_texture(0), m_top(0) {}
+
+      GLuint m_texture;
+      // Free space starts here
+      int m_top;
+      std::vector<Shelf> m_shelves;
+      // Interleaved vertices of the quads (x, y, z, w, s, t, r, g, b, a)
+      std::vector<GLfloat> m_vertices;
+    };
+
+    bool allocate(Page & page, int width, int height, int & x, int & y);
+    void createPage();
+    void draw();
+
+    std::vector<Page> m_pages;
+    int m_pageSize;
+
+    Nimble::Vector4 m_color;
+    int m_batchDepth;
+    unsigned m_drawCalls;
+
+    Luminous::VertexBuffer * m_vbo;
+  };
+
+}
+
+#endif
@@ -12,6 +12,7 @@ HEADERS += Poetic.hpp
 HEADERS += Export.hpp
 HEADERS += Face.hpp
 HEADERS += FontManager.hpp
+HEADERS += GlyphAtlas.hpp
 HEADERS += GlyphContainer.hpp
 HEADERS += Glyph.hpp
 HEADERS += GPUFontBase.hpp
@@ -21,6 +22,7 @@ HEADERS += GPUTextureFont.hpp
 HEADERS += GPUTextureGlyph.hpp
 HEADERS += GPUWrapperFont.hpp
 HEADERS += Size.hpp
+HEADERS += TextBatch.hpp
 HEADERS += Utils.hpp
 
 SOURCES += BBox.cpp
@@ -34,6 +36,7 @@ SOURCES += CPUWrapperFont.cpp
 SOURCES += Poetic.cpp
 SOURCES += Face.cpp
 SOURCES += FontManager.cpp
+SOURCES += GlyphAtlas.cpp
 SOURCES += GlyphContainer.cpp
 SOURCES += Glyph.cpp
 SOURCES += GPUFontBase.cpp
@@ -43,6 +46,7 @@ SOURCES += GPUTextureFont.cpp
 SOURCES += GPUTextureGlyph.cpp
 SOURCES += GPUWrapperFont.cpp
 SOURCES += Size.cpp
+SOURCES += TextBatch.cpp
 SOURCES += Utils.cpp
 
 DEFINES += POETIC_FLIP_Y
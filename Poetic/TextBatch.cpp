@@ -0,0 +1,40 @@
+/* COPYRIGHT
+ *
+ * This file is part of Poetic.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Poetic.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#include "TextBatch.hpp"
+#include "GlyphAtlas.hpp"
+
+#include <Luminous/GLResources.hpp>
+
+namespace Poetic
+{
+
+  TextBatch::TextBatch()
+    : m_atlas(GlyphAtlas::instance(Luminous::GLResources::getThreadResources()))
+  {
+    m_atlas->beginBatch();
+  }
+
+  TextBatch::TextBatch(Luminous::GLResources * resources)
+    : m_atlas(GlyphAtlas::instance(resources))
+  {
+    m_atlas->beginBatch();
+  }
+
+  TextBatch::~TextBatch()
+  {
+    m_atlas->endBatch();
+  }
+
+}
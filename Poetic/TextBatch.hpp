@@ -0,0 +1,67 @@
+/* COPYRIGHT
+ *
+ * This file is part of Poetic.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Poetic.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#ifndef POETIC_TEXT_BATCH_HPP
+#define POETIC_TEXT_BATCH_HPP
+
+#include <Poetic/Export.hpp>
+
+#include <Patterns/NotCopyable.hpp>
+
+namespace Luminous
+{
+  class GLResources;
+}
+
+namespace Poetic
+{
+  class GlyphAtlas;
+
+  /// Collects the text rendered during its lifetime into one batch
+  /** Without a batch, every string is drawn as soon as it has been
+      rendered. Inside a batch, the glyph quads of all strings are
+      collected, and drawn when the batch goes out of scope, with one
+      draw call per glyph atlas page.
+
+      \code
+      {
+        Poetic::TextBatch batch;
+
+        for(int i = 0; i < labels; i++)
+          font->render(label[i], location[i]);
+      } // Text is drawn here
+      \endcode
+
+      The text is drawn with the OpenGL state that is active when the
+      batch ends, except for the color, which is stored per string. Do
+      not change other OpenGL state while a batch is active.
+
+      Batches can be nested, only the outermost batch draws. */
+  class POETIC_API TextBatch : public Patterns::NotCopyable
+  {
+  public:
+    /// Starts a batch in the OpenGL context of the calling thread
+    TextBatch();
+    /// Starts a batch in the given OpenGL context
+    TextBatch(Luminous::GLResources * resources);
+    /// Ends the batch, and draws the text
+    ~TextBatch();
+
+  private:
+    GlyphAtlas * m_atlas;
+  };
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+/* COPYRIGHT
+*
+* This file is part of Radiant.
+*
+* Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+*
+* See file "Radiant.hpp" for authors and more details.
+*
+* This file is licensed under GNU Lesser General Public
+* License (LGPL), version 2.1. The LGPL conditions can be found in 
+* file "LGPL.txt" that is distributed with this source package or obtained 
+* from the GNU organization (www.gnu.org).
+* 
+*/
+
+#ifndef RADIANT_ATOMIC_HPP
+#define RADIANT_ATOMIC_HPP
+
+#include <stdint.h>
+
+#ifdef WIN32
+#include <intrin.h>
+#endif
+
+namespace Radiant {
+
+  /** Atomic operations on integers and pointers.
+
+      These are thin wrappers around the atomic intrinsics of the
+      compiler. All of the operations act as full memory barriers.
+      They are intended for building simple lock-free structures
+      (counters, flags, intrusive stacks) where taking a Mutex would
+      be too expensive, or would block a time-critical thread.
+  */
+  namespace Atomic {
+
+#ifdef WIN32
+
+    /// Adds delta to the value and returns the new value
+    inline int add(volatile int * value, int delta)
+    { return _InterlockedExchangeAdd((volatile long *) value, delta) + delta; }
+
+    /// Sets the value to desired, if it was equal to expected
+    /** @return true if the value was changed */
+    inline bool compareAndSwap(volatile int * value, int expected, int desired)
+    {
+      return _InterlockedCompareExchange((volatile long *) value,
+                                         desired, expected) == expected;
+    }
+
+    /// 64-bit version of compareAndSwap
+    inline bool compareAndSwap(volatile int64_t * value,
+                               int64_t expected, int64_t desired)
+    {
+      return _InterlockedCompareExchange64((volatile __int64 *) value,
+                                           desired, expected) == expected;
+    }
+
+    /// 64-bit version of add
+    inline int64_t add(volatile int64_t * value, int64_t delta)
+    {
+      // _InterlockedExchangeAdd64 is not available on 32-bit targets
+      int64_t old;
+      do {
+        old = *value;
+      } while(!compareAndSwap(value, old, old + delta));
+      return old + delta;
+    }
+
+    /// Sets the pointer to desired, if it was equal to expected
+    /** @return true if the pointer was changed */
+    template <class T>
+    inline bool compareAndSwapPtr(T * volatile * ptr, T * expected, T * desired)
+    {
+      return _InterlockedCompareExchangePointer
+        ((void * volatile *) ptr, desired, expected) == expected;
+    }
+
+    /// Issues a full memory barrier
+    inline void memoryBarrier()
+    {
+      // Interlocked operations are full barriers on Windows
+      long dummy = 0;
+      _InterlockedExchange(&dummy, 1);
+    }
+
+#else
+
+    /// Adds delta to the value and returns the new value
+    inline int add(volatile int * value, int delta)
+    { return __sync_add_and_fetch(value, delta); }
+
+    /// Sets the value to desired, if it was equal to expected
+    /** @return true if the value was changed */
+    inline bool compareAndSwap(volatile int * value, int expected, int desired)
+    { return __sync_bool_compare_and_swap(value, expected, desired); }
+
+    /// 64-bit version of add
+    inline int64_t add(volatile int64_t * value, int64_t delta)
+    { return __sync_add_and_fetch(value, delta); }
+
+    /// 64-bit version of compareAndSwap
+    inline bool compareAndSwap(volatile int64_t * value,
+                               int64_t expected, int64_t desired)
+    { return __sync_bool_compare_and_swap(value, expected, desired); }
+
+    /// Sets the pointer to desired, if it was equal to expected
+    /** @return true if the pointer was changed */
+    template <class T>
+    inline bool compareAndSwapPtr(T * volatile * ptr, T * expected, T * desired)
+    { return __sync_bool_compare_and_swap(ptr, expected, desired); }
+
+    /// Issues a full memory barrier
+    inline void memoryBarrier() { __sync_synchronize(); }
+
+#endif
+
+    /// Replaces the pointer with desired, and returns the old value
+    template <class T>
+    inline T * exchangePtr(T * volatile * ptr, T * desired)
+    {
+      T * old;
+      do {
+        old = *ptr;
+      } while(!compareAndSwapPtr(ptr, old, desired));
+      return old;
+    }
+
+  }
+
+}
+
+#endif
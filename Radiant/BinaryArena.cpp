@@ -0,0 +1,86 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+
+#include "BinaryArena.hpp"
+
+#include <QThreadStorage>
+
+#include <stdlib.h>
+
+namespace Radiant {
+
+  static QThreadStorage<BinaryArena *> __threadArenas;
+
+  BinaryArena::BinaryArena(size_t capacity)
+    : m_data((char *) malloc(capacity)),
+    m_capacity(m_data ? capacity : 0),
+    m_used(0),
+    m_allocations(0)
+  {}
+
+  BinaryArena::~BinaryArena()
+  {
+    free(m_data);
+  }
+
+  void * BinaryArena::allocate(size_t bytes)
+  {
+    bytes = align(bytes);
+
+    if(bytes > m_capacity - m_used)
+      return 0;
+
+    void * ptr = m_data + m_used;
+    m_used += bytes;
+    m_allocations++;
+
+    return ptr;
+  }
+
+  bool BinaryArena::resize(void * ptr, size_t bytes, size_t newBytes)
+  {
+    bytes = align(bytes);
+    newBytes = align(newBytes);
+
+    if((char *) ptr + bytes != m_data + m_used)
+      return false;
+
+    size_t offset = (char *) ptr - m_data;
+
+    if(newBytes > m_capacity - offset)
+      return false;
+
+    m_used = offset + newBytes;
+
+    return true;
+  }
+
+  void BinaryArena::release(void * ptr, size_t bytes)
+  {
+    if(--m_allocations == 0)
+      m_used = 0;
+    else if((char *) ptr + align(bytes) == m_data + m_used)
+      m_used = (char *) ptr - m_data;
+  }
+
+  BinaryArena * BinaryArena::threadArena()
+  {
+    if(!__threadArenas.hasLocalData())
+      __threadArenas.setLocalData(new BinaryArena());
+
+    return __threadArenas.localData();
+  }
+
+}
@@ -0,0 +1,87 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+
+#ifndef RADIANT_BINARY_ARENA_HPP
+#define RADIANT_BINARY_ARENA_HPP
+
+#include <Radiant/Export.hpp>
+
+#include <Patterns/NotCopyable.hpp>
+
+#include <stddef.h>
+
+namespace Radiant {
+
+  /// Bump allocator for short-lived BinaryData buffers
+  /** The arena hands out memory from one pre-allocated block, by
+      advancing a pointer. Memory is returned in LIFO order: releasing
+      the latest allocation moves the pointer back, and when all
+      allocations have been released the whole arena is free
+      again. Buffers of BinaryData objects that live on the stack follow
+      this pattern naturally, so building messages every frame does not
+      touch the heap in steady state:
+
+      <PRE>
+      BinaryData control(BinaryArena::threadArena());
+      control.writeString("panner/setsourcelocation");
+      ...
+      dsp->send(control);
+      </PRE>
+
+      When the arena is full, BinaryData falls back to the heap.
+
+      The arena is not thread-safe, use threadArena() to get an arena
+      that is private to the calling thread.
+  */
+  class RADIANT_API BinaryArena : public Patterns::NotCopyable
+  {
+  public:
+    /// Creates an arena of the given size
+    BinaryArena(size_t capacity = 64 * 1024);
+    ~BinaryArena();
+
+    /// Allocates memory from the arena
+    /** @return Pointer to the memory, or null if the arena is full */
+    void * allocate(size_t bytes);
+    /// Tries to grow or shrink an allocation in place
+    /** This succeeds only for the latest allocation. */
+    bool resize(void * ptr, size_t bytes, size_t newBytes);
+    /// Returns an allocation to the arena
+    void release(void * ptr, size_t bytes);
+
+    /// Number of bytes in use
+    size_t used() const { return m_used; }
+    /// Size of the arena in bytes
+    size_t capacity() const { return m_capacity; }
+    /// Number of allocations that have not been released
+    int allocations() const { return m_allocations; }
+
+    /// Returns the arena of the calling thread
+    /** The arena is created on the first call, and deleted when the
+        thread exits. */
+    static BinaryArena * threadArena();
+
+  private:
+    static size_t align(size_t bytes) { return (bytes + 15) & ~size_t(15); }
+
+    char * m_data;
+    size_t m_capacity;
+    size_t m_used;
+    int    m_allocations;
+  };
+
+}
+
+#endif
@@ -15,6 +15,7 @@
 
 #include "BinaryData.hpp"
 
+#include <Radiant/BinaryArena.hpp>
 #include <Radiant/BinaryStream.hpp>
 #include "DateTime.hpp"
 #include <Radiant/Trace.hpp>
@@ -22,6 +23,8 @@
 
 #include <Nimble/Math.hpp>
 
+#include <algorithm>
+
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
@@ -66,33 +69,152 @@ namespace Radiant {
   const int STRING_MARKER = makeMarker(',', 's', '\0', '\0');
   const int WSTRING_MARKER = makeMarker(',', 'S', '\0', '\0');
   const int BLOB_MARKER   = makeMarker(',', 'b', '\0', '\0');
+  const int FLOAT_ARRAY_MARKER = makeMarker(',', 'f', 'a', '\0');
+
+  /* The first byte of compact data. Standard data always begins with a
+     marker, that is with a ','. */
+  const unsigned char COMPACT_HEADER = 0xC5;
+
+  /* Value types of the compact format, stored in the low four bits of
+     the tag byte. The high four bits hold the vector dimension. */
+  enum {
+    COMPACT_INT,
+    COMPACT_FLOAT32,
+    COMPACT_FLOAT64,
+    COMPACT_TIMESTAMP,
+    COMPACT_STRING,
+    COMPACT_WSTRING,
+    COMPACT_BLOB,
+    COMPACT_VECTORF,
+    COMPACT_VECTORI,
+    COMPACT_FLOAT_ARRAY
+  };
+
+  /* Maximum size of a 64-bit varint */
+  const size_t VARINT_MAX = 10;
+
+  inline uint64_t zigZag(int64_t v)
+  {
+    return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+  }
+
+  inline int64_t unZigZag(uint64_t v)
+  {
+    return int64_t(v >> 1) ^ -int64_t(v & 1);
+  }
+
+  inline size_t utf8Bytes(uint32_t c)
+  {
+    if(c < 0x80)
+      return 1;
+    else if(c < 0x800)
+      return 2;
+    else if(c < 0x10000)
+      return 3;
+    return 4;
+  }
+
+  static void decodeUTF8(const char * src, size_t bytes, std::wstring & str)
+  {
+    const unsigned char * p = (const unsigned char *) src;
+    const unsigned char * end = p + bytes;
+
+    // The string can only be shorter than the number of bytes
+    str.resize(bytes);
+
+    if(!bytes)
+      return;
+
+    wchar_t * out = & str[0];
+    wchar_t * begin = out;
+
+    while(p < end) {
+      uint32_t c = *p++;
+
+      if(c < 0x80) {
+        *out++ = wchar_t(c);
+        continue;
+      }
+
+      int extra = 0;
+
+      if(c >= 0xF0) {
+        c &= 0x07;
+        extra = 3;
+      }
+      else if(c >= 0xE0) {
+        c &= 0x0F;
+        extra = 2;
+      }
+      else if(c >= 0xC0) {
+        c &= 0x1F;
+        extra = 1;
+      }
+      else
+        c = 0xFFFD;
+
+      for(; extra > 0 && p < end && (*p & 0xC0) == 0x80; extra--)
+        c = (c << 6) | (*p++ & 0x3F);
+
+      if(extra)
+        c = 0xFFFD;
+
+      *out++ = wchar_t(c);
+    }
+
+    str.resize(out - begin);
+  }
 
   BinaryData::BinaryData()
     : m_current(0),
       m_total(0),
-      m_size(0),
-      m_shared(false),
-      m_buf(0)
+      m_size(INLINE_BYTES),
+      m_storage(STORAGE_INLINE),
+      m_buf(m_inline),
+      m_arena(0),
+      m_format(FORMAT_STANDARD),
+      m_readFormat(FORMAT_STANDARD)
+    {}
+
+  BinaryData::BinaryData(BinaryArena * arena)
+    : m_current(0),
+      m_total(0),
+      m_size(INLINE_BYTES),
+      m_storage(STORAGE_INLINE),
+      m_buf(m_inline),
+      m_arena(arena),
+      m_format(FORMAT_STANDARD),
+      m_readFormat(FORMAT_STANDARD)
     {}
 
   BinaryData::BinaryData(const BinaryData & that)
     : m_current(0),
       m_total(0),
-      m_size(0),
-      m_shared(false),
-      m_buf(0)
+      m_size(INLINE_BYTES),
+      m_storage(STORAGE_INLINE),
+      m_buf(m_inline),
+      m_arena(0),
+      m_format(FORMAT_STANDARD),
+      m_readFormat(FORMAT_STANDARD)
   {
     *this = that;
   }
 
   BinaryData::~BinaryData()
   {
-    if(!m_shared)
-      free(m_buf);
+    freeBuffer();
   }
 
   void BinaryData::writeFloat32(float v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(5);
+      putTag(COMPACT_FLOAT32);
+      putRaw( & v, 4);
+      endCompact();
+      return;
+    }
+
     ensure(8);
     getRef<int32_t>() = FLOAT_MARKER;
     getRef<float>()   = v;
@@ -100,6 +222,14 @@ namespace Radiant {
 
   void BinaryData::writeFloat64(double v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(9);
+      putTag(COMPACT_FLOAT64);
+      putRaw( & v, 8);
+      endCompact();
+      return;
+    }
+
     ensure(12);
     getRef<int32_t>() = DOUBLE_MARKER;
     getRef<double>()  = v;
@@ -107,6 +237,11 @@ namespace Radiant {
 
   void BinaryData::writeInt32(int32_t v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      writeInt64(v);
+      return;
+    }
+
     ensure(8);
     getRef<int32_t>() = INT32_MARKER;
     getRef<int32_t>() = v;
@@ -114,6 +249,14 @@ namespace Radiant {
 
   void BinaryData::writeInt64(int64_t v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + VARINT_MAX);
+      putTag(COMPACT_INT);
+      putVarint(zigZag(v));
+      endCompact();
+      return;
+    }
+
     ensure(12);
     getRef<int64_t>() = INT64_MARKER;
     getRef<int64_t>() = v;
@@ -121,6 +264,14 @@ namespace Radiant {
 
   void BinaryData::writeTimeStamp(int64_t v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(9);
+      putTag(COMPACT_TIMESTAMP);
+      putRaw( & v, 8);
+      endCompact();
+      return;
+    }
+
     ensure(12);
     getRef<int32_t>() = TS_MARKER;
     getRef<int64_t>() = v;
@@ -129,6 +280,16 @@ namespace Radiant {
   void BinaryData::writeString(const char * s)
   {
     size_t len = strlen(s);
+
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + VARINT_MAX + len);
+      putTag(COMPACT_STRING);
+      putVarint(len);
+      putRaw(s, len);
+      endCompact();
+      return;
+    }
+
     size_t space = stringSpace(s);
     ensure(4 + space);
 
@@ -142,6 +303,32 @@ namespace Radiant {
 
   void BinaryData::writeWString(const std::wstring & str)
   {
+    if(m_format == FORMAT_COMPACT) {
+      // Short strings have a one-byte length, encode them in one pass
+      if(str.size() * 4 < 0x80) {
+        beginCompact(2 + str.size() * 4);
+        putTag(COMPACT_WSTRING);
+        unsigned lenpos = m_current++;
+        for(unsigned i = 0; i < str.size(); i++)
+          putUTF8(uint32_t(str[i]));
+        m_buf[lenpos] = (char) (m_current - lenpos - 1);
+        endCompact();
+        return;
+      }
+
+      size_t bytes = 0;
+      for(unsigned i = 0; i < str.size(); i++)
+        bytes += utf8Bytes(uint32_t(str[i]));
+
+      beginCompact(1 + VARINT_MAX + bytes);
+      putTag(COMPACT_WSTRING);
+      putVarint(bytes);
+      for(unsigned i = 0; i < str.size(); i++)
+        putUTF8(uint32_t(str[i]));
+      endCompact();
+      return;
+    }
+
     ensure(8 + str.size() * 4);
 
     getRef<int32_t>() = WSTRING_MARKER;
@@ -154,6 +341,15 @@ namespace Radiant {
 
   void BinaryData::writeBlob(const void * ptr, int n)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + VARINT_MAX + n);
+      putTag(COMPACT_BLOB);
+      putVarint(n);
+      putRaw(ptr, n);
+      endCompact();
+      return;
+    }
+
     ensure(8 + n);
 
     getRef<int32_t>() = BLOB_MARKER;
@@ -165,6 +361,14 @@ namespace Radiant {
 
   void BinaryData::writeVector2Float32(Nimble::Vector2f v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + 2 * 4);
+      putTag(COMPACT_VECTORF, 2);
+      putRaw(v.data(), 2 * 4);
+      endCompact();
+      return;
+    }
+
     ensure(12);
     getRef<int32_t>() = VECTOR2F_MARKER;
     getRef<float>() = v[0];
@@ -173,6 +377,15 @@ namespace Radiant {
 
   void BinaryData::writeVector2Int32(Nimble::Vector2i v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + 2 * VARINT_MAX);
+      putTag(COMPACT_VECTORI, 2);
+      for(int i = 0; i < 2; i++)
+        putVarint(zigZag(v[i]));
+      endCompact();
+      return;
+    }
+
     ensure(12);
     getRef<int32_t>() = VECTOR2I_MARKER;
     getRef<int>() = v[0];
@@ -181,6 +394,14 @@ namespace Radiant {
 
   void BinaryData::writeVector3Float32(Nimble::Vector3f v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + 3 * 4);
+      putTag(COMPACT_VECTORF, 3);
+      putRaw(v.data(), 3 * 4);
+      endCompact();
+      return;
+    }
+
     ensure(16);
     getRef<int32_t>() = VECTOR3F_MARKER;
     getRef<float>() = v[0];
@@ -190,6 +411,15 @@ namespace Radiant {
 
   void BinaryData::writeVector3Int32(Nimble::Vector3i v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + 3 * VARINT_MAX);
+      putTag(COMPACT_VECTORI, 3);
+      for(int i = 0; i < 3; i++)
+        putVarint(zigZag(v[i]));
+      endCompact();
+      return;
+    }
+
     ensure(16);
     getRef<int32_t>() = VECTOR3I_MARKER;
     getRef<int>() = v[0];
@@ -199,6 +429,15 @@ namespace Radiant {
 
   void BinaryData::writeVector4Int32(const Nimble::Vector4i & v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + 4 * VARINT_MAX);
+      putTag(COMPACT_VECTORI, 4);
+      for(int i = 0; i < 4; i++)
+        putVarint(zigZag(v[i]));
+      endCompact();
+      return;
+    }
+
     ensure(20);
     getRef<int32_t>() = VECTOR4I_MARKER;
     getRef<int>() = v[0];
@@ -209,6 +448,14 @@ namespace Radiant {
 
   void BinaryData::writeVector4Float32(const Nimble::Vector4f & v)
   {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + 4 * 4);
+      putTag(COMPACT_VECTORF, 4);
+      putRaw(v.data(), 4 * 4);
+      endCompact();
+      return;
+    }
+
     ensure(20);
     getRef<int32_t>() = VECTOR4F_MARKER;
     getRef<float>() = v[0];
@@ -217,10 +464,47 @@ namespace Radiant {
     getRef<float>() = v[3];
   }
 
+  void BinaryData::writeFloat32Array(const float * v, int n)
+  {
+    if(m_format == FORMAT_COMPACT) {
+      beginCompact(1 + VARINT_MAX + n * 4);
+      putTag(COMPACT_FLOAT_ARRAY);
+      putVarint(n);
+      putRaw(v, n * 4);
+      endCompact();
+      return;
+    }
+
+    ensure(8 + n * 4);
+    getRef<int32_t>() = FLOAT_ARRAY_MARKER;
+    getRef<int32_t>() = n;
+    char * dest = getPtr<char>(n * 4);
+    if(n)
+      memcpy(dest, v, n * 4);
+  }
+
   void BinaryData::append(const BinaryData & that)
   {
-    ensure(that.pos());
-    memcpy(getPtr<char>(that.pos()), that.data(), that.pos());
+    const char * src = that.data();
+    int n = that.pos();
+
+    if(n && m_current) {
+      bool compact = (unsigned char) m_buf[0] == COMPACT_HEADER;
+
+      if(compact != ((unsigned char) src[0] == COMPACT_HEADER)) {
+        error("BinaryData::append # Cannot mix standard and compact data");
+        return;
+      }
+
+      // The header byte only appears at the beginning of the buffer
+      if(compact) {
+        src++;
+        n--;
+      }
+    }
+
+    ensure(n);
+    memcpy(getPtr<char>(n), src, n);
   }
 
   float BinaryData::readFloat32(bool * ok)
@@ -228,6 +512,15 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      int type, dim;
+      if(!getTag(type, dim)) {
+        if(ok) * ok = false;
+        return 0.0f;
+      }
+      return float(compactFloat(type, dim, ok));
+    }
+
     if(!available(8)) {
       if(ok) * ok = false;
       return 0.0f;
@@ -268,6 +561,15 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      int type, dim;
+      if(!getTag(type, dim)) {
+        if(ok) * ok = false;
+        return 0.0;
+      }
+      return compactFloat(type, dim, ok);
+    }
+
     if(!available(8)) {
       if(ok) * ok = false;
       return 0.0f;
@@ -309,6 +611,16 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      int type, dim;
+      if(!getTag(type, dim)) {
+        if(ok) * ok = false;
+        unavailable("BinaryData::readInt32");
+        return 0;
+      }
+      return int32_t(compactInt(type, dim, ok));
+    }
+
     if(!available(4)) {
       if(ok) * ok = false;
       unavailable("BinaryData::readInt32");
@@ -351,6 +663,16 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      int type, dim;
+      if(!getTag(type, dim)) {
+        if(ok) * ok = false;
+        unavailable("BinaryData::readInt64");
+        return 0;
+      }
+      return compactInt(type, dim, ok);
+    }
+
     if(!available(8)) {
       if(ok) * ok = false;
       unavailable("BinaryData::readInt64");
@@ -381,6 +703,34 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      int type, dim;
+      const char * source;
+      size_t len;
+
+      if(!getTag(type, dim)) {
+        if(ok) * ok = false;
+        return 0;
+      }
+
+      if(type == COMPACT_TIMESTAMP && available(8)) {
+        int64_t v;
+        memcpy( & v, getPtr<char>(8), 8);
+        return v;
+      }
+      else if(type == COMPACT_STRING && getBytes(source, len)) {
+        DateTime dt;
+        if(dt.fromString(std::string(source, len)))
+          return dt.asTimeStamp();
+      }
+      else
+        skipCompact(type, dim);
+
+      if(ok)
+        *ok = false;
+      return 0;
+    }
+
     if(!available(4)) {
       if(ok) * ok = false;
       return 0;
@@ -413,6 +763,29 @@ namespace Radiant {
 
   bool BinaryData::readString(char * str, size_t maxbytes)
   {
+    if(readCompact()) {
+      int type, dim;
+      const char * source;
+      size_t len;
+
+      if(!getTag(type, dim))
+        return false;
+
+      if(type != COMPACT_STRING) {
+        skipCompact(type, dim);
+        return false;
+      }
+
+      if(!getBytes(source, len) || len >= maxbytes) {
+        str[0] = 0;
+        return false;
+      }
+
+      memcpy(str, source, len);
+      str[len] = '\0';
+
+      return true;
+    }
 
     int32_t marker = getRef<int32_t>();
 
@@ -438,6 +811,27 @@ namespace Radiant {
 
   bool BinaryData::readString(std::string & str)
   {
+    if(readCompact()) {
+      int type, dim;
+      const char * source;
+      size_t len;
+
+      if(!getTag(type, dim))
+        return false;
+
+      if(type != COMPACT_STRING) {
+        skipCompact(type, dim);
+        return false;
+      }
+
+      if(!getBytes(source, len))
+        return false;
+
+      str.assign(source, len);
+
+      return true;
+    }
+
     int32_t marker = getRef<int32_t>();
 
     if(marker != STRING_MARKER) {
@@ -458,6 +852,27 @@ namespace Radiant {
 
   bool BinaryData::readWString(std::wstring & str)
   {
+    if(readCompact()) {
+      int type, dim;
+      const char * source;
+      size_t len;
+
+      if(!getTag(type, dim))
+        return false;
+
+      if(type != COMPACT_WSTRING && type != COMPACT_STRING) {
+        skipCompact(type, dim);
+        return false;
+      }
+
+      if(!getBytes(source, len))
+        return false;
+
+      decodeUTF8(source, len, str);
+
+      return true;
+    }
+
     int32_t marker = getRef<int32_t>();
 
     if(marker != WSTRING_MARKER) {
@@ -477,6 +892,27 @@ namespace Radiant {
 
   bool BinaryData::readBlob(void * ptr, int n)
   {
+    if(readCompact()) {
+      int type, dim;
+      const char * source;
+      size_t len;
+
+      if(!getTag(type, dim))
+        return false;
+
+      if(type != COMPACT_BLOB) {
+        skipCompact(type, dim);
+        return false;
+      }
+
+      if(!getBytes(source, len))
+        return false;
+
+      memcpy(ptr, source, Nimble::Math::Min((size_t) n, len));
+
+      return (size_t) n == len;
+    }
+
     int32_t marker = getRef<int32_t>();
 
     if(marker != BLOB_MARKER) {
@@ -495,6 +931,55 @@ namespace Radiant {
     return n == recv;
   }
 
+  bool BinaryData::readFloat32Array(std::vector<float> & v)
+  {
+    if(readCompact()) {
+      int type, dim;
+      uint64_t n;
+
+      if(!getTag(type, dim))
+        return false;
+
+      if(type != COMPACT_FLOAT_ARRAY) {
+        skipCompact(type, dim);
+        return false;
+      }
+
+      if(!getVarint(n) || n > (m_total - m_current) / 4) {
+        m_current = m_total;
+        return false;
+      }
+
+      v.resize(n);
+      if(n)
+        memcpy( & v[0], getPtr<char>(n * 4), n * 4);
+
+      return true;
+    }
+
+    if(!available(8))
+      return false;
+
+    int32_t marker = getRef<int32_t>();
+
+    if(marker != FLOAT_ARRAY_MARKER) {
+      skipParameter(marker);
+      return false;
+    }
+
+    int32_t n = getRef<int32_t>();
+
+    // n * 4 could wrap around, so compare against the bytes left instead
+    if(n < 0 || (unsigned) n > (m_total - m_current) / 4)
+      return false;
+
+    v.resize(n);
+    if(n)
+      memcpy( & v[0], getPtr<char>(n * 4), n * 4);
+
+    return true;
+  }
+
 #define BD_STR_TO_VEC(type, n, ok) \
   const char * source = & m_buf[m_current]; \
   Radiant::Variant v(source); \
@@ -515,6 +1000,15 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      Nimble::Vector2f v;
+      if(compactVector(v.data(), 2))
+        return v;
+      if(ok)
+        *ok = false;
+      return Nimble::Vector2f(0, 0);
+    }
+
     if(!available(4)) {
       if(ok) * ok = false;
       return Nimble::Vector2f(0, 0);
@@ -570,6 +1064,15 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      Nimble::Vector3f v;
+      if(compactVector(v.data(), 3))
+        return v;
+      if(ok)
+        *ok = false;
+      return Nimble::Vector3f(0, 0, 0);
+    }
+
     if(!available(16)) {
       if(ok) * ok = false;
       return Nimble::Vector3f(0, 0, 0);
@@ -601,6 +1104,15 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      Nimble::Vector2i v;
+      if(compactVector(v.data(), 2))
+        return v;
+      if(ok)
+        *ok = false;
+      return Nimble::Vector2i(0, 0);
+    }
+
     if(!available(12)) {
       if(ok) * ok = false;
       return Nimble::Vector2f(0, 0);
@@ -629,6 +1141,15 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      Nimble::Vector3i v;
+      if(compactVector(v.data(), 3))
+        return v;
+      if(ok)
+        *ok = false;
+      return Nimble::Vector3i(0, 0, 0);
+    }
+
     if(!available(16)) {
       if(ok) * ok = false;
       return Nimble::Vector3f(0, 0, 0);
@@ -657,6 +1178,15 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      Nimble::Vector4i v;
+      if(compactVector(v.data(), 4))
+        return v;
+      if(ok)
+        *ok = false;
+      return Nimble::Vector4i(0, 0, 0, 1);
+    }
+
     if(!available(12)) {
       if(ok) * ok = false;
       return Nimble::Vector4i(0, 0, 0, 1);
@@ -686,6 +1216,15 @@ namespace Radiant {
     if(ok)
       *ok = true;
 
+    if(readCompact()) {
+      Nimble::Vector4f v;
+      if(compactVector(v.data(), 4))
+        return v;
+      if(ok)
+        *ok = false;
+      return Nimble::Vector4f(0, 0, 0, 1);
+    }
+
     if(!available(12)) {
       if(ok) * ok = false;
       return Nimble::Vector4f(0, 0, 0, 1);
@@ -755,24 +1294,18 @@ namespace Radiant {
 
   void BinaryData::linkTo(void * data, int capacity)
   {
-    if(!m_shared && m_buf)
-      free(m_buf);
+    freeBuffer();
 
     m_buf = (char *) data;
     m_size = capacity;
-    m_shared = true;
+    m_storage = STORAGE_LINKED;
   }
 
   void BinaryData::ensure(size_t bytes)
   {
     size_t need = m_current + bytes;
-    if(need > m_size) {
-      if(m_shared)
-    fatal("BinaryData::ensure # Sharing data, cannot ensure required space");
-
-      m_size = need + 128 + need / 16;
-      m_buf = (char *) realloc(m_buf, m_size);
-    }
+    if(need > m_size)
+      grow(need);
     m_total = m_current + bytes;
   }
 
@@ -783,6 +1316,36 @@ namespace Radiant {
     bzero(data(), m_size);
   }
 
+  void BinaryData::swap(BinaryData & that)
+  {
+    // The arena blocks must go back to the arena they came from
+    moveToHeap();
+    that.moveToHeap();
+
+    bool thisInline = m_storage == STORAGE_INLINE;
+    bool thatInline = that.m_storage == STORAGE_INLINE;
+
+    if(thisInline || thatInline) {
+      char tmp[INLINE_BYTES];
+      memcpy(tmp, m_inline, INLINE_BYTES);
+      memcpy(m_inline, that.m_inline, INLINE_BYTES);
+      memcpy(that.m_inline, tmp, INLINE_BYTES);
+    }
+
+    std::swap(m_current, that.m_current);
+    std::swap(m_total, that.m_total);
+    std::swap(m_size, that.m_size);
+    std::swap(m_storage, that.m_storage);
+    std::swap(m_buf, that.m_buf);
+    std::swap(m_format, that.m_format);
+    std::swap(m_readFormat, that.m_readFormat);
+
+    if(thisInline)
+      that.m_buf = that.m_inline;
+    if(thatInline)
+      m_buf = m_inline;
+  }
+
   void BinaryData::skipParameter(int marker)
   {
     if(marker == INT32_MARKER ||
@@ -806,6 +1369,10 @@ namespace Radiant {
       int n = getRef<int32_t>();
       m_current += n;
     }
+    else if(marker == FLOAT_ARRAY_MARKER) {
+      int n = getRef<int32_t>();
+      m_current += n * 4;
+    }
   }
 
   size_t BinaryData::stringSpace(const char * str)
@@ -826,4 +1393,356 @@ namespace Radiant {
            func, m_current, m_total);
   }
 
+  void BinaryData::grow(size_t need)
+  {
+    if(m_storage == STORAGE_LINKED)
+      fatal("BinaryData::ensure # Sharing data, cannot ensure required space");
+
+    size_t size = need + 128 + need / 16;
+
+    if(m_storage == STORAGE_HEAP) {
+      m_buf = (char *) realloc(m_buf, size);
+      m_size = size;
+      return;
+    }
+
+    if(m_storage == STORAGE_ARENA && m_arena->resize(m_buf, m_size, size)) {
+      m_size = size;
+      return;
+    }
+
+    char * buf = m_arena ? (char *) m_arena->allocate(size) : 0;
+    Storage storage = STORAGE_ARENA;
+
+    if(!buf) {
+      buf = (char *) malloc(size);
+      storage = STORAGE_HEAP;
+    }
+
+    memcpy(buf, m_buf, m_size);
+
+    freeBuffer();
+
+    m_buf = buf;
+    m_size = size;
+    m_storage = storage;
+  }
+
+  void BinaryData::freeBuffer()
+  {
+    if(m_storage == STORAGE_HEAP)
+      free(m_buf);
+    else if(m_storage == STORAGE_ARENA)
+      m_arena->release(m_buf, m_size);
+  }
+
+  void BinaryData::moveToHeap()
+  {
+    if(m_storage != STORAGE_ARENA)
+      return;
+
+    char * buf = (char *) malloc(m_size);
+    memcpy(buf, m_buf, m_size);
+
+    freeBuffer();
+
+    m_buf = buf;
+    m_storage = STORAGE_HEAP;
+  }
+
+  void BinaryData::detectFormat()
+  {
+    if(m_total && (unsigned char) m_buf[0] == COMPACT_HEADER) {
+      m_readFormat = FORMAT_COMPACT;
+      m_current = 1;
+    }
+    else
+      m_readFormat = FORMAT_STANDARD;
+  }
+
+  void BinaryData::beginCompact(size_t bytes)
+  {
+    if(m_current == 0) {
+      ensure(bytes + 1);
+      m_buf[m_current++] = (char) COMPACT_HEADER;
+      m_readFormat = FORMAT_COMPACT;
+    }
+    else
+      ensure(bytes);
+  }
+
+  void BinaryData::putTag(int type, int dim)
+  {
+    m_buf[m_current++] = (char) (type | (dim << 4));
+  }
+
+  void BinaryData::putRaw(const void * ptr, size_t bytes)
+  {
+    if(bytes)
+      memcpy( & m_buf[m_current], ptr, bytes);
+    m_current += bytes;
+  }
+
+  void BinaryData::putVarint(uint64_t v)
+  {
+    while(v >= 0x80) {
+      m_buf[m_current++] = (char) (v | 0x80);
+      v >>= 7;
+    }
+    m_buf[m_current++] = (char) v;
+  }
+
+  void BinaryData::putUTF8(uint32_t c)
+  {
+    if(c < 0x80) {
+      m_buf[m_current++] = (char) c;
+      return;
+    }
+
+    if(c > 0x10FFFF)
+      c = 0xFFFD;
+
+    if(c < 0x800) {
+      m_buf[m_current++] = (char) (0xC0 | (c >> 6));
+      m_buf[m_current++] = (char) (0x80 | (c & 0x3F));
+    }
+    else if(c < 0x10000) {
+      m_buf[m_current++] = (char) (0xE0 | (c >> 12));
+      m_buf[m_current++] = (char) (0x80 | ((c >> 6) & 0x3F));
+      m_buf[m_current++] = (char) (0x80 | (c & 0x3F));
+    }
+    else {
+      m_buf[m_current++] = (char) (0xF0 | (c >> 18));
+      m_buf[m_current++] = (char) (0x80 | ((c >> 12) & 0x3F));
+      m_buf[m_current++] = (char) (0x80 | ((c >> 6) & 0x3F));
+      m_buf[m_current++] = (char) (0x80 | (c & 0x3F));
+    }
+  }
+
+  bool BinaryData::getTag(int & type, int & dim)
+  {
+    if(!available(1))
+      return false;
+
+    unsigned char tag = m_buf[m_current++];
+    type = tag & 0xF;
+    dim = tag >> 4;
+
+    return true;
+  }
+
+  bool BinaryData::getVarint(uint64_t & v)
+  {
+    const unsigned char * p = (const unsigned char *) m_buf + m_current;
+    const unsigned char * end = (const unsigned char *) m_buf + m_total;
+
+    // Small values fit in one byte
+    if(p < end && *p < 0x80) {
+      v = *p;
+      m_current++;
+      return true;
+    }
+
+    uint64_t value = 0;
+
+    for(int shift = 0; shift < 64 && p < end; shift += 7) {
+      unsigned char byte = *p++;
+      value |= uint64_t(byte & 0x7F) << shift;
+      if(!(byte & 0x80)) {
+        v = value;
+        m_current = p - (const unsigned char *) m_buf;
+        return true;
+      }
+    }
+
+    unavailable("BinaryData::getVarint");
+    m_current = m_total;
+
+    return false;
+  }
+
+  bool BinaryData::getBytes(const char * & ptr, size_t & bytes)
+  {
+    uint64_t n;
+
+    if(!getVarint(n))
+      return false;
+
+    if(n > m_total - m_current) {
+      unavailable("BinaryData::getBytes");
+      m_current = m_total;
+      return false;
+    }
+
+    ptr = & m_buf[m_current];
+    bytes = n;
+    m_current += n;
+
+    return true;
+  }
+
+  void BinaryData::skip(uint64_t bytes)
+  {
+    if(bytes > m_total - m_current)
+      m_current = m_total;
+    else
+      m_current += bytes;
+  }
+
+  void BinaryData::skipCompact(int type, int dim)
+  {
+    uint64_t n = 0;
+
+    if(type == COMPACT_INT)
+      getVarint(n);
+    else if(type == COMPACT_FLOAT32)
+      skip(4);
+    else if(type == COMPACT_FLOAT64 || type == COMPACT_TIMESTAMP)
+      skip(8);
+    else if(type == COMPACT_STRING || type == COMPACT_WSTRING ||
+            type == COMPACT_BLOB) {
+      if(getVarint(n))
+        skip(n);
+    }
+    else if(type == COMPACT_VECTORF)
+      skip(dim * 4);
+    else if(type == COMPACT_VECTORI) {
+      for(int i = 0; i < dim; i++)
+        getVarint(n);
+    }
+    else if(type == COMPACT_FLOAT_ARRAY) {
+      if(getVarint(n))
+        skip(n * 4);
+    }
+    else {
+      // Unknown type, the rest of the buffer cannot be parsed
+      m_current = m_total;
+    }
+  }
+
+  double BinaryData::compactFloat(int type, int dim, bool * ok)
+  {
+    const char * source;
+    size_t len;
+    uint64_t n;
+
+    if(type == COMPACT_INT) {
+      if(getVarint(n))
+        return double(unZigZag(n));
+    }
+    else if(type == COMPACT_FLOAT32 && available(4)) {
+      float v;
+      memcpy( & v, getPtr<char>(4), 4);
+      return v;
+    }
+    else if(type == COMPACT_FLOAT64 && available(8)) {
+      double v;
+      memcpy( & v, getPtr<char>(8), 8);
+      return v;
+    }
+    else if(type == COMPACT_STRING) {
+      if(getBytes(source, len)) {
+        std::string tmp(source, len);
+        char * end = 0;
+        double d = strtod(tmp.c_str(), & end);
+        if(end != tmp.c_str())
+          return d;
+      }
+    }
+    else
+      skipCompact(type, dim);
+
+    if(ok)
+      *ok = false;
+
+    return 0.0;
+  }
+
+  int64_t BinaryData::compactInt(int type, int dim, bool * ok)
+  {
+    const char * source;
+    size_t len;
+    uint64_t n;
+
+    if(type == COMPACT_INT) {
+      if(getVarint(n))
+        return unZigZag(n);
+    }
+    else if(type == COMPACT_FLOAT32 || type == COMPACT_FLOAT64) {
+      bool good = true;
+      double d = compactFloat(type, dim, & good);
+      if(good)
+        return Nimble::Math::Round(d);
+    }
+    else if(type == COMPACT_STRING) {
+      if(getBytes(source, len)) {
+        std::string tmp(source, len);
+        char * end = 0;
+        long d = strtol(tmp.c_str(), & end, 10);
+        if(end != tmp.c_str())
+          return d;
+      }
+    }
+    else {
+      badmarker("BinaryData::compactInt", type);
+      skipCompact(type, dim);
+    }
+
+    if(ok)
+      *ok = false;
+
+    return 0;
+  }
+
+  template <class T>
+  bool BinaryData::compactVector(T * v, int n)
+  {
+    int type, dim;
+    uint64_t x;
+
+    if(!getTag(type, dim))
+      return false;
+
+    if(type == COMPACT_VECTORF && dim == n && available(n * 4)) {
+      for(int i = 0; i < n; i++) {
+        float f;
+        memcpy( & f, getPtr<char>(4), 4);
+        v[i] = T(f);
+      }
+      return true;
+    }
+    else if(type == COMPACT_VECTORI && dim == n) {
+      for(int i = 0; i < n; i++) {
+        if(!getVarint(x))
+          return false;
+        v[i] = T(unZigZag(x));
+      }
+      return true;
+    }
+    else if(type == COMPACT_STRING) {
+      float tmp[4];
+      if(!compactStringFloats(tmp, n))
+        return false;
+      for(int i = 0; i < n; i++)
+        v[i] = T(tmp[i]);
+      return true;
+    }
+
+    skipCompact(type, dim);
+    return false;
+  }
+
+  bool BinaryData::compactStringFloats(float * v, int n)
+  {
+    const char * source;
+    size_t len;
+
+    if(!getBytes(source, len))
+      return false;
+
+    Radiant::Variant var(std::string(source, len));
+
+    return var.getFloats(v, n) == n;
+  }
+
 }
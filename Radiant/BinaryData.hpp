@@ -25,6 +25,7 @@
 #include <vector>
 
 namespace Radiant {
+  class BinaryArena;
   class BinaryStream;
 }
 
@@ -67,12 +68,42 @@ namespace Radiant {
       false if the operation fails. The boolean is never set to true,
       so you must do that in our own code.
 
+      \b Compact format: With setFormat(FORMAT_COMPACT) the buffer is
+      written in a denser encoding. The first byte of the buffer is a
+      header byte that the reading functions detect automatically. Each
+      value is preceded by a single tag byte instead of the 4-byte
+      marker, integers are stored as zig-zag varints, strings (also wide
+      strings) as UTF-8 and vectors/float arrays as packed 32-bit
+      floats. The compact format is a good choice for network traffic
+      and inter-process messages, the standard format stays the default
+      for OSC compatibility.
+
+      \b Memory: Small messages are stored in a buffer inside the
+      object, so short-lived BinaryData objects usually do not allocate
+      memory at all. Larger buffers come from the heap, or from a
+      BinaryArena if one is given to the constructor. swap() exchanges
+      the contents of two objects without copying heap buffers.
+
   */
 
   class RADIANT_API BinaryData
   {
   public:
+    /// Encoding used when writing data
+    enum Format {
+      /// OSC-like format with 4-byte type markers and 4-byte alignment
+      FORMAT_STANDARD,
+      /// Tag byte per value, varint integers and UTF-8 strings
+      FORMAT_COMPACT
+    };
+
+    /// Size of the buffer inside the object
+    enum { INLINE_BYTES = 64 };
+
     BinaryData();
+    /// Constructs an object that allocates its buffer from the arena
+    /** The arena must outlive the object. */
+    explicit BinaryData(BinaryArena * arena);
     BinaryData(const BinaryData & );
     ~BinaryData();
 
@@ -118,6 +149,9 @@ namespace Radiant {
     /// Writes a 4D 32-bit float vector to the data buffer
     void writeVector4Float32(const Nimble::Vector4f &);
 
+    /// Writes an array of 32-bit floating point numbers to the data buffer
+    void writeFloat32Array(const float * v, int n);
+
     void append(const BinaryData & that);
 
     template <class T> inline T read(bool * ok = 0);
@@ -140,6 +174,8 @@ namespace Radiant {
     bool readWString(std::wstring & str);
     /// Reads a blob of expected size
     bool readBlob(void * ptr, int n);
+    /// Reads an array of 32-bit floating point numbers from the buffer
+    bool readFloat32Array(std::vector<float> & v);
 
     /// Reads a 2D 32-bit floating point vector from the buffer
     Nimble::Vector2f readVector2Float32(bool * ok = 0);
@@ -163,6 +199,13 @@ namespace Radiant {
     /// Rewind the index pointer to the beginning
     inline void rewind() { m_current = 0; }
 
+    /// Sets the encoding used by the writing functions
+    /** The format should be selected before writing anything to the
+        buffer, the reading functions detect the format of the data. */
+    inline void setFormat(Format format) { m_format = format; }
+    /// Returns the encoding used by the writing functions
+    inline Format format() const { return m_format; }
+
     inline int total() const { return m_total; }
     inline void setTotal(int bytes) { m_total = bytes; }
 
@@ -179,8 +222,17 @@ namespace Radiant {
     /// Rewind the buffer and fill it with zeroes
     void clear();
 
+    /// Exchanges the contents of two objects
+    /** Only the buffer pointers are exchanged, unless either of the
+        objects uses the internal buffer. This can be used to hand over
+        a message to another object without copying or allocating.
+        Arena memory never changes owner: a buffer from a BinaryArena
+        is first copied to the heap, and both objects keep their own
+        arenas. */
+    void swap(BinaryData & that);
+
     inline BinaryData & operator = (const BinaryData & that)
-    { rewind(); append(that); return * this;}
+    { rewind(); m_format = that.m_format; append(that); return * this;}
 
   private:
 
@@ -198,11 +250,51 @@ namespace Radiant {
 
     void unavailable(const char * func);
 
+    void grow(size_t bytes);
+    void freeBuffer();
+    void moveToHeap();
+
+    /* Compact format helpers. The reading functions check the header
+       byte when they are at the beginning of the buffer. */
+    inline bool readCompact()
+    { if(m_current == 0) detectFormat(); return m_readFormat == FORMAT_COMPACT; }
+    void detectFormat();
+    void beginCompact(size_t bytes);
+    inline void endCompact() { m_total = m_current; }
+    void putTag(int type, int dim = 0);
+    void putRaw(const void * ptr, size_t bytes);
+    void putVarint(uint64_t v);
+    void putUTF8(uint32_t c);
+
+    bool getTag(int & type, int & dim);
+    bool getVarint(uint64_t & v);
+    bool getBytes(const char * & ptr, size_t & bytes);
+    void skip(uint64_t bytes);
+    void skipCompact(int type, int dim);
+    double compactFloat(int type, int dim, bool * ok);
+    int64_t compactInt(int type, int dim, bool * ok);
+    template <class T>
+    bool compactVector(T * v, int n);
+    bool compactStringFloats(float * v, int n);
+
+    /// Owner of the buffer memory
+    enum Storage {
+      STORAGE_INLINE,
+      STORAGE_HEAP,
+      STORAGE_ARENA,
+      // Memory given with linkTo
+      STORAGE_LINKED
+    };
+
     unsigned m_current;
     unsigned m_total;
     unsigned m_size;
-    bool     m_shared;
+    Storage  m_storage;
     char    *m_buf;
+    BinaryArena * m_arena;
+    Format   m_format;
+    Format   m_readFormat;
+    char     m_inline[INLINE_BYTES];
   };
 
 
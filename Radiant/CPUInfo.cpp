@@ -0,0 +1,121 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#include "CPUInfo.hpp"
+
+#if defined(RADIANT_X86) && defined(__GNUC__)
+#include <cpuid.h>
+#elif defined(RADIANT_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Radiant {
+
+  namespace CPUInfo {
+
+    static unsigned g_disabled = 0;
+
+#ifdef RADIANT_X86
+
+    static void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+    {
+#ifdef _MSC_VER
+      int tmp[4];
+      __cpuidex(tmp, (int) leaf, (int) subleaf);
+      for(int i = 0; i < 4; i++)
+        regs[i] = (unsigned) tmp[i];
+#else
+      __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // Returns the state components the OS saves on context switches
+    static unsigned long long xgetbv()
+    {
+#ifdef _MSC_VER
+      return _xgetbv(0);
+#else
+      unsigned eax, edx;
+      __asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+      return ((unsigned long long) edx << 32) | eax;
+#endif
+    }
+
+    static unsigned detect()
+    {
+      unsigned regs[4];
+      unsigned features = 0;
+
+      cpuid(0, 0, regs);
+      unsigned maxLeaf = regs[0];
+
+      if(maxLeaf < 1)
+        return 0;
+
+      cpuid(1, 0, regs);
+
+      if(regs[3] & (1u << 26))
+        features |= FEATURE_SSE2;
+      if(regs[2] & (1u << 9))
+        features |= FEATURE_SSSE3;
+      if(regs[2] & (1u << 19))
+        features |= FEATURE_SSE41;
+
+      // AVX needs OS support for saving the YMM registers
+      bool osxsave = (regs[2] & (1u << 27)) != 0;
+      bool avx = (regs[2] & (1u << 28)) != 0;
+
+      if(osxsave && avx && maxLeaf >= 7 && (xgetbv() & 0x6) == 0x6) {
+        cpuid(7, 0, regs);
+        if(regs[1] & (1u << 5))
+          features |= FEATURE_AVX2;
+      }
+
+      return features;
+    }
+
+#else
+
+    static unsigned detect()
+    {
+      return 0;
+    }
+
+#endif
+
+    unsigned detectedFeatures()
+    {
+      static unsigned features = detect();
+
+      return features;
+    }
+
+    bool hasFeature(Feature feature)
+    {
+      return (detectedFeatures() & ~g_disabled & feature) != 0;
+    }
+
+    void setDisabledFeatures(unsigned mask)
+    {
+      g_disabled = mask;
+    }
+
+    unsigned disabledFeatures()
+    {
+      return g_disabled;
+    }
+
+  }
+
+}
@@ -0,0 +1,72 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#ifndef RADIANT_CPUINFO_HPP
+#define RADIANT_CPUINFO_HPP
+
+#include <Radiant/Export.hpp>
+
+/* Helpers for writing functions that use instruction set extensions
+   which are selected at run-time. A function marked with
+   RADIANT_TARGET_AVX2 may use AVX2 intrinsics even if the rest of the
+   file is compiled for plain x86, but it must only be called if
+   CPUInfo::hasFeature(CPUInfo::FEATURE_AVX2) returns true. */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define RADIANT_X86 1
+#define RADIANT_TARGET_SSE2  __attribute__((target("sse2")))
+#define RADIANT_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define RADIANT_TARGET_AVX2  __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define RADIANT_X86 1
+#define RADIANT_TARGET_SSE2
+#define RADIANT_TARGET_SSSE3
+#define RADIANT_TARGET_AVX2
+#endif
+
+namespace Radiant {
+
+  /// Run-time detection of CPU features
+  /** The SIMD kernels in the libraries use this to pick the best
+      implementation for the machine. For benchmarking and debugging
+      the features can also be disabled, forcing the code to fall back
+      to the plain C++ implementations. */
+  namespace CPUInfo {
+
+    /// Instruction set extensions
+    enum Feature
+    {
+      FEATURE_SSE2  = 0x1,
+      FEATURE_SSSE3 = 0x2,
+      FEATURE_SSE41 = 0x4,
+      FEATURE_AVX2  = 0x8
+    };
+
+    /// Returns the features that are supported by the CPU and the OS
+    RADIANT_API unsigned detectedFeatures();
+
+    /// Returns true if the feature is supported and not disabled
+    RADIANT_API bool hasFeature(Feature feature);
+
+    /// Disables the given features (bitmask of Feature values)
+    /** Disabled features are reported as missing by hasFeature(). Use
+        zero to enable everything again. */
+    RADIANT_API void setDisabledFeatures(unsigned mask);
+    /// Returns the features that have been disabled
+    RADIANT_API unsigned disabledFeatures();
+
+  }
+
+}
+
+#endif
@@ -23,6 +23,8 @@
 #include <sstream>
 #include <string.h>
 
+#include <sys/stat.h>
+
 #ifdef WIN32
 #include <io.h>
 #include <stdlib.h>
@@ -61,6 +63,20 @@ namespace Radiant
       return getFileLen(file);
     }
 
+    bool getFileInfo(const std::string & filename,
+                     uint64_t & bytes, uint64_t & modified)
+    {
+      struct stat st;
+
+      if(stat(filename.c_str(), & st) != 0)
+        return false;
+
+      bytes = (uint64_t) st.st_size;
+      modified = (uint64_t) st.st_mtime;
+
+      return true;
+    }
+
     bool fileReadable(const char* filename)
     {
       return PlatformUtils::fileReadable(filename);
@@ -18,6 +18,8 @@
 
 #include <fstream>
 
+#include <stdint.h>
+
 #include <Radiant/Export.hpp>
 
 namespace Radiant
@@ -31,6 +33,12 @@ namespace Radiant
     RADIANT_API unsigned long getFileLen(std::ifstream& file);
     RADIANT_API unsigned long getFileLen(const std::string & filename);
 
+    /// Get the size and the last modification time of a file.
+    /** The modification time is in seconds since the UNIX epoch.
+        @return false if the file does not exist */
+    RADIANT_API bool getFileInfo(const std::string & filename,
+                                 uint64_t & bytes, uint64_t & modified);
+
     /// Load a text file.
     /** The contents of the file are returned as a zero-terminated
 	string. The caller is responsible for freeing the memory,
@@ -0,0 +1,55 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#ifndef RADIANT_FUTEX_HPP
+#define RADIANT_FUTEX_HPP
+
+#include <Radiant/Export.hpp>
+
+#include <stdint.h>
+
+namespace Radiant
+{
+
+  /// Waiting on a 32-bit word in memory that is shared between processes
+  /** On Linux these functions map directly to the futex system call,
+      so a sleeping process is woken up with a single system call and
+      no CPU time is used while waiting. On other platforms waiting
+      falls back to polling with short sleeps.
+
+      The typical pattern is that the waiter reads the word, checks its
+      condition, and then waits for the word to change from the value
+      that it read. The waker changes the word (for example by
+      incrementing it) and then calls wake(). This way wake-ups that
+      happen between the check and the wait are not lost. */
+  namespace Futex
+  {
+    /// Waits until the word is different from the expected value
+    /** @param word The shared word
+        @param expected The value that was read by the caller
+        @param timeoutMs Maximum time to wait in milliseconds, negative
+        value waits indefinitely
+        @return false if the wait timed out, true otherwise. A true value
+        does not guarantee that the word has changed, the caller must
+        check its condition again. */
+    RADIANT_API bool wait(volatile uint32_t * word, uint32_t expected,
+                          int timeoutMs);
+
+    /// Wakes up all processes and threads that wait on the word
+    RADIANT_API void wakeAll(volatile uint32_t * word);
+  }
+
+}
+
+#endif
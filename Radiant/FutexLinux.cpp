@@ -0,0 +1,57 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#include "Futex.hpp"
+
+#include <climits>
+#include <cerrno>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace Radiant
+{
+
+  namespace Futex
+  {
+
+    /* The words are in shared memory, so the private (process-local)
+       futex operations cannot be used. */
+
+    bool wait(volatile uint32_t * word, uint32_t expected, int timeoutMs)
+    {
+      struct timespec ts;
+      struct timespec * tsp = 0;
+
+      if(timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        tsp = & ts;
+      }
+
+      long r = syscall(SYS_futex, word, FUTEX_WAIT, expected, tsp, 0, 0);
+
+      return !(r == -1 && errno == ETIMEDOUT);
+    }
+
+    void wakeAll(volatile uint32_t * word)
+    {
+      syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+    }
+
+  }
+
+}
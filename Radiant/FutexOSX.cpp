@@ -0,0 +1,48 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#include "Futex.hpp"
+
+#include "Sleep.hpp"
+#include "TimeStamp.hpp"
+
+namespace Radiant
+{
+
+  namespace Futex
+  {
+
+    /* OSX has no public futex-like system call for shared memory, so
+       this polls the word. */
+
+    bool wait(volatile uint32_t * word, uint32_t expected, int timeoutMs)
+    {
+      TimeStamp start = TimeStamp::getTime();
+
+      while(*word == expected) {
+        if(timeoutMs >= 0 && start.sinceSecondsD() * 1000.0 >= timeoutMs)
+          return false;
+
+        Sleep::sleepUs(200);
+      }
+
+      return true;
+    }
+
+    void wakeAll(volatile uint32_t *)
+    {}
+
+  }
+
+}
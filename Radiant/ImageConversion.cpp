@@ -15,6 +15,8 @@
 
 #include "ImageConversion.hpp"
 
+#include "CPUInfo.hpp"
+#include "ThreadPool.hpp"
 #include "Trace.hpp"
 #include "VideoImage.hpp"
 #include "Types.hpp"
@@ -24,9 +26,16 @@
 
 #include <assert.h>
 
+#ifdef RADIANT_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#endif
+
 namespace Radiant {
 
-  bool ImageConversion::convert(const VideoImage * source, VideoImage * target)
+  bool ImageConversion::convert(const VideoImage * source, VideoImage * target,
+                                BayerDemosaic bayer)
   {
     bool ok = true;
 
@@ -96,7 +105,7 @@ namespace Radiant {
     }
     else if(sourceFmt == IMAGE_RAWBAYER) {
       if(targetFmt == IMAGE_RGB)
-	bayerToRGB(source, target);
+	bayerToRGB(source, target, bayer);
       else if(targetFmt == IMAGE_GRAYSCALE)
 	bayerToGrayscale(source, target);
       else 
@@ -172,6 +181,839 @@ namespace Radiant {
     v = v > 255 ? 255 : v
   */
 
+  /////////////////////////////////////////////////////////////////////////
+  // Line kernels. The SIMD versions return the number of pixels that
+  // they converted and the plain versions take care of the rest.
+
+  /* The fixed-point coefficients of YUV2RGB(). */
+  enum {
+    YUV_RV = 1167,
+    YUV_GV = 595,
+    YUV_GU = 404,
+    YUV_BU = 2080
+  };
+
+  /* Converts pixels [x, w) of one line of planar YUV into RGB (3 bytes
+     per pixel) or RGBA (4 bytes per pixel). One chroma sample covers
+     1 << chromaShift pixels. */
+  static void yuvLine(const uchar * iy, const uchar * iu, const uchar * iv,
+                      uchar * dest, int bytes, int chromaShift, int bias,
+                      long x, long w)
+  {
+    dest += x * bytes;
+
+    for(; x < w; x++) {
+      int r, g, b;
+
+      int u = iu[x >> chromaShift] - bias;
+      int v = iv[x >> chromaShift] - bias;
+
+      YUV2RGB(iy[x], u, v, r, g, b);
+      dest[0] = r;
+      dest[1] = g;
+      dest[2] = b;
+      if(bytes == 4)
+        dest[3] = 0xFF;
+      dest += bytes;
+    }
+  }
+
+  /* Converts pixels [x, w) of one line of GBRG Bayer data to half-size
+     RGB. */
+  static void bayerHalfLine(const uchar * src1, const uchar * src2,
+                            uchar * dest, long x, long w)
+  {
+    src1 += 2 * x;
+    src2 += 2 * x;
+    dest += 3 * x;
+
+    for(; x < w; x++) {
+      uint green = (uint) src1[0] + (uint) src2[1];
+      dest[0] = src2[0];
+      dest[2] = src1[1];
+      dest[1] = green >> 1;
+
+      src1 += 2;
+      src2 += 2;
+      dest += 3;
+    }
+  }
+
+  /* Bilinear demosaic of pixels [x, xend) of one line of GBRG Bayer
+     data. up and down are the neighbouring lines, the columns are
+     mirrored at the image edges, which preserves the colour pattern. */
+  static void bayerBilinearLine(const uchar * up, const uchar * mid,
+                                const uchar * down, uchar * dest,
+                                bool evenRow, long x, long xend, long w)
+  {
+    dest += 3 * x;
+
+    for(; x < xend; x++) {
+      long xl = x ? x - 1 : 1;
+      long xr = (x + 1 < w) ? x + 1 : w - 2;
+
+      uint c = mid[x];
+      uint hor = ((uint) mid[xl] + mid[xr] + 1) >> 1;
+      uint ver = ((uint) up[x] + down[x] + 1) >> 1;
+      uint cross = ((uint) mid[xl] + mid[xr] + up[x] + down[x] + 2) >> 2;
+      uint diag = ((uint) up[xl] + up[xr] + down[xl] + down[xr] + 2) >> 2;
+
+      bool evenCol = (x & 1) == 0;
+
+      if(evenRow) {
+        // G B G B ...
+        dest[0] = evenCol ? ver : diag;
+        dest[1] = evenCol ? c : cross;
+        dest[2] = evenCol ? hor : c;
+      }
+      else {
+        // R G R G ...
+        dest[0] = evenCol ? c : hor;
+        dest[1] = evenCol ? cross : c;
+        dest[2] = evenCol ? diag : ver;
+      }
+
+      dest += 3;
+    }
+  }
+
+#ifdef RADIANT_X86
+
+  /////////////////////////////////////////////////////////////////////////
+  // SSE2/SSSE3
+
+  static inline int load32(const uchar * p)
+  {
+    int v;
+    memcpy( & v, p, 4);
+    return v;
+  }
+
+  /* Computes the red, green and blue terms of YUV2RGB() for eight chroma
+     values (signed 16-bit). The results are bit-exact with YUV2RGB():
+     (v << 6) * 1167 >> 16 == v * 1167 >> 10 and the green term is
+     computed with 32-bit precision. */
+  RADIANT_TARGET_SSE2
+  static inline void yuvTermsSSE2(__m128i u, __m128i v,
+                                  __m128i & rt, __m128i & gt, __m128i & bt)
+  {
+    const __m128i gk = _mm_set1_epi32((YUV_GU << 16) | YUV_GV);
+
+    rt = _mm_mulhi_epi16(_mm_slli_epi16(v, 6), _mm_set1_epi16(YUV_RV));
+    bt = _mm_mulhi_epi16(_mm_slli_epi16(u, 6), _mm_set1_epi16(YUV_BU));
+
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(v, u), gk);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(v, u), gk);
+    gt = _mm_packs_epi32(_mm_srai_epi32(lo, 10), _mm_srai_epi32(hi, 10));
+  }
+
+  /* Computes the chroma terms of 16 pixels, t[0-1] red, t[2-3] green
+     and t[4-5] blue, pixels 0-7 and 8-15. */
+  RADIANT_TARGET_SSE2
+  static inline void chromaTermsSSE2(const uchar * iu, const uchar * iv,
+                                     int chromaShift, __m128i bias,
+                                     __m128i * t)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i u, v;
+
+    if(chromaShift == 1) {
+      u = _mm_loadl_epi64((const __m128i *) iu);
+      v = _mm_loadl_epi64((const __m128i *) iv);
+    }
+    else {
+      u = _mm_cvtsi32_si128(load32(iu));
+      v = _mm_cvtsi32_si128(load32(iv));
+    }
+
+    u = _mm_sub_epi16(_mm_unpacklo_epi8(u, zero), bias);
+    v = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias);
+
+    __m128i terms[3];
+    yuvTermsSSE2(u, v, terms[0], terms[1], terms[2]);
+
+    for(int i = 0; i < 3; i++) {
+      __m128i c = terms[i];
+      if(chromaShift == 2)
+        c = _mm_unpacklo_epi16(c, c);
+      t[2 * i] = _mm_unpacklo_epi16(c, c);
+      t[2 * i + 1] = _mm_unpackhi_epi16(c, c);
+    }
+  }
+
+  /* Adds the chroma terms to 16 luma values, saturating to 0-255. */
+  RADIANT_TARGET_SSE2
+  static inline void yuvPixelsSSE2(__m128i y, const __m128i * t,
+                                   __m128i & r, __m128i & g, __m128i & b)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ylo = _mm_unpacklo_epi8(y, zero);
+    __m128i yhi = _mm_unpackhi_epi8(y, zero);
+
+    r = _mm_packus_epi16(_mm_add_epi16(ylo, t[0]), _mm_add_epi16(yhi, t[1]));
+    g = _mm_packus_epi16(_mm_sub_epi16(ylo, t[2]), _mm_sub_epi16(yhi, t[3]));
+    b = _mm_packus_epi16(_mm_add_epi16(ylo, t[4]), _mm_add_epi16(yhi, t[5]));
+  }
+
+  /* Interleaves 16 pixels into four RGBA vectors. */
+  RADIANT_TARGET_SSE2
+  static inline void interleaveSSE2(__m128i r, __m128i g, __m128i b,
+                                    __m128i a, __m128i * p)
+  {
+    __m128i rg0 = _mm_unpacklo_epi8(r, g);
+    __m128i rg1 = _mm_unpackhi_epi8(r, g);
+    __m128i ba0 = _mm_unpacklo_epi8(b, a);
+    __m128i ba1 = _mm_unpackhi_epi8(b, a);
+
+    p[0] = _mm_unpacklo_epi16(rg0, ba0);
+    p[1] = _mm_unpackhi_epi16(rg0, ba0);
+    p[2] = _mm_unpacklo_epi16(rg1, ba1);
+    p[3] = _mm_unpackhi_epi16(rg1, ba1);
+  }
+
+  /* Drops the fourth byte of the RGBA pixels, leaving 48 bytes of RGB
+     in three vectors. */
+  RADIANT_TARGET_SSSE3
+  static inline void packRGBSSSE3(const __m128i * p, __m128i * o)
+  {
+    const __m128i pick = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                       12, 13, 14, -1, -1, -1, -1);
+    __m128i p0 = _mm_shuffle_epi8(p[0], pick);
+    __m128i p1 = _mm_shuffle_epi8(p[1], pick);
+    __m128i p2 = _mm_shuffle_epi8(p[2], pick);
+    __m128i p3 = _mm_shuffle_epi8(p[3], pick);
+
+    o[0] = _mm_or_si128(p0, _mm_slli_si128(p1, 12));
+    o[1] = _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8));
+    o[2] = _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4));
+  }
+
+  RADIANT_TARGET_SSSE3
+  static inline void storeRGBSSSE3(uchar * dest, __m128i r, __m128i g,
+                                   __m128i b)
+  {
+    __m128i p[4], o[3];
+    interleaveSSE2(r, g, b, _mm_setzero_si128(), p);
+    packRGBSSSE3(p, o);
+
+    _mm_storeu_si128((__m128i *) dest, o[0]);
+    _mm_storeu_si128((__m128i *) (dest + 16), o[1]);
+    _mm_storeu_si128((__m128i *) (dest + 32), o[2]);
+  }
+
+  RADIANT_TARGET_SSE2
+  static long yuvLineRGBASSE2(const uchar * iy, const uchar * iu,
+                              const uchar * iv, uchar * dest,
+                              int chromaShift, int bias, long w)
+  {
+    const __m128i alpha = _mm_set1_epi8((char) 0xFF);
+    const __m128i b16 = _mm_set1_epi16(bias);
+    long x = 0;
+
+    for(; x + 16 <= w; x += 16) {
+      __m128i t[6], r, g, b, p[4];
+
+      chromaTermsSSE2(iu + (x >> chromaShift), iv + (x >> chromaShift),
+                      chromaShift, b16, t);
+      yuvPixelsSSE2(_mm_loadu_si128((const __m128i *) (iy + x)), t, r, g, b);
+      interleaveSSE2(r, g, b, alpha, p);
+
+      uchar * d = dest + 4 * x;
+      _mm_storeu_si128((__m128i *) d, p[0]);
+      _mm_storeu_si128((__m128i *) (d + 16), p[1]);
+      _mm_storeu_si128((__m128i *) (d + 32), p[2]);
+      _mm_storeu_si128((__m128i *) (d + 48), p[3]);
+    }
+
+    return x;
+  }
+
+  RADIANT_TARGET_SSSE3
+  static long yuvLineRGBSSSE3(const uchar * iy, const uchar * iu,
+                              const uchar * iv, uchar * dest,
+                              int chromaShift, int bias, long w)
+  {
+    const __m128i b16 = _mm_set1_epi16(bias);
+    long x = 0;
+
+    for(; x + 16 <= w; x += 16) {
+      __m128i t[6], r, g, b;
+
+      chromaTermsSSE2(iu + (x >> chromaShift), iv + (x >> chromaShift),
+                      chromaShift, b16, t);
+      yuvPixelsSSE2(_mm_loadu_si128((const __m128i *) (iy + x)), t, r, g, b);
+      storeRGBSSSE3(dest + 3 * x, r, g, b);
+    }
+
+    return x;
+  }
+
+  RADIANT_TARGET_SSSE3
+  static long bayerHalfLineSSSE3(const uchar * src1, const uchar * src2,
+                                 uchar * dest, long w)
+  {
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    long x = 0;
+
+    // 32 source bytes per line -> 16 destination pixels
+    for(; x + 16 <= w; x += 16) {
+      // The first line holds G B pairs, the second one R G pairs
+      __m128i a0 = _mm_loadu_si128((const __m128i *) (src1 + 2 * x));
+      __m128i a1 = _mm_loadu_si128((const __m128i *) (src1 + 2 * x + 16));
+      __m128i b0 = _mm_loadu_si128((const __m128i *) (src2 + 2 * x));
+      __m128i b1 = _mm_loadu_si128((const __m128i *) (src2 + 2 * x + 16));
+
+      __m128i r = _mm_packus_epi16(_mm_and_si128(b0, mask),
+                                   _mm_and_si128(b1, mask));
+      __m128i b = _mm_packus_epi16(_mm_srli_epi16(a0, 8),
+                                   _mm_srli_epi16(a1, 8));
+      __m128i g0 = _mm_add_epi16(_mm_and_si128(a0, mask),
+                                 _mm_srli_epi16(b0, 8));
+      __m128i g1 = _mm_add_epi16(_mm_and_si128(a1, mask),
+                                 _mm_srli_epi16(b1, 8));
+      __m128i g = _mm_packus_epi16(_mm_srli_epi16(g0, 1),
+                                   _mm_srli_epi16(g1, 1));
+
+      storeRGBSSSE3(dest + 3 * x, r, g, b);
+    }
+
+    return x;
+  }
+
+  /* Rounded average of four 16-byte vectors, (a + b + c + d + 2) >> 2. */
+  RADIANT_TARGET_SSE2
+  static inline __m128i average4SSE2(__m128i a, __m128i b,
+                                     __m128i c, __m128i d)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+
+    __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                             _mm_unpacklo_epi8(b, zero)),
+                               _mm_add_epi16(_mm_unpacklo_epi8(c, zero),
+                                             _mm_unpacklo_epi8(d, zero)));
+    __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                             _mm_unpackhi_epi8(b, zero)),
+                               _mm_add_epi16(_mm_unpackhi_epi8(c, zero),
+                                             _mm_unpackhi_epi8(d, zero)));
+
+    return _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo, two), 2),
+                            _mm_srli_epi16(_mm_add_epi16(hi, two), 2));
+  }
+
+  RADIANT_TARGET_SSE2
+  static inline __m128i selectSSE2(__m128i mask, __m128i a, __m128i b)
+  {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+  }
+
+  /* Bilinear demosaic of one line, starting from pixel 2 so that the
+     left neighbours exist and the even pixels fall on even bytes. */
+  RADIANT_TARGET_SSSE3
+  static long bayerBilinearLineSSSE3(const uchar * up, const uchar * mid,
+                                     const uchar * down, uchar * dest,
+                                     bool evenRow, long w)
+  {
+    const __m128i even = _mm_set1_epi16(0x00FF);
+    long x = 2;
+
+    for(; x + 17 <= w; x += 16) {
+      __m128i c  = _mm_loadu_si128((const __m128i *) (mid + x));
+      __m128i l  = _mm_loadu_si128((const __m128i *) (mid + x - 1));
+      __m128i rr = _mm_loadu_si128((const __m128i *) (mid + x + 1));
+      __m128i u  = _mm_loadu_si128((const __m128i *) (up + x));
+      __m128i ul = _mm_loadu_si128((const __m128i *) (up + x - 1));
+      __m128i ur = _mm_loadu_si128((const __m128i *) (up + x + 1));
+      __m128i d  = _mm_loadu_si128((const __m128i *) (down + x));
+      __m128i dl = _mm_loadu_si128((const __m128i *) (down + x - 1));
+      __m128i dr = _mm_loadu_si128((const __m128i *) (down + x + 1));
+
+      // _mm_avg_epu8 rounds the same way as the plain code
+      __m128i hor = _mm_avg_epu8(l, rr);
+      __m128i ver = _mm_avg_epu8(u, d);
+      __m128i cross = average4SSE2(l, rr, u, d);
+      __m128i diag = average4SSE2(ul, ur, dl, dr);
+
+      __m128i r, g, b;
+
+      if(evenRow) {
+        r = selectSSE2(even, ver, diag);
+        g = selectSSE2(even, c, cross);
+        b = selectSSE2(even, hor, c);
+      }
+      else {
+        r = selectSSE2(even, c, hor);
+        g = selectSSE2(even, cross, c);
+        b = selectSSE2(even, diag, ver);
+      }
+
+      storeRGBSSSE3(dest + 3 * x, r, g, b);
+    }
+
+    return x;
+  }
+
+  /////////////////////////////////////////////////////////////////////////
+  // AVX2. The 256-bit versions run the SSE algorithms in both 128-bit
+  // lanes, the low lane handles pixels 0-15 and the high lane 16-31.
+
+  RADIANT_TARGET_AVX2
+  static inline __m256i loadLanesAVX2(const uchar * lo, const uchar * hi,
+                                      int chromaShift)
+  {
+    __m128i a, b;
+
+    if(chromaShift == 1) {
+      a = _mm_loadl_epi64((const __m128i *) lo);
+      b = _mm_loadl_epi64((const __m128i *) hi);
+    }
+    else {
+      a = _mm_cvtsi32_si128(load32(lo));
+      b = _mm_cvtsi32_si128(load32(hi));
+    }
+
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+  }
+
+  RADIANT_TARGET_AVX2
+  static inline void chromaTermsAVX2(const uchar * iu, const uchar * iv,
+                                     int chromaShift, __m256i bias,
+                                     __m256i * t)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i gk = _mm256_set1_epi32((YUV_GU << 16) | YUV_GV);
+
+    // Chroma samples of pixels 16-31
+    int half = 16 >> chromaShift;
+
+    __m256i u = loadLanesAVX2(iu, iu + half, chromaShift);
+    __m256i v = loadLanesAVX2(iv, iv + half, chromaShift);
+
+    u = _mm256_sub_epi16(_mm256_unpacklo_epi8(u, zero), bias);
+    v = _mm256_sub_epi16(_mm256_unpacklo_epi8(v, zero), bias);
+
+    __m256i terms[3];
+    terms[0] = _mm256_mulhi_epi16(_mm256_slli_epi16(v, 6),
+                                  _mm256_set1_epi16(YUV_RV));
+    terms[2] = _mm256_mulhi_epi16(_mm256_slli_epi16(u, 6),
+                                  _mm256_set1_epi16(YUV_BU));
+
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(v, u), gk);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(v, u), gk);
+    terms[1] = _mm256_packs_epi32(_mm256_srai_epi32(lo, 10),
+                                  _mm256_srai_epi32(hi, 10));
+
+    for(int i = 0; i < 3; i++) {
+      __m256i c = terms[i];
+      if(chromaShift == 2)
+        c = _mm256_unpacklo_epi16(c, c);
+      t[2 * i] = _mm256_unpacklo_epi16(c, c);
+      t[2 * i + 1] = _mm256_unpackhi_epi16(c, c);
+    }
+  }
+
+  RADIANT_TARGET_AVX2
+  static inline void yuvPixelsAVX2(__m256i y, const __m256i * t,
+                                   __m256i & r, __m256i & g, __m256i & b)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i ylo = _mm256_unpacklo_epi8(y, zero);
+    __m256i yhi = _mm256_unpackhi_epi8(y, zero);
+
+    r = _mm256_packus_epi16(_mm256_add_epi16(ylo, t[0]),
+                            _mm256_add_epi16(yhi, t[1]));
+    g = _mm256_packus_epi16(_mm256_sub_epi16(ylo, t[2]),
+                            _mm256_sub_epi16(yhi, t[3]));
+    b = _mm256_packus_epi16(_mm256_add_epi16(ylo, t[4]),
+                            _mm256_add_epi16(yhi, t[5]));
+  }
+
+  RADIANT_TARGET_AVX2
+  static inline void interleaveAVX2(__m256i r, __m256i g, __m256i b,
+                                    __m256i a, __m256i * p)
+  {
+    __m256i rg0 = _mm256_unpacklo_epi8(r, g);
+    __m256i rg1 = _mm256_unpackhi_epi8(r, g);
+    __m256i ba0 = _mm256_unpacklo_epi8(b, a);
+    __m256i ba1 = _mm256_unpackhi_epi8(b, a);
+
+    p[0] = _mm256_unpacklo_epi16(rg0, ba0);
+    p[1] = _mm256_unpackhi_epi16(rg0, ba0);
+    p[2] = _mm256_unpacklo_epi16(rg1, ba1);
+    p[3] = _mm256_unpackhi_epi16(rg1, ba1);
+  }
+
+  RADIANT_TARGET_AVX2
+  static inline void storeRGBAAVX2(uchar * dest, __m256i r, __m256i g,
+                                   __m256i b, __m256i a)
+  {
+    __m256i p[4];
+    interleaveAVX2(r, g, b, a, p);
+
+    _mm256_storeu_si256((__m256i *) dest,
+                        _mm256_permute2x128_si256(p[0], p[1], 0x20));
+    _mm256_storeu_si256((__m256i *) (dest + 32),
+                        _mm256_permute2x128_si256(p[2], p[3], 0x20));
+    _mm256_storeu_si256((__m256i *) (dest + 64),
+                        _mm256_permute2x128_si256(p[0], p[1], 0x31));
+    _mm256_storeu_si256((__m256i *) (dest + 96),
+                        _mm256_permute2x128_si256(p[2], p[3], 0x31));
+  }
+
+  RADIANT_TARGET_AVX2
+  static inline void storeRGBAVX2(uchar * dest, __m256i r, __m256i g,
+                                  __m256i b)
+  {
+    const __m256i pick = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                          12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                          12, 13, 14, -1, -1, -1, -1);
+    __m256i p[4];
+    interleaveAVX2(r, g, b, _mm256_setzero_si256(), p);
+
+    for(int i = 0; i < 4; i++)
+      p[i] = _mm256_shuffle_epi8(p[i], pick);
+
+    // 48 bytes per lane
+    __m256i o0 = _mm256_or_si256(p[0], _mm256_slli_si256(p[1], 12));
+    __m256i o1 = _mm256_or_si256(_mm256_srli_si256(p[1], 4),
+                                 _mm256_slli_si256(p[2], 8));
+    __m256i o2 = _mm256_or_si256(_mm256_srli_si256(p[2], 8),
+                                 _mm256_slli_si256(p[3], 4));
+
+    _mm256_storeu_si256((__m256i *) dest,
+                        _mm256_permute2x128_si256(o0, o1, 0x20));
+    _mm256_storeu_si256((__m256i *) (dest + 32),
+                        _mm256_permute2x128_si256(o2, o0, 0x30));
+    _mm256_storeu_si256((__m256i *) (dest + 64),
+                        _mm256_permute2x128_si256(o1, o2, 0x31));
+  }
+
+  RADIANT_TARGET_AVX2
+  static long yuvLineAVX2(const uchar * iy, const uchar * iu,
+                          const uchar * iv, uchar * dest, int bytes,
+                          int chromaShift, int bias, long w)
+  {
+    const __m256i alpha = _mm256_set1_epi8((char) 0xFF);
+    const __m256i b16 = _mm256_set1_epi16(bias);
+    long x = 0;
+
+    for(; x + 32 <= w; x += 32) {
+      __m256i t[6], r, g, b;
+
+      chromaTermsAVX2(iu + (x >> chromaShift), iv + (x >> chromaShift),
+                      chromaShift, b16, t);
+      yuvPixelsAVX2(_mm256_loadu_si256((const __m256i *) (iy + x)),
+                    t, r, g, b);
+
+      if(bytes == 4)
+        storeRGBAAVX2(dest + 4 * x, r, g, b, alpha);
+      else
+        storeRGBAVX2(dest + 3 * x, r, g, b);
+    }
+
+    return x;
+  }
+
+  RADIANT_TARGET_AVX2
+  static inline __m256i average4AVX2(__m256i a, __m256i b,
+                                     __m256i c, __m256i d)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i two = _mm256_set1_epi16(2);
+
+    __m256i lo = _mm256_add_epi16(
+        _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero),
+                         _mm256_unpacklo_epi8(b, zero)),
+        _mm256_add_epi16(_mm256_unpacklo_epi8(c, zero),
+                         _mm256_unpacklo_epi8(d, zero)));
+    __m256i hi = _mm256_add_epi16(
+        _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero),
+                         _mm256_unpackhi_epi8(b, zero)),
+        _mm256_add_epi16(_mm256_unpackhi_epi8(c, zero),
+                         _mm256_unpackhi_epi8(d, zero)));
+
+    return _mm256_packus_epi16(
+        _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2),
+        _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2));
+  }
+
+  RADIANT_TARGET_AVX2
+  static long bayerBilinearLineAVX2(const uchar * up, const uchar * mid,
+                                    const uchar * down, uchar * dest,
+                                    bool evenRow, long w)
+  {
+    const __m256i even = _mm256_set1_epi16(0x00FF);
+    long x = 2;
+
+    for(; x + 33 <= w; x += 32) {
+      __m256i c  = _mm256_loadu_si256((const __m256i *) (mid + x));
+      __m256i l  = _mm256_loadu_si256((const __m256i *) (mid + x - 1));
+      __m256i rr = _mm256_loadu_si256((const __m256i *) (mid + x + 1));
+      __m256i u  = _mm256_loadu_si256((const __m256i *) (up + x));
+      __m256i ul = _mm256_loadu_si256((const __m256i *) (up + x - 1));
+      __m256i ur = _mm256_loadu_si256((const __m256i *) (up + x + 1));
+      __m256i d  = _mm256_loadu_si256((const __m256i *) (down + x));
+      __m256i dl = _mm256_loadu_si256((const __m256i *) (down + x - 1));
+      __m256i dr = _mm256_loadu_si256((const __m256i *) (down + x + 1));
+
+      __m256i hor = _mm256_avg_epu8(l, rr);
+      __m256i ver = _mm256_avg_epu8(u, d);
+      __m256i cross = average4AVX2(l, rr, u, d);
+      __m256i diag = average4AVX2(ul, ur, dl, dr);
+
+      __m256i r, g, b;
+
+      if(evenRow) {
+        r = _mm256_blendv_epi8(diag, ver, even);
+        g = _mm256_blendv_epi8(cross, c, even);
+        b = _mm256_blendv_epi8(c, hor, even);
+      }
+      else {
+        r = _mm256_blendv_epi8(hor, c, even);
+        g = _mm256_blendv_epi8(c, cross, even);
+        b = _mm256_blendv_epi8(ver, diag, even);
+      }
+
+      storeRGBAVX2(dest + 3 * x, r, g, b);
+    }
+
+    return x;
+  }
+
+#endif
+
+  /* A conversion that is done one line at a time, so that bands of
+     lines can be converted independently. */
+  struct LineConversion
+  {
+    enum Kind {
+      NONE,
+      YUV_PLANAR,
+      BAYER_HALF_SIZE,
+      BAYER_BILINEAR
+    };
+
+    LineConversion()
+      : kind(NONE), source(0), target(0), bytes(0), chromaShift(0),
+      chromaLineShift(0), bias(0), lines(0), align(1)
+    {}
+
+    Kind kind;
+    const VideoImage * source;
+    VideoImage * target;
+
+    // Planar YUV parameters
+    int bytes;
+    int chromaShift;
+    int chromaLineShift;
+    int bias;
+
+    // Number of target lines, and the alignment of band boundaries
+    long lines;
+    long align;
+  };
+
+  /* Prepares the conversion from planar YUV to RGB or RGBA, and sets up
+     the target image. */
+  static void setupYUVPlanar(LineConversion & conv,
+                             const VideoImage * source, VideoImage * target,
+                             ImageFormat format, int chromaShift,
+                             int chromaLineShift, int bias)
+  {
+    long w = source->m_width;
+    long h = source->m_height;
+    int bytes = (format == IMAGE_RGBA) ? 4 : 3;
+
+    target->m_width  = w;
+    target->m_height = h;
+    target->m_format = format;
+    target->m_planes[0].m_linesize = w * bytes;
+    target->m_planes[0].m_type = (format == IMAGE_RGBA) ? PLANE_RGBA : PLANE_RGB;
+
+    assert(target->m_planes[0].m_data);
+
+    conv.kind = LineConversion::YUV_PLANAR;
+    conv.source = source;
+    conv.target = target;
+    conv.bytes = bytes;
+    conv.chromaShift = chromaShift;
+    conv.chromaLineShift = chromaLineShift;
+    conv.bias = bias;
+    conv.lines = h;
+    // Keep the lines that share chroma in the same band
+    conv.align = 1 << chromaLineShift;
+  }
+
+  static void setupBayerHalfSize(LineConversion & conv,
+                                 const VideoImage * source,
+                                 VideoImage * target)
+  {
+    long w = source->m_width / 2;
+    long h = source->m_height / 2;
+
+    target->m_width  = w;
+    target->m_height = h;
+    target->m_format = IMAGE_RGB;
+    target->m_planes[0].m_linesize = 3 * w;
+
+    conv.kind = LineConversion::BAYER_HALF_SIZE;
+    conv.source = source;
+    conv.target = target;
+    conv.lines = h;
+  }
+
+  static void setupBayerBilinear(LineConversion & conv,
+                                 const VideoImage * source,
+                                 VideoImage * target)
+  {
+    long w = source->m_width;
+    long h = source->m_height;
+
+    target->m_width  = w;
+    target->m_height = h;
+    target->m_format = IMAGE_RGB;
+    target->m_planes[0].m_linesize = 3 * w;
+    target->m_planes[0].m_type = PLANE_RGB;
+
+    assert(target->m_planes[0].m_data);
+
+    conv.kind = LineConversion::BAYER_BILINEAR;
+    conv.source = source;
+    conv.target = target;
+    // The demosaicing needs at least two lines and columns
+    conv.lines = (w < 2 || h < 2) ? 0 : h;
+    // Keep the Bayer pattern in step with the band boundaries
+    conv.align = 2;
+  }
+
+  /* Converts the target lines [y0, y1). */
+  static void convertLines(const LineConversion & conv, long y0, long y1)
+  {
+    const VideoImage * source = conv.source;
+    VideoImage * target = conv.target;
+
+#ifdef RADIANT_X86
+    using Radiant::CPUInfo::hasFeature;
+
+    const bool avx2 = hasFeature(CPUInfo::FEATURE_AVX2);
+    const bool ssse3 = hasFeature(CPUInfo::FEATURE_SSSE3);
+    const bool sse2 = hasFeature(CPUInfo::FEATURE_SSE2);
+#endif
+
+    if(conv.kind == LineConversion::YUV_PLANAR) {
+
+      long w = source->m_width;
+      int bytes = conv.bytes;
+      int chromaShift = conv.chromaShift;
+      int bias = conv.bias;
+
+      for(long l = y0; l < y1; l++) {
+
+        uchar * dest = target->m_planes[0].line(l);
+
+        const uchar * iy = source->m_planes[0].line(l);
+        const uchar * iu = source->m_planes[1].line(l >> conv.chromaLineShift);
+        const uchar * iv = source->m_planes[2].line(l >> conv.chromaLineShift);
+
+        long x = 0;
+
+#ifdef RADIANT_X86
+        if(avx2)
+          x = yuvLineAVX2(iy, iu, iv, dest, bytes, chromaShift, bias, w);
+        else if(bytes == 4 && sse2)
+          x = yuvLineRGBASSE2(iy, iu, iv, dest, chromaShift, bias, w);
+        else if(bytes == 3 && ssse3)
+          x = yuvLineRGBSSSE3(iy, iu, iv, dest, chromaShift, bias, w);
+#endif
+
+        yuvLine(iy, iu, iv, dest, bytes, chromaShift, bias, x, w);
+      }
+    }
+    else if(conv.kind == LineConversion::BAYER_HALF_SIZE) {
+
+      long lw = source->m_planes[0].m_linesize;
+      long w = target->m_width;
+
+      const uchar * src = source->m_planes[0].m_data;
+
+      for(long y = y0; y < y1; y++) {
+
+        const uchar * src1 = & src[y * 2 * lw];
+        const uchar * src2 = src1 + lw;
+        uchar * dest = target->m_planes[0].m_data + 3 * w * y;
+
+        long x = 0;
+
+#ifdef RADIANT_X86
+        if(ssse3)
+          x = bayerHalfLineSSSE3(src1, src2, dest, w);
+#endif
+
+        bayerHalfLine(src1, src2, dest, x, w);
+      }
+    }
+    else if(conv.kind == LineConversion::BAYER_BILINEAR) {
+
+      long lw = source->m_planes[0].m_linesize;
+      long w = source->m_width;
+      long h = source->m_height;
+
+      const uchar * src = source->m_planes[0].m_data;
+
+      for(long y = y0; y < y1; y++) {
+
+        // Mirror the lines at the top and bottom edges
+        long yu = y ? y - 1 : 1;
+        long yd = (y + 1 < h) ? y + 1 : h - 2;
+
+        const uchar * up = src + yu * lw;
+        const uchar * mid = src + y * lw;
+        const uchar * down = src + yd * lw;
+        uchar * dest = target->m_planes[0].line(y);
+
+        bool evenRow = (y & 1) == 0;
+
+        long x = 0;
+
+#ifdef RADIANT_X86
+        if(avx2)
+          x = bayerBilinearLineAVX2(up, mid, down, dest, evenRow, w);
+        else if(ssse3)
+          x = bayerBilinearLineSSSE3(up, mid, down, dest, evenRow, w);
+#endif
+
+        if(x) {
+          // The SIMD code starts from the third pixel
+          bayerBilinearLine(up, mid, down, dest, evenRow, 0, 2, w);
+          bayerBilinearLine(up, mid, down, dest, evenRow, x, w, w);
+        }
+        else
+          bayerBilinearLine(up, mid, down, dest, evenRow, 0, w, w);
+      }
+    }
+  }
+
+  /* Runs a line conversion in bands on a thread pool. */
+  class BandJob : public ThreadPool::Job
+  {
+  public:
+    BandJob(const LineConversion & conv, long band)
+      : m_conv(conv), m_band(band)
+    {}
+
+    virtual void runItem(int index)
+    {
+      long y0 = index * m_band;
+      long y1 = y0 + m_band;
+      convertLines(m_conv, y0, y1 < m_conv.lines ? y1 : m_conv.lines);
+    }
+
+  private:
+    const LineConversion & m_conv;
+    long m_band;
+  };
+
   /* This function contains code copied from the Coriander. */
   void ImageConversion::YUV411ToRGB
   (const VideoImage *, VideoImage *)
@@ -214,142 +1056,17 @@ namespace Radiant {
   void ImageConversion::YUV411PToRGB
   (const VideoImage * source, VideoImage * target)
   {
-    long w = source->m_width;
-    long h = source->m_height;
-
-    target->m_width  = w;
-    target->m_height = h;
-    target->m_format = IMAGE_RGB;
-    target->m_planes[0].m_linesize = w;
-    target->m_planes[0].m_type = PLANE_RGB;
-  
-    assert(target->m_planes[0].m_data);
-
-    uchar * dest = target->m_planes[0].m_data;
-
-    for(long l = 0; l < h; l++) {
-
-      const uchar * iy = source->m_planes[0].line(l);
-      const uchar * iu = source->m_planes[1].line(l);
-      const uchar * iv = source->m_planes[2].line(l);
-
-      const uchar * sentinel = iy + w;
-
-      while(iy < sentinel) {
-
-	int r, g, b;
-      
-	int u = *iu++;
-	int v = *iv++;
-
-	int y = *iy++;
-
-	u -= 127;
-	v -= 127;
-
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest += 3;
-
-	y = *iy++;
-
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest += 3;
-
-	y = *iy++;
-
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest += 3;
-
-	y = *iy++;
-
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest += 3;
-      }
-    }
-  
+    LineConversion conv;
+    setupYUVPlanar(conv, source, target, IMAGE_RGB, 2, 0, 127);
+    convertLines(conv, 0, conv.lines);
   }
 
   void ImageConversion::YUV411PToRGBA
   (const VideoImage * source, VideoImage * target)
   {
-    long w = source->m_width;
-    long h = source->m_height;
-
-    target->m_width  = w;
-    target->m_height = h;
-    target->m_format = IMAGE_RGBA;
-    target->m_planes[0].m_linesize = w;
-    target->m_planes[0].m_type = PLANE_RGBA;
-  
-    assert(target->m_planes[0].m_data);
-
-    uchar * dest = target->m_planes[0].m_data;
-
-    for(long l = 0; l < h; l++) {
-
-      const uchar * iy = source->m_planes[0].line(l);
-      const uchar * iu = source->m_planes[1].line(l);
-      const uchar * iv = source->m_planes[2].line(l);
-
-      const uchar * sentinel = iy + w;
-
-      while(iy < sentinel) {
-
-	int r, g, b;
-      
-	int u = *iu++;
-	int v = *iv++;
-
-	int y = *iy++;
-
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest[3] = 0xFF;
-	dest += 4;
-
-	y = *iy++;
-
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest[3] = 0xFF;
-	dest += 4;
-
-	y = *iy++;
-
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest[3] = 0xFF;
-	dest += 4;
-
-	y = *iy++;
-
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest[3] = 0xFF;
-	dest += 4;
-      }
-    }
-  
+    LineConversion conv;
+    setupYUVPlanar(conv, source, target, IMAGE_RGBA, 2, 0, 127);
+    convertLines(conv, 0, conv.lines);
   }
 
   /**  */
@@ -408,210 +1125,25 @@ namespace Radiant {
   void ImageConversion::YUV420PToRGBA
   (const VideoImage * source, VideoImage * target)
   {
-    long w = source->m_width;
-    long h = source->m_height;
-
-    target->m_width  = w;
-    target->m_height = h;
-    target->m_format = IMAGE_RGBA;
-    target->m_planes[0].m_linesize = w * 4;
-    target->m_planes[0].m_type = PLANE_RGBA;
-
-    assert(target->m_planes[0].m_data);
-
-
-    /* Convert  the image two lines at a time (2x2 macroblocks). */
-
-    for(long l = 0; l < h; l += 2) {
-
-      uchar * dest1 = target->m_planes[0].line(l);
-      uchar * dest2 = target->m_planes[0].line(l + 1);
-
-      long l2 = l / 2;
-
-      const uchar * iy1 = source->m_planes[0].line(l);
-      const uchar * iy2 = source->m_planes[0].line(l + 1);
-      const uchar * iu  = source->m_planes[1].line(l2);
-      const uchar * iv  = source->m_planes[2].line(l2);
-
-      const uchar * sentinel = iy1 + w;
-
-      while(iy1 < sentinel) {
-
-	int r, g, b;
-      
-	int u = *iu++;
-	int v = *iv++;
-
-	u -= 128;
-	v -= 128;
-
-	int y = *iy1++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest1[0] = r;
-	dest1[1] = g;
-	dest1[2] = b;
-	dest1[3] = 0xFF;
-	dest1 += 4;
-
-	y = *iy1++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest1[0] = r;
-	dest1[1] = g;
-	dest1[2] = b;
-	dest1[3] = 0xFF;
-	dest1 += 4;
-
-	y = *iy2++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest2[0] = r;
-	dest2[1] = g;
-	dest2[2] = b;
-	dest2[3] = 0xFF;
-	dest2 += 4;
-
-	y = *iy2++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest2[0] = r;
-	dest2[1] = g;
-	dest2[2] = b;
-	dest2[3] = 0xFF;
-	dest2 += 4;
-
-	//printf("yuv = %d %d %d -> rgb = %d %d %d XXXXXX ", y, u, v, r, g, b);
-      }
-    }
+    LineConversion conv;
+    setupYUVPlanar(conv, source, target, IMAGE_RGBA, 1, 1, 128);
+    convertLines(conv, 0, conv.lines);
   }
 
   void ImageConversion::YUV420PToRGB
   (const VideoImage * source, VideoImage * target)
   {
-    long w = source->m_width;
-    long h = source->m_height;
-
-    target->m_width  = w;
-    target->m_height = h;
-    target->m_format = IMAGE_RGB;
-    target->m_planes[0].m_linesize = w * 3;
-    target->m_planes[0].m_type = PLANE_RGB;
-
-    assert(target->m_planes[0].m_data);
-
-
-    /* Convert  the image two lines at a time (2x2 macroblocks). */
-
-    for(long l = 0; l < h; l += 2) {
-
-      uchar * dest1 = target->m_planes[0].line(l);
-      uchar * dest2 = target->m_planes[0].line(l + 1);
-
-      long l2 = l / 2;
-
-      const uchar * iy1 = source->m_planes[0].line(l);
-      const uchar * iy2 = source->m_planes[0].line(l + 1);
-      const uchar * iu  = source->m_planes[1].line(l2);
-      const uchar * iv  = source->m_planes[2].line(l2);
-
-      const uchar * sentinel = iy1 + w;
-
-      while(iy1 < sentinel) {
-
-	int r, g, b;
-      
-	int u = *iu++;
-	int v = *iv++;
-
-	u -= 128;
-	v -= 128;
-
-	int y = *iy1++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest1[0] = r;
-	dest1[1] = g;
-	dest1[2] = b;
-	dest1 += 3;
-
-	y = *iy1++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest1[0] = r;
-	dest1[1] = g;
-	dest1[2] = b;
-	dest1 += 3;
-
-	y = *iy2++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest2[0] = r;
-	dest2[1] = g;
-	dest2[2] = b;
-	dest2 += 3;
-
-	y = *iy2++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest2[0] = r;
-	dest2[1] = g;
-	dest2[2] = b;
-	dest2 += 3;
-
-	//printf("yuv = %d %d %d -> rgb = %d %d %d XXXXXX ", y, u, v, r, g, b);
-      }
-    }
+    LineConversion conv;
+    setupYUVPlanar(conv, source, target, IMAGE_RGB, 1, 1, 128);
+    convertLines(conv, 0, conv.lines);
   }
 
   void ImageConversion::YUV422PToRGBA
   (const VideoImage * source, VideoImage * target)
   {
-    long w = source->m_width;
-    long h = source->m_height;
-
-    target->m_width  = w;
-    target->m_height = h;
-    target->m_format = IMAGE_RGBA;
-    target->m_planes[0].m_linesize = w * 4;
-    target->m_planes[0].m_type = PLANE_RGBA;
-
-    assert(target->m_planes[0].m_data);
-
-    /* Convert  the image (2x1 macroblocks). */
-
-    for(long l = 0; l < h; l++) {
-
-      uchar * dest = target->m_planes[0].line(l);
-
-      const uchar * iy  = source->m_planes[0].line(l);
-      const uchar * iu  = source->m_planes[1].line(l);
-      const uchar * iv  = source->m_planes[2].line(l);
-
-      const uchar * sentinel = iy + w;
-
-      while(iy < sentinel) {
-
-	int r, g, b;
-      
-	int u = *iu++;
-	int v = *iv++;
-
-	u -= 128;
-	v -= 128;
-
-	int y = *iy++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest[3] = 0xFF;
-	dest += 4;
-
-	y = *iy++;
-	YUV2RGB(y, u, v, r, g, b);
-	dest[0] = r;
-	dest[1] = g;
-	dest[2] = b;
-	dest[3] = 0xFF;
-	dest += 4;
-
-	//printf("yuv = %d %d %d -> rgb = %d %d %d XXXXXX ", y, u, v, r, g, b);
-      }
-    }
+    LineConversion conv;
+    setupYUVPlanar(conv, source, target, IMAGE_RGBA, 1, 0, 128);
+    convertLines(conv, 0, conv.lines);
   }
 
   void ImageConversion::YUV422PToGrayscale
@@ -753,37 +1285,68 @@ namespace Radiant {
     }
   }
 
-  void ImageConversion::bayerToRGB(const VideoImage * source, VideoImage * target)
+  void ImageConversion::bayerToRGB(const VideoImage * source, VideoImage * target,
+                                   BayerDemosaic method)
   {
-    long lw = source->m_planes[0].m_linesize;
-    long w = source->m_width / 2;
-    long h = source->m_height / 2;
+    LineConversion conv;
 
-    target->m_width  = w;
-    target->m_height = h;
-    target->m_format = IMAGE_RGB;
-    target->m_planes[0].m_linesize = 3 * w;
+    if(method == BAYER_BILINEAR)
+      setupBayerBilinear(conv, source, target);
+    else
+      setupBayerHalfSize(conv, source, target);
 
-    const uchar * src = source->m_planes[0].m_data;
-    uchar * dest = target->m_planes[0].m_data;
-  
-    for(long y = 0; y < h; y++) {
+    convertLines(conv, 0, conv.lines);
+  }
 
-      const uchar * src1 = & src[y * 2 * lw];
-      const uchar * src2 = src1 + lw;
+  void ImageConversion::bayerToRGBBilinear(const VideoImage * source,
+                                           VideoImage * target)
+  {
+    LineConversion conv;
+    setupBayerBilinear(conv, source, target);
+    convertLines(conv, 0, conv.lines);
+  }
 
-      for(long x = 0; x < w; x++) {
-	uint green = (uint) src1[0] + (uint) src2[1];
-	dest[0] = src2[0];
-	dest[2] = src1[1];
-	dest[1] = green >> 1;
+  bool ImageConversion::convert(const VideoImage * source, VideoImage * target,
+                                ThreadPool & pool, BayerDemosaic bayer)
+  {
+    assert(source != 0 && target != 0);
 
-	src1 += 2;
-	src2 += 2;
-	dest += 3;
-      }    
+    ImageFormat sourceFmt = source->m_format;
+    ImageFormat targetFmt = target->m_format;
+    bool rgb = (targetFmt == IMAGE_RGB || targetFmt == IMAGE_RGBA);
+
+    LineConversion conv;
+
+    if(sourceFmt == IMAGE_YUV_411P && rgb)
+      setupYUVPlanar(conv, source, target, targetFmt, 2, 0, 127);
+    else if(sourceFmt == IMAGE_YUV_420P && rgb)
+      setupYUVPlanar(conv, source, target, targetFmt, 1, 1, 128);
+    else if(sourceFmt == IMAGE_YUV_422P && targetFmt == IMAGE_RGBA)
+      setupYUVPlanar(conv, source, target, targetFmt, 1, 0, 128);
+    else if(sourceFmt == IMAGE_RAWBAYER && targetFmt == IMAGE_RGB) {
+      if(bayer == BAYER_BILINEAR)
+        setupBayerBilinear(conv, source, target);
+      else
+        setupBayerHalfSize(conv, source, target);
     }
+    else
+      return convert(source, target, bayer);
+
+    /* A few bands per thread evens out the load, but the bands should
+       not get so small that the threads spend their time waking up. */
+    const long minBand = 16;
+    long threads = pool.threadCount() + 1;
+    long band = (conv.lines + 4 * threads - 1) / (4 * threads);
+
+    if(band < minBand)
+      band = minBand;
+
+    band = (band + conv.align - 1) / conv.align * conv.align;
+
+    BandJob job(conv, band);
+    pool.run(job, (int) ((conv.lines + band - 1) / band));
 
+    return true;
   }
 
   void ImageConversion::bayerToGrayscale(const VideoImage * source, VideoImage * target)
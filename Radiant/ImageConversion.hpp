@@ -20,19 +20,47 @@
 
 namespace Radiant {
 
+  class ThreadPool;
   class VideoImage;
 
   /// VideoImage conversion utilities.
   /** This class contains static functions for converting between
       different image formats.
 
-      New format conversion functions will be written as needed. */
+      New format conversion functions will be written as needed.
+
+      The conversions from planar YUV and raw Bayer data use SSE2,
+      SSSE3 or AVX2 when the CPU supports them (see
+      #Radiant::CPUInfo). The results are identical to the plain C++
+      code. */
 
   class RADIANT_API ImageConversion
   {
   public:
+    /// Bayer demosaicing methods
+    enum BayerDemosaic
+    {
+      /// Each 2x2 block becomes one pixel, the image is half the size
+      BAYER_HALF_SIZE,
+      /// Full-size image, missing colors are interpolated bilinearly
+      BAYER_BILINEAR
+    };
+
     /// Convert from a random format to another random format
-    static bool convert(const VideoImage * source, VideoImage * target);
+    /** Raw Bayer data is demosaiced with the given method. With
+        BAYER_BILINEAR the target image needs room for the full-size
+        RGB image. */
+    static bool convert(const VideoImage * source, VideoImage * target,
+                        BayerDemosaic bayer = BAYER_HALF_SIZE);
+    /// Converts the image in bands of lines, using a thread pool
+    /** The planar YUV to RGB(A) and Bayer to RGB conversions are split
+        into bands of lines that the pool converts in parallel. Bands
+        start on even lines for YUV 4:2:0 and Bayer data, so the lines
+        that share chroma or a Bayer pattern stay together. Other
+        conversions run on the calling thread. */
+    static bool convert(const VideoImage * source, VideoImage * target,
+                        ThreadPool & pool,
+                        BayerDemosaic bayer = BAYER_HALF_SIZE);
 
     static void YUV411ToRGB(const VideoImage * source, VideoImage * target);
     static void YUV411PToRGB(const VideoImage * source, VideoImage * target);
@@ -51,7 +79,11 @@ namespace Radiant {
     static void grayscaleToRGB(const VideoImage * source, VideoImage * target);
     static void RGBToGrayscale(const VideoImage * source, VideoImage * target);
 
-    static void bayerToRGB(const VideoImage * source, VideoImage * target);
+    /// Converts GBRG Bayer data to RGB, with the given demosaicing method
+    static void bayerToRGB(const VideoImage * source, VideoImage * target,
+                           BayerDemosaic method = BAYER_HALF_SIZE);
+    /// Converts GBRG Bayer data to a full-size RGB image
+    static void bayerToRGBBilinear(const VideoImage * source, VideoImage * target);
     static void bayerToGrayscale(const VideoImage * source, VideoImage * target);
   };
 
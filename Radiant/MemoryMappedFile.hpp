@@ -0,0 +1,61 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#ifndef RADIANT_MEMORY_MAPPED_FILE_HPP
+#define RADIANT_MEMORY_MAPPED_FILE_HPP
+
+#include <Radiant/Export.hpp>
+
+#include <Patterns/NotCopyable.hpp>
+
+#include <stddef.h>
+
+namespace Radiant {
+
+  /// Read-only memory mapping of a file
+  /** The whole file is mapped to the address space of the process, so
+      that its contents can be accessed without reading them to a
+      separate buffer first. The mapping is removed when the object is
+      destroyed, or close() is called. */
+  class RADIANT_API MemoryMappedFile : public Patterns::NotCopyable
+  {
+  public:
+    MemoryMappedFile();
+    ~MemoryMappedFile();
+
+    /// Maps the given file
+    /** @return false if the file cannot be opened or mapped */
+    bool open(const char * filename);
+    /// Removes the mapping
+    void close();
+
+    /// Returns true if a file is mapped
+    bool isOpen() const { return m_data != 0; }
+
+    /// Pointer to the mapped data, or null if nothing is mapped
+    const unsigned char * data() const { return m_data; }
+    /// Size of the mapped file in bytes
+    size_t size() const { return m_size; }
+
+  private:
+    class D;
+    D * m_d;
+
+    const unsigned char * m_data;
+    size_t m_size;
+  };
+
+}
+
+#endif
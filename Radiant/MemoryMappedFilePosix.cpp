@@ -0,0 +1,94 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#include "MemoryMappedFile.hpp"
+
+#include "Trace.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Radiant {
+
+  class MemoryMappedFile::D
+  {
+  public:
+    D() : m_fd(-1) {}
+
+    int m_fd;
+  };
+
+  MemoryMappedFile::MemoryMappedFile()
+    : m_d(new D),
+      m_data(0),
+      m_size(0)
+  {}
+
+  MemoryMappedFile::~MemoryMappedFile()
+  {
+    close();
+    delete m_d;
+  }
+
+  bool MemoryMappedFile::open(const char * filename)
+  {
+    close();
+
+    int fd = ::open(filename, O_RDONLY);
+
+    if(fd < 0)
+      return false;
+
+    struct stat st;
+
+    if(fstat(fd, & st) != 0 || st.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
+
+    void * ptr = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if(ptr == MAP_FAILED) {
+      error("MemoryMappedFile::open # mmap failed for %s: %s",
+            filename, strerror(errno));
+      ::close(fd);
+      return false;
+    }
+
+    m_d->m_fd = fd;
+    m_data = (const unsigned char *) ptr;
+    m_size = st.st_size;
+
+    return true;
+  }
+
+  void MemoryMappedFile::close()
+  {
+    if(m_data)
+      munmap((void *) m_data, m_size);
+
+    if(m_d->m_fd >= 0)
+      ::close(m_d->m_fd);
+
+    m_d->m_fd = -1;
+    m_data = 0;
+    m_size = 0;
+  }
+
+}
@@ -0,0 +1,106 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#include "MemoryMappedFile.hpp"
+
+#include "Trace.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+namespace Radiant {
+
+  class MemoryMappedFile::D
+  {
+  public:
+    D() : m_file(INVALID_HANDLE_VALUE), m_mapping(0) {}
+
+    HANDLE m_file;
+    HANDLE m_mapping;
+  };
+
+  MemoryMappedFile::MemoryMappedFile()
+    : m_d(new D),
+      m_data(0),
+      m_size(0)
+  {}
+
+  MemoryMappedFile::~MemoryMappedFile()
+  {
+    close();
+    delete m_d;
+  }
+
+  bool MemoryMappedFile::open(const char * filename)
+  {
+    close();
+
+    HANDLE file = CreateFileA(filename, GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+
+    if(file == INVALID_HANDLE_VALUE)
+      return false;
+
+    LARGE_INTEGER size;
+
+    if(!GetFileSizeEx(file, & size) || size.QuadPart <= 0) {
+      CloseHandle(file);
+      return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+
+    if(!mapping) {
+      error("MemoryMappedFile::open # CreateFileMapping failed for %s",
+            filename);
+      CloseHandle(file);
+      return false;
+    }
+
+    void * ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if(!ptr) {
+      error("MemoryMappedFile::open # MapViewOfFile failed for %s", filename);
+      CloseHandle(mapping);
+      CloseHandle(file);
+      return false;
+    }
+
+    m_d->m_file = file;
+    m_d->m_mapping = mapping;
+    m_data = (const unsigned char *) ptr;
+    m_size = (size_t) size.QuadPart;
+
+    return true;
+  }
+
+  void MemoryMappedFile::close()
+  {
+    if(m_data)
+      UnmapViewOfFile(m_data);
+
+    if(m_d->m_mapping)
+      CloseHandle(m_d->m_mapping);
+
+    if(m_d->m_file != INVALID_HANDLE_VALUE)
+      CloseHandle(m_d->m_file);
+
+    m_d->m_file = INVALID_HANDLE_VALUE;
+    m_d->m_mapping = 0;
+    m_data = 0;
+    m_size = 0;
+  }
+
+}
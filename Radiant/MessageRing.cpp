@@ -0,0 +1,135 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#include "MessageRing.hpp"
+
+#include "Atomic.hpp"
+#include "BinaryData.hpp"
+#include "RingBuffer.hpp"
+
+#include <string.h>
+
+namespace Radiant {
+
+  MessageRing::MessageRing(unsigned messages, unsigned maxMessageBytes,
+                           Mode mode)
+    : m_mode(mode),
+      m_slotBytes(maxMessageBytes),
+      m_head(0),
+      m_tail(0),
+      m_dropped(0)
+  {
+    unsigned n = RingBuffer<int>::targetSize(messages ? messages : 1);
+
+    m_mask = n - 1;
+    // Keep the slots aligned, so that messages can be read in place
+    m_stride = (maxMessageBytes + 15) & ~15u;
+
+    m_data = new char [n * m_stride];
+    m_sequence = new int [n];
+    m_bytes = new unsigned [n];
+
+    for(unsigned i = 0; i < n; i++) {
+      m_sequence[i] = (int) i;
+      m_bytes[i] = 0;
+    }
+  }
+
+  MessageRing::~MessageRing()
+  {
+    delete [] m_data;
+    delete [] (int *) m_sequence;
+    delete [] m_bytes;
+  }
+
+  bool MessageRing::write(const void * data, unsigned bytes)
+  {
+    if(bytes > m_slotBytes) {
+      Atomic::add( & m_dropped, 1);
+      return false;
+    }
+
+    unsigned pos = (unsigned) m_head;
+
+    for(;;) {
+      int seq = m_sequence[pos & m_mask];
+      int diff = (int) ((unsigned) seq - pos);
+
+      if(diff < 0) {
+        // The consumer has not freed this slot yet, the ring is full
+        Atomic::add( & m_dropped, 1);
+        return false;
+      }
+
+      if(diff == 0) {
+        if(m_mode == SINGLE_PRODUCER) {
+          m_head = (int) (pos + 1);
+          break;
+        }
+        else if(Atomic::compareAndSwap( & m_head, (int) pos, (int) (pos + 1)))
+          break;
+      }
+
+      // Another producer took the slot
+      pos = (unsigned) m_head;
+    }
+
+    unsigned index = pos & m_mask;
+
+    memcpy(slot(pos), data, bytes);
+    m_bytes[index] = bytes;
+
+    // Publish the message
+    Atomic::memoryBarrier();
+    m_sequence[index] = (int) (pos + 1);
+
+    return true;
+  }
+
+  bool MessageRing::write(const BinaryData & data)
+  {
+    return write(data.data(), data.pos());
+  }
+
+  const char * MessageRing::peek(unsigned * bytes)
+  {
+    unsigned pos = (unsigned) m_tail;
+    unsigned index = pos & m_mask;
+
+    if(m_sequence[index] != (int) (pos + 1))
+      return 0;
+
+    Atomic::memoryBarrier();
+
+    if(bytes)
+      *bytes = m_bytes[index];
+
+    return slot(pos);
+  }
+
+  void MessageRing::pop()
+  {
+    unsigned pos = (unsigned) m_tail;
+    unsigned index = pos & m_mask;
+
+    if(m_sequence[index] != (int) (pos + 1))
+      return;
+
+    // Hand the slot back to the producers, for the next lap
+    Atomic::memoryBarrier();
+    m_sequence[index] = (int) (pos + m_mask + 1);
+    m_tail = (int) (pos + 1);
+  }
+
+}
@@ -0,0 +1,119 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+#ifndef RADIANT_MESSAGE_RING_HPP
+#define RADIANT_MESSAGE_RING_HPP
+
+#include <Radiant/Export.hpp>
+
+#include <Patterns/NotCopyable.hpp>
+
+namespace Radiant {
+
+  class BinaryData;
+
+  /** Fixed-capacity message queue that never blocks.
+
+      MessageRing passes variable-length byte messages from one or more
+      producer threads to one consumer thread. All memory is allocated
+      in the constructor: the ring has a fixed number of slots, and each
+      slot can hold a message of up to maxMessageBytes bytes.
+
+      The consumer side is wait-free, which makes the ring suitable for
+      passing control data to real-time threads (for example an audio
+      callback), where taking a mutex could block the thread. In
+      SINGLE_PRODUCER mode the producer is wait-free as well. In
+      MULTIPLE_PRODUCERS mode the producers claim slots with
+      compare-and-swap, so they are lock-free.
+
+      If the ring is full, or a message is too large, the message is
+      dropped, and the drop counter is incremented.
+
+      Like RingBuffer, the number of slots is always 2^n.
+
+      \code
+      // Producer
+      ring.write(data.data(), data.pos());
+
+      // Consumer
+      unsigned bytes;
+      while(const char * msg = ring.peek( & bytes)) {
+        handle(msg, bytes);
+        ring.pop();
+      }
+      \endcode
+  */
+  class RADIANT_API MessageRing : public Patterns::NotCopyable
+  {
+  public:
+    enum Mode {
+      /// Only one thread calls write
+      SINGLE_PRODUCER,
+      /// Any number of threads can call write
+      MULTIPLE_PRODUCERS
+    };
+
+    /** @param messages The number of message slots. This is rounded up
+        to a power of two.
+        @param maxMessageBytes The largest message that fits in a slot
+        @param mode Whether multiple threads may write to the ring */
+    MessageRing(unsigned messages = 256, unsigned maxMessageBytes = 1024,
+                Mode mode = SINGLE_PRODUCER);
+    ~MessageRing();
+
+    /** Adds a message to the ring.
+        @return false if the message was dropped */
+    bool write(const void * data, unsigned bytes);
+    /** Adds the bytes from the beginning of the buffer up to the
+        current position to the ring. */
+    bool write(const BinaryData & data);
+
+    /** Returns the oldest message, without removing it from the
+        ring. Only the consumer thread may call this function.
+        @param bytes The size of the message is stored here
+        @return Pointer to the message, or null if the ring is empty */
+    const char * peek(unsigned * bytes);
+    /// Removes the oldest message. Only the consumer may call this.
+    void pop();
+
+    /// Number of messages dropped since the ring was created
+    unsigned dropped() const { return (unsigned) m_dropped; }
+    /// Number of message slots
+    unsigned capacity() const { return m_mask + 1; }
+    /// Largest message that fits in a slot
+    unsigned maxMessageBytes() const { return m_slotBytes; }
+
+  private:
+
+    char * slot(unsigned index) { return m_data + (index & m_mask) * m_stride; }
+
+    Mode     m_mode;
+    unsigned m_mask;
+    unsigned m_slotBytes;
+    unsigned m_stride;
+
+    char   * m_data;
+    // Sequence number of each slot, tells which lap the slot is on
+    volatile int * m_sequence;
+    unsigned     * m_bytes;
+
+    volatile int m_head;
+    // Only touched by the consumer
+    int          m_tail;
+    volatile int m_dropped;
+  };
+
+}
+
+#endif
@@ -55,6 +55,10 @@ namespace Radiant
 
     /// Setup an environment variable
     RADIANT_API void setEnv(const char * name, const char * value);
+
+    /// Returns the number of logical CPUs available to the process
+    /** If the number cannot be determined, one is returned. */
+    RADIANT_API int getNumberOfCPUs();
   }
 
 }
@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -120,6 +121,12 @@ namespace Radiant
       else
         unsetenv(name);
     }
+
+    int getNumberOfCPUs()
+    {
+      long n = sysconf(_SC_NPROCESSORS_ONLN);
+      return n > 0 ? (int) n : 1;
+    }
   }
 
 }
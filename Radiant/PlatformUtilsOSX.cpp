@@ -24,6 +24,8 @@
 #include <mach/mach_traps.h>
 #include <mach/mach.h>
 
+#include <sys/sysctl.h>
+
 #include <CoreFoundation/CoreFoundation.h>
 
 namespace Radiant
@@ -111,6 +113,17 @@ namespace Radiant
       else
         unsetenv(name);
     }
+
+    int getNumberOfCPUs()
+    {
+      int n = 0;
+      size_t len = sizeof(n);
+
+      if(sysctlbyname("hw.ncpu", &n, &len, 0, 0) != 0 || n <= 0)
+        return 1;
+
+      return n;
+    }
   }
 
 }
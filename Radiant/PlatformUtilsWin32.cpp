@@ -163,6 +163,14 @@ namespace Radiant
       SetEnvironmentVariableA((char *) name, (char *) value);
     }
 
+    int getNumberOfCPUs()
+    {
+      SYSTEM_INFO info;
+      GetSystemInfo(&info);
+
+      return info.dwNumberOfProcessors > 0 ? (int) info.dwNumberOfProcessors : 1;
+    }
+
   }
 
 
@@ -3,11 +3,15 @@ include(../multitude.pri)
 HEADERS += CameraDriver.hpp
 HEADERS += CSVDocument.hpp
 HEADERS += UDPSocket.hpp
+HEADERS += UDPSocketBatch.hpp
+HEADERS += Atomic.hpp
+HEADERS += BinaryArena.hpp
 HEADERS += BinaryData.hpp
 HEADERS += BinaryStream.hpp
 HEADERS += Color.hpp
 HEADERS += ColorUtils.hpp
 HEADERS += Condition.hpp
+HEADERS += CPUInfo.hpp
 HEADERS += Config.hpp
 HEADERS += ConfigReader.hpp
 HEADERS += ConfigReaderTmpl.hpp
@@ -20,11 +24,14 @@ HEADERS += Export.hpp
 HEADERS += FileUtils.hpp
 HEADERS += FixedStr.hpp
 HEADERS += FixedStrImpl.hpp
+!win32:HEADERS += Futex.hpp
 HEADERS += Grid.hpp
 HEADERS += GridTmpl.hpp
 HEADERS += ImageConversion.hpp
 HEADERS += IODefs.hpp
 HEADERS += Log.hpp
+HEADERS += MemoryMappedFile.hpp
+HEADERS += MessageRing.hpp
 HEADERS += Mutex.hpp
 HEADERS += PlatformUtils.hpp
 HEADERS += Priority.hpp
@@ -38,6 +45,7 @@ HEADERS += RingBufferImpl.hpp
 HEADERS += Semaphore.hpp
 HEADERS += SerialPort.hpp
 HEADERS += Size2D.hpp
+linux-*:HEADERS += SocketReactor.hpp
 HEADERS += Sleep.hpp
 !win32:HEADERS += SHMDuplexPipe.hpp
 !win32:HEADERS += SHMPipe.hpp
@@ -46,6 +54,7 @@ HEADERS += StringUtils.hpp
 HEADERS += TCPServerSocket.hpp
 HEADERS += TCPSocket.hpp
 HEADERS += ThreadData.hpp
+HEADERS += ThreadPool.hpp
 HEADERS += Thread.hpp
 HEADERS += Timer.hpp
 HEADERS += TimeStamp.hpp
@@ -59,11 +68,13 @@ HEADERS += ClonablePtr.hpp
 HEADERS += VideoCamera.hpp
 SOURCES += CameraDriver.cpp
 SOURCES += CSVDocument.cpp
+SOURCES += BinaryArena.cpp
 SOURCES += BinaryData.cpp
 SOURCES += VideoCamera.cpp
 SOURCES += Color.cpp
 SOURCES += ColorUtils.cpp
 SOURCES += ConfigReader.cpp
+SOURCES += CPUInfo.cpp
 SOURCES += DateTime.cpp
 SOURCES += DirectoryCommon.cpp
 SOURCES += FileUtils.cpp
@@ -71,6 +82,7 @@ SOURCES += FixedStr.cpp
 SOURCES += Grid.cpp
 SOURCES += ImageConversion.cpp
 SOURCES += Log.cpp
+SOURCES += MessageRing.cpp
 SOURCES += ResourceLocator.cpp
 SOURCES += RingBuffer.cpp
 SOURCES += Size2D.cpp
@@ -80,6 +92,7 @@ SOURCES += SemaphoreQt.cpp
 !win32:SOURCES += SHMPipe.cpp
 !win32:SOURCES += SMRingBuffer.cpp
 SOURCES += StringUtils.cpp
+SOURCES += ThreadPool.cpp
 SOURCES += Timer.cpp
 SOURCES += TimeStamp.cpp
 SOURCES += Trace.cpp
@@ -88,14 +101,18 @@ SOURCES += VideoInput.cpp
 SOURCES += WatchDog.cpp
 LIBS += $$LIB_NIMBLE $$LIB_PATTERNS
 
+linux-*:SOURCES += FutexLinux.cpp
 linux-*:SOURCES += PlatformUtilsLinux.cpp
+linux-*:SOURCES += SocketReactorLinux.cpp
 macx {
+    SOURCES += FutexOSX.cpp
     SOURCES += PlatformUtilsOSX.cpp
     LIBS += -framework,CoreFoundation
 }
 unix {
     HEADERS += VideoCamera1394.hpp
     SOURCES += DirectoryPosix.cpp
+    SOURCES += MemoryMappedFilePosix.cpp
     SOURCES += SerialPortPosix.cpp
     SOURCES += TCPServerSocketQt.cpp
     SOURCES += TCPSocketQt.cpp
@@ -126,6 +143,7 @@ win32 {
     }
 
     SOURCES += PlatformUtilsWin32.cpp
+    SOURCES += MemoryMappedFileWin32.cpp
     SOURCES += SerialPortWin32.cpp
     SOURCES += DirectoryQt.cpp
     SOURCES += TCPServerSocketQt.cpp
@@ -15,6 +15,8 @@
 
 #include "SHMPipe.hpp"
 
+#include <Radiant/Atomic.hpp>
+#include <Radiant/Futex.hpp>
 #include <Radiant/StringUtils.hpp>
 #include <Radiant/Sleep.hpp>
 #include <Radiant/TimeStamp.hpp>
@@ -177,7 +179,9 @@ namespace Radiant
       m_read(0),
       m_mask(0),
       m_shm(0),
-      m_pipe(0)
+      m_pipe(0),
+      m_reserved(0),
+      m_staged(false)
   {
     const char * const  fnName = "SHMPipe::SHMPipe";
 
@@ -358,8 +362,6 @@ namespace Radiant
 
   int SHMPipe::read(void * ptr, int n)
   {
-    // int orig = n;
-
     uint32_t avail = readAvailable();
 
     if( (int) avail < n) {
@@ -368,25 +370,8 @@ namespace Radiant
       return 0;
     }
 
-    uint8_t * dest = (uint8_t *) ptr;
-    const uint8_t  * pipe = m_pipe;
-
-    n = Nimble::Math::Min((uint32_t) n, avail);
-    uint32_t m = m_mask;
-    for(int i = 0; i < n; i++) {
-      dest[i] = pipe[(m_read + i) & m];
-      // printf("b[%d]: %x ", i, pipe[(m_read + i) & m]);
-    }
-    
-    m_read += n;
-
-    storeHeaderValue(SHM_READ_LOC, m_read);
-
-    /*
-    if(n)
-      info("SHMPipe::read # Read %d vs %d (%d vs %d)",
-	   n, orig, readPos(), writePos());
-    */
+    copyOut(m_read, (uint8_t *) ptr, n);
+    release(n);
 
     return n;
   }
@@ -395,34 +380,35 @@ namespace Radiant
   {
     data.rewind();
 
-    uint32_t bytes = 0;
-
-    uint32_t n = read( & bytes, 4);
-
-    debug("SHMPipe::read # reading 4 header bytes, got %u (%u %u)",
-	  n, bytes, (m_read & m_mask));
+    const uint8_t * header = peek(4);
 
-    if(n != 4) {
+    if(!header) {
       // debug("SHMPipe::read # could not read 4 bytes");
-      return n;
+      return 0;
     }
 
+    uint32_t bytes;
+    memcpy( & bytes, header, 4);
+
     if(bytes > m_size) {
       error("SHMPipe::read # Too large object to read, stream corrupted %u",
 	    (int) bytes);
       return 0;
     }
 
-    data.ensure(bytes);
-    n = read(data.data(), bytes);
-    data.setTotal(n);
-
-    if(n != bytes) {
+    if(readAvailable() < bytes + 4) {
       error("SHMPipe::read # could not read final %d vs %d (%u %u)",
-	    n, (int) bytes, m_read, readPos());
+	    (int) readAvailable() - 4, (int) bytes, m_read, readPos());
+      return 0;
     }
 
-    return n + 4;
+    data.ensure(bytes);
+    copyOut(m_read + 4, (uint8_t *) data.data(), bytes);
+    data.setTotal(bytes);
+
+    release(bytes + 4);
+
+    return bytes + 4;
   }
 
   uint32_t SHMPipe::readAvailable()
@@ -433,28 +419,46 @@ namespace Radiant
     return wp - rp;
   }
 
-  int SHMPipe::write(const void * ptr, int n)
+  bool SHMPipe::waitRead(uint32_t n, int timeoutMs)
   {
-    // int orig = n;
+    TimeStamp start = TimeStamp::getTime();
 
-    uint32_t avail = writeAvailable();
+    volatile uint32_t * waiters = headerWord(SHM_WAITERS_LOC);
+    volatile uint32_t * wake = headerWord(SHM_WAKE_LOC);
 
-    const uint8_t * src = (const uint8_t *) ptr;
-    uint8_t  * pipe = m_pipe;
+    while(readAvailable() < n) {
 
-    n = Nimble::Math::Min((uint32_t) n, avail);
-    
-    int m = m_mask;
-    for(int i = 0; i < n; i++) {
-      pipe[(m_written + i) & m] = src[i];
+      int left = -1;
+
+      if(timeoutMs >= 0) {
+        left = timeoutMs - (int) (start.sinceSecondsD() * 1000.0);
+        if(left <= 0)
+          return false;
+      }
+
+      uint32_t seq = *wake;
+
+      // Atomic add is a full barrier, see flush()
+      Atomic::add((volatile int *) waiters, 1);
+
+      if(readAvailable() < n)
+        Futex::wait(wake, seq, left);
+
+      Atomic::add((volatile int *) waiters, -1);
     }
 
+    return true;
+  }
+
+  int SHMPipe::write(const void * ptr, int n)
+  {
+    uint32_t avail = writeAvailable();
+
+    n = Nimble::Math::Min((uint32_t) n, avail);
+
+    copyIn(m_written, (const uint8_t *) ptr, n);
     m_written += n;
 
-    /*if(n)
-      info("SHMPipe::write # Wrote %d vs %d (%d vs %d)",
-	   n, orig, readPos(), writePos());
-    */
     return n;
   }
 
@@ -468,10 +472,13 @@ namespace Radiant
     }
 
     uint32_t bytes = data.pos();
-    if(write( & bytes, 4) != 4)
-      return 0;
 
-    return write(data.data(), bytes) + 4;
+    uint8_t * dest = reserve(bytes + 4);
+    memcpy(dest, & bytes, 4);
+    memcpy(dest + 4, data.data(), bytes);
+    commit(bytes + 4);
+
+    return bytes + 4;
   }
 
   uint32_t SHMPipe::writeAvailable(int require)
@@ -522,8 +529,132 @@ namespace Radiant
 
   void SHMPipe::flush()
   { 
+    // The data must be in memory before the reader sees the new position
+    Atomic::memoryBarrier();
     storeHeaderValue(SHM_WRITE_LOC, m_written);
     // info("SHMPipe::flush # Flushed out written data (%u)",(unsigned) m_written);
+
+    /* The barrier pairs with the one in waitRead: either the reader sees
+       the new write position, or we see the reader waiting. */
+    Atomic::memoryBarrier();
+
+    if(*headerWord(SHM_WAITERS_LOC)) {
+      Atomic::add((volatile int *) headerWord(SHM_WAKE_LOC), 1);
+      Futex::wakeAll(headerWord(SHM_WAKE_LOC));
+    }
+  }
+
+  uint8_t * SHMPipe::reserve(uint32_t n)
+  {
+    if(writeAvailable() < n)
+      return 0;
+
+    m_reserved = n;
+
+    uint32_t pos = m_written & m_mask;
+
+    if(pos + n <= m_size) {
+      m_staged = false;
+      return m_pipe + pos;
+    }
+
+    // The space wraps around the end of the ring
+    if(m_stage.size() < n)
+      m_stage.resize(n);
+
+    m_staged = true;
+
+    return & m_stage[0];
+  }
+
+  void SHMPipe::commit(uint32_t n)
+  {
+    assert(n <= m_reserved);
+
+    if(m_staged)
+      copyIn(m_written, & m_stage[0], n);
+
+    m_written += n;
+    m_reserved = 0;
+    m_staged = false;
+  }
+
+  const uint8_t * SHMPipe::peek(uint32_t n)
+  {
+    if(readAvailable() < n)
+      return 0;
+
+    // Read the data after the write position
+    Atomic::memoryBarrier();
+
+    uint32_t pos = m_read & m_mask;
+
+    if(pos + n <= m_size)
+      return m_pipe + pos;
+
+    if(m_peekBuffer.size() < n)
+      m_peekBuffer.resize(n);
+
+    copyOut(m_read, & m_peekBuffer[0], n);
+
+    return & m_peekBuffer[0];
+  }
+
+  int SHMPipe::peek(BinaryData & data)
+  {
+    const uint8_t * header = peek(4);
+
+    if(!header)
+      return 0;
+
+    uint32_t bytes;
+    memcpy( & bytes, header, 4);
+
+    if(bytes > m_size) {
+      error("SHMPipe::peek # Too large object to read, stream corrupted %u",
+	    (int) bytes);
+      return 0;
+    }
+
+    const uint8_t * msg = peek(bytes + 4);
+
+    if(!msg)
+      return 0;
+
+    data.linkTo((void *) (msg + 4), bytes);
+    data.rewind();
+    data.setTotal(bytes);
+
+    return bytes + 4;
+  }
+
+  void SHMPipe::release(uint32_t n)
+  {
+    m_read += n;
+
+    // Finish reading before the writer can reuse the space
+    Atomic::memoryBarrier();
+    storeHeaderValue(SHM_READ_LOC, m_read);
+  }
+
+  void SHMPipe::copyIn(uint32_t pos, const uint8_t * src, uint32_t n)
+  {
+    pos &= m_mask;
+
+    uint32_t first = Nimble::Math::Min(n, m_size - pos);
+
+    memcpy(m_pipe + pos, src, first);
+    memcpy(m_pipe, src + first, n - first);
+  }
+
+  void SHMPipe::copyOut(uint32_t pos, uint8_t * dest, uint32_t n) const
+  {
+    pos &= m_mask;
+
+    uint32_t first = Nimble::Math::Min(n, m_size - pos);
+
+    memcpy(dest, m_pipe + pos, first);
+    memcpy(dest + first, m_pipe, n - first);
   }
 
   void SHMPipe::zero()
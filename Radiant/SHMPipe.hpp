@@ -28,6 +28,7 @@
 #endif
 
 #include <string>
+#include <vector>
 
 namespace Radiant
 {
@@ -47,6 +48,30 @@ namespace Radiant
       updated. The writer observes the read head location so that it
       does not overwrite data that has not been read yet.
 
+      <B>Zero-copy access:</B> reserve() and commit() let the
+      producer write directly into the shared ring, and peek() and
+      release() let the consumer read in place. Only when the requested
+      range wraps around the end of the ring is it staged through a
+      private buffer. For example, a BinaryData message can be
+      serialized straight into the pipe:
+
+      <PRE>
+      uint8_t * p = pipe.reserve(4 + maxBytes);
+      if(p) {
+        BinaryData bd;
+        bd.linkTo(p + 4, maxBytes);
+        bd.rewind();
+        bd.writeFloat32(x);
+        ...
+        uint32_t bytes = bd.pos();
+        memcpy(p, & bytes, 4);
+        pipe.commit(4 + bytes);
+        pipe.flush();
+      }
+      </PRE>
+
+      and read back with peek(BinaryData &) and release().
+
       @see SHMDuplexPipe
   */
   class SHMPipe
@@ -76,6 +101,16 @@ namespace Radiant
     RADIANT_API int read(BinaryData &);
     /// The number of bytes available for reading immediately
     RADIANT_API uint32_t readAvailable();
+    /// Waits until at least n bytes are available for reading
+    /** The reader sleeps in the kernel (see Radiant::Futex), and the
+        writer wakes it up in flush(). If nobody is waiting, the writer
+        does not make any system calls.
+
+        @param n Number of bytes to wait for
+        @param timeoutMs Maximum time to wait in milliseconds, negative
+        value waits indefinitely
+        @return true if n bytes are available */
+    RADIANT_API bool waitRead(uint32_t n, int timeoutMs);
 
     /// Stores data into the buffer, without flushing it.
     /** 
@@ -88,6 +123,32 @@ namespace Radiant
     /// Flush the written data to the buffer
     RADIANT_API void flush();
 
+    /// Reserves contiguous space for writing
+    /** The returned pointer is valid until commit() is called. Nothing
+        is visible to the reader before commit() and flush().
+
+        @return Pointer to n writable bytes, or zero if there is not
+        enough free space in the pipe at the moment */
+    RADIANT_API uint8_t * reserve(uint32_t n);
+    /// Commits the first n bytes of the latest reservation
+    RADIANT_API void commit(uint32_t n);
+
+    /// Returns a pointer to the next n unread bytes, without consuming them
+    /** The pointer is valid until release() or read() is called.
+        @return Pointer to the data, or zero if fewer than n bytes are
+        available */
+    RADIANT_API const uint8_t * peek(uint32_t n);
+    /// Links a BinaryData object to the next message in place
+    /** The message must have been written with write(const BinaryData &),
+        or in the same format. After the message has been parsed, call
+        release() with the returned byte count.
+
+        @return The number of bytes that the message takes in the pipe,
+        or zero if there is no complete message */
+    RADIANT_API int peek(BinaryData & data);
+    /// Consumes n bytes, after they have been examined with peek()
+    RADIANT_API void release(uint32_t n);
+
     /// Returns the size of the shared memory area
     RADIANT_API uint32_t size() const { return m_size; }
 
@@ -105,7 +166,10 @@ namespace Radiant
       SHM_SIZE_LOC = 0,
       SHM_WRITE_LOC  = 4,
       SHM_READ_LOC = 8,
-      // Leave bytes 12-19 free, so we can use those later, if needed.
+      // Number of readers sleeping in waitRead
+      SHM_WAITERS_LOC = 12,
+      // Futex word, incremented when the sleeping readers are woken up
+      SHM_WAKE_LOC = 16,
       SHM_PIPE_LOC = 20,
       SHM_HEADER_SIZE = SHM_PIPE_LOC
     };
@@ -131,9 +195,17 @@ namespace Radiant
     void storeHeaderValue(int loc, uint32_t val)
     { * ((uint32_t *)(m_shm + loc)) = val; }
 
+    volatile uint32_t * headerWord(int loc)
+    { return (volatile uint32_t *) (m_shm + loc); }
+
     /// Output attributes and properties.
     void dump() const;
 
+    /// Copies bytes to the ring, starting from the write position pos
+    void copyIn(uint32_t pos, const uint8_t * src, uint32_t n);
+    /// Copies bytes from the ring, starting from the read position pos
+    void copyOut(uint32_t pos, uint8_t * dest, uint32_t n) const;
+
     /// true if this is the creator object, false if it is a reference object.
     bool    m_isCreator;
 
@@ -160,6 +232,14 @@ namespace Radiant
     // Pointer to the pipe area:
     uint8_t  * m_pipe;
 
+    // Size of the latest reservation
+    uint32_t m_reserved;
+    // Reservations that wrap around the end of the ring are staged here
+    std::vector<uint8_t> m_stage;
+    bool     m_staged;
+    // peek() copies data that wraps around the end of the ring here
+    std::vector<uint8_t> m_peekBuffer;
+
   };
 
 }
@@ -13,7 +13,10 @@
  * 
  */
 
+#include <Radiant/Atomic.hpp>
+#include <Radiant/Futex.hpp>
 #include <Radiant/StringUtils.hpp>
+#include <Radiant/TimeStamp.hpp>
 #include <Radiant/Trace.hpp>
 
 #include "SMRingBuffer.hpp"
@@ -49,12 +52,19 @@ namespace Radiant
   uint32_t  SMRingBuffer::smDefaultPermissions = 0666;
 #endif
 
-  uint32_t  SMRingBuffer::smHeaderSize = sizeof(uint32_t) * 4;
+  uint32_t  SMRingBuffer::smHeaderSize = sizeof(uint32_t) * 6;
 
   // Set maximum buffer size to the largest possible value of a 32-bit integer less (header size + 1).
   uint32_t  SMRingBuffer::maxSize = 4294967295u - (smHeaderSize + 1);
 
 
+  // Indices of the words used for blocking reads in the header.
+  enum {
+    WAITERS_WORD = 4,
+    WAKE_WORD = 5
+  };
+
+
   // Construction / destruction.
 
 #ifdef WIN32
@@ -392,6 +402,7 @@ namespace Radiant
     {
 //      error("SMRingBuffer::write # Insufficient space, %ul requested, %ul available.",
 //        (unsigned long)(numBytes), (unsigned long)(totalAvl));
+      setReadWriteState(prevReadWriteState);
       return 0;
     }
 
@@ -419,6 +430,8 @@ namespace Radiant
 
     setReadWriteState(prevReadWriteState);
 
+    wakeReaders();
+
     return numBytes;
   }
 
@@ -458,6 +471,7 @@ namespace Radiant
     uint32_t  firstAvl = 0;
     if(totalBytes > available(& firstAvl))
     {
+      setReadWriteState(prevReadWriteState);
       return 0;
     }
 
@@ -500,6 +514,8 @@ namespace Radiant
 
     setReadWriteState(prevReadWriteState);
 
+    wakeReaders();
+
     return totalBytes;
   }
 
@@ -512,6 +528,54 @@ namespace Radiant
     return write(2, ptrs, sizes);
   }
 
+  bool SMRingBuffer::waitForData(const uint32_t numBytes, const int timeoutMs)
+  {
+    TimeStamp start = TimeStamp::getTime();
+
+    volatile uint32_t * waiters = headerWord(WAITERS_WORD);
+    volatile uint32_t * wake = headerWord(WAKE_WORD);
+
+    while(used() < numBytes)
+    {
+      int left = -1;
+
+      if(timeoutMs >= 0)
+      {
+        left = timeoutMs - (int)(start.sinceSecondsD() * 1000.0);
+        if(left <= 0)
+        {
+          return false;
+        }
+      }
+
+      const uint32_t  seq = *wake;
+
+      // Atomic add is a full barrier, it pairs with the one in wakeReaders()
+      Atomic::add((volatile int *)(waiters), 1);
+
+      if(used() < numBytes)
+      {
+        Futex::wait(wake, seq, left);
+      }
+
+      Atomic::add((volatile int *)(waiters), -1);
+    }
+
+    return true;
+  }
+
+  void SMRingBuffer::wakeReaders()
+  {
+    // Publish the write position before checking for sleeping readers
+    Atomic::memoryBarrier();
+
+    if(*headerWord(WAITERS_WORD))
+    {
+      Atomic::add((volatile int *)(headerWord(WAKE_WORD)), 1);
+      Futex::wakeAll(headerWord(WAKE_WORD));
+    }
+  }
+
   uint32_t SMRingBuffer::peek(void * const dst, const uint32_t numBytes)
   {
     if(numBytes == 0)
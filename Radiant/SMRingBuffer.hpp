@@ -91,10 +91,10 @@ namespace Radiant
     static uint32_t   smDefaultPermissions;
 
     /// Size of header information preceding ring buffer in shared
-    /// memory.  The header contains 4 (x 32-bit integer) items that
+    /// memory.  The header contains 6 (x 32-bit integer) items that
     /// must be available to all sharing processes: buffer size,
-    /// write position, read position and read/write state, in that
-    /// order.
+    /// write position, read position, read/write state, number of
+    /// waiting readers and the wake-up word, in that order.
     static uint32_t   smHeaderSize;
 
     /// Maximum size in bytes of buffer.
@@ -187,6 +187,16 @@ namespace Radiant
     /// Return true if the ring buffer is full.
     bool isFull() const { return (available() == 0); }
 
+    /// Waits until at least numBytes bytes can be read
+    /** The reader sleeps in the kernel (see Radiant::Futex) until a
+        writer wakes it up. Writers make the wake-up system call only
+        when somebody is waiting.
+        @param numBytes Number of bytes to wait for
+        @param timeoutMs Maximum time to wait in milliseconds, negative
+        value waits indefinitely
+        @return true if the data is available */
+    bool waitForData(const uint32_t numBytes, const int timeoutMs);
+
 
     /// Reading and writing.
 
@@ -279,6 +289,13 @@ namespace Radiant
     /// Advance the read position.
     void advanceReadPos(const uint32_t advance) { setReadPos((readPos() + advance) % size()); }
 
+    /// Return a pointer to a header word.
+    volatile uint32_t * headerWord(const int index) const
+    { return (volatile uint32_t *)((m_startPtr - smHeaderSize) + sizeof(uint32_t) * index); }
+
+    /// Wake up the readers that wait for data, if there are any.
+    void wakeReaders();
+
 
     /// Attributes.
 
@@ -0,0 +1,169 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+
+#ifndef RADIANT_SOCKET_REACTOR_HPP
+#define RADIANT_SOCKET_REACTOR_HPP
+
+#include <Radiant/Export.hpp>
+#include <Radiant/Mutex.hpp>
+
+#include <Patterns/NotCopyable.hpp>
+
+#include <map>
+#include <vector>
+
+namespace Radiant {
+
+  class TCPServerSocket;
+  class TCPSocket;
+  class UDPSocket;
+
+  /// Event dispatcher for many sockets
+  /** The reactor waits for events on any number of sockets, and calls
+      the handler of a socket when there is something to do: a
+      connection to accept, data to read, or a closed connection. This
+      way one or a few threads can serve all the clients of a server,
+      instead of having a thread that polls each socket.
+
+      Writes to TCP sockets go through the reactor, and never block:
+      what cannot be written right away is queued, and written when the
+      socket can take more data.
+
+      One socket is never handled by two threads at the same time, so
+      the handlers of a socket do not need locking of their own. The
+      handlers may call write, read and remove from any thread.
+
+      The sockets are owned by the caller. A socket must be removed
+      from the reactor before it is deleted, either in one of its
+      handler callbacks or after stop().
+
+      The reactor uses epoll, and is available on Linux. */
+  class RADIANT_API SocketReactor : public Patterns::NotCopyable
+  {
+  public:
+
+    /// Receives the events of sockets
+    class RADIANT_API Handler
+    {
+    public:
+      virtual ~Handler();
+
+      /// Data is available on a TCP socket
+      /** The data should be read with SocketReactor::read, until it
+          returns zero. */
+      virtual void readable(SocketReactor & reactor, TCPSocket * socket);
+      /// Datagrams are available on a UDP socket
+      /** The datagrams should be read with UDPSocket::readMany or
+          UDPSocket::read, until there are no more. */
+      virtual void readable(SocketReactor & reactor, UDPSocket * socket);
+      /// A server socket accepted a new connection
+      /** The new socket is not in the reactor, the handler can add it,
+          or delete it. The default implementation deletes it. */
+      virtual void accepted(SocketReactor & reactor, TCPServerSocket * server,
+                            TCPSocket * socket);
+      /// A TCP connection was closed by the peer, or it failed
+      /** The socket has already been removed from the reactor. */
+      virtual void closed(SocketReactor & reactor, TCPSocket * socket);
+    };
+
+    /** @param threads The number of threads that start() launches */
+    SocketReactor(int threads = 1);
+    /// Stops the threads
+    ~SocketReactor();
+
+    /// Adds a socket to the reactor
+    /** @return false if the socket is not open, or is already in the
+        reactor */
+    bool add(TCPSocket * socket, Handler * handler);
+    /// Adds a socket to the reactor
+    bool add(UDPSocket * socket, Handler * handler);
+    /// Adds a socket to the reactor
+    bool add(TCPServerSocket * socket, Handler * handler);
+
+    /// Removes a socket from the reactor
+    /** Data that is still queued for the socket is dropped. */
+    void remove(TCPSocket * socket);
+    /// Removes a socket from the reactor
+    void remove(UDPSocket * socket);
+    /// Removes a socket from the reactor
+    void remove(TCPServerSocket * socket);
+
+    /// Reads data from a TCP socket, without blocking
+    /** @return The number of bytes read, zero if there was nothing to
+        read, and -1 if the connection was closed. In that case the
+        handler gets a closed() callback. */
+    int read(TCPSocket * socket, void * buffer, int bytes);
+    /// Writes data to a TCP socket, without blocking
+    /** The data that does not fit in the socket buffer is queued, and
+        written when the socket becomes writable.
+
+        @return false if the socket is not in the reactor, or the
+        connection has failed */
+    bool write(TCPSocket * socket, const void * buffer, int bytes);
+    /// Returns the number of bytes queued for the socket
+    size_t queuedBytes(TCPSocket * socket);
+
+    /// Starts the dispatching threads
+    bool start();
+    /// Stops the dispatching threads, and waits for them to finish
+    void stop();
+
+    /// Waits for events, and dispatches them in the calling thread
+    /** This can be used instead of start(), by applications that have
+        a loop of their own.
+        @param timeoutMs Maximum time to wait, negative waits until
+        something happens
+        @return The number of events dispatched */
+    int poll(int timeoutMs);
+
+    /// Returns the number of sockets in the reactor
+    int socketCount() const;
+
+  private:
+
+    class Entry;
+    class Worker;
+
+    enum Type {
+      TCP,
+      UDP,
+      SERVER
+    };
+
+    bool addEntry(int fd, Type type, void * socket, Handler * handler);
+    void removeEntry(const void * socket);
+    Entry * acquire(const void * socket);
+    Entry * acquireFd(int fd);
+    void release(Entry * entry);
+    void dispatch(int fd, int events);
+    void handle(Entry * entry, int events);
+    bool flush(Entry * entry);
+    void rearm(Entry * entry);
+    void loop();
+
+    mutable MutexAuto m_mutex;
+    std::map<int, Entry *> m_fds;
+    std::map<const void *, Entry *> m_sockets;
+
+    int m_epoll;
+    int m_wakeup;
+    volatile bool m_continue;
+    int m_threadCount;
+    std::vector<Worker *> m_workers;
+  };
+
+}
+
+#endif
@@ -0,0 +1,551 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+
+#include "SocketReactor.hpp"
+
+#include "TCPServerSocket.hpp"
+#include "TCPSocket.hpp"
+#include "Thread.hpp"
+#include "Trace.hpp"
+#include "UDPSocket.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace Radiant {
+
+  /* One socket in the reactor. The entries are reference counted, the
+     counts are changed with the reactor mutex locked. */
+  class SocketReactor::Entry
+  {
+  public:
+    Entry(int fd, Type type, void * socket, Handler * handler)
+      : m_fd(fd),
+      m_type(type),
+      m_socket(socket),
+      m_handler(handler),
+      m_refs(1),
+      m_outputPos(0),
+      m_dispatching(false),
+      m_events(0),
+      m_removed(false),
+      m_hungUp(false)
+    {}
+
+    int m_fd;
+    Type m_type;
+    void * m_socket;
+    Handler * m_handler;
+    int m_refs;
+
+    // The members below are protected by m_mutex
+    MutexAuto m_mutex;
+    std::vector<char> m_output;
+    size_t m_outputPos;
+    // A thread is running the handlers of the socket
+    bool m_dispatching;
+    // Events that arrived while the handlers were running
+    int m_events;
+    bool m_removed;
+    bool m_hungUp;
+  };
+
+  class SocketReactor::Worker : public Thread
+  {
+  public:
+    Worker(SocketReactor * host) : m_host(host) {}
+
+  protected:
+    virtual void childLoop() { m_host->loop(); }
+
+    SocketReactor * m_host;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////
+
+  SocketReactor::Handler::~Handler()
+  {}
+
+  void SocketReactor::Handler::readable(SocketReactor &, TCPSocket *)
+  {}
+
+  void SocketReactor::Handler::readable(SocketReactor &, UDPSocket *)
+  {}
+
+  void SocketReactor::Handler::accepted(SocketReactor &, TCPServerSocket *,
+                                        TCPSocket * socket)
+  {
+    delete socket;
+  }
+
+  void SocketReactor::Handler::closed(SocketReactor &, TCPSocket *)
+  {}
+
+  ////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////
+
+  SocketReactor::SocketReactor(int threads)
+    : m_continue(true),
+    m_threadCount(threads < 1 ? 1 : threads)
+  {
+    m_epoll = epoll_create(64);
+
+    if(m_epoll < 0)
+      error("SocketReactor::SocketReactor # epoll_create failed: %s",
+            strerror(errno));
+
+    // Wakes up the waiting threads, when the reactor is stopped
+    m_wakeup = eventfd(0, 0);
+
+    struct epoll_event ev;
+    memset( & ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wakeup;
+
+    if(m_wakeup < 0 || epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, & ev) < 0)
+      error("SocketReactor::SocketReactor # Could not set up the wake-up "
+            "descriptor: %s", strerror(errno));
+  }
+
+  SocketReactor::~SocketReactor()
+  {
+    stop();
+
+    for(std::map<int, Entry *>::iterator it = m_fds.begin();
+        it != m_fds.end(); it++)
+      delete it->second;
+
+    if(m_wakeup >= 0)
+      ::close(m_wakeup);
+    if(m_epoll >= 0)
+      ::close(m_epoll);
+  }
+
+  bool SocketReactor::add(TCPSocket * socket, Handler * handler)
+  {
+    return addEntry(socket->fd(), TCP, socket, handler);
+  }
+
+  bool SocketReactor::add(UDPSocket * socket, Handler * handler)
+  {
+    return addEntry(socket->fd(), UDP, socket, handler);
+  }
+
+  bool SocketReactor::add(TCPServerSocket * socket, Handler * handler)
+  {
+    return addEntry(socket->fd(), SERVER, socket, handler);
+  }
+
+  void SocketReactor::remove(TCPSocket * socket)
+  {
+    removeEntry(socket);
+  }
+
+  void SocketReactor::remove(UDPSocket * socket)
+  {
+    removeEntry(socket);
+  }
+
+  void SocketReactor::remove(TCPServerSocket * socket)
+  {
+    removeEntry(socket);
+  }
+
+  int SocketReactor::read(TCPSocket * socket, void * buffer, int bytes)
+  {
+    Entry * e = acquire(socket);
+
+    if(!e)
+      return -1;
+
+    int n = recv(e->m_fd, buffer, bytes, MSG_DONTWAIT);
+
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+      n = 0;
+    else if(n <= 0) {
+      // Zero bytes from a readable socket means that the peer closed it
+      Guard g( & e->m_mutex);
+      e->m_hungUp = true;
+      n = -1;
+    }
+
+    release(e);
+
+    return n;
+  }
+
+  bool SocketReactor::write(TCPSocket * socket, const void * buffer, int bytes)
+  {
+    Entry * e = acquire(socket);
+
+    if(!e)
+      return false;
+
+    bool ok;
+
+    {
+      Guard g( & e->m_mutex);
+
+      const char * data = (const char *) buffer;
+
+      e->m_output.insert(e->m_output.end(), data, data + bytes);
+
+      ok = flush(e);
+
+      // Wait for the socket to become writable
+      if(ok && e->m_outputPos < e->m_output.size() && !e->m_dispatching)
+        rearm(e);
+    }
+
+    release(e);
+
+    return ok;
+  }
+
+  size_t SocketReactor::queuedBytes(TCPSocket * socket)
+  {
+    Entry * e = acquire(socket);
+
+    if(!e)
+      return 0;
+
+    size_t n;
+
+    {
+      Guard g( & e->m_mutex);
+      n = e->m_output.size() - e->m_outputPos;
+    }
+
+    release(e);
+
+    return n;
+  }
+
+  bool SocketReactor::start()
+  {
+    if(!m_workers.empty())
+      return true;
+
+    m_continue = true;
+
+    bool ok = true;
+
+    for(int i = 0; i < m_threadCount; i++) {
+      Worker * w = new Worker(this);
+      m_workers.push_back(w);
+      ok = w->run() && ok;
+    }
+
+    return ok;
+  }
+
+  void SocketReactor::stop()
+  {
+    if(m_workers.empty())
+      return;
+
+    m_continue = false;
+
+    uint64_t one = 1;
+    if(::write(m_wakeup, & one, sizeof(one)) != sizeof(one))
+      error("SocketReactor::stop # Could not wake up the threads");
+
+    for(size_t i = 0; i < m_workers.size(); i++) {
+      m_workers[i]->waitEnd();
+      delete m_workers[i];
+    }
+
+    m_workers.clear();
+
+    // Reset the wake-up counter
+    if(::read(m_wakeup, & one, sizeof(one)) != sizeof(one))
+      error("SocketReactor::stop # Could not reset the wake-up descriptor");
+  }
+
+  int SocketReactor::poll(int timeoutMs)
+  {
+    enum { EVENTS = 64 };
+
+    struct epoll_event events[EVENTS];
+
+    int n = epoll_wait(m_epoll, events, EVENTS, timeoutMs);
+
+    if(n < 0) {
+      if(errno != EINTR)
+        error("SocketReactor::poll # epoll_wait failed: %s", strerror(errno));
+      return 0;
+    }
+
+    int dispatched = 0;
+
+    for(int i = 0; i < n; i++) {
+      // The wake-up descriptor stays readable until stop() resets it
+      if(events[i].data.fd == m_wakeup)
+        continue;
+
+      dispatch(events[i].data.fd, events[i].events);
+      dispatched++;
+    }
+
+    return dispatched;
+  }
+
+  int SocketReactor::socketCount() const
+  {
+    Guard g( & m_mutex);
+    return (int) m_fds.size();
+  }
+
+  bool SocketReactor::addEntry(int fd, Type type, void * socket,
+                               Handler * handler)
+  {
+    if(fd < 0 || m_epoll < 0)
+      return false;
+
+    Guard g( & m_mutex);
+
+    if(m_fds.find(fd) != m_fds.end() || m_sockets.find(socket) != m_sockets.end())
+      return false;
+
+    Entry * e = new Entry(fd, type, socket, handler);
+
+    struct epoll_event ev;
+    memset( & ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = fd;
+
+    if(epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, & ev) < 0) {
+      error("SocketReactor::add # epoll_ctl failed: %s", strerror(errno));
+      delete e;
+      return false;
+    }
+
+    m_fds[fd] = e;
+    m_sockets[socket] = e;
+
+    return true;
+  }
+
+  void SocketReactor::removeEntry(const void * socket)
+  {
+    Entry * e = 0;
+
+    {
+      Guard g( & m_mutex);
+
+      std::map<const void *, Entry *>::iterator it = m_sockets.find(socket);
+
+      if(it == m_sockets.end())
+        return;
+
+      e = it->second;
+      m_sockets.erase(it);
+      m_fds.erase(e->m_fd);
+
+      epoll_ctl(m_epoll, EPOLL_CTL_DEL, e->m_fd, 0);
+    }
+
+    {
+      Guard g( & e->m_mutex);
+      e->m_removed = true;
+    }
+
+    release(e);
+  }
+
+  SocketReactor::Entry * SocketReactor::acquire(const void * socket)
+  {
+    Guard g( & m_mutex);
+
+    std::map<const void *, Entry *>::iterator it = m_sockets.find(socket);
+
+    if(it == m_sockets.end())
+      return 0;
+
+    it->second->m_refs++;
+
+    return it->second;
+  }
+
+  SocketReactor::Entry * SocketReactor::acquireFd(int fd)
+  {
+    Guard g( & m_mutex);
+
+    std::map<int, Entry *>::iterator it = m_fds.find(fd);
+
+    if(it == m_fds.end())
+      return 0;
+
+    it->second->m_refs++;
+
+    return it->second;
+  }
+
+  void SocketReactor::release(Entry * entry)
+  {
+    bool last;
+
+    {
+      Guard g( & m_mutex);
+      last = --entry->m_refs == 0;
+    }
+
+    if(last)
+      delete entry;
+  }
+
+  void SocketReactor::dispatch(int fd, int events)
+  {
+    Entry * e = acquireFd(fd);
+
+    if(!e)
+      return;
+
+    {
+      Guard g( & e->m_mutex);
+
+      /* Another thread is running the handlers (the socket was re-armed
+         by write), it will handle these events as well. */
+      if(e->m_dispatching) {
+        e->m_events |= events;
+        release(e);
+        return;
+      }
+
+      e->m_dispatching = true;
+    }
+
+    for(;;) {
+      handle(e, events);
+
+      Guard g( & e->m_mutex);
+
+      events = e->m_events;
+      e->m_events = 0;
+
+      if(!events || e->m_removed) {
+        e->m_dispatching = false;
+        if(!e->m_removed)
+          rearm(e);
+        break;
+      }
+    }
+
+    release(e);
+  }
+
+  void SocketReactor::handle(Entry * e, int events)
+  {
+    if(events & EPOLLOUT) {
+      Guard g( & e->m_mutex);
+      flush(e);
+    }
+
+    if(events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+      if(e->m_type == TCP)
+        e->m_handler->readable(*this, (TCPSocket *) e->m_socket);
+      else if(e->m_type == UDP)
+        e->m_handler->readable(*this, (UDPSocket *) e->m_socket);
+      else {
+        TCPServerSocket * server = (TCPServerSocket *) e->m_socket;
+
+        while(server->isPendingConnection(0)) {
+          TCPSocket * socket = server->accept();
+
+          if(!socket)
+            break;
+
+          e->m_handler->accepted(*this, server, socket);
+        }
+      }
+    }
+
+    if(e->m_type != TCP)
+      return;
+
+    bool closed;
+
+    {
+      Guard g( & e->m_mutex);
+      closed = e->m_hungUp && !e->m_removed;
+    }
+
+    if(closed) {
+      removeEntry(e->m_socket);
+      e->m_handler->closed(*this, (TCPSocket *) e->m_socket);
+    }
+  }
+
+  bool SocketReactor::flush(Entry * e)
+  {
+    while(e->m_outputPos < e->m_output.size()) {
+      int n = send(e->m_fd, & e->m_output[e->m_outputPos],
+                   e->m_output.size() - e->m_outputPos,
+                   MSG_DONTWAIT | MSG_NOSIGNAL);
+
+      if(n < 0) {
+        if(errno == EINTR)
+          continue;
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+
+        e->m_hungUp = true;
+        e->m_output.clear();
+        e->m_outputPos = 0;
+        return false;
+      }
+
+      e->m_outputPos += n;
+    }
+
+    if(e->m_outputPos == e->m_output.size()) {
+      e->m_output.clear();
+      e->m_outputPos = 0;
+    }
+    else if(e->m_outputPos > e->m_output.size() / 2) {
+      // Drop the written bytes from the front of the queue
+      e->m_output.erase(e->m_output.begin(),
+                        e->m_output.begin() + e->m_outputPos);
+      e->m_outputPos = 0;
+    }
+
+    return true;
+  }
+
+  void SocketReactor::rearm(Entry * e)
+  {
+    struct epoll_event ev;
+    memset( & ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    if(e->m_outputPos < e->m_output.size())
+      ev.events |= EPOLLOUT;
+    ev.data.fd = e->m_fd;
+
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, e->m_fd, & ev);
+  }
+
+  void SocketReactor::loop()
+  {
+    while(m_continue)
+      poll(-1);
+  }
+
+}
@@ -42,6 +42,9 @@ namespace Radiant {
     /// Returns true of the socket is open.
     bool isOpen() const;
 
+    /// Returns the file descriptor of the socket, or -1 if it is closed
+    int fd() const;
+
     const char * host() const;
     int port() const;
 
@@ -111,6 +111,11 @@ namespace Radiant
     return (m_d->m_fd > 0);
   }
 
+  int TCPServerSocket::fd() const
+  {
+    return m_d->m_fd;
+  }
+
   bool TCPServerSocket::isPendingConnection(unsigned int waitMicroSeconds)
   {
     if(m_d->m_fd < 0)
@@ -31,6 +31,8 @@ namespace Radiant
   public:
     D() : QTcpServer() {}
 
+    bool hasPendingConnection() const { return !m_fds.empty(); }
+
     int pendingConnection() {
       if(m_fds.empty()) return -1;
 
@@ -94,9 +96,18 @@ namespace Radiant
   {
     return m_d->isListening();
   }
+
+  int TCPServerSocket::fd() const
+  {
+    return (int) m_d->socketDescriptor();
+  }
  
   bool TCPServerSocket::isPendingConnection(unsigned int waitMicroSeconds)
   {
+    // Connections that were queued earlier, but not accepted yet
+    if(m_d->hasPendingConnection())
+      return true;
+
     return m_d->waitForNewConnection(waitMicroSeconds / 1000);
   }
 
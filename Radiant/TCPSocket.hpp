@@ -50,6 +50,11 @@ namespace Radiant {
     /// Returns true of the socket is open.
     bool isOpen() const;
 
+    /// Returns the file descriptor of the socket, or -1 if it is closed
+    /** This method is potentially non-portable as not all platforms
+        use file descriptors to handle sockets. */
+    int fd() const;
+
     const char * host() const;
     int port() const;
 
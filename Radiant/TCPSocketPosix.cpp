@@ -118,6 +118,11 @@ namespace Radiant
     return (m_d->m_fd > 0);
   }
 
+  int TCPSocket::fd() const
+  {
+    return m_d->m_fd;
+  }
+
   int TCPSocket::read(void * buffer, int bytes, bool waitfordata)
   {
     if(m_d->m_fd < 0)
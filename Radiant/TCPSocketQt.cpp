@@ -115,6 +115,11 @@ namespace Radiant
     return m_d->isValid();
   }
 
+  int TCPSocket::fd() const
+  {
+    return (int) m_d->socketDescriptor();
+  }
+
   const char * TCPSocket::host() const
   {
     return m_d->peerName().toAscii();
@@ -0,0 +1,164 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#include "ThreadPool.hpp"
+
+#include "Atomic.hpp"
+#include "PlatformUtils.hpp"
+#include "Thread.hpp"
+#include "Trace.hpp"
+
+namespace Radiant {
+
+  class ThreadPool::Worker : public Thread
+  {
+  public:
+    Worker(ThreadPool * host) : m_host(host) {}
+
+  protected:
+    virtual void childLoop() { m_host->workerLoop(); }
+
+    ThreadPool * m_host;
+  };
+
+  ThreadPool::ThreadPool(int threads)
+    : m_started(false),
+    m_continue(true),
+    m_job(0),
+    m_count(0),
+    m_generation(0),
+    m_active(0),
+    m_next(0)
+  {
+    if(threads < 0)
+      threads = PlatformUtils::getNumberOfCPUs() - 1;
+
+    for(int i = 0; i < threads; i++)
+      m_workers.push_back(new Worker(this));
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    m_mutex.lock();
+    m_continue = false;
+    m_wake.wakeAll();
+    m_mutex.unlock();
+
+    for(size_t i = 0; i < m_workers.size(); i++) {
+      if(m_workers[i]->isRunning())
+        m_workers[i]->waitEnd();
+      delete m_workers[i];
+    }
+  }
+
+  void ThreadPool::run(Job & job, int count)
+  {
+    if(count <= 0)
+      return;
+
+    /* With a single item, no workers or a busy pool the calling thread
+       does all the work. */
+    if(count == 1 || m_workers.empty() || !m_runMutex.tryLock()) {
+      for(int i = 0; i < count; i++)
+        job.runItem(i);
+      return;
+    }
+
+    start();
+
+    m_mutex.lock();
+    m_job = & job;
+    m_count = count;
+    m_next = 0;
+    m_generation++;
+    m_wake.wakeAll();
+    m_mutex.unlock();
+
+    runItems( & job, count);
+
+    /* All the items have been claimed. Wait for the workers that are
+       still processing theirs, late workers see that there is no job. */
+    m_mutex.lock();
+    while(m_active > 0)
+      m_done.wait(m_mutex);
+    m_job = 0;
+    m_mutex.unlock();
+
+    m_runMutex.unlock();
+  }
+
+  ThreadPool & ThreadPool::instance()
+  {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  void ThreadPool::workerLoop()
+  {
+    int generation = 0;
+
+    m_mutex.lock();
+
+    while(m_continue) {
+
+      if(m_job && m_generation != generation) {
+        generation = m_generation;
+
+        Job * job = m_job;
+        int count = m_count;
+        m_active++;
+        m_mutex.unlock();
+
+        runItems(job, count);
+
+        m_mutex.lock();
+        if(--m_active == 0)
+          m_done.wakeAll();
+      }
+      else
+        m_wake.wait(m_mutex);
+    }
+
+    m_mutex.unlock();
+  }
+
+  void ThreadPool::runItems(Job * job, int count)
+  {
+    for(;;) {
+      int index = Atomic::add( & m_next, 1) - 1;
+      if(index >= count)
+        break;
+      job->runItem(index);
+    }
+  }
+
+  void ThreadPool::start()
+  {
+    if(m_started)
+      return;
+
+    /* Called with m_runMutex locked. Workers that fail to start simply
+       do not take part, the calling thread processes their share. */
+    bool ok = true;
+
+    for(size_t i = 0; i < m_workers.size(); i++)
+      ok = m_workers[i]->run() && ok;
+
+    if(!ok)
+      Radiant::error("ThreadPool::start # Could not start all the worker threads");
+
+    m_started = true;
+  }
+
+}
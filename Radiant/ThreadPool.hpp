@@ -0,0 +1,102 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#ifndef RADIANT_THREAD_POOL_HPP
+#define RADIANT_THREAD_POOL_HPP
+
+#include <Radiant/Condition.hpp>
+#include <Radiant/Export.hpp>
+#include <Radiant/Mutex.hpp>
+
+#include <Patterns/NotCopyable.hpp>
+
+#include <vector>
+
+namespace Radiant {
+
+  /// A pool of worker threads for data-parallel jobs
+  /** A job is split into a number of work items that are processed by
+      the worker threads and the calling thread. run() returns once all
+      the items have been processed. The workers are started when the
+      pool is first used, and they sleep between jobs, so the same pool
+      can be used for every video frame without creating threads.
+
+      The pool runs one job at a time. If another thread is already
+      running a job, run() processes the items on the calling thread
+      instead of waiting for the pool. */
+  class RADIANT_API ThreadPool : public Patterns::NotCopyable
+  {
+  public:
+
+    /// A job that is split into independent work items
+    class RADIANT_API Job
+    {
+    public:
+      virtual ~Job() {}
+      /// Processes one work item, index is in the range [0, count)
+      /** This function is called from several threads at the same
+          time, with different indices. */
+      virtual void runItem(int index) = 0;
+    };
+
+    /** Creates the pool. The threads are started on first use.
+
+        @param threads The number of worker threads. If the value is
+        negative, one thread less than the number of CPUs is used (the
+        calling thread makes up for the last CPU). */
+    ThreadPool(int threads = -1);
+    /// Stops the worker threads
+    ~ThreadPool();
+
+    /// Runs job.runItem() for each index in [0, count)
+    /** Returns when all the items have been processed. */
+    void run(Job & job, int count);
+
+    /// Returns the number of worker threads
+    int threadCount() const { return (int) m_workers.size(); }
+
+    /// Returns a pool that is shared by the whole application
+    static ThreadPool & instance();
+
+  private:
+
+    class Worker;
+
+    void workerLoop();
+    void runItems(Job * job, int count);
+    void start();
+
+    MutexAuto m_mutex;
+    // Serializes run() calls
+    MutexAuto m_runMutex;
+    Condition m_wake;
+    Condition m_done;
+
+    std::vector<Worker *> m_workers;
+    bool m_started;
+    bool m_continue;
+
+    // The current job, protected by m_mutex
+    Job * m_job;
+    int m_count;
+    int m_generation;
+    // Number of workers that are processing the current job
+    int m_active;
+    // Index of the next unclaimed work item
+    volatile int m_next;
+  };
+
+}
+
+#endif
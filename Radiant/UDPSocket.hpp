@@ -38,6 +38,23 @@ namespace Radiant
   class RADIANT_API UDPSocket : public Radiant::BinaryStream
   {
   public:
+
+    /// A buffer for one datagram, for readMany and writeMany
+    class Datagram
+    {
+    public:
+      Datagram(void * data = 0, int size = 0)
+        : m_data(data), m_size(size), m_length(0) {}
+
+      /// The datagram data
+      void * m_data;
+      /// The size of the buffer when reading, the size of the datagram
+      /// when writing
+      int    m_size;
+      /// The length of the received datagram, set by readMany
+      int    m_length;
+    };
+
     UDPSocket();
     UDPSocket(int fd);
     ~UDPSocket();
@@ -59,6 +76,9 @@ namespace Radiant
     bool close();
     
     bool isOpen() const;
+
+    /// Returns the file descriptor of the socket, or -1 if it is closed
+    int fd() const;
     
     /** Reads one datagram packet from the socket. 
 
@@ -77,6 +97,32 @@ namespace Radiant
     
     */
     int write(const void * buffer, int bytes);
+
+    /** Reads several datagram packets from the socket.
+
+        Each packet goes to its own buffer, and its length is stored in
+        Datagram::m_length. A packet that does not fit in its buffer is
+        truncated. On Linux all the packets are read with a single
+        recvmmsg system call (per 64 packets), elsewhere read() is
+        called in a loop.
+
+        @param datagrams The buffers for the packets
+        @param count The number of buffers
+        @param waitfordata If true, waits until at least one packet
+        is available
+        @return The number of packets read, or -1 on error. If there
+        was nothing to read, then zero is returned.
+    */
+    int readMany(Datagram * datagrams, int count, bool waitfordata = false);
+
+    /** Writes several datagram packets to the socket.
+
+        On Linux the packets are sent with a single sendmmsg system
+        call (per 64 packets), elsewhere write() is called in a loop.
+
+        @return The number of packets written, or -1 on error.
+    */
+    int writeMany(const Datagram * datagrams, int count);
     
   private:
     class D;
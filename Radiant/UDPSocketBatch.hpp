@@ -0,0 +1,143 @@
+/* COPYRIGHT
+ *
+ * This file is part of Radiant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Radiant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in 
+ * file "LGPL.txt" that is distributed with this source package or obtained 
+ * from the GNU organization (www.gnu.org).
+ * 
+ */
+
+#ifndef RADIANT_UDP_SOCKET_BATCH_HPP
+#define RADIANT_UDP_SOCKET_BATCH_HPP
+
+// Batched datagram IO on Linux, shared by the UDPSocket implementations
+
+#ifdef __linux__
+
+#include <Radiant/UDPSocket.hpp>
+
+#include <errno.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+namespace Radiant
+{
+
+  namespace UDPSocketBatch
+  {
+    enum {
+      /// Maximum number of datagrams per system call
+      BATCH = 64
+    };
+
+    /// Reads datagrams with recvmmsg
+    inline int readMany(int fd, UDPSocket::Datagram * datagrams, int count,
+                        bool waitfordata)
+    {
+      if(waitfordata) {
+        // The socket may be non-blocking, so wait with poll
+        struct pollfd pfd;
+        bzero( & pfd, sizeof(pfd));
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+
+        if(poll( & pfd, 1, -1) < 0 && errno != EINTR)
+          return -1;
+      }
+
+      struct mmsghdr msgs[BATCH];
+      struct iovec iovs[BATCH];
+      int got = 0;
+
+      while(got < count) {
+        int n = count - got;
+        if(n > BATCH)
+          n = BATCH;
+
+        bzero(msgs, n * sizeof(msgs[0]));
+
+        for(int i = 0; i < n; i++) {
+          iovs[i].iov_base = datagrams[got + i].m_data;
+          iovs[i].iov_len = datagrams[got + i].m_size;
+          msgs[i].msg_hdr.msg_iov = & iovs[i];
+          msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int r = recvmmsg(fd, msgs, n, MSG_DONTWAIT, 0);
+
+        if(r < 0) {
+          if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            break;
+          return got ? got : -1;
+        }
+
+        for(int i = 0; i < r; i++)
+          datagrams[got + i].m_length = msgs[i].msg_len;
+
+        got += r;
+
+        // The socket has been emptied
+        if(r < n)
+          break;
+      }
+
+      return got;
+    }
+
+    /// Writes datagrams with sendmmsg, to the given address or to the
+    /// connected peer
+    inline int writeMany(int fd, const struct sockaddr * to, socklen_t tolen,
+                         const UDPSocket::Datagram * datagrams, int count)
+    {
+      struct mmsghdr msgs[BATCH];
+      struct iovec iovs[BATCH];
+      int sent = 0;
+
+      while(sent < count) {
+        int n = count - sent;
+        if(n > BATCH)
+          n = BATCH;
+
+        bzero(msgs, n * sizeof(msgs[0]));
+
+        for(int i = 0; i < n; i++) {
+          iovs[i].iov_base = datagrams[sent + i].m_data;
+          iovs[i].iov_len = datagrams[sent + i].m_size;
+          msgs[i].msg_hdr.msg_name = (void *) to;
+          msgs[i].msg_hdr.msg_namelen = to ? tolen : 0;
+          msgs[i].msg_hdr.msg_iov = & iovs[i];
+          msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int r = sendmmsg(fd, msgs, n, 0);
+
+        if(r < 0) {
+          if(errno == EINTR)
+            continue;
+          return sent ? sent : -1;
+        }
+
+        sent += r;
+
+        // The send buffer is full
+        if(r < n)
+          break;
+      }
+
+      return sent;
+    }
+  }
+
+}
+
+#endif
+
+#endif
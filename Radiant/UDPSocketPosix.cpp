@@ -14,6 +14,7 @@
  */
 
 #include "UDPSocket.hpp"
+#include "UDPSocketBatch.hpp"
 #include "TCPSocket.hpp"
 #include "Trace.hpp"
 
@@ -26,6 +27,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <strings.h>
+#include <unistd.h>
 
 namespace Radiant
 {
@@ -139,6 +141,11 @@ namespace Radiant
     return (m_d->m_fd > 0);
   }
 
+  int UDPSocket::fd() const
+  {
+    return m_d->m_fd;
+  }
+
   int UDPSocket::read(void * buffer, int bytes, bool waitfordata)
   {
     if(m_d->m_fd < 0) 
@@ -176,4 +183,60 @@ namespace Radiant
                   sizeof(m_d->m_server));
   }
 
+  int UDPSocket::readMany(Datagram * datagrams, int count, bool waitfordata)
+  {
+    if(m_d->m_fd < 0)
+      return -1;
+
+#ifdef __linux__
+    return UDPSocketBatch::readMany(m_d->m_fd, datagrams, count, waitfordata);
+#else
+    int got = 0;
+
+    for( ; got < count; got++) {
+      struct pollfd pfd;
+      bzero( & pfd, sizeof(pfd));
+
+      pfd.fd = m_d->m_fd;
+      pfd.events = POLLIN;
+      poll(&pfd, 1, (waitfordata && !got) ? -1 : 0);
+
+      if(!(pfd.revents & POLLIN))
+        break;
+
+      Datagram & d = datagrams[got];
+      int n = recvfrom(m_d->m_fd, d.m_data, d.m_size, 0, 0, 0);
+
+      if(n < 0)
+        return got ? got : -1;
+
+      d.m_length = n;
+    }
+
+    return got;
+#endif
+  }
+
+  int UDPSocket::writeMany(const Datagram * datagrams, int count)
+  {
+    if(m_d->m_fd < 0)
+      return -1;
+
+#ifdef __linux__
+    return UDPSocketBatch::writeMany(m_d->m_fd,
+                                     (const sockaddr *) & m_d->m_server,
+                                     sizeof(m_d->m_server),
+                                     datagrams, count);
+#else
+    int sent = 0;
+
+    for( ; sent < count; sent++) {
+      if(write(datagrams[sent].m_data, datagrams[sent].m_size) < 0)
+        return sent ? sent : -1;
+    }
+
+    return sent;
+#endif
+  }
+
 }
@@ -14,6 +14,7 @@
  */
 
 #include "UDPSocket.hpp"
+#include "UDPSocketBatch.hpp"
 #include "Trace.hpp"
 
 #include <QUdpSocket>
@@ -85,6 +86,11 @@ namespace Radiant
     return m_d->isValid();
   }
 
+  int UDPSocket::fd() const
+  {
+    return (int) m_d->socketDescriptor();
+  }
+
   static inline bool __stateOk(QAbstractSocket::SocketState s)
   {
 	return (s == QAbstractSocket::ConnectedState) ||
@@ -128,6 +134,55 @@ namespace Radiant
   {
     return m_d->write((const char *)buffer, bytes);
   }
+
+  int UDPSocket::readMany(Datagram * datagrams, int count, bool waitForData)
+  {
+    if(!__stateOk(m_d->state())) {
+      error("UDPSocket::readMany # Socket not connected # %d",
+            (int) m_d->state());
+      return -1;
+    }
+
+#ifdef __linux__
+    return UDPSocketBatch::readMany((int) m_d->socketDescriptor(),
+                                    datagrams, count, waitForData);
+#else
+    if(waitForData && !m_d->hasPendingDatagrams())
+      m_d->waitForReadyRead(-1);
+
+    int got = 0;
+
+    for( ; got < count && m_d->hasPendingDatagrams(); got++) {
+      Datagram & d = datagrams[got];
+      int n = (int) m_d->readDatagram((char *) d.m_data, d.m_size);
+
+      if(n < 0)
+        return got ? got : -1;
+
+      d.m_length = n;
+    }
+
+    return got;
+#endif
+  }
+
+  int UDPSocket::writeMany(const Datagram * datagrams, int count)
+  {
+#ifdef __linux__
+    // The socket is connected to the peer, no address is needed
+    return UDPSocketBatch::writeMany((int) m_d->socketDescriptor(), 0, 0,
+                                     datagrams, count);
+#else
+    int sent = 0;
+
+    for( ; sent < count; sent++) {
+      if(write(datagrams[sent].m_data, datagrams[sent].m_size) < 0)
+        return sent ? sent : -1;
+    }
+
+    return sent;
+#endif
+  }
  
 }
 
@@ -159,6 +159,9 @@ namespace Radiant {
       rowbytes[1]  = rowbytes[2]  = 0;
       rowbytes[0]  = m_width + m_width / 2;
     }
+    else if(m_format == IMAGE_YUV_411P) {
+      rowbytes[1]  = rowbytes[2]  = m_width / 4;
+    }
     else if(m_format == IMAGE_YUV_420) {
       linecount[1] = linecount[2] = 0;
       rowbytes[1]  = rowbytes[2]  = 0;
@@ -19,9 +19,18 @@
 #include "ModuleOutCollect.hpp"
 #include "ModuleSamplePlayer.hpp"
 
+#include <Radiant/Atomic.hpp>
 #include <Radiant/FixedStr.hpp>
+#include <Radiant/PlatformUtils.hpp>
+#include <Radiant/Thread.hpp>
 #include <Radiant/Trace.hpp>
 
+#ifndef WIN32
+#include <Radiant/Futex.hpp>
+#else
+#include <Radiant/Semaphore.hpp>
+#endif
+
 #include <algorithm>
 #include <typeinfo>
 
@@ -34,6 +43,104 @@ namespace Resonant {
 
   using namespace Radiant;
 
+  /* Number of times a worker polls for new work before it goes to
+     sleep. */
+  static const int WORKER_SPINS = 4000;
+
+  /* Items sorted by dependency level, for one version of the graph. */
+  class DSPNetwork::Schedule
+  {
+  public:
+    Schedule() : m_version(0), m_parallel(false), m_next(0) {}
+
+    int m_version;
+    std::vector<Item *> m_items;
+    // Index of the last item of each level, plus one
+    std::vector<int> m_levelEnds;
+    bool m_parallel;
+    // Link in the list of retired schedules
+    Schedule * m_next;
+  };
+
+  /* Wakes up threads without taking a mutex, so that the audio thread
+     can use it. The waiter reads value(), checks its condition, and
+     waits for the value to change. */
+  class DSPNetwork::Signal
+  {
+  public:
+    Signal() : m_word(0), m_sleeping(0) {}
+
+    uint32_t value() const { return m_word; }
+
+    void wait(uint32_t seen)
+    {
+      Atomic::add( & m_sleeping, 1);
+
+      while(m_word == seen) {
+#ifndef WIN32
+        Futex::wait( & m_word, seen, -1);
+#else
+        m_semaphore.acquire();
+#endif
+      }
+
+      Atomic::add( & m_sleeping, -1);
+    }
+
+    void wake()
+    {
+      Atomic::add((volatile int *) & m_word, 1);
+
+      int sleeping = m_sleeping;
+
+      if(sleeping) {
+#ifndef WIN32
+        Futex::wakeAll( & m_word);
+#else
+        m_semaphore.release(sleeping);
+#endif
+      }
+    }
+
+  private:
+    volatile uint32_t m_word;
+    volatile int m_sleeping;
+#ifdef WIN32
+    Radiant::Semaphore m_semaphore;
+#endif
+  };
+
+  /* Thread that helps the audio thread to process each dependency
+     level. */
+  class DSPNetwork::Worker : public Radiant::Thread
+  {
+  public:
+    Worker(DSPNetwork * network) : m_network(network) {}
+
+    virtual void childLoop()
+    {
+      // Try to match the audio thread; this fails without privileges
+      Radiant::Thread::setThreadRealTimePriority(40);
+      m_network->workerLoop();
+    }
+
+  private:
+    DSPNetwork * m_network;
+  };
+
+  /* Thread that builds the schedules, so that the audio thread does
+     not need to allocate memory or analyze the graph. */
+  class DSPNetwork::Planner : public Radiant::Thread
+  {
+  public:
+    Planner(DSPNetwork * network) : m_network(network) {}
+
+    virtual void childLoop() { m_network->planLoop(); }
+
+  private:
+    DSPNetwork * m_network;
+  };
+
   DSPNetwork::Item::Item()
     : m_module(0),
       m_compiled(false),
@@ -115,8 +222,31 @@ namespace Resonant {
   DSPNetwork::DSPNetwork()
     : // m_continue(false),
     m_panner(0),
-    m_doneCount(0)
+    m_controls(CONTROL_QUEUE_SIZE, MAX_CONTROL_BYTES,
+               Radiant::MessageRing::MULTIPLE_PRODUCERS),
+    m_doneCount(0),
+    m_graphVersion(0),
+    m_parallelThreshold(8),
+    m_snapshotState(SNAPSHOT_FREE),
+    m_snapshotVersion(-1),
+    m_snapshotItems(0),
+    m_snapshotPorts(0),
+    m_schedule(0),
+    m_nextSchedule(0),
+    m_retired(0),
+    m_planner(0),
+    m_planSignal(new Signal()),
+    m_workerCount(0),
+    m_claim(0),
+    m_inflight(0),
+    m_workersRun(false),
+    m_active(0),
+    m_cycleFrames(0),
+    m_workSignal(new Signal())
   {
+    m_workerCount = Nimble::Math::Clamp
+      (Radiant::PlatformUtils::getNumberOfCPUs() - 1, 0, 3);
+
     m_devName[0] = 0;
     m_collect = new ModuleOutCollect(0, this);
     m_collect->setId("outcollect");
@@ -135,6 +265,11 @@ namespace Resonant {
     if(m_instance == this)
       m_instance = 0;
 
+    stopWorkers();
+
+    delete m_planSignal;
+    delete m_workSignal;
+
     for(uint i = 0; i < m_buffers.size(); i++)
       m_buffers[i].clear();
 
@@ -154,6 +289,8 @@ namespace Resonant {
 
     // m_continue = true;
 
+    startWorkers();
+
     return startReadWrite(44100, 2);
   }
 
@@ -178,10 +315,9 @@ namespace Resonant {
       error("DSPNetwork::markDone # Failed for \"%s\"", i.m_module->id());
   }
 
-  void DSPNetwork::send(Radiant::BinaryData & control)
+  bool DSPNetwork::send(Radiant::BinaryData & control)
   {
-    Radiant::Guard g( & m_inMutex);
-    m_incoming.append(control);
+    return m_controls.write(control);
   }
 
   ModuleSamplePlayer * DSPNetwork::samplePlayer()
@@ -240,56 +376,409 @@ namespace Resonant {
     checkNewItems();
     checkNewControl();
 
+    if(!m_workers.empty()) {
+      takeSchedule();
+
+      if(!m_schedule || m_schedule->m_version != m_graphVersion)
+        takeSnapshot();
+    }
+
+    if(m_schedule && m_schedule->m_version == m_graphVersion &&
+       m_schedule->m_parallel) {
+      processParallel(cycle);
+    }
+    else {
+      for(iterator it = m_items.begin(); it != m_items.end(); it++) {
+        Item & item = (*it);
+        /*
+           Module * m = item.m_module;
+           trace("DSPNetwork::doCycle # Processing %p %s", m, typeid(*m).name());
+           */
+        item.process(cycle);
+      }
+    }
+
+    checkDoneItems();
+
+  }
+
+  /* Copies the buffer pointers of the graph for the planner. Called
+     from the audio thread, so nothing is allocated: if the arrays are
+     too small, the planner grows them and the snapshot is taken again
+     on a later cycle. */
+  void DSPNetwork::takeSnapshot()
+  {
+    if(m_snapshotState != SNAPSHOT_FREE || m_snapshotVersion == m_graphVersion)
+      return;
+
+    Radiant::Atomic::memoryBarrier();
+
+    int items = 0;
+    int ports = 0;
+
     for(iterator it = m_items.begin(); it != m_items.end(); it++) {
       Item & item = (*it);
-      /*
-         Module * m = item.m_module;
-         trace("DSPNetwork::doCycle # Processing %p %s", m, typeid(*m).name());
-         */
-      item.process(cycle);
+      int n = item.m_ins.size() + item.m_outs.size();
+
+      if(items < (int) m_snapItems.size() &&
+         ports + n <= (int) m_snapPorts.size()) {
+        m_snapItems[items] = & item;
+        m_snapCounts[items * 2] = item.m_ins.size();
+        m_snapCounts[items * 2 + 1] = item.m_outs.size();
+
+        for(unsigned k = 0; k < item.m_ins.size(); k++)
+          m_snapPorts[ports + k] = item.m_ins[k];
+        for(unsigned k = 0; k < item.m_outs.size(); k++)
+          m_snapPorts[ports + item.m_ins.size() + k] = item.m_outs[k];
+      }
+
+      items++;
+      ports += n;
     }
 
-    checkDoneItems();
+    if(items > (int) m_snapItems.size() || ports > (int) m_snapPorts.size()) {
+      // Tell the planner how much space is needed
+      m_snapshotItems = -items;
+      m_snapshotPorts = -ports;
+    }
+    else {
+      m_snapshotItems = items;
+      m_snapshotPorts = ports;
+      m_snapshotVersion = m_graphVersion;
+    }
 
+    Radiant::Atomic::memoryBarrier();
+    m_snapshotState = SNAPSHOT_READY;
+    m_planSignal->wake();
   }
 
-  void DSPNetwork::checkNewControl()
+  /* Takes a new schedule from the planner, if one is ready. Called from
+     the audio thread. */
+  void DSPNetwork::takeSchedule()
   {
-    {
-      Radiant::Guard g( & m_inMutex);
-      m_incopy = m_incoming;
-      m_incoming.rewind();
+    if(!m_nextSchedule)
+      return;
+
+    Schedule * s = Radiant::Atomic::exchangePtr( & m_nextSchedule,
+                                                 (Schedule *) 0);
+
+    if(!s)
+      return;
+
+    if(s->m_version != m_graphVersion) {
+      // The graph has changed again
+      retire(s);
+      return;
     }
 
-    int sentinel = m_incopy.pos();
+    if(m_schedule)
+      retire(m_schedule);
 
-    m_incopy.rewind();
+    m_schedule = s;
+  }
 
-    char buf[512];
+  /* Hands the schedule to the planner for deleting. */
+  void DSPNetwork::retire(Schedule * s)
+  {
+    Schedule * head;
 
-    FixedStrT<512> id;
+    do {
+      head = m_retired;
+      s->m_next = head;
+    } while(!Radiant::Atomic::compareAndSwapPtr( & m_retired, head, s));
+  }
+
+  void DSPNetwork::planLoop()
+  {
+    while(m_workersRun) {
+      uint32_t seen = m_planSignal->value();
+
+      if(m_snapshotState == SNAPSHOT_READY) {
+        Radiant::Atomic::memoryBarrier();
+
+        Schedule * s = 0;
+
+        if(m_snapshotItems < 0) {
+          // Grow the snapshot, with some room for later additions
+          m_snapItems.resize(-m_snapshotItems * 2);
+          m_snapCounts.resize(-m_snapshotItems * 4);
+          m_snapPorts.resize(-m_snapshotPorts * 2);
+        }
+        else
+          s = buildSchedule();
+
+        Radiant::Atomic::memoryBarrier();
+        m_snapshotState = SNAPSHOT_FREE;
+
+        if(s)
+          delete Radiant::Atomic::exchangePtr( & m_nextSchedule, s);
+      }
+
+      Schedule * r = Radiant::Atomic::exchangePtr( & m_retired, (Schedule *) 0);
+
+      while(r) {
+        Schedule * next = r->m_next;
+        delete r;
+        r = next;
+      }
+
+      if(m_snapshotState != SNAPSHOT_READY && m_workersRun)
+        m_planSignal->wait(seen);
+    }
+  }
+
+  /* Sorts the items of the snapshot into dependency levels. An item
+     depends on an earlier item if it reads a buffer that the earlier
+     item writes, or writes a buffer that the earlier item reads or
+     writes. Items on the same level can then be processed in any
+     order, in parallel. */
+  DSPNetwork::Schedule * DSPNetwork::buildSchedule()
+  {
+    int n = m_snapshotItems;
+
+    std::vector<int> levels(n, 0);
+    std::vector<int> firstPort(n, 0);
+
+    for(int i = 1; i < n; i++)
+      firstPort[i] = firstPort[i - 1] + m_snapCounts[i * 2 - 2] +
+        m_snapCounts[i * 2 - 1];
+
+    int maxLevel = 0;
+
+    for(int j = 0; j < n; j++) {
+      float ** ins = & m_snapPorts[0] + firstPort[j];
+      float ** outs = ins + m_snapCounts[j * 2];
+      int nins = m_snapCounts[j * 2];
+      int nouts = m_snapCounts[j * 2 + 1];
 
-    while(m_incopy.pos() < sentinel) {
-      buf[0] = 0;
+      for(int i = 0; i < j; i++) {
+        float ** eins = & m_snapPorts[0] + firstPort[i];
+        float ** eouts = eins + m_snapCounts[i * 2];
+        float ** eend = eouts + m_snapCounts[i * 2 + 1];
+        bool depends = false;
 
-      if(!m_incopy.readString(buf, 512)) {
-        error("DSPNetwork::checkNewControl # Could not read string");
+        for(int k = 0; k < nins && !depends; k++)
+          depends = ins[k] && std::find(eouts, eend, ins[k]) != eend;
+
+        for(int k = 0; k < nouts && !depends; k++)
+          depends = outs[k] && std::find(eins, eend, outs[k]) != eend;
+
+        if(depends && levels[i] + 1 > levels[j])
+          levels[j] = levels[i] + 1;
+      }
+
+      if(levels[j] > maxLevel)
+        maxLevel = levels[j];
+    }
+
+    Schedule * s = new Schedule();
+    s->m_version = m_snapshotVersion;
+    s->m_items.reserve(n);
+
+    int widest = 0;
+
+    for(int level = 0; level <= maxLevel && n; level++) {
+      int begin = s->m_items.size();
+
+      for(int i = 0; i < n; i++)
+        if(levels[i] == level)
+          s->m_items.push_back(m_snapItems[i]);
+
+      s->m_levelEnds.push_back(s->m_items.size());
+      widest = Nimble::Math::Max(widest, (int) s->m_items.size() - begin);
+    }
+
+    s->m_parallel = !m_workers.empty() && widest > 1 &&
+                    n >= m_parallelThreshold;
+
+    debug("DSPNetwork::buildSchedule # %d items in %d levels, %s",
+          n, (int) s->m_levelEnds.size(), s->m_parallel ? "parallel" : "serial");
+
+    return s;
+  }
+
+  void DSPNetwork::processParallel(int n)
+  {
+    m_active = m_schedule;
+    m_cycleFrames = n;
+
+    const std::vector<int> & ends = m_schedule->m_levelEnds;
+    int begin = 0;
+
+    for(unsigned level = 0; level < ends.size(); level++) {
+      int end = ends[level];
+
+      if(end - begin == 1) {
+        // Not worth waking up the workers
+        m_schedule->m_items[begin]->process(n);
+        begin = end;
         continue;
       }
 
-      const char * slash = strchr(buf, '/');
-      const char * command;
+      // Publish the level
+      int64_t claim = (int64_t(end) << 32) | begin;
+      int64_t old = m_claim;
+
+      while(!Radiant::Atomic::compareAndSwap( & m_claim, old, claim))
+        old = m_claim;
+
+      m_workSignal->wake();
 
-      if(!slash) {
-        id = buf;
-        command = 0;
+      /* Process items until all are claimed. If the workers are late,
+         the audio thread ends up processing the whole level. */
+      processClaims();
+
+      // Wait only for the items that the workers are processing
+      while(m_inflight > 0)
+        ;
+
+      Radiant::Atomic::memoryBarrier();
+
+      begin = end;
+    }
+  }
+
+  /* Claims and processes items of the current level, until none are
+     left. Returns the number of items processed. */
+  int DSPNetwork::processClaims()
+  {
+    int done = 0;
+
+    for(;;) {
+      int64_t claim = m_claim;
+      int next = (int) (claim & 0xFFFFFFFF);
+      int end = (int) (claim >> 32);
+
+      if(next >= end)
+        break;
+
+      // Counted before claiming, so that the audio thread waits for it
+      Radiant::Atomic::add( & m_inflight, 1);
+
+      if(Radiant::Atomic::compareAndSwap( & m_claim, claim, claim + 1)) {
+        m_active->m_items[next]->process(m_cycleFrames);
+        done++;
       }
-      else {
-        id.copyn(buf, slash - buf);
-        command = slash + 1;
+
+      Radiant::Atomic::add( & m_inflight, -1);
+    }
+
+    return done;
+  }
+
+  bool DSPNetwork::hasClaims() const
+  {
+    int64_t claim = m_claim;
+    return (int) (claim & 0xFFFFFFFF) < (int) (claim >> 32);
+  }
+
+  void DSPNetwork::workerLoop()
+  {
+    while(m_workersRun) {
+
+      if(processClaims())
+        continue;
+
+      uint32_t seen = m_workSignal->value();
+
+      for(int i = 0; i < WORKER_SPINS && !hasClaims(); i++)
+        ;
+
+      if(!hasClaims() && m_workersRun)
+        m_workSignal->wait(seen);
+    }
+  }
+
+  void DSPNetwork::startWorkers()
+  {
+    if(!m_workers.empty() || m_workerCount <= 0)
+      return;
+
+    m_workersRun = true;
+
+    for(int i = 0; i < m_workerCount; i++) {
+      Worker * w = new Worker(this);
+      m_workers.push_back(w);
+      w->run();
+    }
+
+    m_planner = new Planner(this);
+    m_planner->run();
+
+    m_graphVersion++;
+  }
+
+  void DSPNetwork::stopWorkers()
+  {
+    if(m_workers.empty())
+      return;
+
+    m_workersRun = false;
+    m_workSignal->wake();
+    m_planSignal->wake();
+
+    for(unsigned i = 0; i < m_workers.size(); i++) {
+      m_workers[i]->waitEnd();
+      delete m_workers[i];
+    }
+
+    m_workers.clear();
+
+    m_planner->waitEnd();
+    delete m_planner;
+    m_planner = 0;
+
+    delete m_schedule;
+    delete m_nextSchedule;
+    m_schedule = 0;
+    m_nextSchedule = 0;
+
+    while(m_retired) {
+      Schedule * next = m_retired->m_next;
+      delete m_retired;
+      m_retired = next;
+    }
+  }
+
+  void DSPNetwork::checkNewControl()
+  {
+    char buf[512];
+
+    FixedStrT<512> id;
+
+    unsigned bytes;
+
+    while(const char * msg = m_controls.peek( & bytes)) {
+
+      // Read the message in place, without copying it
+      m_incopy.linkTo((void *) msg, bytes);
+      m_incopy.setTotal(bytes);
+      m_incopy.rewind();
+
+      while(m_incopy.pos() < (int) bytes) {
+        buf[0] = 0;
+
+        if(!m_incopy.readString(buf, 512)) {
+          error("DSPNetwork::checkNewControl # Could not read string");
+          break;
+        }
+
+        const char * slash = strchr(buf, '/');
+        const char * command;
+
+        if(!slash) {
+          id = buf;
+          command = 0;
+        }
+        else {
+          id.copyn(buf, slash - buf);
+          command = slash + 1;
+        }
+
+        deliverControl(id, command, m_incopy);
       }
 
-      deliverControl(id, command, m_incopy);
+      m_controls.pop();
     }
   }
 
@@ -323,6 +812,7 @@ namespace Resonant {
       if(!compile(*itptr, 0)) {
         error("DSPNetwork::checkNewItems # Could not add module %s", type);
         m_items.pop_front();
+        m_graphVersion++;
       }
       else {
         debug("DSPNetwork::checkNewItems # Added a new module %s", type);
@@ -461,6 +951,7 @@ namespace Resonant {
         iterator tmp = it;
         it++;
         m_items.erase(tmp);
+        m_graphVersion++;
       }
       else
         it++;
@@ -591,6 +1082,7 @@ namespace Resonant {
     }
 
     item.m_compiled = true;
+    m_graphVersion++;
 
     Module * m = item.m_module;
 
@@ -20,6 +20,7 @@
 #include <Resonant/Module.hpp>
 
 #include <Radiant/BinaryData.hpp>
+#include <Radiant/MessageRing.hpp>
 #include <Radiant/Mutex.hpp>
 
 #include <Radiant/RefPtr.hpp>
@@ -28,6 +29,7 @@
 #include <vector>
 #include <cassert>
 
+#include <stdint.h>
 #include <string.h>
 
 namespace Resonant {
@@ -60,6 +62,17 @@ namespace Resonant {
       return pointer to the network. It is strongly recommended that you do not delete the
       defualt DSPNetwork before application is ready exit, as doing so may invalidate
       pointers that are held to it.
+
+      Large graphs are processed in parallel. The modules are sorted
+      into dependency levels, so that the modules on one level do not
+      share any buffers. The sorting is done by a planner thread, from
+      a snapshot that the audio thread takes when the graph changes;
+      until the new schedule is ready the graph is processed serially.
+      The modules of each level are claimed one by one by the audio
+      thread and a pool of worker threads, so the audio thread
+      processes any modules that the workers do not get to in time.
+      Small graphs, and graphs without independent modules, are
+      processed serially in the audio thread.
    */
   class RESONANT_API DSPNetwork : public AudioLoop
   {
@@ -238,8 +251,40 @@ control.writeString("moviegain/gain");
 control.writeFloat32(0.3);
 DSPNetwork::instance().send(control);
         \endcode
+
+        The message is passed to the signal processing thread through a
+        lock-free queue, so the audio thread is never blocked by the
+        sender. If the queue is full the message is dropped (see
+        #droppedControls).
+
+        @return false if the message was dropped
     */
-    void send(Radiant::BinaryData & control);
+    bool send(Radiant::BinaryData & control);
+
+    /// Returns the number of control messages that have been dropped
+    /** Messages are dropped if they are sent faster than the signal
+        processing thread consumes them, or if a message is larger than
+        #MAX_CONTROL_BYTES. */
+    unsigned droppedControls() const { return m_controls.dropped(); }
+
+    enum {
+      /// Maximum size of a single control message
+      MAX_CONTROL_BYTES = 1024,
+      /// Number of control messages that can be waiting in the queue
+      CONTROL_QUEUE_SIZE = 512
+    };
+
+    /** Sets the number of worker threads that help the audio thread
+        to process the graph. This must be called before #start. By
+        default one thread per additional CPU core is used, at most
+        three. Zero disables parallel processing. */
+    void setWorkerThreads(int threads) { m_workerCount = threads; }
+    /// Returns the number of worker threads
+    int workerThreads() const { return m_workerCount; }
+
+    /** Sets the smallest number of modules for which parallel
+        processing is used. */
+    void setParallelThreshold(int items) { m_parallelThreshold = items; }
 
     /// Returns the default sample player object.
     /** If the object does not exis yet, it is created on the fly. */
@@ -256,8 +301,25 @@ DSPNetwork::instance().send(control);
                          //			 PaStreamCallbackFlags status
                          );
 
+    class Worker;
+    class Planner;
+    class Schedule;
+    class Signal;
+
     void doCycle(int);
 
+    void takeSnapshot();
+    void takeSchedule();
+    void retire(Schedule *);
+    void planLoop();
+    Schedule * buildSchedule();
+    void processParallel(int);
+    int processClaims();
+    bool hasClaims() const;
+    void workerLoop();
+    void startWorkers();
+    void stopWorkers();
+
     void checkNewControl();
     void checkNewItems();
     void checkDoneItems();
@@ -285,9 +347,8 @@ DSPNetwork::instance().send(control);
     ModulePanner   *m_panner;
 
     Radiant::BinaryData m_controlData;
-    Radiant::BinaryData m_incoming;
+    Radiant::MessageRing m_controls;
     Radiant::BinaryData m_incopy;
-    Radiant::MutexAuto m_inMutex;
 
     char        m_devName[128];
     // bool        m_continue;
@@ -296,6 +357,48 @@ DSPNetwork::instance().send(control);
 
     Radiant::MutexAuto m_newMutex;
 
+    // Incremented by the audio thread whenever the graph changes
+    int         m_graphVersion;
+    int         m_parallelThreshold;
+
+    /* Snapshot of the graph for the planner. The audio thread fills it
+       without allocating, when it is SNAPSHOT_FREE. */
+    enum {
+      SNAPSHOT_FREE,
+      SNAPSHOT_READY
+    };
+    volatile int m_snapshotState;
+    int         m_snapshotVersion;
+    // Number of items and buffer pointers, or -1 if the arrays were too small
+    int         m_snapshotItems;
+    int         m_snapshotPorts;
+    std::vector<Item *> m_snapItems;
+    // Number of inputs and outputs of each item
+    std::vector<int> m_snapCounts;
+    std::vector<float *> m_snapPorts;
+
+    // Schedule used by the audio thread
+    Schedule *  m_schedule;
+    // Schedule built by the planner, taken by the audio thread
+    Schedule * volatile m_nextSchedule;
+    // Schedules that the audio thread no longer uses, deleted by the planner
+    Schedule * volatile m_retired;
+
+    Planner *   m_planner;
+    Signal *    m_planSignal;
+
+    std::vector<Worker *> m_workers;
+    int         m_workerCount;
+    /* The level that is being processed: the end index in the high
+       and the next unclaimed index in the low 32 bits. */
+    volatile int64_t m_claim;
+    // Number of items being claimed or processed
+    volatile int m_inflight;
+    volatile bool m_workersRun;
+    Schedule *  m_active;
+    int         m_cycleFrames;
+    Signal *    m_workSignal;
+
     static DSPNetwork * m_instance;
   };
 
@@ -16,9 +16,11 @@
 #include "ModuleSamplePlayer.hpp"
 
 #include "DSPNetwork.hpp"
+#include "SampleMixing.hpp"
 
 #include <Nimble/Math.hpp>
 
+#include <Radiant/BinaryArena.hpp>
 #include <Radiant/BinaryData.hpp>
 #include <Radiant/Directory.hpp>
 #include <Radiant/FileUtils.hpp>
@@ -123,79 +125,65 @@ namespace Resonant {
       return m_state == WAITING_FOR_SAMPLE;
     }
 
-    unsigned avail = m_sample->available(m_position);
-
-    if((int) avail > n)
-      avail = n;
-
     float * b1 = out[m_targetChannel];
-    float gain = m_gain;
-    float pitch = m_relPitch;
-
-    bool more;
-
     int chans = m_sample->channels();
+    unsigned frames = m_sample->frames();
+    uint64_t step = SampleMixing::rateToStep(m_relPitch);
+    const uint64_t end = (uint64_t) frames << 32;
 
-    if(pitch == 1.0f) {
-      const float * src = m_sample->buf(m_position) + m_sampleChannel;
+    int done = 0;
 
-      for(unsigned i = 0; i < avail; i++) {
-        *b1++ += *src * gain;
-        src += chans;
-      }
+    while(done < n && frames && step) {
 
-      m_position += avail;
+      if(step == SampleMixing::FRAME && !(m_phase & 0xFFFFFFFF)) {
+        // Plain playback, no interpolation needed
+        unsigned pos = (unsigned) (m_phase >> 32);
+        unsigned avail = m_sample->available(pos);
 
-      more = (int) avail == n;
-    }
-    else {
-      double dpos = m_dpos;
-      double dmax = m_sample->frames() - 1;
-
-      const float * src = m_sample->buf(0) + m_sampleChannel;
+        if((int) avail > n - done)
+          avail = n - done;
 
-      for(int i = 0 ; i < n && dpos < dmax; i++) {
-
-        int base = (int) dpos;
-        double w2 = dpos - (double) base;
-        *b1++ += gain *
-                 float((src[base * chans] * (1.0 - w2) + src[(base+1) * chans] * w2));
-        dpos += pitch;
+        SampleMixing::mix(b1 + done, m_sample->buf(pos) + m_sampleChannel,
+                          chans, m_gain, avail);
+        done += avail;
+        m_phase += (uint64_t) avail << 32;
+      }
+      else {
+        done += SampleMixing::mixResampled
+                (b1 + done, m_sample->buf(0) + m_sampleChannel, chans, frames,
+                 m_phase, step, m_gain, n - done, m_loop);
       }
 
-      m_dpos = dpos;
+      if(m_phase < end)
+        continue;
 
-      more = dpos < dmax;
+      if(!m_loop)
+        break;
+
+      // Wrap around and fill the rest of the buffer, without a gap
+      m_phase %= end;
     }
 
-    if(!more) {
-      if(m_loop) {
-        // debug("ModuleSamplePlayer::SampleVoice::synthesize # rewind");
-        m_position = 0;
-        m_dpos = 0.0f;
-        more = 1;
-      }
-      else {
-        // debug("ModuleSamplePlayer::SampleVoice::synthesize # done");
-        m_sample = 0;
-        m_state = INACTIVE;
-      }
+    if(!frames || !step || m_phase >= end) {
+      // debug("ModuleSamplePlayer::SampleVoice::synthesize # done");
+      m_sample = 0;
+      m_state = INACTIVE;
+      return false;
     }
 
-    return more != 0;
+    return true;
   }
 
   void ModuleSamplePlayer::SampleVoice::init
       (Sample * sample, Radiant::BinaryData * data)
   {
     m_sample = sample;
-    m_position = 0;
+    m_phase = 0;
 
     m_gain = 1.0f;
     m_relPitch = 1.0f;
     m_sampleChannel = 0;
     m_targetChannel = 0;
-    m_dpos = 0.0f;
     m_loop = false;
 
     const int buflen = 64;
@@ -242,7 +230,7 @@ namespace Resonant {
       }
     }
 
-    m_dpos = 0.0;
+    m_phase = 0;
 
     m_state = sample ? PLAYING : WAITING_FOR_SAMPLE;
 
@@ -557,7 +545,7 @@ namespace Resonant {
 
     sf_close(sndf);
 
-    Radiant::BinaryData control;
+    Radiant::BinaryData control(Radiant::BinaryArena::threadArena());
     control.writeString(std::string(id()) + "/playsample");
 
     control.writeString(filename);
@@ -27,6 +27,7 @@
 #include <string>
 #include <vector>
 
+#include <stdint.h>
 #include <strings.h>
 
 namespace Resonant {
@@ -154,7 +155,7 @@ namespace Resonant {
       SampleVoice(Sample * s = 0)
         : m_state(INACTIVE), m_gain(1), m_relPitch(1.0f),
           m_sampleChannel(0), m_targetChannel(0),
-          m_sample(s), m_position(0)
+          m_sample(s), m_phase(0)
       {}
 
       bool synthesize(float ** out, int n);
@@ -180,13 +181,13 @@ namespace Resonant {
 
       float m_gain;
       float m_relPitch;
-      double m_dpos;
 
       int      m_sampleChannel;
       int      m_targetChannel;
       bool     m_loop;
       Sample * m_sample;
-      unsigned m_position;
+      /// Playback position in 32.32 fixed-point frames
+      uint64_t m_phase;
     };
 
     /* Loads samples from the disk, as necessary. */
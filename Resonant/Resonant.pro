@@ -11,6 +11,7 @@ HEADERS += ModuleGain.hpp
 HEADERS += ModuleOutCollect.hpp
 HEADERS += ModuleSamplePlayer.hpp
 HEADERS += ModulePanner.hpp
+HEADERS += SampleMixing.hpp
 
 SOURCES += Application.cpp
 SOURCES += AudioFileHandler.cpp
@@ -22,6 +23,7 @@ SOURCES += ModuleGain.cpp
 SOURCES += ModuleOutCollect.cpp
 SOURCES += ModuleSamplePlayer.cpp
 SOURCES += ModulePanner.cpp
+SOURCES += SampleMixing.cpp
 
 LIBS += $$LIB_RADIANT $$LIB_NIMBLE $$LIB_PATTERNS $$LIB_VALUABLE
 
@@ -0,0 +1,351 @@
+/* COPYRIGHT
+ *
+ * This file is part of Resonant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Resonant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#include "SampleMixing.hpp"
+
+#include <Radiant/CPUInfo.hpp>
+
+#ifdef RADIANT_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace Resonant {
+
+  namespace SampleMixing {
+
+    static const float FRACTION_SCALE = 1.0f / 4294967296.0f;
+
+    /* 4-point Catmull-Rom interpolation between x0 and x1. The SIMD
+       versions use the same operations in the same order, so that
+       they give identical results. */
+    static inline float cubic(float xm1, float x0, float x1, float x2, float t)
+    {
+      float c1 = 0.5f * (x1 - xm1);
+      float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+      float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+
+      return ((c3 * t + c2) * t + c1) * t + x0;
+    }
+
+    /* Reads a frame that may be outside the sample. */
+    static inline float edgeSample(const float * src, int channels,
+                                   int frames, int i, bool loop)
+    {
+      if(loop)
+        i = ((i % frames) + frames) % frames;
+      else if(i < 0)
+        i = 0;
+      else if(i >= frames)
+        i = frames - 1;
+
+      return src[i * channels];
+    }
+
+#ifdef RADIANT_X86
+
+    /////////////////////////////////////////////////////////////////////////
+    // SSE2
+
+    RADIANT_TARGET_SSE2
+    static int mixSSE2(float * dest, const float * src, int channels,
+                       float gain, int n)
+    {
+      __m128 g = _mm_set1_ps(gain);
+      int i = 0;
+
+      if(channels == 1) {
+        for(; i + 4 <= n; i += 4) {
+          __m128 s = _mm_loadu_ps(src + i);
+          __m128 d = _mm_loadu_ps(dest + i);
+          _mm_storeu_ps(dest + i, _mm_add_ps(d, _mm_mul_ps(s, g)));
+        }
+      }
+      else if(channels == 2) {
+        // The last block would read one float past the last frame
+        for(; i + 4 < n; i += 4) {
+          __m128 a = _mm_loadu_ps(src + 2 * i);
+          __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+          __m128 s = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+          __m128 d = _mm_loadu_ps(dest + i);
+          _mm_storeu_ps(dest + i, _mm_add_ps(d, _mm_mul_ps(s, g)));
+        }
+      }
+      else {
+        for(; i + 4 <= n; i += 4) {
+          const float * p = src + i * channels;
+          __m128 s = _mm_set_ps(p[3 * channels], p[2 * channels],
+                                p[channels], p[0]);
+          __m128 d = _mm_loadu_ps(dest + i);
+          _mm_storeu_ps(dest + i, _mm_add_ps(d, _mm_mul_ps(s, g)));
+        }
+      }
+
+      return i;
+    }
+
+    RADIANT_TARGET_SSE2
+    static inline __m128 cubicSSE2(__m128 xm1, __m128 x0, __m128 x1,
+                                   __m128 x2, __m128 t)
+    {
+      const __m128 half = _mm_set1_ps(0.5f);
+      const __m128 onehalf = _mm_set1_ps(1.5f);
+      const __m128 two = _mm_set1_ps(2.0f);
+      const __m128 twohalf = _mm_set1_ps(2.5f);
+
+      __m128 c1 = _mm_mul_ps(half, _mm_sub_ps(x1, xm1));
+      __m128 c2 = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(xm1, _mm_mul_ps(twohalf, x0)),
+                                        _mm_mul_ps(two, x1)),
+                             _mm_mul_ps(half, x2));
+      __m128 c3 = _mm_add_ps(_mm_mul_ps(half, _mm_sub_ps(x2, xm1)),
+                             _mm_mul_ps(onehalf, _mm_sub_ps(x0, x1)));
+
+      __m128 r = _mm_add_ps(_mm_mul_ps(c3, t), c2);
+      r = _mm_add_ps(_mm_mul_ps(r, t), c1);
+      return _mm_add_ps(_mm_mul_ps(r, t), x0);
+    }
+
+    /* Handles blocks of four output samples, as long as all the taps
+       are inside the sample. */
+    RADIANT_TARGET_SSE2
+    static int resampleSSE2(float * dest, const float * src, int channels,
+                            unsigned frames, uint64_t & position,
+                            uint64_t step, float gain, int n)
+    {
+      __m128 g = _mm_set1_ps(gain);
+      uint64_t pos = position;
+      int i = 0;
+
+      for(; i + 4 <= n; i += 4) {
+        uint64_t p[4] = { pos, pos + step, pos + 2 * step, pos + 3 * step };
+
+        if((p[0] >> 32) < 1 || (p[3] >> 32) + 2 >= frames)
+          break;
+
+        float t[4];
+        const float * b[4];
+
+        for(int k = 0; k < 4; k++) {
+          t[k] = (float) (uint32_t) p[k] * FRACTION_SCALE;
+          b[k] = src + (int) (p[k] >> 32) * channels;
+        }
+
+        __m128 xm1 = _mm_set_ps(b[3][-channels], b[2][-channels],
+                                b[1][-channels], b[0][-channels]);
+        __m128 x0 = _mm_set_ps(b[3][0], b[2][0], b[1][0], b[0][0]);
+        __m128 x1 = _mm_set_ps(b[3][channels], b[2][channels],
+                               b[1][channels], b[0][channels]);
+        __m128 x2 = _mm_set_ps(b[3][2 * channels], b[2][2 * channels],
+                               b[1][2 * channels], b[0][2 * channels]);
+
+        __m128 v = cubicSSE2(xm1, x0, x1, x2, _mm_loadu_ps(t));
+        __m128 d = _mm_loadu_ps(dest + i);
+        _mm_storeu_ps(dest + i, _mm_add_ps(d, _mm_mul_ps(v, g)));
+
+        pos += 4 * step;
+      }
+
+      position = pos;
+
+      return i;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // AVX2
+
+    RADIANT_TARGET_AVX2
+    static int mixAVX2(float * dest, const float * src, int channels,
+                       float gain, int n)
+    {
+      __m256 g = _mm256_set1_ps(gain);
+      int i = 0;
+
+      if(channels == 1) {
+        for(; i + 8 <= n; i += 8) {
+          __m256 s = _mm256_loadu_ps(src + i);
+          __m256 d = _mm256_loadu_ps(dest + i);
+          _mm256_storeu_ps(dest + i, _mm256_add_ps(d, _mm256_mul_ps(s, g)));
+        }
+      }
+      else if(channels == 2) {
+        for(; i + 8 < n; i += 8) {
+          __m256 a = _mm256_loadu_ps(src + 2 * i);
+          __m256 b = _mm256_loadu_ps(src + 2 * i + 8);
+          // Even elements of each 128-bit lane, then fix the lane order
+          __m256 s = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+          s = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(s),
+                                                     _MM_SHUFFLE(3, 1, 2, 0)));
+          __m256 d = _mm256_loadu_ps(dest + i);
+          _mm256_storeu_ps(dest + i, _mm256_add_ps(d, _mm256_mul_ps(s, g)));
+        }
+      }
+      else {
+        __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                           _mm256_set1_epi32(channels));
+        for(; i + 8 <= n; i += 8) {
+          __m256 s = _mm256_i32gather_ps(src + i * channels, index, 4);
+          __m256 d = _mm256_loadu_ps(dest + i);
+          _mm256_storeu_ps(dest + i, _mm256_add_ps(d, _mm256_mul_ps(s, g)));
+        }
+      }
+
+      return i;
+    }
+
+    RADIANT_TARGET_AVX2
+    static int resampleAVX2(float * dest, const float * src, int channels,
+                            unsigned frames, uint64_t & position,
+                            uint64_t step, float gain, int n)
+    {
+      const __m256 g = _mm256_set1_ps(gain);
+      const __m256 half = _mm256_set1_ps(0.5f);
+      const __m256 onehalf = _mm256_set1_ps(1.5f);
+      const __m256 two = _mm256_set1_ps(2.0f);
+      const __m256 twohalf = _mm256_set1_ps(2.5f);
+      const __m256i chans = _mm256_set1_epi32(channels);
+
+      uint64_t pos = position;
+      int i = 0;
+
+      for(; i + 8 <= n; i += 8) {
+
+        if((pos >> 32) < 1 || ((pos + 7 * step) >> 32) + 2 >= frames)
+          break;
+
+        int idx[8];
+        float t[8];
+
+        for(int k = 0; k < 8; k++) {
+          uint64_t p = pos + k * step;
+          idx[k] = (int) (p >> 32);
+          t[k] = (float) (uint32_t) p * FRACTION_SCALE;
+        }
+
+        __m256i base = _mm256_mullo_epi32
+          (_mm256_loadu_si256((const __m256i *) idx), chans);
+
+        __m256 x0 = _mm256_i32gather_ps(src, base, 4);
+        __m256 xm1 = _mm256_i32gather_ps(src - channels, base, 4);
+        __m256 x1 = _mm256_i32gather_ps(src + channels, base, 4);
+        __m256 x2 = _mm256_i32gather_ps(src + 2 * channels, base, 4);
+        __m256 tt = _mm256_loadu_ps(t);
+
+        __m256 c1 = _mm256_mul_ps(half, _mm256_sub_ps(x1, xm1));
+        __m256 c2 = _mm256_sub_ps
+          (_mm256_add_ps(_mm256_sub_ps(xm1, _mm256_mul_ps(twohalf, x0)),
+                         _mm256_mul_ps(two, x1)),
+           _mm256_mul_ps(half, x2));
+        __m256 c3 = _mm256_add_ps(_mm256_mul_ps(half, _mm256_sub_ps(x2, xm1)),
+                                  _mm256_mul_ps(onehalf, _mm256_sub_ps(x0, x1)));
+
+        __m256 r = _mm256_add_ps(_mm256_mul_ps(c3, tt), c2);
+        r = _mm256_add_ps(_mm256_mul_ps(r, tt), c1);
+        r = _mm256_add_ps(_mm256_mul_ps(r, tt), x0);
+
+        __m256 d = _mm256_loadu_ps(dest + i);
+        _mm256_storeu_ps(dest + i, _mm256_add_ps(d, _mm256_mul_ps(r, g)));
+
+        pos += 8 * step;
+      }
+
+      position = pos;
+
+      return i;
+    }
+
+#endif
+
+    /////////////////////////////////////////////////////////////////////////
+    // Dispatch and the plain C++ fallback
+
+    void mix(float * dest, const float * src, int channels, float gain, int n)
+    {
+      int i = 0;
+
+#ifdef RADIANT_X86
+      using Radiant::CPUInfo::hasFeature;
+
+      if(hasFeature(Radiant::CPUInfo::FEATURE_AVX2))
+        i = mixAVX2(dest, src, channels, gain, n);
+      else if(hasFeature(Radiant::CPUInfo::FEATURE_SSE2))
+        i = mixSSE2(dest, src, channels, gain, n);
+#endif
+
+      for(src += i * channels; i < n; i++) {
+        dest[i] += *src * gain;
+        src += channels;
+      }
+    }
+
+    int mixResampled(float * dest, const float * src, int channels,
+                     unsigned frames, uint64_t & position, uint64_t step,
+                     float gain, int n, bool loop)
+    {
+      if(!frames || !step)
+        return 0;
+
+#ifdef RADIANT_X86
+      using Radiant::CPUInfo::hasFeature;
+
+      const bool avx2 = hasFeature(Radiant::CPUInfo::FEATURE_AVX2);
+      const bool sse2 = hasFeature(Radiant::CPUInfo::FEATURE_SSE2);
+#endif
+
+      int i = 0;
+
+      while(i < n) {
+
+#ifdef RADIANT_X86
+        if(avx2)
+          i += resampleAVX2(dest + i, src, channels, frames, position,
+                            step, gain, n - i);
+        if(sse2)
+          i += resampleSSE2(dest + i, src, channels, frames, position,
+                            step, gain, n - i);
+        if(i >= n)
+          break;
+#endif
+
+        // One sample at a time near the ends, and for the tail
+        unsigned idx = (unsigned) (position >> 32);
+
+        if(idx >= frames)
+          break;
+
+        float t = (float) (uint32_t) position * FRACTION_SCALE;
+        float v;
+
+        if(idx >= 1 && idx + 2 < frames) {
+          const float * b = src + idx * channels;
+          v = cubic(b[-channels], b[0], b[channels], b[2 * channels], t);
+        }
+        else {
+          int f = frames;
+          int j = idx;
+          v = cubic(edgeSample(src, channels, f, j - 1, loop),
+                    edgeSample(src, channels, f, j, loop),
+                    edgeSample(src, channels, f, j + 1, loop),
+                    edgeSample(src, channels, f, j + 2, loop), t);
+        }
+
+        dest[i++] += v * gain;
+        position += step;
+      }
+
+      return i;
+    }
+
+  }
+
+}
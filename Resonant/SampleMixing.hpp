@@ -0,0 +1,73 @@
+/* COPYRIGHT
+ *
+ * This file is part of Resonant.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Resonant.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#ifndef RESONANT_SAMPLE_MIXING_HPP
+#define RESONANT_SAMPLE_MIXING_HPP
+
+#include <Resonant/Export.hpp>
+
+#include <stdint.h>
+
+namespace Resonant {
+
+  /// Low-level kernels for mixing sample data
+  /** These functions implement the inner loops of the sample player:
+      they pick one channel from interleaved sample data, scale it by a
+      gain, and add it to an output buffer. The SIMD implementation is
+      picked at run-time with Radiant::CPUInfo.
+
+      Positions in resampled playback are 32.32 fixed-point frame
+      indices, so that the position does not lose precision in long
+      samples, and stepping through the sample is exact. */
+  namespace SampleMixing {
+
+    /// Fixed-point value of one frame in the 32.32 positions
+    const uint64_t FRAME = (uint64_t) 1 << 32;
+
+    /// Converts a playback rate to a fixed-point step
+    /** Rates that are not positive give zero. */
+    inline uint64_t rateToStep(float rate)
+    { return rate > 0.0f ? (uint64_t) (rate * 4294967296.0 + 0.5) : 0; }
+
+    /// Mixes one channel of interleaved samples to the output
+    /** dest[i] += src[i * channels] * gain, for i in [0, n) */
+    RESONANT_API void mix(float * dest, const float * src, int channels,
+                          float gain, int n);
+
+    /// Mixes one channel with cubic interpolation
+    /** Reads the sample with 4-point (Catmull-Rom) interpolation,
+        starting from the fixed-point position, and advancing it by
+        step after each output sample. Mixing stops after n samples,
+        or when the position goes past the last frame.
+
+        @param dest Output buffer, the samples are added to it
+        @param src First sample of the channel to play
+        @param channels Number of interleaved channels in src
+        @param frames Number of frames in src
+        @param position Fixed-point position, updated by the call
+        @param step Fixed-point increment per output sample
+        @param gain Gain coefficient
+        @param n Maximum number of output samples
+        @param loop If true, interpolation near the ends of the
+        sample wraps to the other end, so that loops are seamless
+        @return The number of samples mixed */
+    RESONANT_API int mixResampled(float * dest, const float * src,
+                                  int channels, unsigned frames,
+                                  uint64_t & position, uint64_t step,
+                                  float gain, int n, bool loop);
+  }
+
+}
+
+#endif
@@ -0,0 +1,32 @@
+/* COPYRIGHT
+ *
+ * This file is part of Screenplay.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Screenplay.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+
+#include "PictureBuffer.hpp"
+
+namespace Screenplay {
+
+  PictureBuffer::PictureBuffer(void * data, size_t size)
+    : m_data((unsigned char *) data),
+    m_size(size),
+    m_refs(1)
+  {}
+
+  PictureBuffer::~PictureBuffer()
+  {}
+
+  PictureAllocator::~PictureAllocator()
+  {}
+
+}
@@ -0,0 +1,85 @@
+/* COPYRIGHT
+ *
+ * This file is part of Screenplay.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Screenplay.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+
+#ifndef SCREENPLAY_PICTURE_BUFFER_HPP
+#define SCREENPLAY_PICTURE_BUFFER_HPP
+
+#include <Patterns/NotCopyable.hpp>
+
+#include <Radiant/Atomic.hpp>
+
+#include <Screenplay/Export.hpp>
+
+#include <stddef.h>
+
+namespace Screenplay {
+
+  /// Reference-counted memory for decoded video pictures
+  /** The video decoder writes the pictures directly into these
+      buffers. The decoder keeps a reference to each picture that it
+      still uses for prediction, and the application can take its own
+      references to keep a picture alive after the decoder has moved
+      on. The buffer is destroyed when the last reference is
+      dropped. The reference counting is thread-safe.
+
+      Subclasses return the memory to wherever it came from, in their
+      destructor. */
+  class SCREENPLAY_API PictureBuffer : public Patterns::NotCopyable
+  {
+  public:
+    /// Creates a buffer with one reference
+    PictureBuffer(void * data, size_t size);
+
+    /// Adds a reference to the buffer
+    void ref() { Radiant::Atomic::add( & m_refs, 1); }
+    /// Removes a reference, and deletes the buffer if it was the last one
+    void unref()
+    {
+      if(Radiant::Atomic::add( & m_refs, -1) == 0)
+        delete this;
+    }
+    /// Returns the number of references
+    /** If the count is one, the caller holds the only reference. */
+    int refCount() const { return m_refs; }
+
+    /// Returns the start of the memory block
+    unsigned char * data() { return m_data; }
+    /// Returns the size of the memory block, in bytes
+    size_t size() const { return m_size; }
+
+  protected:
+    virtual ~PictureBuffer();
+
+  private:
+    unsigned char * m_data;
+    size_t m_size;
+    volatile int m_refs;
+  };
+
+  /// Source of PictureBuffer objects for the video decoder
+  class SCREENPLAY_API PictureAllocator
+  {
+  public:
+    virtual ~PictureAllocator();
+
+    /// Allocates a buffer of at least the given size
+    /** @return A buffer with one reference, or null if there is no
+        memory */
+    virtual PictureBuffer * allocate(size_t bytes) = 0;
+  };
+
+}
+
+#endif
@@ -1,8 +1,10 @@
 include(../multitude.pri)
 
 HEADERS += Export.hpp
+HEADERS += PictureBuffer.hpp
 HEADERS += VideoFFMPEG.hpp
 
+SOURCES += PictureBuffer.cpp
 SOURCES += VideoFFMPEG.cpp
 
 unix:PKGCONFIG += libavutil libavformat libavcodec
@@ -19,6 +19,7 @@
 #include <Radiant/Trace.hpp>
 #include <Radiant/Types.hpp>
 
+#include <stdint.h>
 #include <string.h>
 
 #include <strings.h>
@@ -41,6 +42,16 @@ namespace Screenplay {
 
   int VideoInputFFMPEG::m_debug = 1;
 
+  /* Width of the border that the codecs draw around the pictures, for
+     motion vectors that point outside the picture. */
+  static const int __pictureEdge = 16;
+
+  static bool __directRendering(PixelFormat fmt)
+  {
+    return fmt == PIX_FMT_YUV420P || fmt == PIX_FMT_YUVJ420P ||
+      fmt == PIX_FMT_YUVJ422P;
+  }
+
   VideoInputFFMPEG::VideoInputFFMPEG()
     : m_acodec(0),
     m_aindex(-1),
@@ -55,6 +66,9 @@ namespace Screenplay {
     m_frame(0),
     m_ic(0),
     m_pkt(0),
+    m_allocator(0),
+    m_picture(0),
+    m_threads(1),
     m_flags(0),
     m_lastPts(0)
   {
@@ -157,6 +171,9 @@ namespace Screenplay {
         if (got_picture) {
           got = true;
 
+          m_picture = (m_frame->type == FF_BUFFER_TYPE_USER) ?
+                      (PictureBuffer *) m_frame->opaque : 0;
+
           int64_t pts = m_pkt->dts;
           if(pts <= 0)
             pts = m_frame->pts;
@@ -567,6 +584,18 @@ namespace Screenplay {
            }
            }*/
 
+        // Decode straight into the buffers of the application
+        if(m_vcodec && m_allocator &&
+           (m_vcodec->capabilities & CODEC_CAP_DR1)) {
+          enc->opaque = this;
+          enc->get_buffer = getBuffer;
+          enc->release_buffer = releaseBuffer;
+          enc->reget_buffer = regetBuffer;
+        }
+
+        if(m_vcodec && m_threads > 1)
+          avcodec_thread_init(enc, m_threads);
+
         if(!m_vcodec || avcodec_open(enc, m_vcodec) < 0)
           ; // THROW1(Exception, "Could not get video codec")
         else if(flags & WITH_VIDEO)
@@ -660,6 +689,7 @@ namespace Screenplay {
     m_audioFrames = 0;
 
     m_frame = 0;
+    m_picture = 0;
 
     m_vcodec = 0;
     m_vindex = -1;
@@ -737,6 +767,138 @@ namespace Screenplay {
     return true;
   }
 
+  int VideoInputFFMPEG::getBuffer(AVCodecContext * context, AVFrame * pic)
+  {
+    VideoInputFFMPEG * self = (VideoInputFFMPEG *) context->opaque;
+
+    if(!self->m_allocator || !__directRendering(context->pix_fmt))
+      return avcodec_default_get_buffer(context, pic);
+
+    int hshift = 0, vshift = 0;
+    avcodec_get_chroma_sub_sample(context->pix_fmt, & hshift, & vshift);
+
+    int w = context->width;
+    int h = context->height;
+    avcodec_align_dimensions(context, & w, & h);
+
+    int edge = (context->flags & CODEC_FLAG_EMU_EDGE) ? 0 : __pictureEdge;
+    w += edge * 2;
+    h += edge * 2;
+
+    /* The planes are 16-byte aligned, and the lines are padded so
+       that the data can also start at an aligned address. */
+    int linesizes[3];
+    size_t offsets[3];
+    size_t total = 0;
+
+    for(int i = 0; i < 3; i++) {
+      int hs = i ? hshift : 0;
+      int vs = i ? vshift : 0;
+
+      linesizes[i] = ((w >> hs) + 16 + 15) & ~15;
+      offsets[i] = total;
+      total += (size_t) linesizes[i] * ((h >> vs) + 1);
+    }
+
+    PictureBuffer * buffer = self->m_allocator->allocate(total + 16);
+
+    if(!buffer) {
+      error("VideoInputFFMPEG::getBuffer # No memory for a %d x %d picture",
+            context->width, context->height);
+      return -1;
+    }
+
+    unsigned char * base = (unsigned char *)
+                           (((uintptr_t) buffer->data() + 15) & ~(uintptr_t) 15);
+
+    for(int i = 0; i < 3; i++) {
+      int hs = i ? hshift : 0;
+      int vs = i ? vshift : 0;
+      int left = ((edge >> hs) + 15) & ~15;
+
+      pic->base[i] = base + offsets[i];
+      pic->data[i] = pic->base[i] + (edge >> vs) * linesizes[i] + left;
+      pic->linesize[i] = linesizes[i];
+    }
+
+    pic->base[3] = pic->data[3] = 0;
+    pic->linesize[3] = 0;
+
+    pic->opaque = buffer;
+    pic->type = FF_BUFFER_TYPE_USER;
+    // The same value avcodec_default_get_buffer uses for fresh buffers
+    pic->age = 256 * 256 * 256 * 64;
+
+    return 0;
+  }
+
+  void VideoInputFFMPEG::releaseBuffer(AVCodecContext * context, AVFrame * pic)
+  {
+    if(pic->type != FF_BUFFER_TYPE_USER) {
+      avcodec_default_release_buffer(context, pic);
+      return;
+    }
+
+    ((PictureBuffer *) pic->opaque)->unref();
+
+    pic->opaque = 0;
+
+    for(int i = 0; i < 4; i++)
+      pic->data[i] = 0;
+  }
+
+  int VideoInputFFMPEG::regetBuffer(AVCodecContext * context, AVFrame * pic)
+  {
+    if(!pic->data[0]) {
+      pic->buffer_hints |= FF_BUFFER_HINTS_READABLE;
+      return context->get_buffer(context, pic);
+    }
+
+    if(pic->type != FF_BUFFER_TYPE_USER)
+      return avcodec_default_reget_buffer(context, pic);
+
+    PictureBuffer * old = (PictureBuffer *) pic->opaque;
+
+    // Only the decoder uses the picture, it can be updated in place
+    if(old->refCount() == 1)
+      return 0;
+
+    /* The application still shows the picture, so the decoder gets a
+       copy of it to update. */
+    unsigned char * data[3];
+    int linesizes[3];
+
+    for(int i = 0; i < 3; i++) {
+      data[i] = pic->data[i];
+      linesizes[i] = pic->linesize[i];
+    }
+
+    pic->data[0] = 0;
+
+    if(getBuffer(context, pic) < 0) {
+      pic->data[0] = data[0];
+      return -1;
+    }
+
+    int hshift = 0, vshift = 0;
+    avcodec_get_chroma_sub_sample(context->pix_fmt, & hshift, & vshift);
+
+    for(int i = 0; i < 3; i++) {
+      int hs = i ? hshift : 0;
+      int vs = i ? vshift : 0;
+      int bytes = -((-context->width) >> hs);
+      int lines = -((-context->height) >> vs);
+
+      for(int y = 0; y < lines; y++)
+        memcpy(pic->data[i] + y * pic->linesize[i],
+               data[i] + y * linesizes[i], bytes);
+    }
+
+    old->unref();
+
+    return 0;
+  }
+
   void VideoInputFFMPEG::setDebug(int debug)
   {
     m_debug = debug;
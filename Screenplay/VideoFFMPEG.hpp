@@ -20,6 +20,7 @@
 #include <Radiant/VideoInput.hpp>
 
 #include <Screenplay/Export.hpp>
+#include <Screenplay/PictureBuffer.hpp>
 
 #include <string>
 
@@ -96,10 +97,41 @@ namespace Screenplay {
     m_flags &= ~Radiant::DO_LOOP;
     }
     */
+    /// Sets the allocator for the decoded pictures
+    /** With an allocator the decoder writes the pictures directly into
+        buffers from the allocator, so that the application can keep
+        the pictures without copying them. This works with codecs that
+        support direct rendering, and with the planar YUV formats. In
+        other cases the decoder uses its own memory, and
+        pictureBuffer() returns null.
+
+        The allocator is taken into use when the next file is
+        opened. It must stay alive until the file is closed. */
+    void setPictureAllocator(PictureAllocator * allocator)
+    { m_allocator = allocator; }
+    /// Returns the buffer that holds the latest captured image
+    /** Returns null if the image is in the memory of the decoder. The
+        decoder may reuse the buffer after the next captureImage, unless
+        the caller takes a reference to it with PictureBuffer::ref(). */
+    PictureBuffer * pictureBuffer() { return m_picture; }
+
+    /// Sets the number of threads that the video codec uses
+    /** The codec splits the decoding of each picture between the
+        threads, if it supports that. The count is taken into use when
+        the next file is opened. */
+    void setThreadCount(int threads) { m_threads = threads; }
+    /// Returns the number of threads that the video codec uses
+    int threadCount() const { return m_threads; }
+
     /// Turn on/off the printing of debug messages
     static void setDebug(int debug);
 
   private:
+    // Callbacks of AVCodecContext, for decoding into PictureBuffer objects
+    static int getBuffer(AVCodecContext * context, AVFrame * pic);
+    static void releaseBuffer(AVCodecContext * context, AVFrame * pic);
+    static int regetBuffer(AVCodecContext * context, AVFrame * pic);
+
     int actualChannels() const
     {
       return (m_flags & Radiant::MONOPHONIZE_AUDIO) ?
@@ -133,6 +165,11 @@ namespace Screenplay {
 
     Radiant::VideoImage m_image;
 
+    PictureAllocator * m_allocator;
+    PictureBuffer    * m_picture;
+
+    int              m_threads;
+
     int              m_flags;
     int64_t          m_lastPts;
     Radiant::TimeStamp  m_audioTS;
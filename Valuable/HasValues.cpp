@@ -59,9 +59,7 @@ namespace Valuable
 
   ValueObject * HasValues::getValue(const std::string & name)
   {
-    container::iterator it = m_children.find(name);
-
-    return it == m_children.end() ? 0 : it->second;
+    return m_index.find(name);
   }
 
   bool HasValues::addValue(const std::string & cname, ValueObject * const value)
@@ -91,6 +89,7 @@ namespace Valuable
     value->setName(cname);
 
     m_children[value->name()] = value;
+    m_index.insert(value, value->name());
     value->m_parent  = this;
 
     return true;
@@ -109,6 +108,7 @@ namespace Valuable
     }
 
     m_children.erase(it);
+    m_index.remove(value, cname);
     value->m_parent = 0;
   }
 
@@ -229,6 +229,7 @@ namespace Valuable
     vp.m_listener = obj;
     vp.m_from = from;
     vp.m_to = to;
+    vp.m_fromHash = NameIndex::hash(vp.m_from);
 
     if(defaultData)
       vp.m_defaultData = *defaultData;
@@ -285,27 +286,20 @@ namespace Valuable
     if(!id)
       return;
 
+    // Look up the first path segment in place, without copying it
     const char * delim = strchr(id, '/');
 
-    std::string key(id);
-    int skip;
-
-    if(delim) {
-      skip = delim - id;
-      key.erase(key.begin() + skip, key.end());
-      skip++;
-    }
-    else
-      skip = key.size();
+    size_t len = delim ? delim - id : strlen(id);
+    const char * rest = delim ? delim + 1 : id + len;
 
-    // info("HasValues::processMessage # Child id = %s", key.c_str());
+    // info("HasValues::processMessage # Child id = %.*s", (int) len, id);
 
-    ValueObject * vo = getValue(key);
+    ValueObject * vo = m_index.find(id, len);
 
     if(vo) {
       // info("HasValues::processMessage # Sending message \"%s\" to %s",
-      // id + skip, typeid(*vo).name());
-      vo->processMessage(id + skip, data);
+      // rest, typeid(*vo).name());
+      vo->processMessage(rest, data);
     }
   }
 
@@ -330,9 +324,11 @@ namespace Valuable
     if(!id || !m_eventsEnabled)
       return;
 
+    uint32_t h = NameIndex::hash(id, strlen(id));
+
     for(Listeners::iterator it = m_elisteners.begin(); it != m_elisteners.end(); it++) {
       ValuePass & vp = *it;
-      if(vp.m_from == id) {
+      if(vp.m_fromHash == h && vp.m_from == id) {
 
         BinaryData & bdsend = vp.m_defaultData.total() ? vp.m_defaultData : bd;
 
@@ -360,6 +356,9 @@ namespace Valuable
     ValueObject * vo = (*it).second;
     m_children.erase(it);
     m_children[now] = vo;
+
+    m_index.remove(vo, was);
+    m_index.insert(vo, now);
   }
 
 
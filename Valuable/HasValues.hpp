@@ -17,6 +17,7 @@
 #define VALUABLE_HASVALUES_HPP
 
 #include <Valuable/Export.hpp>
+#include <Valuable/NameIndex.hpp>
 #include <Valuable/ValueInt.hpp>
 #include <Valuable/ValueObject.hpp>
 
@@ -166,10 +167,12 @@ namespace Valuable
     void childRenamed(const std::string & was, const std::string & now);
 
     container m_children;
+    // Hash index of m_children, used for message routing
+    NameIndex m_index;
 
     class ValuePass {
     public:
-      ValuePass() : m_listener(0) {}
+      ValuePass() : m_listener(0), m_fromHash(0) {}
 
       inline bool operator == (const ValuePass & that) const
       { return (m_listener == that.m_listener) && (m_from == that.m_from) &&
@@ -179,6 +182,8 @@ namespace Valuable
       Radiant::BinaryData   m_defaultData;
       std::string m_from;
       std::string m_to;
+      // NameIndex::hash of m_from, compared before the strings
+      uint32_t m_fromHash;
     };
 
     typedef std::list<ValuePass> Listeners;
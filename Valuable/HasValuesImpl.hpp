@@ -40,20 +40,18 @@ namespace Valuable
       return m_parent->setValue(rest, v);
     }
 
-    container::iterator it = m_children.find(next);
-    if(it == m_children.end()) {
+    ValueObject * vo = m_index.find(next);
+    if(!vo) {
       Radiant::error(
           "HasValues::setValue # property '%s' not found", next.c_str());
       return false;
     }
 
-    HasValues * hv = dynamic_cast<HasValues *> (it->second);
+    HasValues * hv = dynamic_cast<HasValues *> (vo);
     if(hv)
       return hv->setValue(rest, v);
-    else {
-      ValueObject * vo = it->second;
+    else
       return vo->set(v);
-    }
   }
 
 }
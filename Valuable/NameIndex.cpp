@@ -0,0 +1,132 @@
+/* COPYRIGHT
+ *
+ * This file is part of Valuable.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Valuable.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#include "NameIndex.hpp"
+
+#include "ValueObject.hpp"
+
+#include <cstring>
+
+namespace Valuable
+{
+
+  NameIndex::NameIndex()
+    : m_count(0)
+  {}
+
+  uint32_t NameIndex::hash(const char * name, size_t len)
+  {
+    uint32_t h = 2166136261u;
+
+    for(size_t i = 0; i < len; i++) {
+      h ^= (unsigned char) name[i];
+      h *= 16777619u;
+    }
+
+    return h;
+  }
+
+  void NameIndex::insert(ValueObject * object, const std::string & name)
+  {
+    // Keep the table at most half full
+    if((m_count + 1) * 2 > m_slots.size())
+      rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+
+    uint32_t h = hash(name);
+    size_t mask = m_slots.size() - 1;
+    size_t i = h & mask;
+
+    while(m_slots[i].m_object)
+      i = (i + 1) & mask;
+
+    m_slots[i].m_hash = h;
+    m_slots[i].m_object = object;
+    m_count++;
+  }
+
+  bool NameIndex::remove(ValueObject * object, const std::string & name)
+  {
+    if(m_slots.empty())
+      return false;
+
+    size_t mask = m_slots.size() - 1;
+    size_t i = hash(name) & mask;
+
+    while(m_slots[i].m_object != object) {
+      if(!m_slots[i].m_object)
+        return false;
+      i = (i + 1) & mask;
+    }
+
+    /* Shift the following entries of the probe sequence back, so that
+       lookups never need tombstones. */
+    for(size_t j = (i + 1) & mask; m_slots[j].m_object; j = (j + 1) & mask) {
+      size_t home = m_slots[j].m_hash & mask;
+
+      // Can the entry at j move to i, without going before its home slot?
+      bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+
+      if(movable) {
+        m_slots[i] = m_slots[j];
+        i = j;
+      }
+    }
+
+    m_slots[i] = Slot();
+    m_count--;
+
+    return true;
+  }
+
+  ValueObject * NameIndex::find(const char * name, size_t len) const
+  {
+    if(!m_count)
+      return 0;
+
+    uint32_t h = hash(name, len);
+    size_t mask = m_slots.size() - 1;
+
+    for(size_t i = h & mask; m_slots[i].m_object; i = (i + 1) & mask) {
+      const Slot & s = m_slots[i];
+
+      if(s.m_hash == h) {
+        const std::string & n = s.m_object->name();
+        if(n.size() == len && memcmp(n.data(), name, len) == 0)
+          return s.m_object;
+      }
+    }
+
+    return 0;
+  }
+
+  void NameIndex::rehash(size_t slots)
+  {
+    std::vector<Slot> old(slots);
+    old.swap(m_slots);
+
+    size_t mask = m_slots.size() - 1;
+
+    for(size_t k = 0; k < old.size(); k++) {
+      if(!old[k].m_object)
+        continue;
+
+      size_t i = old[k].m_hash & mask;
+      while(m_slots[i].m_object)
+        i = (i + 1) & mask;
+
+      m_slots[i] = old[k];
+    }
+  }
+
+}
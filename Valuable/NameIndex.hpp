@@ -0,0 +1,81 @@
+/* COPYRIGHT
+ *
+ * This file is part of Valuable.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "Valuable.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#ifndef VALUABLE_NAME_INDEX_HPP
+#define VALUABLE_NAME_INDEX_HPP
+
+#include <Valuable/Export.hpp>
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace Valuable
+{
+  class ValueObject;
+
+  /// Hash index for finding child objects by name
+  /** The index is an open-addressing hash table that stores the
+      objects together with the hashes of their names. The names are
+      not copied: lookups compare against ValueObject::name(), so the
+      index must be updated whenever a child is renamed.
+
+      Lookups take a pointer and a length, so that a segment of a
+      message path can be looked up without building a std::string. */
+  class VALUABLE_API NameIndex
+  {
+  public:
+    NameIndex();
+
+    /// Calculates the hash of a name (32-bit FNV-1a)
+    static uint32_t hash(const char * name, size_t len);
+    /// Calculates the hash of a name
+    static uint32_t hash(const std::string & name)
+    { return hash(name.c_str(), name.size()); }
+
+    /// Adds an object to the index with the given name
+    void insert(ValueObject * object, const std::string & name);
+    /// Removes an object that was added with the given name
+    /** @return true if the object was found */
+    bool remove(ValueObject * object, const std::string & name);
+
+    /// Finds an object by name, returns zero if it is not in the index
+    ValueObject * find(const char * name, size_t len) const;
+    /// Finds an object by name, returns zero if it is not in the index
+    ValueObject * find(const std::string & name) const
+    { return find(name.c_str(), name.size()); }
+
+    /// Returns the number of objects in the index
+    size_t size() const { return m_count; }
+
+  private:
+
+    struct Slot
+    {
+      Slot() : m_hash(0), m_object(0) {}
+
+      uint32_t      m_hash;
+      ValueObject * m_object;
+    };
+
+    void rehash(size_t slots);
+
+    std::vector<Slot> m_slots;
+    size_t m_count;
+  };
+
+}
+
+#endif
@@ -11,6 +11,7 @@ HEADERS += DOMElement.hpp
 HEADERS += Export.hpp
 HEADERS += HasValues.hpp
 HEADERS += HasValuesImpl.hpp
+HEADERS += NameIndex.hpp
 HEADERS += Valuable.hpp
 HEADERS += ValueBool.hpp
 HEADERS += ValueColor.hpp
@@ -34,6 +35,7 @@ SOURCES += ConfigDocument.cpp
 SOURCES += ConfigElement.cpp
 SOURCES += ConfigValue.cpp
 SOURCES += HasValues.cpp
+SOURCES += NameIndex.cpp
 SOURCES += Valuable.cpp
 SOURCES += ValueBool.cpp
 SOURCES += ValueColor.cpp
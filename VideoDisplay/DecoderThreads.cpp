@@ -0,0 +1,140 @@
+/* COPYRIGHT
+ *
+ * This file is part of VideoDisplay.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "VideoDisplay.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+
+#include "DecoderThreads.hpp"
+
+#include <Radiant/PlatformUtils.hpp>
+#include <Radiant/Trace.hpp>
+
+namespace VideoDisplay {
+
+  using namespace Radiant;
+
+  DecoderThreads::DecoderThreads()
+    : m_granted(0),
+      m_budget(PlatformUtils::getNumberOfCPUs())
+  {
+    if(m_budget < 1)
+      m_budget = 1;
+  }
+
+  DecoderThreads::~DecoderThreads()
+  {}
+
+  DecoderThreads & DecoderThreads::instance()
+  {
+    static DecoderThreads threads;
+    return threads;
+  }
+
+  void DecoderThreads::setCoreBudget(int cores)
+  {
+    Guard g( & m_mutex);
+    m_budget = cores < 1 ? 1 : cores;
+  }
+
+  int DecoderThreads::coreBudget() const
+  {
+    Guard g( & m_mutex);
+    return m_budget;
+  }
+
+  int DecoderThreads::start(const void * video, int width, int height)
+  {
+    Guard g( & m_mutex);
+
+    // A restart gives back the earlier grant first
+    container::iterator it = m_videos.find(video);
+
+    if(it != m_videos.end()) {
+      m_granted -= it->second.m_threads;
+      m_videos.erase(it);
+    }
+
+    long pixels = (long) width * height;
+    m_videos[video] = Grant(pixels, 0);
+
+    // Take only what the other videos have left, but always one thread
+    int n = share(pixels);
+    int left = m_budget - m_granted;
+
+    if(n > left)
+      n = left;
+    if(n < 1)
+      n = 1;
+
+    m_videos[video].m_threads = n;
+    m_granted += n;
+
+    debug("DecoderThreads::start # %p %d x %d, %d threads (%d videos, "
+          "%d of %d threads granted)", video, width, height, n,
+          (int) m_videos.size(), m_granted, m_budget);
+
+    return n;
+  }
+
+  void DecoderThreads::stop(const void * video)
+  {
+    Guard g( & m_mutex);
+
+    container::iterator it = m_videos.find(video);
+
+    if(it == m_videos.end())
+      return;
+
+    m_granted -= it->second.m_threads;
+    m_videos.erase(it);
+  }
+
+  int DecoderThreads::threads(const void * video) const
+  {
+    Guard g( & m_mutex);
+
+    container::const_iterator it = m_videos.find(video);
+
+    return it == m_videos.end() ? 0 : it->second.m_threads;
+  }
+
+  int DecoderThreads::activeVideos() const
+  {
+    Guard g( & m_mutex);
+    return (int) m_videos.size();
+  }
+
+  int DecoderThreads::share(long pixels) const
+  {
+    if(pixels < SMALL_VIDEO_PIXELS)
+      return 1;
+
+    // Each playing video already has its own thread
+    int spare = m_budget - (int) m_videos.size();
+
+    if(spare <= 0)
+      return 1;
+
+    double large = 0.0;
+
+    for(container::const_iterator it = m_videos.begin();
+        it != m_videos.end(); it++) {
+      if(it->second.m_pixels >= SMALL_VIDEO_PIXELS)
+        large += it->second.m_pixels;
+    }
+
+    int n = 1 + (int) (spare * (pixels / large));
+
+    return n < MAX_THREADS ? n : MAX_THREADS;
+  }
+
+}
@@ -0,0 +1,108 @@
+/* COPYRIGHT
+ *
+ * This file is part of VideoDisplay.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "VideoDisplay.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+
+#ifndef VIDEODISPLAY_DECODER_THREADS_HPP
+#define VIDEODISPLAY_DECODER_THREADS_HPP
+
+#include <VideoDisplay/Export.hpp>
+
+#include <Patterns/NotCopyable.hpp>
+
+#include <Radiant/Mutex.hpp>
+
+#include <map>
+
+namespace VideoDisplay {
+
+  /// Divides the CPU cores between the videos that are being decoded
+  /** Every playing video has a decoder thread of its own. Large videos
+      can also use extra threads inside the codec, so that a single
+      high-resolution video does not decode on one core while the
+      others are idle. This class decides how many threads each video
+      gets: the cores that are left after every playing video has its
+      own thread are divided between the large videos, in proportion
+      to their pixel counts. Small and stopped videos get no extra
+      threads.
+
+      The thread count is decided when the decoder is opened, and it
+      stays the same until the video is stopped. The threads of each
+      video are kept on record, and a video that starts later only
+      gets extra threads from the cores that are still free, so the
+      budget is never exceeded by more than the one thread that every
+      video needs. */
+  class VIDEODISPLAY_API DecoderThreads : public Patterns::NotCopyable
+  {
+  public:
+    DecoderThreads();
+    ~DecoderThreads();
+
+    /// Returns the object that all the videos share
+    static DecoderThreads & instance();
+
+    /// Sets the number of cores for video decoding
+    /** By default all the CPUs of the computer are used. */
+    void setCoreBudget(int cores);
+    /// Returns the number of cores for video decoding
+    int coreBudget() const;
+
+    /// Registers a video that starts playing
+    /** @param video The video, used as a key
+        @param width The width of the video frames
+        @param height The height of the video frames
+        @return The number of threads that the decoder of the video
+        should use, at least one */
+    int start(const void * video, int width, int height);
+    /// Unregisters a video that was stopped or paused
+    void stop(const void * video);
+
+    /// Returns the threads granted to the video, zero if it is not playing
+    int threads(const void * video) const;
+    /// Returns the number of playing videos
+    int activeVideos() const;
+
+    enum {
+      /// Videos with fewer pixels than this do not get extra threads
+      SMALL_VIDEO_PIXELS = 640 * 480,
+      /// Maximum number of threads per video
+      MAX_THREADS = 16
+    };
+
+  private:
+
+    int share(long pixels) const;
+
+    /// Threads given to one playing video
+    class Grant
+    {
+    public:
+      Grant(long pixels = 0, int threads = 0)
+        : m_pixels(pixels), m_threads(threads) {}
+
+      long m_pixels;
+      int m_threads;
+    };
+
+    typedef std::map<const void *, Grant> container;
+
+    mutable Radiant::MutexAuto m_mutex;
+    container m_videos;
+    // Sum of the granted threads
+    int m_granted;
+    int m_budget;
+  };
+
+}
+
+#endif
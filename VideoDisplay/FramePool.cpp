@@ -0,0 +1,236 @@
+/* COPYRIGHT
+ *
+ * This file is part of VideoDisplay.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "VideoDisplay.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#include "FramePool.hpp"
+
+#include <Radiant/Trace.hpp>
+
+#include <stdlib.h>
+
+namespace VideoDisplay {
+
+  using namespace Radiant;
+
+  FramePool::FramePool()
+    : m_limit(sizeof(void *) >= 8 ? ((uint64_t) 4 << 30) : ((uint64_t) 1 << 30)),
+    m_allocated(0),
+    m_cached(0)
+  {}
+
+  FramePool::~FramePool()
+  {
+    freeCached();
+  }
+
+  FramePool & FramePool::instance()
+  {
+    static FramePool pool;
+    return pool;
+  }
+
+  void * FramePool::acquire(size_t bytes, size_t & capacity, Counters * owner)
+  {
+    size_t size = sizeClass(bytes);
+
+    Guard g( & m_mutex);
+
+    void * data = 0;
+
+    Cache::iterator it = m_cache.find(size);
+
+    if(it != m_cache.end() && !it->second.empty()) {
+      data = it->second.back().m_data;
+      it->second.pop_back();
+      m_cached -= size;
+
+      m_counters.m_reuses++;
+      if(owner)
+        owner->m_reuses++;
+    }
+    else {
+      if(makeRoom(size))
+        data = malloc(size);
+
+      if(!data) {
+        m_counters.m_failures++;
+        if(owner)
+          owner->m_failures++;
+
+        error("FramePool::acquire # Cannot allocate %lu bytes (%lu of %lu in use)",
+              (unsigned long) size, (unsigned long) m_allocated,
+              (unsigned long) m_limit);
+        capacity = 0;
+        return 0;
+      }
+
+      m_allocated += size;
+
+      m_counters.m_allocations++;
+      if(owner)
+        owner->m_allocations++;
+    }
+
+    m_counters.m_buffersInUse++;
+    m_counters.m_bytesInUse += size;
+
+    if(owner) {
+      owner->m_buffersInUse++;
+      owner->m_bytesInUse += size;
+    }
+
+    capacity = size;
+
+    return data;
+  }
+
+  void FramePool::release(void * buffer, size_t capacity, Counters * owner)
+  {
+    if(!buffer)
+      return;
+
+    Guard g( & m_mutex);
+
+    m_counters.m_releases++;
+    m_counters.m_buffersInUse--;
+    m_counters.m_bytesInUse -= capacity;
+
+    if(owner) {
+      owner->m_releases++;
+      owner->m_buffersInUse--;
+      owner->m_bytesInUse -= capacity;
+    }
+
+    if(m_allocated > m_limit) {
+      // The limit was lowered, give the memory back
+      free(buffer);
+      m_allocated -= capacity;
+      return;
+    }
+
+    Buffer b(buffer);
+    b.m_released = TimeStamp::getTime();
+
+    m_cache[capacity].push_back(b);
+    m_cached += capacity;
+  }
+
+  void FramePool::freeIdle(Radiant::TimeStamp maxIdle)
+  {
+    Guard g( & m_mutex);
+
+    TimeStamp limit = TimeStamp::getTime() - maxIdle;
+
+    for(Cache::iterator it = m_cache.begin(); it != m_cache.end(); ++it) {
+      std::vector<Buffer> & buffers = it->second;
+
+      // The oldest buffers are at the front
+      size_t n = 0;
+      while(n < buffers.size() && buffers[n].m_released < limit) {
+        free(buffers[n].m_data);
+        n++;
+      }
+
+      buffers.erase(buffers.begin(), buffers.begin() + n);
+      m_cached -= n * it->first;
+      m_allocated -= n * it->first;
+    }
+  }
+
+  void FramePool::freeCached()
+  {
+    Guard g( & m_mutex);
+
+    for(Cache::iterator it = m_cache.begin(); it != m_cache.end(); ++it) {
+      for(size_t i = 0; i < it->second.size(); i++)
+        free(it->second[i].m_data);
+
+      m_allocated -= it->second.size() * it->first;
+    }
+
+    m_cache.clear();
+    m_cached = 0;
+  }
+
+  void FramePool::setByteLimit(uint64_t bytes)
+  {
+    Guard g( & m_mutex);
+    m_limit = bytes;
+    makeRoom(0);
+  }
+
+  uint64_t FramePool::byteLimit() const
+  {
+    Guard g( & m_mutex);
+    return m_limit;
+  }
+
+  uint64_t FramePool::bytesAllocated() const
+  {
+    Guard g( & m_mutex);
+    return m_allocated;
+  }
+
+  uint64_t FramePool::bytesCached() const
+  {
+    Guard g( & m_mutex);
+    return m_cached;
+  }
+
+  FramePool::Counters FramePool::counters(const Counters * owner) const
+  {
+    Guard g( & m_mutex);
+    return owner ? * owner : m_counters;
+  }
+
+  size_t FramePool::sizeClass(size_t bytes)
+  {
+    // The smallest power of two that is not below bytes (at least 4 kB)
+    size_t pow2 = 4096;
+    while(pow2 < bytes)
+      pow2 <<= 1;
+
+    // Four classes between pow2 / 2 and pow2
+    size_t step = pow2 / 8;
+    size_t size = pow2 / 2 + step;
+
+    while(size < bytes)
+      size += step;
+
+    return size;
+  }
+
+  bool FramePool::makeRoom(size_t bytes)
+  {
+    // Free the largest cached buffers first
+    Cache::reverse_iterator it = m_cache.rbegin();
+
+    while(m_allocated + bytes > m_limit && it != m_cache.rend()) {
+
+      std::vector<Buffer> & buffers = it->second;
+
+      if(buffers.empty()) {
+        ++it;
+        continue;
+      }
+
+      free(buffers.back().m_data);
+      buffers.pop_back();
+      m_cached -= it->first;
+      m_allocated -= it->first;
+    }
+
+    return m_allocated + bytes <= m_limit;
+  }
+
+}
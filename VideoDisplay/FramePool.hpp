@@ -0,0 +1,143 @@
+/* COPYRIGHT
+ *
+ * This file is part of VideoDisplay.
+ *
+ * Copyright: MultiTouch Oy, Helsinki University of Technology and others.
+ *
+ * See file "VideoDisplay.hpp" for authors and more details.
+ *
+ * This file is licensed under GNU Lesser General Public
+ * License (LGPL), version 2.1. The LGPL conditions can be found in
+ * file "LGPL.txt" that is distributed with this source package or obtained
+ * from the GNU organization (www.gnu.org).
+ *
+ */
+#ifndef VIDEODISPLAY_FRAME_POOL_HPP
+#define VIDEODISPLAY_FRAME_POOL_HPP
+
+#include <VideoDisplay/Export.hpp>
+
+#include <Patterns/NotCopyable.hpp>
+
+#include <Radiant/Mutex.hpp>
+#include <Radiant/TimeStamp.hpp>
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+namespace VideoDisplay {
+
+  /// A pool of video frame buffers that is shared by all videos
+  /** The decoded video frames are stored in buffers that come from
+      this pool. When a frame is freed, its buffer is kept in the pool
+      and handed to the next frame of about the same size, so that
+      seeking, restarting and switching between videos does not keep
+      allocating and freeing large blocks of memory.
+
+      The buffer sizes are rounded up to size classes, four classes per
+      power of two, so that frames of slightly different size can share
+      buffers.
+
+      The pool has a hard limit on the number of bytes that it
+      allocates, counting both the buffers in use and the cached
+      ones. When the limit is reached, cached buffers are freed, and
+      if that is not enough, the request fails. */
+  class VIDEODISPLAY_API FramePool : public Patterns::NotCopyable
+  {
+  public:
+
+    /// Memory statistics of the pool, or of a single video
+    class VIDEODISPLAY_API Counters
+    {
+    public:
+      Counters()
+        : m_allocations(0),
+        m_reuses(0),
+        m_releases(0),
+        m_failures(0),
+        m_buffersInUse(0),
+        m_bytesInUse(0)
+      {}
+
+      /// Number of buffers that were allocated from the system
+      uint64_t m_allocations;
+      /// Number of buffers that were recycled from the pool
+      uint64_t m_reuses;
+      /// Number of buffers that were returned to the pool
+      uint64_t m_releases;
+      /// Number of requests that failed because of the byte limit
+      uint64_t m_failures;
+      /// Number of buffers currently in use
+      uint64_t m_buffersInUse;
+      /// Bytes in the buffers that are currently in use
+      uint64_t m_bytesInUse;
+    };
+
+    FramePool();
+    /// Frees the cached buffers
+    ~FramePool();
+
+    /// Returns the pool that all the videos use
+    static FramePool & instance();
+
+    /// Gets a buffer of at least the given size
+    /** @param bytes The required buffer size
+        @param capacity Set to the actual size of the buffer, it must
+        be passed to release()
+        @param owner Counters of the video that uses the buffer, or null
+        @return The buffer, or null if the byte limit would be exceeded */
+    void * acquire(size_t bytes, size_t & capacity, Counters * owner = 0);
+    /// Returns a buffer to the pool
+    void release(void * buffer, size_t capacity, Counters * owner = 0);
+
+    /// Frees cached buffers that have not been used for a while
+    void freeIdle(Radiant::TimeStamp maxIdle);
+    /// Frees all cached buffers
+    void freeCached();
+
+    /// Sets the maximum number of bytes that the pool allocates
+    void setByteLimit(uint64_t bytes);
+    /// Returns the maximum number of bytes that the pool allocates
+    uint64_t byteLimit() const;
+
+    /// Returns the number of bytes allocated, in use and cached
+    uint64_t bytesAllocated() const;
+    /// Returns the number of bytes in cached buffers
+    uint64_t bytesCached() const;
+
+    /// Returns a copy of the counters of the video, or of the whole pool
+    Counters counters(const Counters * owner = 0) const;
+
+    /// Rounds the size up to its size class
+    static size_t sizeClass(size_t bytes);
+
+  private:
+
+    class Buffer
+    {
+    public:
+      Buffer(void * data = 0) : m_data(data) {}
+
+      void * m_data;
+      Radiant::TimeStamp m_released;
+    };
+
+    typedef std::map<size_t, std::vector<Buffer> > Cache;
+
+    // Frees cached buffers until "bytes" more can be allocated
+    bool makeRoom(size_t bytes);
+
+    mutable Radiant::MutexAuto m_mutex;
+
+    Cache m_cache;
+    uint64_t m_limit;
+    uint64_t m_allocated;
+    uint64_t m_cached;
+    Counters m_counters;
+  };
+
+}
+
+#endif
@@ -18,6 +18,8 @@
 #include "AudioTransfer.hpp"
 #include "VideoInFFMPEG.hpp"
 
+#include <Radiant/Atomic.hpp>
+#include <Radiant/BinaryArena.hpp>
 #include <Radiant/ImageConversion.hpp>
 #include <Radiant/Sleep.hpp>
 #include <Radiant/PlatformUtils.hpp>
@@ -26,6 +28,8 @@
 #include <Poetic/GPUFont.hpp>
 #include <Poetic/CPUFont.hpp>
 
+#include <Luminous/BGThread.hpp>
+#include <Luminous/Task.hpp>
 #include <Luminous/Utils.hpp>
 
 namespace VideoDisplay {
@@ -155,20 +159,133 @@ namespace VideoDisplay {
     return ok;
   }
 
+  /* One pixel buffer object in the upload ring. */
+  class ShowGL::MyTextures::Slot
+  {
+  public:
+    Slot()
+      : m_pbo(0),
+      m_mapped(0),
+      m_frame(-1),
+      m_format(Radiant::IMAGE_UNKNOWN),
+      m_width(0),
+      m_height(0),
+      m_bytes(0),
+      m_copied(0),
+      m_ok(false),
+      m_busy(false)
+    {
+      bzero(m_offsets, sizeof(m_offsets));
+    }
+
+    GLuint m_pbo;
+    unsigned char * m_mapped;
+    int m_frame;
+    // The layout of the frame in the buffer
+    Radiant::ImageFormat m_format;
+    int m_width;
+    int m_height;
+    Vector2i m_areas[3];
+    long m_offsets[3];
+    long m_bytes;
+    // Set by the copy task, when it is done with the buffer
+    volatile int m_copied;
+    // Set by the copy task, if the frame was copied
+    bool m_ok;
+    bool m_busy;
+  };
+
+  /* Copies the planes of one frame to a mapped pixel buffer. */
+  class ShowGL::MyTextures::CopyTask : public Luminous::Task
+  {
+  public:
+    CopyTask(Slot * slot, VideoIn * video, VideoIn::Frame * frame,
+             volatile int * pending)
+      : Task(PRIORITY_HIGH),
+      m_slot(slot),
+      m_video(video),
+      m_frame(frame),
+      m_pending(pending)
+    {}
+
+    virtual void doTask()
+    {
+      // The decoder does not touch the frame while the mutex is held
+      if(m_video)
+        m_video->mutex().lock();
+
+      const Radiant::VideoImage & img = m_frame->m_image;
+
+      m_slot->m_ok = img.m_format == m_slot->m_format &&
+                     img.m_width == m_slot->m_width &&
+                     img.m_height == m_slot->m_height;
+
+      if(m_slot->m_ok) {
+        for(int i = 0; i < 3; i++) {
+          Vector2i area = m_slot->m_areas[i];
+          unsigned char * dest = m_slot->m_mapped + m_slot->m_offsets[i];
+
+          for(int y = 0; y < area.y; y++)
+            memcpy(dest + y * area.x, img.m_planes[i].line(y), area.x);
+        }
+      }
+
+      if(m_video)
+        m_video->mutex().unlock();
+
+      /* After this the slot belongs to the rendering thread, and the
+         ShowGL may be deleted. */
+      Radiant::Atomic::memoryBarrier();
+      m_slot->m_copied = 1;
+      Radiant::Atomic::add(m_pending, -1);
+
+      m_state = DONE;
+    }
+
+    virtual void finished()
+    {
+      delete this;
+    }
+
+  private:
+    Slot * m_slot;
+    VideoIn * m_video;
+    VideoIn::Frame * m_frame;
+    volatile int * m_pending;
+  };
+
   // static int __mytexcount = 0;
 
   ShowGL::MyTextures::MyTextures(Luminous::GLResources * resources)
-      : GLResource(resources)
+      : GLResource(resources),
+      m_usePBO(GLEW_ARB_pixel_buffer_object)
   {
     m_frame = -1;
 
     bzero(m_texSizes, sizeof(m_texSizes));
+
+    for(int i = 0; i < SLOTS; i++)
+      m_slots[i] = new Slot();
     // __mytexcount++;
     // info("ShowGL::MyTextures::MyTextures # %d", __mytexcount);
   }
 
   ShowGL::MyTextures::~MyTextures()
   {
+    for(int i = 0; i < SLOTS; i++) {
+      Slot * s = m_slots[i];
+
+      // Let running copies finish, before the memory is unmapped
+      while(s->m_busy && !s->m_copied)
+        Radiant::Sleep::sleepMs(1);
+
+      releaseSlot(s);
+
+      if(s->m_pbo)
+        glDeleteBuffers(1, & s->m_pbo);
+
+      delete s;
+    }
     // __mytexcount--;
     // info("ShowGL::MyTextures::~MyTextures # %d", __mytexcount);
   }
@@ -191,18 +308,26 @@ namespace VideoDisplay {
     glActiveTexture(GL_TEXTURE0);
   }
 
-  void ShowGL::MyTextures::doTextures(int frame, Radiant::VideoImage * img)
+  void ShowGL::MyTextures::doTextures(int frame, ShowGL * show)
   {
-    if(m_frame == frame)
-      return;
+    Radiant::VideoImage * img = & show->m_frame->m_image;
+    bool rgb = img->m_format == Radiant::IMAGE_RGB_24;
 
-    if(img->m_format == Radiant::IMAGE_RGB_24) {
-      doTexturesRGB(img);
+    if(m_usePBO && !rgb) {
+      streamTexturesYUV(frame, show);
+      return;
     }
-    else {
-      doTexturesYUV(img);
+
+    if(m_frame == frame) {
+      show->m_uploadStats.m_skipped++;
+      return;
     }
 
+    long bytes = rgb ? doTexturesRGB(img) : doTexturesYUV(img);
+
+    show->m_uploadStats.m_frames++;
+    show->m_uploadStats.m_bytes += bytes;
+
     m_frame = frame;
   }
 
@@ -215,7 +340,8 @@ namespace VideoDisplay {
         area.x /= 4;
       }
       else if(img->m_format == Radiant::IMAGE_YUV_420P) {
-        area /= 2;
+        area.x /= 2;
+        area.y /= 2;
       }
       else if(img->m_format == Radiant::IMAGE_YUV_422P) {
         area.x /= 2;
@@ -226,7 +352,7 @@ namespace VideoDisplay {
   }
 
 
-  void ShowGL::MyTextures::doTexturesRGB(Radiant::VideoImage *img)
+  long ShowGL::MyTextures::doTexturesRGB(Radiant::VideoImage *img)
   {
     glActiveTexture(GL_TEXTURE0);
 
@@ -241,10 +367,13 @@ namespace VideoDisplay {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+    return long(img->width()) * img->height() * 3;
   }
 
-  void ShowGL::MyTextures::doTexturesYUV(Radiant::VideoImage *img)
+  long ShowGL::MyTextures::doTexturesYUV(Radiant::VideoImage *img)
   {
+    long bytes = 0;
 
     for(uint i = 0; i < 3; i++) {
 
@@ -253,64 +382,242 @@ namespace VideoDisplay {
       Luminous::Texture2D * tex = & m_texIds[i];
       tex->bind();
 
-      Vector2i area, real = planeSize(img, i);
+      Vector2i area = uploadArea(img, i);
       Vector2i & ts = m_texSizes[i];
 
-      area = real;
-
-      if(area.x & 0x3) {
-        area.x -= area.x & 0x3;
-      }
-      if(area.y & 0x3)
-        area.y -= area.y & 0x3;
-
-      ts = area;
-
-      if(m_frame < 0 || area != tex->size()) {
-
-        debug("ShowGL::YUVProgram::doTextures # area = [%d %d] ptr = %p",
-              area.x, area.y, img->m_planes[i].m_data);
-
-        tex->setWidth(area.x);
-        tex->setHeight(area.y);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE,
-                     area.x, area.y, 0,
-                     GL_LUMINANCE, GL_UNSIGNED_BYTE, 0);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-
-        Luminous::Utils::glCheck
-            ("ShowGL::YUVProgram::doTextures # glTexImage2D");
-
-      }
+      resizeTexture(i, area);
 
       // info("ShowGL::YUVProgram::doTextures # frame = %d, ts = [%d %d]",
       // frame, ts.x, ts.y);
 
-      if(real.x & 0x3) {
+      /* The lines may be padded (decoded pictures are used as such),
+         so the upload follows the line size of the plane. */
+      const Radiant::VideoImage::Plane & plane = img->m_planes[i];
+
+      if(plane.m_linesize & 0x3) {
 
         for(int y = 0; y < area.y; y++) {
           glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y,
                           ts.x, 1,
                           GL_LUMINANCE, GL_UNSIGNED_BYTE,
-                          img->m_planes[i].m_data + y * real.x);
+                          plane.line(y));
 
         }
       }
-      else
+      else {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, plane.m_linesize);
         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
                         ts.x, ts.y,
                         GL_LUMINANCE, GL_UNSIGNED_BYTE,
-                        img->m_planes[i].m_data);
+                        plane.m_data);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+      }
 
       Luminous::Utils::glCheck
           ("ShowGL::YUVProgram::doTextures # glTexSubImage2D");
+
+      bytes += long(area.x) * area.y;
     }
+
+    return bytes;
+  }
+
+  void ShowGL::MyTextures::streamTexturesYUV(int frame, ShowGL * show)
+  {
+    finishUploads(show);
+
+    if(m_frame == frame) {
+      show->m_uploadStats.m_skipped++;
+      return;
+    }
+
+    if(isPending(frame))
+      return;
+
+    VideoIn::Frame * f = show->m_frame;
+    Radiant::VideoImage * img = & f->m_image;
+
+    if(m_frame < 0) {
+      // The first frame is loaded directly, to have something to show
+      show->m_uploadStats.m_frames++;
+      show->m_uploadStats.m_bytes += doTexturesYUV(img);
+      m_frame = frame;
+      return;
+    }
+
+    Slot * slot = 0;
+
+    for(int i = 0; i < SLOTS && !slot; i++)
+      if(!m_slots[i]->m_busy)
+        slot = m_slots[i];
+
+    // All buffers are in use, try again on the next frame
+    if(!slot)
+      return;
+
+    long bytes = 0;
+
+    for(uint i = 0; i < 3; i++) {
+      slot->m_areas[i] = uploadArea(img, i);
+      slot->m_offsets[i] = bytes;
+      bytes += long(slot->m_areas[i].x) * slot->m_areas[i].y;
+    }
+
+    if(!slot->m_pbo)
+      glGenBuffers(1, & slot->m_pbo);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->m_pbo);
+    // Orphan the old storage, so that mapping does not wait for the GPU
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, 0, GL_STREAM_DRAW);
+    slot->m_mapped = (unsigned char *)
+                     glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if(!slot->m_mapped) {
+      error("ShowGL::MyTextures::streamTexturesYUV # Could not map a pixel "
+            "buffer, using direct uploads");
+      m_usePBO = false;
+      show->m_uploadStats.m_frames++;
+      show->m_uploadStats.m_bytes += doTexturesYUV(img);
+      m_frame = frame;
+      return;
+    }
+
+    slot->m_frame = frame;
+    slot->m_format = img->m_format;
+    slot->m_width = img->m_width;
+    slot->m_height = img->m_height;
+    slot->m_bytes = bytes;
+    slot->m_copied = 0;
+    slot->m_ok = false;
+    slot->m_busy = true;
+
+    Radiant::Atomic::add( & show->m_pendingUploads, 1);
+
+    Luminous::BGThread::instance()->addTask
+        (new CopyTask(slot, show->m_video, f, & show->m_pendingUploads));
+  }
+
+  void ShowGL::MyTextures::finishUploads(ShowGL * show)
+  {
+    // The latest copied frame goes to the textures, older ones are dropped
+    Slot * latest = 0;
+
+    for(int i = 0; i < SLOTS; i++) {
+      Slot * s = m_slots[i];
+
+      if(s->m_busy && s->m_copied && s->m_ok && s->m_frame > m_frame &&
+         (!latest || s->m_frame > latest->m_frame))
+        latest = s;
+    }
+
+    if(latest) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, latest->m_pbo);
+      bool ok = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+      latest->m_mapped = 0;
+
+      if(ok) {
+        for(uint i = 0; i < 3; i++) {
+          glActiveTexture(GL_TEXTURE0 + i);
+          glEnable(GL_TEXTURE_2D);
+          m_texIds[i].bind();
+
+          Vector2i area = latest->m_areas[i];
+
+          resizeTexture(i, area);
+
+          // With the buffer bound, the data pointer is an offset to the buffer
+          glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, area.x, area.y,
+                          GL_LUMINANCE, GL_UNSIGNED_BYTE,
+                          (const GLvoid *) (size_t) latest->m_offsets[i]);
+        }
+
+        Luminous::Utils::glCheck
+            ("ShowGL::MyTextures::finishUploads # glTexSubImage2D");
+
+        show->m_uploadStats.m_frames++;
+        show->m_uploadStats.m_bytes += latest->m_bytes;
+        m_frame = latest->m_frame;
+      }
+      else
+        error("ShowGL::MyTextures::finishUploads # Pixel buffer contents "
+              "were lost");
+
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    for(int i = 0; i < SLOTS; i++) {
+      Slot * s = m_slots[i];
+
+      if(s->m_busy && s->m_copied)
+        releaseSlot(s);
+    }
+  }
+
+  bool ShowGL::MyTextures::isPending(int frame) const
+  {
+    for(int i = 0; i < SLOTS; i++)
+      if(m_slots[i]->m_busy && m_slots[i]->m_frame == frame)
+        return true;
+
+    return false;
+  }
+
+  void ShowGL::MyTextures::releaseSlot(Slot * slot)
+  {
+    if(slot->m_mapped) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->m_pbo);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      slot->m_mapped = 0;
+    }
+
+    slot->m_frame = -1;
+    slot->m_copied = 0;
+    slot->m_ok = false;
+    slot->m_busy = false;
+  }
+
+  Vector2i ShowGL::MyTextures::uploadArea(const Radiant::VideoImage *img,
+                                          uint i)
+  {
+    Vector2i area = planeSize(img, i);
+
+    if(area.x & 0x3) {
+      area.x -= area.x & 0x3;
+    }
+    if(area.y & 0x3)
+      area.y -= area.y & 0x3;
+
+    return area;
+  }
+
+  void ShowGL::MyTextures::resizeTexture(uint i, Vector2i area)
+  {
+    Luminous::Texture2D * tex = & m_texIds[i];
+
+    m_texSizes[i] = area;
+
+    if(area == tex->size())
+      return;
+
+    debug("ShowGL::MyTextures::resizeTexture # area = [%d %d]",
+          area.x, area.y);
+
+    tex->setWidth(area.x);
+    tex->setHeight(area.y);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE,
+                 area.x, area.y, 0,
+                 GL_LUMINANCE, GL_UNSIGNED_BYTE, 0);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+    Luminous::Utils::glCheck("ShowGL::MyTextures::resizeTexture # glTexImage2D");
   }
   /////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////
@@ -326,7 +633,8 @@ namespace VideoDisplay {
       m_state(PAUSE),
       m_updates(0),
       m_seeking(false),
-      m_contrast(this, "contrast", 1.0f)
+      m_contrast(this, "contrast", 1.0f),
+      m_pendingUploads(0)
   {
     debug("ShowGL::ShowGL # %p", this);
     clearHistogram();
@@ -336,6 +644,7 @@ namespace VideoDisplay {
   {
     debug("ShowGL::~ShowGL # %p", this);
     stop();
+    waitUploads();
     delete m_video;
   }
 
@@ -383,6 +692,7 @@ namespace VideoDisplay {
       debug("Captured preview frame %p", m_frame);
     }
 
+    waitUploads();
     delete m_video;
     m_video = ffmpg;
 
@@ -599,7 +909,7 @@ namespace VideoDisplay {
 
       // debug("ShowGL::render # %p %p", this, m_frame);
 
-      textures->doTextures(m_count, & m_frame->m_image);
+      textures->doTextures(m_count, this);
       textures->bind();
 
       if(m_frame->m_image.m_format < Radiant::IMAGE_RGB_24) {
@@ -747,7 +1057,8 @@ namespace VideoDisplay {
 
     char buf[128];
 
-    Radiant::BinaryData control;
+    // Sent every frame, keep the message out of the heap
+    Radiant::BinaryData control(Radiant::BinaryArena::threadArena());
 
     control.writeString("panner/setsourcelocation");
 
@@ -764,4 +1075,10 @@ namespace VideoDisplay {
     bzero(m_histogram, sizeof(m_histogram));
   }
 
+  void ShowGL::waitUploads()
+  {
+    while(m_pendingUploads)
+      Radiant::Sleep::sleepMs(1);
+  }
+
 }
@@ -102,7 +102,11 @@ namespace VideoDisplay {
 
       virtual void bind();
       virtual void unbind();
-      void doTextures(int frame, Radiant::VideoImage *);
+      /// Updates the textures to show the current frame of the video
+      /** The YUV frames are streamed through pixel buffer objects: the
+          frame is copied into a mapped buffer in a BGThread task, and
+          the textures are updated from the buffer on a later call. */
+      void doTextures(int frame, ShowGL * show);
 
       Vector2i planeSize(const Radiant::VideoImage *img, uint i);
 
@@ -110,14 +114,30 @@ namespace VideoDisplay {
 
     private:
 
-      void doTexturesRGB(Radiant::VideoImage *);
-      void doTexturesYUV(Radiant::VideoImage *);
+      class Slot;
+      class CopyTask;
+
+      enum {
+        /// Number of pixel buffer objects in the upload ring
+        SLOTS = 3
+      };
+
+      long doTexturesRGB(Radiant::VideoImage *);
+      long doTexturesYUV(Radiant::VideoImage *);
+      void streamTexturesYUV(int frame, ShowGL * show);
+      void finishUploads(ShowGL * show);
+      bool isPending(int frame) const;
+      void releaseSlot(Slot * slot);
+      Vector2i uploadArea(const Radiant::VideoImage *img, uint i);
+      void resizeTexture(uint i, Vector2i area);
 
       int m_frame;
       Luminous::Texture2D  m_texIds[3];
       Vector2i             m_texSizes[3];
       Luminous::Texture2D  m_blankTex;
 
+      Slot * m_slots[SLOTS];
+      bool   m_usePBO;
     };
 
   public:
@@ -243,9 +263,32 @@ namespace VideoDisplay {
           */
     void setContrast(float contrast) { m_contrast = contrast; }
 
+    /// Statistics of the video texture uploads
+    class UploadStats
+    {
+    public:
+      UploadStats() : m_frames(0), m_bytes(0), m_skipped(0) {}
+
+      /// Returns the average number of bytes uploaded per frame
+      double bytesPerFrame() const
+      { return m_frames ? m_bytes / (double) m_frames : 0.0; }
+
+      /// Number of frames uploaded to the textures
+      uint64_t m_frames;
+      /// Number of bytes uploaded to the textures
+      uint64_t m_bytes;
+      /// Number of renders that reused the textures of the previous frame
+      uint64_t m_skipped;
+    };
+
+    /// Returns the statistics of the texture uploads
+    const UploadStats & uploadStats() const { return m_uploadStats; }
+
   private:
 
     void clearHistogram();
+    // Waits until the frames have been copied to the pixel buffers
+    void waitUploads();
 
     std::string             m_filename;
     VideoIn               * m_video;
@@ -268,6 +311,10 @@ namespace VideoDisplay {
     SubTitles               m_subTitles;
 
     Valuable::ValueFloat    m_contrast;
+
+    UploadStats             m_uploadStats;
+    // Frame copies to pixel buffers, that are running in BGThread
+    volatile int            m_pendingUploads;
   };
 
 }
@@ -1,12 +1,16 @@
 include(../multitude.pri)
 
 HEADERS += AudioTransfer.hpp
+HEADERS += DecoderThreads.hpp
 HEADERS += Export.hpp
+HEADERS += FramePool.hpp
 HEADERS += ShowGL.hpp
 HEADERS += SubTitles.hpp
 HEADERS += VideoIn.hpp
 HEADERS += VideoInFFMPEG.hpp
 
+SOURCES += DecoderThreads.cpp
+SOURCES += FramePool.cpp
 SOURCES += VideoIn.cpp
 SOURCES += VideoInFFMPEG.cpp
 
@@ -22,6 +22,8 @@
 #include <Radiant/Trace.hpp>
 #include <Radiant/VideoInput.hpp>
 
+#include <Screenplay/PictureBuffer.hpp>
+
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,11 +38,15 @@ namespace VideoDisplay {
   static Radiant::MutexStatic __countermutex;
   int    __framecount = 0;
 
-  VideoIn::Frame::Frame()
+  VideoIn::Frame::Frame(FramePool::Counters * owner)
       : m_audio(0),
       m_allocatedAudio(0),
       m_audioFrames(0),
-      m_type(FRAME_INVALID)
+      m_type(FRAME_INVALID),
+      m_buffer(0),
+      m_bufferSize(0),
+      m_picture(0),
+      m_owner(owner)
   {
     int tmp = 0;
     {
@@ -60,11 +66,96 @@ namespace VideoDisplay {
       tmp = __framecount;
     }
     debug("VideoIn::Frame::~Frame # %p Instance count at %d", this, tmp);
-    m_image.freeMemory();
+    releaseImage();
     if(m_audio)
       free(m_audio);
   }
 
+  bool VideoIn::Frame::prepareImage(const Radiant::VideoImage & like)
+  {
+    ImageFormat fmt = like.m_format;
+
+    // The planes of a picture are not ours, drop them with the picture
+    if(m_picture)
+      releaseImage();
+
+    if(m_buffer && m_image.m_format == fmt &&
+       m_image.m_width == like.m_width && m_image.m_height == like.m_height)
+      return true;
+
+    if(fmt != IMAGE_GRAYSCALE && fmt != IMAGE_RGB && fmt != IMAGE_RGBA &&
+       fmt != IMAGE_YUV_411P && fmt != IMAGE_YUV_420P &&
+       fmt != IMAGE_YUV_422P) {
+      error("VideoIn::Frame::prepareImage # Unsupported image format %s",
+            VideoImage::formatName(fmt));
+      return false;
+    }
+
+    // The planes are stored one after another, 16-byte aligned
+    Nimble::Vector2i areas[4];
+    size_t offsets[4];
+    size_t total = 0;
+
+    for(int i = 0; i < 4; i++) {
+      areas[i] = VideoImage::planeSize(fmt, like.m_width, like.m_height, i);
+      offsets[i] = total;
+      total += ((size_t) areas[i].x * areas[i].y + 15) & ~(size_t) 15;
+    }
+
+    if(!total)
+      return false;
+
+    if(total > m_bufferSize || total < m_bufferSize / 2) {
+      releaseImage();
+
+      m_buffer = FramePool::instance().acquire(total, m_bufferSize, m_owner);
+
+      if(!m_buffer)
+        return false;
+    }
+
+    m_image.m_format = fmt;
+    m_image.m_width = like.m_width;
+    m_image.m_height = like.m_height;
+
+    for(int i = 0; i < 4; i++) {
+      unsigned char * data = (areas[i].x && areas[i].y) ?
+        (unsigned char *) m_buffer + offsets[i] : 0;
+      m_image.m_planes[i].set(data, areas[i].x, like.m_planes[i].m_type);
+    }
+
+    return true;
+  }
+
+  void VideoIn::Frame::adoptImage(const Radiant::VideoImage & image,
+                                  Screenplay::PictureBuffer * picture)
+  {
+    picture->ref();
+
+    releaseImage();
+
+    m_picture = picture;
+    m_image = image;
+  }
+
+  void VideoIn::Frame::releaseImage()
+  {
+    /* Without a pool buffer or a picture the planes are the frame's
+       own, for example from VideoImage::allocateMemory. */
+    if(!m_buffer && !m_picture)
+      m_image.freeMemory();
+
+    FramePool::instance().release(m_buffer, m_bufferSize, m_owner);
+
+    if(m_picture)
+      m_picture->unref();
+
+    m_buffer = 0;
+    m_bufferSize = 0;
+    m_picture = 0;
+    m_image.reset();
+  }
+
   void VideoIn::Frame::copyAudio(const void * audio, int channels, int frames,
                                  Radiant::AudioSampleFormat format,
                                  Radiant::TimeStamp ts)
@@ -435,7 +526,8 @@ namespace VideoDisplay {
                                      FrameType type,
                                      Radiant::TimeStamp show,
                                      Radiant::TimeStamp absolute,
-                                     bool immediate)
+                                     bool immediate,
+                                     Screenplay::PictureBuffer * picture)
   {
     assert(m_frames.size() != 0);
 
@@ -464,11 +556,21 @@ namespace VideoDisplay {
     RefPtr<Frame> & rf = m_frames[m_decodedFrames % m_frames.size()];
 
     if(!rf.ptr()) {
-      rf = new Frame;
+      rf = new Frame( & m_frameMemory);
     }
 
     Frame & f = * rf.ptr();
 
+    // Keeps the decoded picture, or copies the image into a buffer of
+    // the frame
+    if(picture)
+      f.adoptImage(*im, picture);
+    else if(!f.prepareImage(*im)) {
+      error("VideoIn::putFrame # No memory for a %d x %d frame",
+            im->m_width, im->m_height);
+      return 0;
+    }
+
     f.m_type = type;
     f.m_time = show;
     f.m_absolute = absolute;
@@ -479,11 +581,7 @@ namespace VideoDisplay {
     if(type == FRAME_SNAPSHOT)
       m_consumedAuFrames = m_decodedFrames;
 
-    if(!f.m_image.m_planes[0].m_data) {
-      f.m_image.allocateMemory(*im);
-    }
-
-    bool ok = f.m_image.copyData(*im);
+    bool ok = picture || f.m_image.copyData(*im);
 
     if(!ok)
       error("VideoIn::putFrame # Radiant::Image::copyData failed");
@@ -528,6 +626,9 @@ namespace VideoDisplay {
         m_frames[i] = 0;
       }
     }
+
+    // Buffers that no video has wanted for a while go back to the system
+    FramePool::instance().freeIdle(Radiant::TimeStamp::createSecondsI(30));
   }
 
   void VideoIn::pushRequest(const Req & r)
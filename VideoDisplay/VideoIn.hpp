@@ -28,11 +28,16 @@
 #include <Radiant/TimeStamp.hpp>
 
 #include <VideoDisplay/Export.hpp>
+#include <VideoDisplay/FramePool.hpp>
 
 #include <sys/types.h>
 
 #include <vector>
 
+namespace Screenplay {
+  class PictureBuffer;
+}
+
 namespace VideoDisplay {
 
 
@@ -72,9 +77,26 @@ namespace VideoDisplay {
     class VIDEODISPLAY_API Frame : public Patterns::NotCopyable
     {
     public:
-      Frame();
+      /** @param owner The memory counters of the video that owns the
+          frame. */
+      Frame(FramePool::Counters * owner = 0);
       ~Frame();
 
+      /// Sets up m_image to match the format and size of the given image
+      /** The image data is stored in a buffer from FramePool. The
+          buffer is kept as long as it is large enough, and not much
+          too large. Returns false if no buffer could be obtained. */
+      bool prepareImage(const Radiant::VideoImage & like);
+      /// Makes m_image use the memory of a decoded picture
+      /** The frame keeps a reference to the picture, so that the
+          decoder does not reuse the picture while the frame shows
+          it. The image data is not copied. */
+      void adoptImage(const Radiant::VideoImage & image,
+                      Screenplay::PictureBuffer * picture);
+      /// Returns the image buffer to FramePool, or drops the picture
+      /** Planes that the frame allocated itself are freed. */
+      void releaseImage();
+
       void copyAudio(const void * audio, int channels, int frames,
                      Radiant::AudioSampleFormat format,
                      Radiant::TimeStamp ts);
@@ -90,6 +112,12 @@ namespace VideoDisplay {
       int       m_allocatedAudio;
       int       m_audioFrames;
       FrameType m_type;
+
+    private:
+      void    * m_buffer;
+      size_t    m_bufferSize;
+      Screenplay::PictureBuffer * m_picture;
+      FramePool::Counters * m_owner;
     };
 
     /** Basic informationa about a video file. */
@@ -142,6 +170,10 @@ namespace VideoDisplay {
 
     uint finalFrames()   const { return m_finalFrames; }
 
+    /// Returns the frame buffer memory statistics of this video
+    FramePool::Counters frameMemory() const
+    { return FramePool::instance().counters( & m_frameMemory); }
+
     const char * name() { return m_name.c_str(); }
 
     VIDEODISPLAY_API static void setDebug(int level);
@@ -177,11 +209,14 @@ namespace VideoDisplay {
 
     VIDEODISPLAY_API void deallocateFrames();
 
+    /** If the image is in a decoded picture buffer, the frame takes a
+        reference to the picture instead of copying the image. */
     VIDEODISPLAY_API Frame * putFrame(const Radiant::VideoImage *,
              FrameType type,
              Radiant::TimeStamp show,
              Radiant::TimeStamp absolute,
-             bool immediate);
+             bool immediate,
+             Screenplay::PictureBuffer * picture = 0);
 
     VIDEODISPLAY_API void ignorePreviousFrames();
     VIDEODISPLAY_API void freeFreeableMemory();
@@ -199,6 +234,9 @@ namespace VideoDisplay {
       REQUEST_QUEUE_SIZE = 32
     };
 
+    // Declared before m_frames, the frames update it as they are deleted
+    FramePool::Counters m_frameMemory;
+
     std::vector<Radiant::RefPtr<Frame> > m_frames;
 
     VideoInfo m_info;
@@ -15,6 +15,8 @@
 
 #include "VideoInFFMPEG.hpp"
 
+#include "DecoderThreads.hpp"
+
 #include <Radiant/Trace.hpp>
 
 #include <map>
@@ -55,14 +57,43 @@ namespace VideoDisplay {
 
   using namespace Radiant;
 
+  /* A decoded picture in a buffer from FramePool. */
+  class PooledPicture : public Screenplay::PictureBuffer
+  {
+  public:
+    PooledPicture(void * data, size_t capacity, FramePool::Counters * owner)
+      : Screenplay::PictureBuffer(data, capacity),
+      m_owner(owner)
+    {}
+
+  protected:
+    virtual ~PooledPicture()
+    {
+      FramePool::instance().release(data(), size(), m_owner);
+    }
+
+  private:
+    FramePool::Counters * m_owner;
+  };
+
+  Screenplay::PictureBuffer * VideoInFFMPEG::PicturePool::allocate(size_t bytes)
+  {
+    size_t capacity = 0;
+    void * data = FramePool::instance().acquire(bytes, capacity, m_owner);
+
+    return data ? new PooledPicture(data, capacity, m_owner) : 0;
+  }
+
   VideoInFFMPEG::VideoInFFMPEG()
-      : m_channels(0),
+      : m_pictures( & m_frameMemory),
+      m_channels(0),
       m_sampleRate(44100),
       m_audioCount(0),
       m_auformat(ASF_INT16)
 
   {
     m_audiobuf.resize(2 * 44100);
+    m_video.setPictureAllocator( & m_pictures);
   }
 
   VideoInFFMPEG::~VideoInFFMPEG()
@@ -73,6 +104,7 @@ namespace VideoDisplay {
       m_vcond.wakeAll(m_vmutex);
       waitEnd();
     }
+    DecoderThreads::instance().stop(this);
     debug("VideoInFFMPEG::~VideoInFFMPEG # EXIT");
   }
 
@@ -239,6 +271,10 @@ namespace VideoDisplay {
 
     info("VideoInFFMPEG::videoPlay # %lf", pos.secondsD());
 
+    m_video.setThreadCount(DecoderThreads::instance().
+                           start(this, m_info.m_videoFrameSize.x,
+                                 m_info.m_videoFrameSize.y));
+
     if(!m_video.open(m_name.c_str(), m_flags)) {
       endOfFile();
       debug("VideoInFFMPEG::videoPlay # Open failed for \"%s\"",
@@ -280,7 +316,8 @@ namespace VideoDisplay {
 
     if(pos == 0) {
 
-      Frame * f = putFrame(img, FRAME_STREAM, 0, m_video.frameTime(), true);
+      Frame * f = putFrame(img, FRAME_STREAM, 0, m_video.frameTime(), true,
+                           m_video.pictureBuffer());
 
       if(aframes && f) {
         Radiant::Guard g(mutex());
@@ -317,7 +354,8 @@ namespace VideoDisplay {
 
       if(m_frameTime >= pos) {
 
-        Frame * f = putFrame(img, FRAME_STREAM, 0, m_video.frameTime(), true);
+        Frame * f = putFrame(img, FRAME_STREAM, 0, m_video.frameTime(), true,
+                             m_video.pictureBuffer());
 
         if(aframes && f) {
           Radiant::Guard g(mutex());
@@ -351,7 +389,8 @@ namespace VideoDisplay {
 
     m_frameDelta = m_frameTime.secsTo(vt);
 
-    Frame * f = putFrame(img, FRAME_STREAM, vt + m_syncOffset, vt, false);
+    Frame * f = putFrame(img, FRAME_STREAM, vt + m_syncOffset, vt, false,
+                         m_video.pictureBuffer());
 
     int aframes = 0;
     const void * audio = m_video.captureAudio( & aframes);
@@ -376,6 +415,7 @@ namespace VideoDisplay {
   {
     debug("VideoInFFMPEG::videoStop");
     m_video.close();
+    DecoderThreads::instance().stop(this);
 
   }
 
@@ -395,6 +435,7 @@ namespace VideoDisplay {
 
   void VideoInFFMPEG::endOfFile()
   {
+    DecoderThreads::instance().stop(this);
     m_finalFrames = m_decodedFrames;
     m_playing = false;
     m_atEnd = true;
@@ -45,6 +45,19 @@ namespace VideoDisplay {
 
   private:
 
+    /* Allocates the decoded pictures from FramePool, and counts them
+       as the memory of this video. */
+    class PicturePool : public Screenplay::PictureAllocator
+    {
+    public:
+      PicturePool(FramePool::Counters * owner) : m_owner(owner) {}
+
+      virtual Screenplay::PictureBuffer * allocate(size_t bytes);
+
+    private:
+      FramePool::Counters * m_owner;
+    };
+
     virtual bool open(const char * filename, Radiant::TimeStamp pos);
 
     virtual void videoGetSnapshot(Radiant::TimeStamp pos);
@@ -66,6 +79,8 @@ namespace VideoDisplay {
     Radiant::TimeStamp m_duration;
     double m_frameDelta;
 
+    // Declared before m_video, the decoder releases its pictures on close
+    PicturePool m_pictures;
     Screenplay::VideoInputFFMPEG m_video;
 
     std::vector<float> m_audiobuf;